@@ -0,0 +1,431 @@
+// Benchmarks for each stage of the pipeline (`make bench`).
+//
+// Every workload is timed stage by stage, each in isolation:
+// - lex      Lexer::scanTokens, in source bytes per second
+// - parse    Parser::parse on tokens lexed beforehand, in AST nodes per second
+// - compile  Compiler::compile (which lexes, parses and type checks again),
+//            in bytecode bytes per second
+// - run      VM::run on a chunk loaded beforehand, in instructions per second;
+//            the count comes from one profiled run in the interpreter, so
+//            with the JIT it is the interpreter work done per second
+// Workloads are the .fs files given on the command line plus two generated
+// programs whose loops need not terminate, so they only go through the
+// front end. Each measurement runs --warmup times untimed, then --reps
+// times; the report gives min/p50/p90/max and the p50 throughput. --json
+// writes the results, one per line, and --baseline compares p50 against
+// such a file from another commit.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fcntl.h>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <unistd.h>
+#include <vector>
+#include "../src/include/compiler.h"  // Also the lexer and parser
+#include "../src/include/vm.h"
+
+namespace {
+
+struct Options {
+    int warmup = 1;
+    int reps = 5;
+    std::string json;
+    std::string baseline;
+    std::string label;
+    std::vector<std::string> workloads;
+};
+
+struct Workload {
+    std::string name;
+    std::string source;
+    bool runnable;
+};
+
+struct Result {
+    std::string workload;
+    std::string stage;
+    std::string unit;
+    double work;  // Units processed per repetition
+    std::vector<int64_t> nanos;  // Sorted
+    
+    int64_t percentile(double p) const {
+        size_t rank = static_cast<size_t>(p / 100 * (nanos.size() - 1) + 0.5);
+        return nanos[rank];
+    }
+    double throughput() const { return work / (percentile(50) / 1e9); }
+};
+
+// Counts every expression and statement in a tree.
+class NodeCounter : public ExpressionVisitor, public StatementVisitor {
+public:
+    size_t count = 0;
+    
+    void visit(const std::vector<std::unique_ptr<Statement>>& statements) {
+        for (auto& stmt : statements) {
+            stmt->accept(this);
+        }
+    }
+    
+    void visit(const std::vector<std::unique_ptr<Expression>>& expressions) {
+        for (auto& expr : expressions) {
+            expr->accept(this);
+        }
+    }
+    
+    void visitLiteral(Literal*) override { count++; }
+    void visitVariableExpression(VariableExpression*) override { count++; }
+    void visitGroupingExpression(GroupingExpression* expr) override { count++; expr->expression->accept(this); }
+    void visitUnaryExpression(UnaryExpression* expr) override { count++; expr->right->accept(this); }
+    void visitAwaitExpression(AwaitExpression* expr) override { count++; expr->operand->accept(this); }
+    void visitArrayExpression(ArrayExpression* expr) override { count++; visit(expr->elements); }
+    void visitCallExpression(CallExpression* expr) override { count++; visit(expr->arguments); }
+    void visitMemberExpression(MemberExpression*) override { count++; }
+    
+    void visitBinaryExpression(BinaryExpression* expr) override {
+        count++;
+        expr->left->accept(this);
+        expr->right->accept(this);
+    }
+    
+    void visitLogicalExpression(LogicalExpression* expr) override {
+        count++;
+        expr->left->accept(this);
+        expr->right->accept(this);
+    }
+    
+    void visitDictExpression(DictExpression* expr) override {
+        count++;
+        visit(expr->keys);
+        visit(expr->values);
+    }
+    
+    void visitIndexExpression(IndexExpression* expr) override {
+        count++;
+        expr->array->accept(this);
+        expr->index->accept(this);
+    }
+    
+    void visitExpressionStatement(ExpressionStatement* stmt) override { count++; stmt->expression->accept(this); }
+    void visitPrintStatement(PrintStatement* stmt) override { count++; stmt->expression->accept(this); }
+    void visitClassStatement(ClassStatement* stmt) override { count++; visit(stmt->methods); }
+    void visitTaskStatement(TaskStatement* stmt) override { count++; visit(stmt->body); }
+    void visitAssignStatement(AssignStatement* stmt) override { count++; stmt->value->accept(this); }
+    void visitBreakStatement(BreakStatement*) override { count++; }
+    void visitContinueStatement(ContinueStatement*) override { count++; }
+    void visitImportStatement(ImportStatement*) override { count++; }
+    
+    void visitSetIndexStatement(SetIndexStatement* stmt) override {
+        count++;
+        stmt->target->accept(this);
+        stmt->value->accept(this);
+    }
+    
+    void visitIfStatement(IfStatement* stmt) override {
+        count++;
+        stmt->condition->accept(this);
+        visit(stmt->thenBranch);
+        visit(stmt->elseBranch);
+    }
+    
+    void visitWhileStatement(WhileStatement* stmt) override {
+        count++;
+        stmt->condition->accept(this);
+        visit(stmt->body);
+    }
+    
+    void visitForStatement(ForStatement* stmt) override {
+        count++;
+        stmt->start->accept(this);
+        stmt->stop->accept(this);
+        visit(stmt->body);
+    }
+};
+
+// Ints in 16 variables mixed by random assignments, ifs and whiles. Only
+// the initial values are literals, since a chunk holds 256 constants (and
+// 256 loops); blocks stay short enough for 16-bit jumps.
+std::string generateProgram(int statements, uint32_t seed) {
+    auto next = [&seed](uint32_t bound) {
+        seed = seed * 1664525 + 1013904223;
+        return (seed >> 8) % bound;
+    };
+    auto variable = [&next]() { return "v" + std::to_string(next(16)); };
+    const char* ops[] = {" + ", " - ", " * "};
+    
+    std::ostringstream out;
+    for (int i = 0; i < 16; i++) {
+        out << "v" << i << " = " << i + 1 << "\n";
+    }
+    std::string indent;
+    int open = 0;
+    int inBlock = 0;  // Statements in the innermost open block
+    int loops = 0;
+    for (int i = 0; i < statements; i++) {
+        uint32_t kind = next(10);
+        if (open > 0 && inBlock == 12) kind = 9;
+        inBlock++;
+        if ((kind < 6 || open == 3) && kind != 9) {
+            out << indent << variable() << " = " << variable() << ops[next(3)] << "(" << variable()
+                << ops[next(3)] << variable() << ")\n";
+        } else if (kind < 8) {
+            bool loop = kind == 7 && loops < 200;
+            loops += loop;
+            out << indent << (loop ? "while " : "if ") << variable() << " < " << variable() << " {\n";
+            indent += "    ";
+            open++;
+            inBlock = 0;
+        } else if (open > 0) {
+            indent.resize(indent.size() - 4);
+            open--;
+            inBlock = 0;
+            out << indent << "}\n";
+        } else {
+            out << "print " << variable() << "\n";
+        }
+    }
+    while (open-- > 0) {
+        indent.resize(indent.size() - 4);
+        out << indent << "}\n";
+    }
+    return out.str();
+}
+
+// Send standard output (the workloads' print) to /dev/null while alive.
+class Silence {
+public:
+    Silence() : saved(dup(STDOUT_FILENO)) {
+        std::fflush(stdout);
+        int null = open("/dev/null", O_WRONLY);
+        dup2(null, STDOUT_FILENO);
+        close(null);
+    }
+    
+    ~Silence() {
+        std::fflush(stdout);
+        dup2(saved, STDOUT_FILENO);
+        close(saved);
+    }
+
+private:
+    int saved;
+};
+
+Result measure(const Options& options, const Workload& workload, const std::string& stage,
+               const std::string& unit, double work, const std::function<int64_t()>& once) {
+    Result result{workload.name, stage, unit, work, {}};
+    for (int i = 0; i < options.warmup; i++) {
+        once();
+    }
+    for (int i = 0; i < options.reps; i++) {
+        result.nanos.push_back(once());
+    }
+    std::sort(result.nanos.begin(), result.nanos.end());
+    return result;
+}
+
+template <typename F>
+int64_t timed(F&& body) {
+    auto start = std::chrono::steady_clock::now();
+    body();
+    return (std::chrono::steady_clock::now() - start).count();
+}
+
+void benchWorkload(const Options& options, const Workload& workload, std::vector<Result>& results) {
+    const std::string& source = workload.source;
+    std::vector<Token> tokens = Lexer(source).scanTokens();
+    NodeCounter nodes;
+    nodes.visit(Parser(tokens).parse());
+    Heap sizingHeap;
+    Chunk sizingChunk;
+    if (!Compiler(sizingHeap).compile(source, sizingChunk)) {
+        std::cerr << workload.name << " does not compile; skipped." << std::endl;
+        return;
+    }
+    
+    results.push_back(measure(options, workload, "lex", "bytes/s", source.size(), [&]() {
+        return timed([&]() { Lexer(source).scanTokens(); });
+    }));
+    results.push_back(measure(options, workload, "parse", "nodes/s", nodes.count, [&]() {
+        return timed([&]() { Parser(tokens).parse(); });
+    }));
+    results.push_back(measure(options, workload, "compile", "bytes/s", sizingChunk.code.size(), [&]() {
+        Heap heap;
+        Chunk chunk;
+        return timed([&]() { Compiler(heap).compile(source, chunk); });
+    }));
+    if (!workload.runnable) return;
+    
+    Silence silence;
+    uint64_t instructions;
+    {
+        VM vm;
+        vm.enableProfiling();
+        vm.interpret(source);
+        instructions = vm.getProfiler()->instructions();
+    }
+    results.push_back(measure(options, workload, "run", "instructions/s", instructions, [&]() {
+        VM vm;
+        vm.load(source);
+        return timed([&]() { vm.run(); });
+    }));
+}
+
+std::string readFile(const std::string& path, bool& ok) {
+    std::ifstream file(path, std::ios::binary);
+    std::stringstream contents;
+    contents << file.rdbuf();
+    ok = static_cast<bool>(file);
+    return contents.str();
+}
+
+std::string baseName(const std::string& path) {
+    size_t slash = path.find_last_of('/');
+    return slash == std::string::npos ? path : path.substr(slash + 1);
+}
+
+// p50 per "workload/stage" from a --json file.
+std::map<std::string, int64_t> readBaseline(const std::string& path, bool& ok) {
+    std::map<std::string, int64_t> p50s;
+    std::istringstream in(readFile(path, ok));
+    auto field = [](const std::string& line, const std::string& name) {
+        std::string key = "\"" + name + "\": ";
+        size_t at = line.find(key);
+        if (at == std::string::npos) return std::string();
+        at += key.size();
+        if (line[at] == '"') return line.substr(at + 1, line.find('"', at + 1) - at - 1);
+        return line.substr(at, line.find_first_of(",}", at) - at);
+    };
+    for (std::string line; std::getline(in, line);) {
+        std::string workload = field(line, "workload");
+        std::string p50 = field(line, "p50_ns");
+        if (!workload.empty() && !p50.empty()) {
+            p50s[workload + "/" + field(line, "stage")] = std::atoll(p50.c_str());
+        }
+    }
+    return p50s;
+}
+
+void printReport(std::ostream& out, const std::vector<Result>& results,
+                 const std::map<std::string, int64_t>& baseline) {
+    auto millis = [](int64_t ns) { return ns / 1e6; };
+    out << std::left << std::setw(20) << "workload" << std::setw(9) << "stage" << std::right
+        << std::setw(10) << "min ms" << std::setw(10) << "p50 ms" << std::setw(10) << "p90 ms"
+        << std::setw(10) << "max ms" << std::setw(12) << "p50 rate" << "  unit";
+    if (!baseline.empty()) out << std::setw(21) << "vs base";
+    out << std::endl;
+    
+    for (const Result& result : results) {
+        out << std::left << std::setw(20) << result.workload << std::setw(9) << result.stage
+            << std::right << std::fixed << std::setprecision(3)
+            << std::setw(10) << millis(result.nanos.front()) << std::setw(10) << millis(result.percentile(50))
+            << std::setw(10) << millis(result.percentile(90)) << std::setw(10) << millis(result.nanos.back())
+            << std::scientific << std::setprecision(2) << std::setw(12) << result.throughput()
+            << "  " << result.unit;
+        auto base = baseline.find(result.workload + "/" + result.stage);
+        if (base != baseline.end() && base->second > 0) {
+            out << std::string(15 - result.unit.size(), ' ');
+            double change = 100.0 * (result.percentile(50) - base->second) / base->second;
+            out << std::fixed << std::setprecision(1) << std::showpos << std::setw(9) << change << "%"
+                << std::noshowpos;
+        }
+        out << std::defaultfloat << std::endl;
+    }
+}
+
+bool writeJson(const std::string& path, const Options& options, const std::vector<Result>& results) {
+    std::ofstream out(path);
+    out << "{\"label\": \"" << options.label << "\", \"warmup\": " << options.warmup
+        << ", \"reps\": " << options.reps << ", \"results\": [\n";
+    for (size_t i = 0; i < results.size(); i++) {
+        const Result& result = results[i];
+        out << "{\"workload\": \"" << result.workload << "\", \"stage\": \"" << result.stage
+            << "\", \"unit\": \"" << result.unit << "\", \"work\": " << std::fixed
+            << std::setprecision(0) << result.work << ", \"min_ns\": " << result.nanos.front()
+            << ", \"p50_ns\": " << result.percentile(50) << ", \"p90_ns\": " << result.percentile(90)
+            << ", \"max_ns\": " << result.nanos.back() << ", \"throughput\": "
+            << std::setprecision(1) << result.throughput() << "}"
+            << (i + 1 < results.size() ? "," : "") << "\n";
+    }
+    out << "]}\n";
+    return static_cast<bool>(out);
+}
+
+bool parseArgs(int argc, char* argv[], Options& options) {
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        std::string value = arg.substr(arg.find('=') + 1);
+        if (arg.rfind("--warmup=", 0) == 0) {
+            options.warmup = std::atoi(value.c_str());
+        } else if (arg.rfind("--reps=", 0) == 0) {
+            options.reps = std::atoi(value.c_str());
+        } else if (arg.rfind("--json=", 0) == 0) {
+            options.json = value;
+        } else if (arg.rfind("--baseline=", 0) == 0) {
+            options.baseline = value;
+        } else if (arg.rfind("--label=", 0) == 0) {
+            options.label = value;
+        } else if (arg.rfind("--", 0) == 0) {
+            return false;
+        } else {
+            options.workloads.push_back(arg);
+        }
+    }
+    return options.warmup >= 0 && options.reps > 0;
+}
+    
+} // namespace
+
+int main(int argc, char* argv[]) {
+    Options options;
+    if (!parseArgs(argc, argv, options)) {
+        std::cerr << "Usage: fusion-bench [--warmup=<n>] [--reps=<n>] [--json=<file>]" << std::endl;
+        std::cerr << "                    [--baseline=<file>] [--label=<text>] [workload.fs ...]" << std::endl;
+        return 64;
+    }
+    
+    std::vector<Workload> workloads;
+    for (const std::string& path : options.workloads) {
+        bool ok;
+        std::string source = readFile(path, ok);
+        if (!ok) {
+            std::cerr << "Could not open file \"" << path << "\"." << std::endl;
+            return 74;
+        }
+        workloads.push_back({baseName(path), source, true});
+    }
+    for (int statements : {1000, 10000}) {
+        workloads.push_back({"generated-" + std::to_string(statements),
+                             generateProgram(statements, statements), false});
+    }
+    
+    std::map<std::string, int64_t> baseline;
+    if (!options.baseline.empty()) {
+        bool ok;
+        baseline = readBaseline(options.baseline, ok);
+        if (!ok) {
+            std::cerr << "Could not open file \"" << options.baseline << "\"." << std::endl;
+            return 74;
+        }
+    }
+    
+    std::vector<Result> results;
+    for (const Workload& workload : workloads) {
+        std::cerr << "-- " << workload.name << std::endl;
+        benchWorkload(options, workload, results);
+    }
+    
+    printReport(std::cout, results, baseline);
+    if (!options.json.empty() && !writeJson(options.json, options, results)) {
+        std::cerr << "Could not write \"" << options.json << "\"." << std::endl;
+        return 74;
+    }
+    return 0;
+}
@@ -0,0 +1,15 @@
+// Element-wise array kernels, reductions and indexed stores
+a = array(20000, 1.5)
+b = array(20000, 2.0)
+total = 0.0
+for i in range(200) {
+    c = a * b + a
+    total = total + sum(c)
+}
+v = array(1000, 0)
+for r in range(100) {
+    for i in range(1000) {
+        v[i] = v[i] + i
+    }
+}
+print total + sum(v)
@@ -0,0 +1,13 @@
+// Counting into dicts with int and string keys
+counts = {}
+for i in range(40000) {
+    k = (i * 7) % 997
+    counts[k] = get(counts, k, 0) + 1
+}
+names = ["ant", "bee", "cat", "dog", "eel", "fox", "gnu", "hen"]
+tally = {}
+for i in range(20000) {
+    name = names[i % 8]
+    tally[name] = get(tally, name, 0) + 1
+}
+print len(counts) + len(tally)
@@ -0,0 +1,21 @@
+// Mandelbrot set membership: number arithmetic in a short inner loop
+inside = 0
+for py in range(100) {
+    for px in range(200) {
+        x0 = px / 66.0 - 2.0
+        y0 = py / 50.0 - 1.0
+        x = 0.0
+        y = 0.0
+        n = 0
+        while n < 60 and x * x + y * y < 4.0 {
+            t = x * x - y * y + x0
+            y = 2.0 * x * y + y0
+            x = t
+            n = n + 1
+        }
+        if n == 60 {
+            inside = inside + 1
+        }
+    }
+}
+print inside
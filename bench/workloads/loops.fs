@@ -0,0 +1,11 @@
+// Nested int loops: arithmetic, compare-and-branch and back edges
+total = 0
+for i in range(400) {
+    for j in range(400) {
+        total = total + (i * j) % 7
+        if total % 2 == 0 {
+            total = total + 1
+        }
+    }
+}
+print total
@@ -0,0 +1,11 @@
+// Building strings piece by piece, and concatenating them
+s = ""
+for i in range(200000) {
+    s = s + "ab" + "c"
+}
+joined = ""
+for i in range(20000) {
+    line = "item" + " " + "value"
+    joined = joined + line + ","
+}
+print len(s) + len(joined)
@@ -2,29 +2,241 @@
 #include <fstream>
 #include <sstream>
 #include <string>
+#include <chrono>
+#include <csignal>
+#include <cstdlib>
+#include "src/include/aot.h"
+#include "src/include/heapprofile.h"
+#include "src/include/metrics.h"
+#include "src/include/timeline.h"
 #include "src/include/vm.h"
 
-void runFile(const std::string& path);
-void runPrompt();
+// Command line options
+struct Options {
+    std::string script;
+    bool build = false;                        // build <script> -o <output>
+    std::string output;
+    bool gcStats = false;                      // --gc-stats
+    std::chrono::nanoseconds gcMaxPause{0};    // --gc-max-pause=<time>, 0 = stop-the-world
+    std::string flush;                         // --flush=line|block|exit, empty = by terminal
+    bool profile = false;                      // --profile[=<collapsed stacks file>]
+    std::string profileStacks;
+    bool trace = false;                        // --trace[=<binary trace file>]
+    std::string traceFile;
+    TraceFilter traceFilter;                   // --trace-lines=<a>-<b>, --trace-ops=<OP>,...
+    bool dumpBytecode = false;                 // --dump-bytecode
+    std::string timeline;                      // --timeline=<trace event file>
+    std::string metrics;                       // --metrics=<Prometheus text file>
+    std::chrono::nanoseconds metricsInterval{0};  // --metrics-interval=<time>, 0 = on SIGUSR1 and exit
+    bool replay = false;                       // replay <trace file>
+    std::string heapProfile;                   // --heap-profile=<snapshot file>
+    bool heapDiff = false;                     // heap-diff <before> <after>
+    std::string heapDiffAfter;
+};
+
+bool parseArgs(int argc, char* argv[], Options& options);
+bool parseDuration(const std::string& text, std::chrono::nanoseconds& out);
+void configureVM(VM& vm, const Options& options);
+void reportVM(VM& vm, const Options& options);
+int buildFile(const Options& options);
+void runFile(const Options& options);
+void runPrompt(const Options& options);
 std::string readFile(const std::string& path);
 
 int main(int argc, char* argv[]) {
-    if (argc > 2) {
-        std::cout << "Usage: langlang [script]" << std::endl;
+    Options options;
+    if (!parseArgs(argc, argv, options)) {
+        std::cout << "Usage: langlang [--gc-max-pause=<time>] [--gc-stats] [--flush=line|block|exit]" << std::endl;
+        std::cout << "                [--profile[=<stacks file>]] [--dump-bytecode] [--timeline=<file>]" << std::endl;
+        std::cout << "                [--metrics=<file>] [--metrics-interval=<time>] [--heap-profile=<file>]" << std::endl;
+        std::cout << "                [--trace[=<file>]] [--trace-lines=<a>-<b>] [--trace-ops=<OP>,...] [script]" << std::endl;
+        std::cout << "       langlang build <script> -o <executable>" << std::endl;
+        std::cout << "       langlang replay <trace file>" << std::endl;
+        std::cout << "       langlang heap-diff <before snapshot> <after snapshot>" << std::endl;
         return 64;
-    } else if (argc == 2) {
-        runFile(argv[1]);
+    }
+    
+    if (options.build) {
+        return buildFile(options);
+    } else if (options.replay) {
+        return replayTrace(options.script, std::cout, std::cerr) ? 0 : 65;
+    } else if (options.heapDiff) {
+        return diffHeapSnapshots(options.script, options.heapDiffAfter, std::cout, std::cerr) ? 0 : 65;
+    } else if (!options.script.empty()) {
+        runFile(options);
     } else {
-        runPrompt();
+        runPrompt(options);
     }
     
     return 0;
 }
 
-void runFile(const std::string& path) {
-    std::string source = readFile(path);
+bool parseArgs(int argc, char* argv[], Options& options) {
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        
+        if (i == 1 && arg == "build") {
+            options.build = true;
+        } else if (i == 1 && arg == "replay") {
+            options.replay = true;
+        } else if (i == 1 && arg == "heap-diff") {
+            options.heapDiff = true;
+        } else if (arg == "-o" && options.build && i + 1 < argc) {
+            options.output = argv[++i];
+        } else if (arg == "--gc-stats") {
+            options.gcStats = true;
+        } else if (arg.rfind("--gc-max-pause=", 0) == 0) {
+            if (!parseDuration(arg.substr(15), options.gcMaxPause)) return false;
+        } else if (arg == "--flush=line" || arg == "--flush=block" || arg == "--flush=exit") {
+            options.flush = arg.substr(8);
+        } else if (arg == "--profile") {
+            options.profile = true;
+        } else if (arg.rfind("--profile=", 0) == 0 && arg.size() > 10) {
+            options.profile = true;
+            options.profileStacks = arg.substr(10);
+        } else if (arg == "--trace") {
+            options.trace = true;
+        } else if (arg.rfind("--trace=", 0) == 0 && arg.size() > 8) {
+            options.trace = true;
+            options.traceFile = arg.substr(8);
+        } else if (arg.rfind("--trace-lines=", 0) == 0) {
+            if (!options.traceFilter.parseLines(arg.substr(14))) return false;
+        } else if (arg.rfind("--trace-ops=", 0) == 0) {
+            if (!options.traceFilter.parseOpCodes(arg.substr(12))) return false;
+        } else if (arg == "--dump-bytecode") {
+            options.dumpBytecode = true;
+        } else if (arg.rfind("--timeline=", 0) == 0 && arg.size() > 11) {
+            options.timeline = arg.substr(11);
+        } else if (arg.rfind("--metrics=", 0) == 0 && arg.size() > 10) {
+            options.metrics = arg.substr(10);
+        } else if (arg.rfind("--metrics-interval=", 0) == 0) {
+            if (!parseDuration(arg.substr(19), options.metricsInterval)) return false;
+        } else if (arg.rfind("--heap-profile=", 0) == 0 && arg.size() > 15) {
+            options.heapProfile = arg.substr(15);
+        } else if (options.heapDiff && !options.script.empty() && options.heapDiffAfter.empty()) {
+            options.heapDiffAfter = arg;
+        } else if (arg.rfind("--", 0) == 0 || !options.script.empty()) {
+            return false;
+        } else {
+            options.script = arg;
+        }
+    }
+    
+    if (options.replay) return !options.script.empty();
+    if (options.heapDiff) return !options.heapDiffAfter.empty();
+    return !options.build || (!options.script.empty() && !options.output.empty());
+}
+
+// Accepts e.g. "1ms", "500us", "2000000ns", "0.5s"; a bare number is milliseconds.
+bool parseDuration(const std::string& text, std::chrono::nanoseconds& out) {
+    char* end = nullptr;
+    double amount = std::strtod(text.c_str(), &end);
+    if (end == text.c_str() || amount <= 0) return false;
+    
+    std::string unit(end);
+    double scale;
+    if (unit == "ns") scale = 1;
+    else if (unit == "us") scale = 1e3;
+    else if (unit == "ms" || unit.empty()) scale = 1e6;
+    else if (unit == "s") scale = 1e9;
+    else return false;
+    
+    out = std::chrono::nanoseconds(static_cast<long long>(amount * scale));
+    return true;
+}
+
+void configureVM(VM& vm, const Options& options) {
+    // Before the collector's marker thread starts, so it shows up named.
+    if (!options.timeline.empty() && !Timeline::start(options.timeline)) {
+        std::cerr << "Could not write \"" << options.timeline << "\"." << std::endl;
+        exit(74);
+    }
+    if (!options.metrics.empty() && !Metrics::startExport(options.metrics, options.metricsInterval, SIGUSR1)) {
+        std::cerr << "Could not write \"" << options.metrics << "\"." << std::endl;
+        exit(74);
+    }
+    if (options.gcMaxPause.count() > 0) {
+        vm.getHeap().setConcurrent(options.gcMaxPause);
+    }
+    if (options.flush == "line") {
+        vm.getOutput().setPolicy(FlushPolicy::LINE);
+    } else if (options.flush == "block") {
+        vm.getOutput().setPolicy(FlushPolicy::BLOCK);
+    } else if (options.flush == "exit") {
+        vm.getOutput().setPolicy(FlushPolicy::EXIT);
+    }
+    if (options.profile) {
+        vm.enableProfiling();
+    }
+    if (options.trace && options.traceFile.empty()) {
+        vm.setTracer(std::make_unique<Tracer>(vm.getChunk(), options.traceFilter, std::clog));
+    } else if (options.trace) {
+        auto tracer = std::make_unique<Tracer>(vm.getChunk(), options.traceFilter, options.traceFile);
+        if (!tracer->ok()) {
+            std::cerr << "Could not write \"" << options.traceFile << "\"." << std::endl;
+            exit(74);
+        }
+        vm.setTracer(std::move(tracer));
+    }
+    vm.setDumpBytecode(options.dumpBytecode);
+    // Modules are looked up next to the script, then along FUSION_PATH.
+    size_t slash = options.script.rfind('/');
+    vm.addModulePath(slash == std::string::npos ? "." : options.script.substr(0, slash));
+    if (const char* path = std::getenv("FUSION_PATH")) {
+        std::istringstream directories(path);
+        std::string directory;
+        while (std::getline(directories, directory, ':')) {
+            if (!directory.empty()) vm.addModulePath(directory);
+        }
+    }
+    if (!options.heapProfile.empty()) {
+        vm.enableHeapProfiling(options.heapProfile);
+        std::signal(SIGUSR2, [](int) { HeapProfiler::requestSnapshot(); });
+    }
+}
+
+void reportVM(VM& vm, const Options& options) {
+    if (options.gcStats) {
+        vm.getHeap().printPauseReport(std::cerr);
+    }
+    if (Tracer* tracer = vm.getTracer()) {
+        tracer->close();
+    }
+    Timeline::stop();
+    Metrics::stopExport();
+    if (HeapProfiler* heapProfiler = vm.getHeapProfiler()) {
+        heapProfiler->writeSnapshot(vm.getHeap(), options.heapProfile);
+    }
+    if (Profiler* profiler = vm.getProfiler()) {
+        profiler->report(std::cerr);
+        if (!options.profileStacks.empty()) {
+            std::ofstream stacks(options.profileStacks);
+            profiler->writeCollapsed(stacks);
+            if (!stacks) std::cerr << "Could not write \"" << options.profileStacks << "\"." << std::endl;
+        }
+    }
+}
+
+int buildFile(const Options& options) {
+    std::string source = readFile(options.script);
+    
+    switch (AotCompiler::build(source, options.script, options.output)) {
+        case BuildResult::OK:
+            return 0;
+        case BuildResult::COMPILE_ERROR:
+            return 65;
+        case BuildResult::BUILD_ERROR:
+            break;
+    }
+    return 70;
+}
+
+void runFile(const Options& options) {
+    std::string source = readFile(options.script);
     VM vm;
+    configureVM(vm, options);
     InterpretResult result = vm.interpret(source);
+    reportVM(vm, options);
     
     if (result == InterpretResult::COMPILE_ERROR) {
         exit(65);
@@ -34,8 +246,9 @@ void runFile(const std::string& path) {
     }
 }
 
-void runPrompt() {
+void runPrompt(const Options& options) {
     VM vm;
+    configureVM(vm, options);
     std::string line;
     
     std::cout << "LangLang VM v0.1" << std::endl;
@@ -50,6 +263,8 @@ void runPrompt() {
         
         vm.interpret(line);
     }
+    
+    reportVM(vm, options);
 }
 
 std::string readFile(const std::string& path) {
@@ -64,4 +279,4 @@ std::string readFile(const std::string& path) {
     contents << file.rdbuf();
     
     return contents.str();
-}
\ No newline at end of file
+}
@@ -0,0 +1,489 @@
+#include "../../include/aot.h"
+#include "../../include/builtins.h"
+#include "../../include/compiler.h"
+#include "../../include/gc.h"
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace {
+
+// Double literal that reads back to exactly the same value
+std::string numberLiteral(double value) {
+    if (std::isnan(value)) return "std::numeric_limits<double>::quiet_NaN()";
+    if (std::isinf(value)) {
+        return value > 0 ? "std::numeric_limits<double>::infinity()"
+                         : "-std::numeric_limits<double>::infinity()";
+    }
+    
+    char buffer[32];
+    std::snprintf(buffer, sizeof(buffer), "%.17g", value);
+    std::string literal(buffer);
+    if (literal.find_first_of(".e") == std::string::npos) literal += ".0";
+    return literal;
+}
+
+// Octal escapes for anything that is not plain printable ASCII
+std::string stringLiteral(const char* chars, size_t length) {
+    std::string literal = "\"";
+    for (size_t i = 0; i < length; i++) {
+        unsigned char c = static_cast<unsigned char>(chars[i]);
+        if (c == '"' || c == '\\') {
+            literal += '\\';
+            literal += static_cast<char>(c);
+        } else if (c >= 0x20 && c < 0x7F) {
+            literal += static_cast<char>(c);
+        } else {
+            char escape[8];
+            std::snprintf(escape, sizeof(escape), "\\%03o", c);
+            literal += escape;
+        }
+    }
+    return literal + "\"";
+}
+// Enumerator for an operator the runtime's binary() takes
+const char* binaryOpName(OpCode op) {
+    switch (op) {
+        case OpCode::FLOOR_DIVIDE: return "OpCode::FLOOR_DIVIDE";
+        case OpCode::MODULO: return "OpCode::MODULO";
+        case OpCode::BIT_AND: return "OpCode::BIT_AND";
+        case OpCode::BIT_OR: return "OpCode::BIT_OR";
+        case OpCode::BIT_XOR: return "OpCode::BIT_XOR";
+        case OpCode::SHIFT_LEFT: return "OpCode::SHIFT_LEFT";
+        case OpCode::SHIFT_RIGHT: return "OpCode::SHIFT_RIGHT";
+        default: return "";
+    }
+}
+
+// Enumerator for a CALL_BUILTIN operand
+const char* builtinEnumerator(Builtin builtin) {
+    switch (builtin) {
+        case Builtin::LEN: return "Builtin::LEN";
+        case Builtin::ARRAY: return "Builtin::ARRAY";
+        case Builtin::SUM: return "Builtin::SUM";
+        case Builtin::MIN: return "Builtin::MIN";
+        case Builtin::MAX: return "Builtin::MAX";
+        case Builtin::DOT: return "Builtin::DOT";
+        case Builtin::ALL: return "Builtin::ALL";
+        case Builtin::ANY: return "Builtin::ANY";
+        case Builtin::KEYS: return "Builtin::KEYS";
+        case Builtin::VALUES: return "Builtin::VALUES";
+        case Builtin::HAS: return "Builtin::HAS";
+        case Builtin::GET: return "Builtin::GET";
+        case Builtin::REMOVE: return "Builtin::REMOVE";
+    }
+    return "";
+}
+
+// Enumerator for a fused compare-and-branch opcode
+const char* branchOpName(OpCode op) {
+    switch (op) {
+        case OpCode::EQUAL_JUMP: return "OpCode::EQUAL_JUMP";
+        case OpCode::NOT_EQUAL_JUMP: return "OpCode::NOT_EQUAL_JUMP";
+        case OpCode::LESS_JUMP: return "OpCode::LESS_JUMP";
+        case OpCode::LESS_EQUAL_JUMP: return "OpCode::LESS_EQUAL_JUMP";
+        case OpCode::GREATER_JUMP: return "OpCode::GREATER_JUMP";
+        case OpCode::GREATER_EQUAL_JUMP: return "OpCode::GREATER_EQUAL_JUMP";
+        default: return "";
+    }
+}
+    
+} // namespace
+
+BuildResult AotCompiler::build(const std::string& source, const std::string& sourceName,
+                               const std::string& output) {
+    Heap heap;
+    Chunk chunk;
+    heap.addRoots(&chunk.constants);
+    Compiler compiler(heap);
+    if (!compiler.compile(source, chunk)) {
+        return BuildResult::COMPILE_ERROR;
+    }
+    
+    std::ostringstream code;
+    std::string error;
+    if (!generate(chunk, sourceName, code, error)) {
+        std::cerr << "build: " << error << std::endl;
+        return BuildResult::BUILD_ERROR;
+    }
+    
+    char cppPath[] = "/tmp/fusion-XXXXXX.cpp";
+    int fd = mkstemps(cppPath, 4);
+    if (fd < 0) {
+        std::cerr << "build: could not create a temporary file." << std::endl;
+        return BuildResult::BUILD_ERROR;
+    }
+    close(fd);
+    
+    std::ofstream file(cppPath, std::ios::binary);
+    file << code.str();
+    file.close();
+    
+    bool linked = file && link(cppPath, output, error);
+    unlink(cppPath);
+    if (!linked) {
+        std::cerr << "build: " << (error.empty() ? "could not write generated code." : error) << std::endl;
+        return BuildResult::BUILD_ERROR;
+    }
+    
+    return BuildResult::OK;
+}
+
+bool AotCompiler::generate(const Chunk& chunk, const std::string& sourceName,
+                           std::ostream& out, std::string& error) {
+    // Static stack depth before each instruction gives each operand its slot.
+    std::vector<int> depths;
+    int maxDepth = 0;
+    if (!stackDepths(chunk, depths, maxDepth)) {
+        error = "malformed bytecode.";
+        return false;
+    }
+    // Modules are found and compiled as the script runs, which a standalone
+    // executable cannot do.
+    if (!chunk.imports.empty()) {
+        error = "scripts that import modules cannot be built yet.";
+        return false;
+    }
+    
+    std::vector<bool> targets(chunk.code.size(), false);
+    for (size_t offset = 0; offset < chunk.code.size();) {
+        int length, effect;
+        describeOpCode(chunk.code[offset], length, effect);
+        long target;
+        if (depths[offset] >= 0 && jumpTarget(chunk, offset, target)) targets[target] = true;
+        offset += length;
+    }
+    
+    out << "// Generated by fusion build from " << sourceName << "\n";
+    out << "#include <limits>\n";
+    out << "#include \"fusionrt.h\"\n\n";
+    out << "int main() {\n";
+    out << "    NativeRuntime rt(" << chunk.localCount + std::max(maxDepth, 1) << ", "
+        << chunk.constants.size() << ");\n";
+    out << "    Value* l = rt.stack();\n";
+    out << "    Value* s = l + " << chunk.localCount << ";\n";
+    
+    for (size_t i = 0; i < chunk.constants.size(); i++) {
+        const Value& value = chunk.constants[i];
+        if (isStringValue(value)) {
+            auto* string = static_cast<ObjString*>(std::get<Obj*>(value));
+            out << "    rt.defineString(" << i << ", "
+                << stringLiteral(string->chars(), string->length) << ", "
+                << string->length << ");\n";
+        }
+    }
+    
+    int line = -1;
+    bool returned = false;
+    for (size_t offset = 0; offset < chunk.code.size();) {
+        OpCode op = static_cast<OpCode>(chunk.code[offset]);
+        int d = depths[offset];
+        int at = chunk.lines[offset];
+        int length, effect;
+        describeOpCode(chunk.code[offset], length, effect);
+        if (d < 0) {
+            offset += length;
+            continue;
+        }
+        
+        if (targets[offset]) out << "  L" << offset << ":;\n";
+        if (at != line) {
+            out << "\n    // line " << at << "\n";
+            line = at;
+        }
+        
+        // Operands: a is the slot below the top, b the top.
+        std::string a = "s[" + std::to_string(d - 2) + "]";
+        std::string b = "s[" + std::to_string(d - 1) + "]";
+        std::string where = ", " + std::to_string(at) + ");\n";
+        returned = false;
+        
+        switch (op) {
+            case OpCode::CONSTANT: {
+                uint8_t index = chunk.code[offset + 1];
+                const Value& value = chunk.constants[index];
+                out << "    s[" << d << "] = ";
+                if (std::holds_alternative<double>(value)) {
+                    out << numberLiteral(std::get<double>(value));
+                } else if (std::holds_alternative<int64_t>(value)) {
+                    out << "int64_t(" << std::get<int64_t>(value) << ")";
+                } else if (std::holds_alternative<bool>(value)) {
+                    out << (std::get<bool>(value) ? "true" : "false");
+                } else if (std::holds_alternative<std::nullptr_t>(value)) {
+                    out << "nullptr";
+                } else if (isStringValue(value)) {
+                    out << "rt.constant(" << static_cast<int>(index) << ")";
+                } else {
+                    error = "unsupported constant at offset " + std::to_string(offset) + ".";
+                    return false;
+                }
+                out << ";\n";
+                break;
+            }
+            case OpCode::ADD:
+                out << "    rt.add(" << a << ", " << b << where;
+                break;
+            case OpCode::SUBTRACT:
+                out << "    rt.subtract(" << a << ", " << b << where;
+                break;
+            case OpCode::MULTIPLY:
+                out << "    rt.multiply(" << a << ", " << b << where;
+                break;
+            case OpCode::DIVIDE:
+                out << "    rt.divide(" << a << ", " << b << where;
+                break;
+            case OpCode::NEGATE:
+                out << "    rt.negate(" << b << where;
+                break;
+            case OpCode::NOT:
+                out << "    rt.logicalNot(" << b << ");\n";
+                break;
+            case OpCode::EQUALS:
+                out << "    rt.equals(" << a << ", " << b << ");\n";
+                break;
+            case OpCode::GREATER:
+                out << "    rt.greater(" << a << ", " << b << where;
+                break;
+            case OpCode::LESS:
+                out << "    rt.less(" << a << ", " << b << where;
+                break;
+            case OpCode::LESS_EQUAL:
+                out << "    rt.lessEqual(" << a << ", " << b << where;
+                break;
+            case OpCode::GREATER_EQUAL:
+                out << "    rt.greaterEqual(" << a << ", " << b << where;
+                break;
+            case OpCode::FLOOR_DIVIDE:
+            case OpCode::MODULO:
+            case OpCode::BIT_AND:
+            case OpCode::BIT_OR:
+            case OpCode::BIT_XOR:
+            case OpCode::SHIFT_LEFT:
+            case OpCode::SHIFT_RIGHT:
+                out << "    rt.binary(" << binaryOpName(op) << ", " << a << ", " << b << where;
+                break;
+            case OpCode::BIT_NOT:
+                out << "    rt.unary(OpCode::BIT_NOT, " << b << where;
+                break;
+            case OpCode::ADD_NUMBER:
+                out << "    " << a << " = numberOf(" << a << ") + numberOf(" << b << ");\n";
+                break;
+            case OpCode::SUBTRACT_NUMBER:
+                out << "    " << a << " = numberOf(" << a << ") - numberOf(" << b << ");\n";
+                break;
+            case OpCode::MULTIPLY_NUMBER:
+                out << "    " << a << " = numberOf(" << a << ") * numberOf(" << b << ");\n";
+                break;
+            case OpCode::DIVIDE_NUMBER:
+                out << "    rt.divideNumbers(" << a << ", " << b << where;
+                break;
+            case OpCode::NEGATE_NUMBER:
+                out << "    " << b << " = -numberOf(" << b << ");\n";
+                break;
+            case OpCode::EQUALS_NUMBER:
+                out << "    " << a << " = numberOf(" << a << ") == numberOf(" << b << ");\n";
+                break;
+            case OpCode::GREATER_NUMBER:
+                out << "    " << a << " = numberOf(" << a << ") > numberOf(" << b << ");\n";
+                break;
+            case OpCode::LESS_NUMBER:
+                out << "    " << a << " = numberOf(" << a << ") < numberOf(" << b << ");\n";
+                break;
+            case OpCode::ADD_INT:
+                out << "    rt.addInts(" << a << ", " << b << where;
+                break;
+            case OpCode::SUBTRACT_INT:
+                out << "    rt.subtractInts(" << a << ", " << b << where;
+                break;
+            case OpCode::MULTIPLY_INT:
+                out << "    rt.multiplyInts(" << a << ", " << b << where;
+                break;
+            case OpCode::NEGATE_INT:
+                out << "    rt.negateInt(" << b << where;
+                break;
+            case OpCode::EQUALS_INT:
+                out << "    " << a << " = intOf(" << a << ") == intOf(" << b << ");\n";
+                break;
+            case OpCode::GREATER_INT:
+                out << "    " << a << " = intOf(" << a << ") > intOf(" << b << ");\n";
+                break;
+            case OpCode::LESS_INT:
+                out << "    " << a << " = intOf(" << a << ") < intOf(" << b << ");\n";
+                break;
+            case OpCode::CONCAT:
+                out << "    rt.concatenate(" << a << ", " << b << ");\n";
+                break;
+            case OpCode::GET_LOCAL:
+                out << "    s[" << d << "] = l[" << static_cast<int>(chunk.code[offset + 1]) << "];\n";
+                break;
+            case OpCode::SET_LOCAL:
+                out << "    l[" << static_cast<int>(chunk.code[offset + 1]) << "] = " << b << ";\n";
+                break;
+            case OpCode::GET_STRING_LOCAL: {
+                int slot = chunk.code[offset + 1];
+                out << "    rt.flatten(l[" << slot << "]);\n";
+                out << "    s[" << d << "] = l[" << slot << "];\n";
+                break;
+            }
+            case OpCode::GET_MEMBER:  // Rejected above
+                break;
+            case OpCode::APPEND_LOCAL: {
+                int count = chunk.code[offset + 2];
+                out << "    rt.append(l[" << static_cast<int>(chunk.code[offset + 1]) << "], &s["
+                    << d - count << "], " << count << where;
+                break;
+            }
+            case OpCode::BUILD_ARRAY: {
+                int count = chunk.code[offset + 1];
+                out << "    rt.buildArray(&s[" << d - count << "], " << count << where;
+                break;
+            }
+            case OpCode::BUILD_DICT: {
+                int count = chunk.code[offset + 1];
+                out << "    rt.buildDict(&s[" << d - 2 * count << "], " << count << where;
+                break;
+            }
+            case OpCode::GET_INDEX:
+                out << "    rt.getIndex(" << a << ", " << b << where;
+                break;
+            case OpCode::SET_INDEX:
+                out << "    rt.setIndex(s[" << d - 3 << "], " << a << ", " << b << where;
+                break;
+            case OpCode::CALL_BUILTIN: {
+                const char* builtin = builtinEnumerator(static_cast<Builtin>(chunk.code[offset + 1]));
+                int argc = chunk.code[offset + 2];
+                if (*builtin == '\0') {
+                    error = "unknown builtin at offset " + std::to_string(offset) + ".";
+                    return false;
+                }
+                out << "    rt.call(" << builtin << ", &s[" << d - argc << "], " << argc << where;
+                break;
+            }
+            case OpCode::JUMP:
+            case OpCode::LOOP: {
+                long target;
+                jumpTarget(chunk, offset, target);
+                out << "    goto L" << target << ";\n";
+                break;
+            }
+            case OpCode::JUMP_IF_FALSE: {
+                long target;
+                jumpTarget(chunk, offset, target);
+                out << "    if (!isTruthy(" << b << ")) goto L" << target << ";\n";
+                break;
+            }
+            case OpCode::JUMP_IF_TRUE: {
+                long target;
+                jumpTarget(chunk, offset, target);
+                out << "    if (isTruthy(" << b << ")) goto L" << target << ";\n";
+                break;
+            }
+            case OpCode::JUMP_IF_FALSE_OR_POP:
+            case OpCode::JUMP_IF_TRUE_OR_POP: {
+                // The kept value is already in the slot the target expects.
+                long target;
+                jumpTarget(chunk, offset, target);
+                out << "    if (" << (op == OpCode::JUMP_IF_FALSE_OR_POP ? "!" : "")
+                    << "isTruthy(" << b << ")) goto L" << target << ";\n";
+                break;
+            }
+            case OpCode::EQUAL_JUMP:
+            case OpCode::NOT_EQUAL_JUMP:
+            case OpCode::LESS_JUMP:
+            case OpCode::LESS_EQUAL_JUMP:
+            case OpCode::GREATER_JUMP:
+            case OpCode::GREATER_EQUAL_JUMP: {
+                long target;
+                jumpTarget(chunk, offset, target);
+                out << "    if (!rt.branch(" << branchOpName(op) << ", " << a << ", " << b << ", "
+                    << at << ")) goto L" << target << ";\n";
+                break;
+            }
+            case OpCode::PRINT:
+                out << "    rt.print(" << b << ");\n";
+                break;
+            case OpCode::POP:
+                break;
+            case OpCode::AWAIT:
+                out << "    rt.await(" << b << where;
+                break;
+            case OpCode::RETURN:
+                out << "    return rt.finish();\n";
+                returned = true;
+                break;
+        }
+        
+        offset += length;
+    }
+    
+    if (!returned) out << "    return rt.finish();\n";
+    out << "}\n";
+    return true;
+}
+
+bool AotCompiler::link(const std::string& cppPath, const std::string& output, std::string& error) {
+    std::string home = runtimeHome();
+    std::string library = home + "/libfusionrt.a";
+    struct stat info;
+    if (stat(library.c_str(), &info) != 0) {
+        error = "runtime library not found at " + library + " (run make, or set FUSION_HOME).";
+        return false;
+    }
+    
+    const char* cxx = std::getenv("CXX");
+    std::string compiler = cxx != nullptr && *cxx != '\0' ? cxx : "g++";
+    std::string include = "-I" + home + "/src/include";
+    std::vector<std::string> args = {
+        compiler, "-std=c++17", "-O2", include, cppPath, library, "-pthread", "-o", output
+    };
+    
+    std::vector<char*> argv;
+    for (std::string& arg : args) argv.push_back(&arg[0]);
+    argv.push_back(nullptr);
+    
+    pid_t pid = fork();
+    if (pid < 0) {
+        error = "could not start " + compiler + ".";
+        return false;
+    }
+    if (pid == 0) {
+        execvp(argv[0], argv.data());
+        _exit(127);
+    }
+    
+    int status = 0;
+    while (waitpid(pid, &status, 0) < 0) {
+        if (errno != EINTR) break;
+    }
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        error = WIFEXITED(status) && WEXITSTATUS(status) == 127
+            ? "could not run " + compiler + "."
+            : compiler + " failed.";
+        return false;
+    }
+    
+    return true;
+}
+
+std::string AotCompiler::runtimeHome() {
+    const char* home = std::getenv("FUSION_HOME");
+    if (home != nullptr && *home != '\0') return home;
+    
+    char path[PATH_MAX];
+    ssize_t length = readlink("/proc/self/exe", path, sizeof(path) - 1);
+    if (length <= 0) return ".";
+    path[length] = '\0';
+    
+    std::string executable(path);
+    size_t slash = executable.rfind('/');
+    return slash == std::string::npos ? "." : executable.substr(0, slash);
+}
@@ -1,6 +1,12 @@
 #include "../../include/bytecode.h"
+#include "../../include/array.h"
+#include "../../include/builtins.h"
+#include "../../include/dict.h"
 #include <iostream>
 #include <iomanip>
+#include <algorithm>
+#include <charconv>
+#include <cstring>
 
 void Chunk::write(OpCode byte, int line) {
     code.push_back(static_cast<uint8_t>(byte));
@@ -23,79 +29,665 @@ int Chunk::addConstant(const Value& value) {
     return constants.size() - 1;
 }
 
+bool isTruthy(const Value& value) {
+    if (std::holds_alternative<std::nullptr_t>(value)) {
+        return false;
+    }
+    if (std::holds_alternative<bool>(value)) {
+        return std::get<bool>(value);
+    }
+    return true;
+}
+
+bool valuesEqual(const Value& a, const Value& b) {
+    // Ints and doubles compare by value; long double holds every int exactly.
+    if (std::holds_alternative<int64_t>(a) && std::holds_alternative<double>(b)) {
+        return static_cast<long double>(std::get<int64_t>(a)) == std::get<double>(b);
+    }
+    if (std::holds_alternative<double>(a) && std::holds_alternative<int64_t>(b)) {
+        return std::get<double>(a) == static_cast<long double>(std::get<int64_t>(b));
+    }
+    if (a.index() != b.index()) return false;
+    
+    if (std::holds_alternative<std::nullptr_t>(a)) {
+        return true;  // null == null
+    }
+    if (std::holds_alternative<bool>(a)) {
+        return std::get<bool>(a) == std::get<bool>(b);
+    }
+    if (std::holds_alternative<double>(a)) {
+        return std::get<double>(a) == std::get<double>(b);
+    }
+    if (std::holds_alternative<int64_t>(a)) {
+        return std::get<int64_t>(a) == std::get<int64_t>(b);
+    }
+    if (isStringValue(a) && isStringValue(b)) {
+        auto* left = static_cast<ObjString*>(std::get<Obj*>(a));
+        auto* right = static_cast<ObjString*>(std::get<Obj*>(b));
+        return left->length == right->length &&
+               std::memcmp(left->chars(), right->chars(), left->length) == 0;
+    }
+    if (isArrayValue(a) && isArrayValue(b)) {
+        return arraysEqual(static_cast<ObjArray*>(std::get<Obj*>(a)),
+                           static_cast<ObjArray*>(std::get<Obj*>(b)));
+    }
+    if (isDictValue(a) && isDictValue(b)) {
+        return dictsEqual(static_cast<ObjDict*>(std::get<Obj*>(a)),
+                          static_cast<ObjDict*>(std::get<Obj*>(b)));
+    }
+    if (std::holds_alternative<Obj*>(a)) {
+        return std::get<Obj*>(a) == std::get<Obj*>(b);
+    }
+    
+    return false;  // Shouldn't reach here
+}
+
+namespace {
+
+// Arrays and dicts print their elements; one already being printed, which
+// contains itself, prints as [...] or {...}.
+void appendValue(std::string& out, const Value& value, std::vector<const Obj*>& open) {
+    if (!isArrayValue(value) && !isDictValue(value)) {
+        appendScalar(out, value);
+        return;
+    }
+    
+    const Obj* container = std::get<Obj*>(value);
+    bool array = container->type == ObjType::ARRAY;
+    if (std::find(open.begin(), open.end(), container) != open.end()) {
+        out += array ? "[...]" : "{...}";
+        return;
+    }
+    
+    open.push_back(container);
+    if (array) {
+        auto* elements = static_cast<const ObjArray*>(container);
+        out += '[';
+        for (uint32_t i = 0; i < elements->length; i++) {
+            if (i > 0) out += ", ";
+            appendValue(out, arrayElement(elements, i), open);
+        }
+        out += ']';
+    } else {
+        auto* dict = static_cast<const ObjDict*>(container);
+        out += '{';
+        for (uint32_t i = 0; i < dict->count; i++) {
+            if (i > 0) out += ", ";
+            appendValue(out, dictKey(dict, i), open);
+            out += ": ";
+            appendValue(out, dictValue(dict, i), open);
+        }
+        out += '}';
+    }
+    open.pop_back();
+}
+    
+} // namespace
+
+void appendScalar(std::string& out, const Value& value) {
+    // Room for any double's shortest form, e.g. -2.2250738585072014e-308.
+    char buffer[32];
+    if (const double* number = std::get_if<double>(&value)) {
+        out.append(buffer, std::to_chars(buffer, buffer + sizeof(buffer), *number).ptr);
+    } else if (const int64_t* integer = std::get_if<int64_t>(&value)) {
+        out.append(buffer, std::to_chars(buffer, buffer + sizeof(buffer), *integer).ptr);
+    } else if (const bool* boolean = std::get_if<bool>(&value)) {
+        out += *boolean ? "true" : "false";
+    } else if (isStringValue(value)) {
+        auto* string = static_cast<ObjString*>(std::get<Obj*>(value));
+        out.append(string->chars(), string->length);
+    } else if (std::holds_alternative<std::nullptr_t>(value)) {
+        out += "null";
+    } else {
+        out += "unknown";
+    }
+}
+
+void appendValue(std::string& out, const Value& value) {
+    std::vector<const Obj*> open;
+    appendValue(out, value, open);
+}
+
+std::string valueToString(const Value& value) {
+    std::string out;
+    appendValue(out, value);
+    return out;
+}
+
+bool describeOpCode(uint8_t byte, int& length, int& effect) {
+    length = 1;
+    switch (static_cast<OpCode>(byte)) {
+        case OpCode::CONSTANT:
+            length = 2;
+            effect = 1;
+            return true;
+        case OpCode::ADD:
+        case OpCode::SUBTRACT:
+        case OpCode::MULTIPLY:
+        case OpCode::DIVIDE:
+        case OpCode::EQUALS:
+        case OpCode::GREATER:
+        case OpCode::LESS:
+        case OpCode::LESS_EQUAL:
+        case OpCode::GREATER_EQUAL:
+        case OpCode::FLOOR_DIVIDE:
+        case OpCode::MODULO:
+        case OpCode::BIT_AND:
+        case OpCode::BIT_OR:
+        case OpCode::BIT_XOR:
+        case OpCode::SHIFT_LEFT:
+        case OpCode::SHIFT_RIGHT:
+        case OpCode::ADD_NUMBER:
+        case OpCode::SUBTRACT_NUMBER:
+        case OpCode::MULTIPLY_NUMBER:
+        case OpCode::DIVIDE_NUMBER:
+        case OpCode::EQUALS_NUMBER:
+        case OpCode::GREATER_NUMBER:
+        case OpCode::LESS_NUMBER:
+        case OpCode::ADD_INT:
+        case OpCode::SUBTRACT_INT:
+        case OpCode::MULTIPLY_INT:
+        case OpCode::EQUALS_INT:
+        case OpCode::GREATER_INT:
+        case OpCode::LESS_INT:
+        case OpCode::CONCAT:
+        case OpCode::GET_INDEX:
+        case OpCode::PRINT:
+        case OpCode::POP:
+            effect = -1;
+            return true;
+        case OpCode::GET_LOCAL:
+        case OpCode::GET_STRING_LOCAL:
+        case OpCode::GET_MEMBER:
+            length = 2;
+            effect = 1;
+            return true;
+        case OpCode::SET_LOCAL:
+            length = 2;
+            effect = -1;
+            return true;
+        case OpCode::APPEND_LOCAL:
+            length = 3;
+            effect = 0;
+            return true;
+        case OpCode::BUILD_ARRAY:
+        case OpCode::BUILD_DICT:
+            length = 2;
+            effect = 1;
+            return true;
+        case OpCode::SET_INDEX:
+            effect = -3;
+            return true;
+        case OpCode::CALL_BUILTIN:
+            length = 3;
+            effect = 1;
+            return true;
+        case OpCode::JUMP:
+            length = 3;
+            effect = 0;
+            return true;
+        case OpCode::JUMP_IF_FALSE:
+        case OpCode::JUMP_IF_TRUE:
+            length = 3;
+            effect = -1;
+            return true;
+        case OpCode::JUMP_IF_FALSE_OR_POP:
+        case OpCode::JUMP_IF_TRUE_OR_POP:
+            // Falling through pops; the jump keeps the value.
+            length = 3;
+            effect = -1;
+            return true;
+        case OpCode::LOOP:
+            length = 4;
+            effect = 0;
+            return true;
+        case OpCode::EQUAL_JUMP:
+        case OpCode::NOT_EQUAL_JUMP:
+        case OpCode::LESS_JUMP:
+        case OpCode::LESS_EQUAL_JUMP:
+        case OpCode::GREATER_JUMP:
+        case OpCode::GREATER_EQUAL_JUMP:
+            length = 3;
+            effect = -2;
+            return true;
+        case OpCode::NEGATE:
+        case OpCode::NEGATE_NUMBER:
+        case OpCode::NEGATE_INT:
+        case OpCode::BIT_NOT:
+        case OpCode::NOT:
+        case OpCode::AWAIT:
+        case OpCode::RETURN:
+            effect = 0;
+            return true;
+    }
+    return false;
+}
+
+const char* opCodeName(uint8_t byte) {
+    switch (static_cast<OpCode>(byte)) {
+        case OpCode::CONSTANT: return "CONSTANT";
+        case OpCode::ADD: return "ADD";
+        case OpCode::SUBTRACT: return "SUBTRACT";
+        case OpCode::MULTIPLY: return "MULTIPLY";
+        case OpCode::DIVIDE: return "DIVIDE";
+        case OpCode::NEGATE: return "NEGATE";
+        case OpCode::NOT: return "NOT";
+        case OpCode::EQUALS: return "EQUALS";
+        case OpCode::GREATER: return "GREATER";
+        case OpCode::LESS: return "LESS";
+        case OpCode::LESS_EQUAL: return "LESS_EQUAL";
+        case OpCode::GREATER_EQUAL: return "GREATER_EQUAL";
+        case OpCode::FLOOR_DIVIDE: return "FLOOR_DIVIDE";
+        case OpCode::MODULO: return "MODULO";
+        case OpCode::BIT_AND: return "BIT_AND";
+        case OpCode::BIT_OR: return "BIT_OR";
+        case OpCode::BIT_XOR: return "BIT_XOR";
+        case OpCode::BIT_NOT: return "BIT_NOT";
+        case OpCode::SHIFT_LEFT: return "SHIFT_LEFT";
+        case OpCode::SHIFT_RIGHT: return "SHIFT_RIGHT";
+        case OpCode::ADD_NUMBER: return "ADD_NUMBER";
+        case OpCode::SUBTRACT_NUMBER: return "SUBTRACT_NUMBER";
+        case OpCode::MULTIPLY_NUMBER: return "MULTIPLY_NUMBER";
+        case OpCode::DIVIDE_NUMBER: return "DIVIDE_NUMBER";
+        case OpCode::NEGATE_NUMBER: return "NEGATE_NUMBER";
+        case OpCode::EQUALS_NUMBER: return "EQUALS_NUMBER";
+        case OpCode::GREATER_NUMBER: return "GREATER_NUMBER";
+        case OpCode::LESS_NUMBER: return "LESS_NUMBER";
+        case OpCode::ADD_INT: return "ADD_INT";
+        case OpCode::SUBTRACT_INT: return "SUBTRACT_INT";
+        case OpCode::MULTIPLY_INT: return "MULTIPLY_INT";
+        case OpCode::NEGATE_INT: return "NEGATE_INT";
+        case OpCode::EQUALS_INT: return "EQUALS_INT";
+        case OpCode::GREATER_INT: return "GREATER_INT";
+        case OpCode::LESS_INT: return "LESS_INT";
+        case OpCode::CONCAT: return "CONCAT";
+        case OpCode::GET_LOCAL: return "GET_LOCAL";
+        case OpCode::SET_LOCAL: return "SET_LOCAL";
+        case OpCode::GET_STRING_LOCAL: return "GET_STRING_LOCAL";
+        case OpCode::APPEND_LOCAL: return "APPEND_LOCAL";
+        case OpCode::GET_MEMBER: return "GET_MEMBER";
+        case OpCode::BUILD_ARRAY: return "BUILD_ARRAY";
+        case OpCode::BUILD_DICT: return "BUILD_DICT";
+        case OpCode::GET_INDEX: return "GET_INDEX";
+        case OpCode::SET_INDEX: return "SET_INDEX";
+        case OpCode::CALL_BUILTIN: return "CALL_BUILTIN";
+        case OpCode::JUMP: return "JUMP";
+        case OpCode::JUMP_IF_FALSE: return "JUMP_IF_FALSE";
+        case OpCode::JUMP_IF_TRUE: return "JUMP_IF_TRUE";
+        case OpCode::JUMP_IF_FALSE_OR_POP: return "JUMP_IF_FALSE_OR_POP";
+        case OpCode::JUMP_IF_TRUE_OR_POP: return "JUMP_IF_TRUE_OR_POP";
+        case OpCode::LOOP: return "LOOP";
+        case OpCode::EQUAL_JUMP: return "EQUAL_JUMP";
+        case OpCode::NOT_EQUAL_JUMP: return "NOT_EQUAL_JUMP";
+        case OpCode::LESS_JUMP: return "LESS_JUMP";
+        case OpCode::LESS_EQUAL_JUMP: return "LESS_EQUAL_JUMP";
+        case OpCode::GREATER_JUMP: return "GREATER_JUMP";
+        case OpCode::GREATER_EQUAL_JUMP: return "GREATER_EQUAL_JUMP";
+        case OpCode::PRINT: return "PRINT";
+        case OpCode::POP: return "POP";
+        case OpCode::AWAIT: return "AWAIT";
+        case OpCode::RETURN: return "RETURN";
+    }
+    return "UNKNOWN";
+}
+
+bool jumpTarget(const Chunk& chunk, size_t offset, long& target) {
+    auto distance = [&]() {
+        return static_cast<uint16_t>((chunk.code[offset + 1] << 8) | chunk.code[offset + 2]);
+    };
+    switch (static_cast<OpCode>(chunk.code[offset])) {
+        case OpCode::JUMP:
+        case OpCode::JUMP_IF_FALSE:
+        case OpCode::JUMP_IF_TRUE:
+        case OpCode::JUMP_IF_FALSE_OR_POP:
+        case OpCode::JUMP_IF_TRUE_OR_POP:
+        case OpCode::EQUAL_JUMP:
+        case OpCode::NOT_EQUAL_JUMP:
+        case OpCode::LESS_JUMP:
+        case OpCode::LESS_EQUAL_JUMP:
+        case OpCode::GREATER_JUMP:
+        case OpCode::GREATER_EQUAL_JUMP:
+            target = static_cast<long>(offset) + 3 + distance();
+            return true;
+        case OpCode::LOOP:
+            target = static_cast<long>(offset) + 4 - distance();
+            return true;
+        default:
+            return false;
+    }
+}
+
+bool stackDepths(const Chunk& chunk, std::vector<int>& depths, int& maxDepth) {
+    size_t size = chunk.code.size();
+    depths.assign(size, -1);
+    maxDepth = 0;
+    if (size == 0) return true;
+    
+    // Instruction starts, so jumps can be checked to land on one
+    std::vector<bool> starts(size, false);
+    for (size_t offset = 0; offset < size;) {
+        int length, effect;
+        if (!describeOpCode(chunk.code[offset], length, effect) || offset + length > size) {
+            return false;
+        }
+        starts[offset] = true;
+        offset += length;
+    }
+    
+    std::vector<size_t> work = {0};
+    depths[0] = 0;
+    while (!work.empty()) {
+        size_t offset = work.back();
+        work.pop_back();
+        
+        int length, effect;
+        describeOpCode(chunk.code[offset], length, effect);
+        OpCode op = static_cast<OpCode>(chunk.code[offset]);
+        if (op == OpCode::BUILD_ARRAY) effect -= chunk.code[offset + 1];
+        if (op == OpCode::BUILD_DICT) effect -= 2 * chunk.code[offset + 1];
+        if (op == OpCode::CALL_BUILTIN || op == OpCode::APPEND_LOCAL) effect -= chunk.code[offset + 2];
+        int depth = depths[offset] + effect;
+        if (depth < 0) return false;
+        maxDepth = std::max(maxDepth, depth);
+        
+        auto flowTo = [&](long target) {
+            if (target < 0 || static_cast<size_t>(target) >= size || !starts[target]) return false;
+            if (depths[target] == -1) {
+                depths[target] = depth;
+                work.push_back(static_cast<size_t>(target));
+            }
+            return depths[target] == depth;
+        };
+        
+        long target;
+        if (jumpTarget(chunk, offset, target)) {
+            bool keeps = op == OpCode::JUMP_IF_FALSE_OR_POP || op == OpCode::JUMP_IF_TRUE_OR_POP;
+            if (keeps) depth++;
+            if (!flowTo(target)) return false;
+            if (keeps) depth--;
+        }
+        
+        bool fallsThrough = op != OpCode::JUMP && op != OpCode::LOOP && op != OpCode::RETURN;
+        if (fallsThrough && !flowTo(static_cast<long>(offset + length))) return false;
+    }
+    
+    return true;
+}
+
+bool verifyChunk(Chunk& chunk, std::string& error) {
+    chunk.maxDepth = -1;
+    if (chunk.lines.size() != chunk.code.size()) {
+        error = "line table does not match the code";
+        return false;
+    }
+    
+    std::vector<int> depths;
+    int maxDepth;
+    if (!stackDepths(chunk, depths, maxDepth)) {
+        error = "malformed control flow or stack depths";
+        return false;
+    }
+    
+    // stackDepths() checked the opcodes and their lengths, so only the
+    // operands are left; unreachable code never runs and is skipped.
+    const std::vector<uint8_t>& code = chunk.code;
+    auto fail = [&](size_t offset, const char* what) {
+        error = std::string(what) + " at offset " + std::to_string(offset);
+        return false;
+    };
+    for (size_t offset = 0; offset < code.size();) {
+        int length, effect;
+        describeOpCode(code[offset], length, effect);
+        if (depths[offset] < 0) {
+            offset += length;
+            continue;
+        }
+        
+        switch (static_cast<OpCode>(code[offset])) {
+            case OpCode::CONSTANT:
+                if (code[offset + 1] >= chunk.constants.size()) return fail(offset, "constant out of range");
+                break;
+            case OpCode::GET_LOCAL:
+            case OpCode::SET_LOCAL:
+            case OpCode::GET_STRING_LOCAL:
+            case OpCode::APPEND_LOCAL:
+                if (code[offset + 1] >= chunk.localCount) return fail(offset, "variable slot out of range");
+                break;
+            case OpCode::LOOP:
+                if (code[offset + 3] >= chunk.loopCounts.size()) return fail(offset, "loop counter out of range");
+                break;
+            case OpCode::GET_MEMBER:
+                if (code[offset + 1] >= chunk.members.size() ||
+                    chunk.members[code[offset + 1]].module >= chunk.imports.size()) {
+                    return fail(offset, "module variable out of range");
+                }
+                break;
+            case OpCode::CALL_BUILTIN: {
+                int minArity, maxArity;
+                if (!builtinArity(code[offset + 1], minArity, maxArity)) return fail(offset, "unknown builtin");
+                if (code[offset + 2] < minArity || code[offset + 2] > maxArity) {
+                    return fail(offset, "wrong builtin argument count");
+                }
+                break;
+            }
+            default:
+                break;
+        }
+        offset += length;
+    }
+    
+    chunk.maxDepth = maxDepth;
+    return true;
+}
+
 // Disassembler implementation
-void Disassembler::disassembleChunk(const Chunk& chunk, const std::string& name) {
-    std::cout << "== " << name << " ==" << std::endl;
+void Disassembler::disassembleChunk(const Chunk& chunk, const std::string& name, std::ostream& out) {
+    out << "== " << name << " ==" << std::endl;
     
     for (int offset = 0; offset < chunk.code.size();) {
-        offset = disassembleInstruction(chunk, offset);
+        offset = disassembleInstruction(chunk, offset, out);
     }
 }
 
-int Disassembler::disassembleInstruction(const Chunk& chunk, int offset) {
-    std::cout << std::setw(4) << std::setfill('0') << offset << " ";
+int Disassembler::disassembleInstruction(const Chunk& chunk, int offset, std::ostream& out) {
+    out << std::setw(4) << std::setfill('0') << offset << " ";
     
     if (offset > 0 && chunk.lines[offset] == chunk.lines[offset - 1]) {
-        std::cout << "   | ";
+        out << "   | ";
     } else {
-        std::cout << std::setw(4) << chunk.lines[offset] << " ";
+        out << std::setw(4) << chunk.lines[offset] << " ";
     }
     
     uint8_t instruction = chunk.code[offset];
     switch (static_cast<OpCode>(instruction)) {
         case OpCode::CONSTANT:
-            return constantInstruction("CONSTANT", chunk, offset);
+            return constantInstruction("CONSTANT", chunk, offset, out);
         case OpCode::ADD:
-            return simpleInstruction("ADD", offset);
+            return simpleInstruction("ADD", offset, out);
         case OpCode::SUBTRACT:
-            return simpleInstruction("SUBTRACT", offset);
+            return simpleInstruction("SUBTRACT", offset, out);
         case OpCode::MULTIPLY:
-            return simpleInstruction("MULTIPLY", offset);
+            return simpleInstruction("MULTIPLY", offset, out);
         case OpCode::DIVIDE:
-            return simpleInstruction("DIVIDE", offset);
+            return simpleInstruction("DIVIDE", offset, out);
         case OpCode::NEGATE:
-            return simpleInstruction("NEGATE", offset);
+            return simpleInstruction("NEGATE", offset, out);
         case OpCode::NOT:
-            return simpleInstruction("NOT", offset);
+            return simpleInstruction("NOT", offset, out);
         case OpCode::EQUALS:
-            return simpleInstruction("EQUALS", offset);
+            return simpleInstruction("EQUALS", offset, out);
         case OpCode::GREATER:
-            return simpleInstruction("GREATER", offset);
+            return simpleInstruction("GREATER", offset, out);
         case OpCode::LESS:
-            return simpleInstruction("LESS", offset);
+            return simpleInstruction("LESS", offset, out);
+        case OpCode::LESS_EQUAL:
+            return simpleInstruction("LESS_EQUAL", offset, out);
+        case OpCode::GREATER_EQUAL:
+            return simpleInstruction("GREATER_EQUAL", offset, out);
+        case OpCode::FLOOR_DIVIDE:
+            return simpleInstruction("FLOOR_DIVIDE", offset, out);
+        case OpCode::MODULO:
+            return simpleInstruction("MODULO", offset, out);
+        case OpCode::BIT_AND:
+            return simpleInstruction("BIT_AND", offset, out);
+        case OpCode::BIT_OR:
+            return simpleInstruction("BIT_OR", offset, out);
+        case OpCode::BIT_XOR:
+            return simpleInstruction("BIT_XOR", offset, out);
+        case OpCode::BIT_NOT:
+            return simpleInstruction("BIT_NOT", offset, out);
+        case OpCode::SHIFT_LEFT:
+            return simpleInstruction("SHIFT_LEFT", offset, out);
+        case OpCode::SHIFT_RIGHT:
+            return simpleInstruction("SHIFT_RIGHT", offset, out);
+        case OpCode::ADD_NUMBER:
+            return simpleInstruction("ADD_NUMBER", offset, out);
+        case OpCode::SUBTRACT_NUMBER:
+            return simpleInstruction("SUBTRACT_NUMBER", offset, out);
+        case OpCode::MULTIPLY_NUMBER:
+            return simpleInstruction("MULTIPLY_NUMBER", offset, out);
+        case OpCode::DIVIDE_NUMBER:
+            return simpleInstruction("DIVIDE_NUMBER", offset, out);
+        case OpCode::NEGATE_NUMBER:
+            return simpleInstruction("NEGATE_NUMBER", offset, out);
+        case OpCode::EQUALS_NUMBER:
+            return simpleInstruction("EQUALS_NUMBER", offset, out);
+        case OpCode::GREATER_NUMBER:
+            return simpleInstruction("GREATER_NUMBER", offset, out);
+        case OpCode::LESS_NUMBER:
+            return simpleInstruction("LESS_NUMBER", offset, out);
+        case OpCode::ADD_INT:
+            return simpleInstruction("ADD_INT", offset, out);
+        case OpCode::SUBTRACT_INT:
+            return simpleInstruction("SUBTRACT_INT", offset, out);
+        case OpCode::MULTIPLY_INT:
+            return simpleInstruction("MULTIPLY_INT", offset, out);
+        case OpCode::NEGATE_INT:
+            return simpleInstruction("NEGATE_INT", offset, out);
+        case OpCode::EQUALS_INT:
+            return simpleInstruction("EQUALS_INT", offset, out);
+        case OpCode::GREATER_INT:
+            return simpleInstruction("GREATER_INT", offset, out);
+        case OpCode::LESS_INT:
+            return simpleInstruction("LESS_INT", offset, out);
+        case OpCode::CONCAT:
+            return simpleInstruction("CONCAT", offset, out);
+        case OpCode::GET_LOCAL:
+            return byteInstruction("GET_LOCAL", chunk, offset, out);
+        case OpCode::SET_LOCAL:
+            return byteInstruction("SET_LOCAL", chunk, offset, out);
+        case OpCode::GET_STRING_LOCAL:
+            return byteInstruction("GET_STRING_LOCAL", chunk, offset, out);
+        case OpCode::GET_MEMBER: {
+            // Replayed traces carry no member table.
+            uint8_t index = chunk.code[offset + 1];
+            out << "GET_MEMBER " << static_cast<int>(index);
+            if (index < chunk.members.size() && chunk.members[index].module < chunk.imports.size()) {
+                const Chunk::Member& member = chunk.members[index];
+                out << " '" << chunk.imports[member.module] << "." << member.name << "'";
+            }
+            out << std::endl;
+            return offset + 2;
+        }
+        case OpCode::APPEND_LOCAL:
+            out << "APPEND_LOCAL " << static_cast<int>(chunk.code[offset + 1]) << " "
+                      << static_cast<int>(chunk.code[offset + 2]) << std::endl;
+            return offset + 3;
+        case OpCode::BUILD_ARRAY:
+            return byteInstruction("BUILD_ARRAY", chunk, offset, out);
+        case OpCode::BUILD_DICT:
+            return byteInstruction("BUILD_DICT", chunk, offset, out);
+        case OpCode::GET_INDEX:
+            return simpleInstruction("GET_INDEX", offset, out);
+        case OpCode::SET_INDEX:
+            return simpleInstruction("SET_INDEX", offset, out);
+        case OpCode::CALL_BUILTIN:
+            out << "CALL_BUILTIN " << builtinName(static_cast<Builtin>(chunk.code[offset + 1]))
+                      << " " << static_cast<int>(chunk.code[offset + 2]) << std::endl;
+            return offset + 3;
+        case OpCode::JUMP:
+            return jumpInstruction("JUMP", chunk, offset, out);
+        case OpCode::JUMP_IF_FALSE:
+            return jumpInstruction("JUMP_IF_FALSE", chunk, offset, out);
+        case OpCode::JUMP_IF_TRUE:
+            return jumpInstruction("JUMP_IF_TRUE", chunk, offset, out);
+        case OpCode::JUMP_IF_FALSE_OR_POP:
+            return jumpInstruction("JUMP_IF_FALSE_OR_POP", chunk, offset, out);
+        case OpCode::JUMP_IF_TRUE_OR_POP:
+            return jumpInstruction("JUMP_IF_TRUE_OR_POP", chunk, offset, out);
+        case OpCode::LOOP:
+            return jumpInstruction("LOOP", chunk, offset, out);
+        case OpCode::EQUAL_JUMP:
+            return jumpInstruction("EQUAL_JUMP", chunk, offset, out);
+        case OpCode::NOT_EQUAL_JUMP:
+            return jumpInstruction("NOT_EQUAL_JUMP", chunk, offset, out);
+        case OpCode::LESS_JUMP:
+            return jumpInstruction("LESS_JUMP", chunk, offset, out);
+        case OpCode::LESS_EQUAL_JUMP:
+            return jumpInstruction("LESS_EQUAL_JUMP", chunk, offset, out);
+        case OpCode::GREATER_JUMP:
+            return jumpInstruction("GREATER_JUMP", chunk, offset, out);
+        case OpCode::GREATER_EQUAL_JUMP:
+            return jumpInstruction("GREATER_EQUAL_JUMP", chunk, offset, out);
         case OpCode::PRINT:
-            return simpleInstruction("PRINT", offset);
+            return simpleInstruction("PRINT", offset, out);
         case OpCode::POP:
-            return simpleInstruction("POP", offset);
+            return simpleInstruction("POP", offset, out);
+        case OpCode::AWAIT:
+            return simpleInstruction("AWAIT", offset, out);
         case OpCode::RETURN:
-            return simpleInstruction("RETURN", offset);
+            return simpleInstruction("RETURN", offset, out);
         default:
-            std::cout << "Unknown opcode " << instruction << std::endl;
+            out << "Unknown opcode " << instruction << std::endl;
             return offset + 1;
     }
 }
 
-int Disassembler::simpleInstruction(const std::string& name, int offset) {
-    std::cout << name << std::endl;
+int Disassembler::simpleInstruction(const std::string& name, int offset, std::ostream& out) {
+    out << name << std::endl;
     return offset + 1;
 }
 
-int Disassembler::constantInstruction(const std::string& name, const Chunk& chunk, int offset) {
+int Disassembler::constantInstruction(const std::string& name, const Chunk& chunk, int offset,
+                                      std::ostream& out) {
     uint8_t constantIndex = chunk.code[offset + 1];
-    std::cout << name << " " << static_cast<int>(constantIndex) << " '";
+    out << name << " " << static_cast<int>(constantIndex) << " '";
     
     // Print the constant value
     const Value& value = chunk.constants[constantIndex];
     if (std::holds_alternative<double>(value)) {
-        std::cout << std::get<double>(value);
+        out << std::get<double>(value);
+    } else if (std::holds_alternative<int64_t>(value)) {
+        out << std::get<int64_t>(value);
     } else if (std::holds_alternative<bool>(value)) {
-        std::cout << (std::get<bool>(value) ? "true" : "false");
-    } else if (std::holds_alternative<std::string>(value)) {
-        std::cout << std::get<std::string>(value);
+        out << (std::get<bool>(value) ? "true" : "false");
+    } else if (std::holds_alternative<Obj*>(value)) {
+        Obj* obj = std::get<Obj*>(value);
+        if (isObjType(obj, ObjType::STRING)) {
+            out << static_cast<ObjString*>(obj)->chars();
+        }
     } else if (std::holds_alternative<std::nullptr_t>(value)) {
-        std::cout << "null";
+        out << "null";
     }
     
-    std::cout << "'" << std::endl;
+    out << "'" << std::endl;
+    return offset + 2;
+}
+
+int Disassembler::byteInstruction(const std::string& name, const Chunk& chunk, int offset,
+                                  std::ostream& out) {
+    out << name << " " << static_cast<int>(chunk.code[offset + 1]) << std::endl;
     return offset + 2;
+}
+
+int Disassembler::jumpInstruction(const std::string& name, const Chunk& chunk, int offset,
+                                  std::ostream& out) {
+    long target = 0;
+    jumpTarget(chunk, offset, target);
+    out << name << " -> " << std::setw(4) << std::setfill('0') << target;
+    
+    bool loop = static_cast<OpCode>(chunk.code[offset]) == OpCode::LOOP;
+    if (loop) out << " (loop " << static_cast<int>(chunk.code[offset + 3]) << ")";
+    out << std::endl;
+    return offset + (loop ? 4 : 3);
 }
\ No newline at end of file
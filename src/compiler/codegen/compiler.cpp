@@ -1,4 +1,7 @@
 #include "../../include/compiler.h"
+#include "../../include/builtins.h"
+#include "../../include/timeline.h"
+#include <algorithm>
 #include <iostream>
 #include <string>
 #include <cstdlib>
@@ -7,29 +10,47 @@ bool Compiler::compile(const std::string& source, Chunk& chunk) {
     hadError = false;
     compilingChunk = &chunk;
     currentLine = 1;
+    locals.clear();
+    loops.clear();
+    builtStrings.clear();
     
     // Lexical analysis
-    Lexer lexer(source);
-    std::vector<Token> tokens = lexer.scanTokens();
+    std::vector<Token> tokens;
+    {
+        TimelineScope span("compile", "lex");
+        Lexer lexer(source);
+        tokens = lexer.scanTokens();
+    }
     
     // Parsing
-    Parser parser(tokens);
-    std::vector<std::unique_ptr<Statement>> statements = parser.parse();
+    std::vector<std::unique_ptr<Statement>> statements;
+    {
+        TimelineScope span("compile", "parse");
+        Parser parser(tokens);
+        statements = parser.parse();
+    }
     
     if (hadError) return false;
     
+    // Type checking
+    {
+        TimelineScope span("compile", "typecheck");
+        if (!types.check(statements)) return false;
+    }
+    
     // Code generation
+    TimelineScope span("compile", "codegen");
+    findAppends(statements, false);
     for (auto& stmt : statements) {
         stmt->accept(this);
     }
     
     emitReturn();
-    
-    #ifdef DEBUG_PRINT_CODE
-    if (!hadError) {
-        Disassembler::disassembleChunk(*currentChunk(), "code");
+    chunk.localCount = static_cast<int>(locals.size());
+    chunk.localNames.assign(locals.size(), std::string());
+    for (const auto& [name, slot] : locals) {
+        chunk.localNames[slot] = name;
     }
-    #endif
     
     return !hadError;
 }
@@ -37,6 +58,7 @@ bool Compiler::compile(const std::string& source, Chunk& chunk) {
 // Expression visitor methods
 
 void Compiler::visitLiteral(Literal* expr) {
+    currentLine = expr->line;
     if (expr->value == "null") {
         emitConstant(nullptr);
     } else if (expr->value == "true") {
@@ -45,8 +67,19 @@ void Compiler::visitLiteral(Literal* expr) {
         emitConstant(false);
     } else if (expr->value[0] == '"' && expr->value[expr->value.length() - 1] == '"') {
         // String literal (remove the quotes)
-        std::string str = expr->value.substr(1, expr->value.length() - 2);
-        emitConstant(str);
+        // Constants live as long as the chunk, so skip the nursery.
+        ObjString* str = heap.copyTenuredString(expr->value.data() + 1, expr->value.length() - 2);
+        emitConstant(static_cast<Obj*>(str));
+    } else if (expr->value.find('.') == std::string::npos) {
+        // Digits alone make an int
+        try {
+            int64_t value = std::stoll(expr->value);
+            emitConstant(value);
+        } catch (const std::out_of_range& e) {
+            error("Integer literal out of range: " + expr->value);
+        } catch (const std::exception& e) {
+            error("Invalid literal: " + expr->value);
+        }
     } else {
         // Assume it's a number
         try {
@@ -66,13 +99,19 @@ void Compiler::visitGroupingExpression(GroupingExpression* expr) {
 void Compiler::visitUnaryExpression(UnaryExpression* expr) {
     // Compile the operand first
     expr->right->accept(this);
+    currentLine = expr->op.line;
     
     // Then emit the unary operator
     switch (expr->op.type) {
         case TokenType::MINUS:
-            emitByte(OpCode::NEGATE);
+            emitByte(typedOp(types.typeOf(expr->right.get()),
+                             OpCode::NEGATE, OpCode::NEGATE_NUMBER, OpCode::NEGATE_INT));
+            break;
+        case TokenType::TILDE:
+            emitByte(OpCode::BIT_NOT);
             break;
         case TokenType::BANG:
+        case TokenType::NOT:
             emitByte(OpCode::NOT);
             break;
         default:
@@ -87,44 +126,81 @@ void Compiler::visitBinaryExpression(BinaryExpression* expr) {
     
     // Compile the right operand
     expr->right->accept(this);
+    currentLine = expr->op.line;
     
-    // Then emit the binary operator
+    // Then emit the binary operator, typed when the operands are proven
+    StaticType type = operandType(expr);
     switch (expr->op.type) {
         case TokenType::PLUS:
-            emitByte(OpCode::ADD);
+            if (type == StaticType::STRING) {
+                emitByte(OpCode::CONCAT);
+            } else {
+                emitByte(typedOp(type, OpCode::ADD, OpCode::ADD_NUMBER, OpCode::ADD_INT));
+            }
             break;
         case TokenType::MINUS:
-            emitByte(OpCode::SUBTRACT);
+            emitByte(typedOp(type, OpCode::SUBTRACT, OpCode::SUBTRACT_NUMBER, OpCode::SUBTRACT_INT));
             break;
         case TokenType::STAR:
-            emitByte(OpCode::MULTIPLY);
+            emitByte(typedOp(type, OpCode::MULTIPLY, OpCode::MULTIPLY_NUMBER, OpCode::MULTIPLY_INT));
             break;
         case TokenType::SLASH:
-            emitByte(OpCode::DIVIDE);
+            // Always a double, so only the double form is typed
+            emitByte(type == StaticType::NUMBER ? OpCode::DIVIDE_NUMBER : OpCode::DIVIDE);
+            break;
+        case TokenType::DIV:
+            emitByte(OpCode::FLOOR_DIVIDE);
+            break;
+        case TokenType::PERCENT:
+            emitByte(OpCode::MODULO);
+            break;
+        case TokenType::AMPERSAND:
+            emitByte(OpCode::BIT_AND);
+            break;
+        case TokenType::PIPE:
+            emitByte(OpCode::BIT_OR);
+            break;
+        case TokenType::CARET:
+            emitByte(OpCode::BIT_XOR);
+            break;
+        case TokenType::LESS_LESS:
+            emitByte(OpCode::SHIFT_LEFT);
+            break;
+        case TokenType::GREATER_GREATER:
+            emitByte(OpCode::SHIFT_RIGHT);
             break;
         case TokenType::EQUAL_EQUAL:
-            emitByte(OpCode::EQUALS);
+            emitByte(typedOp(type, OpCode::EQUALS, OpCode::EQUALS_NUMBER, OpCode::EQUALS_INT));
             break;
         case TokenType::BANG_EQUAL:
             // a != b is the same as !(a == b)
-            emitByte(OpCode::EQUALS);
+            emitByte(typedOp(type, OpCode::EQUALS, OpCode::EQUALS_NUMBER, OpCode::EQUALS_INT));
             emitByte(OpCode::NOT);
             break;
         case TokenType::GREATER:
-            emitByte(OpCode::GREATER);
+            emitByte(typedOp(type, OpCode::GREATER, OpCode::GREATER_NUMBER, OpCode::GREATER_INT));
             break;
         case TokenType::GREATER_EQUAL:
-            // a >= b is the same as !(a < b)
-            emitByte(OpCode::LESS);
-            emitByte(OpCode::NOT);
+            // a >= b is the same as !(a < b); the untyped form may be
+            // element-wise, so it has its own opcode
+            if (type == StaticType::NUMBER || type == StaticType::INT) {
+                emitByte(typedOp(type, OpCode::LESS, OpCode::LESS_NUMBER, OpCode::LESS_INT));
+                emitByte(OpCode::NOT);
+            } else {
+                emitByte(OpCode::GREATER_EQUAL);
+            }
             break;
         case TokenType::LESS:
-            emitByte(OpCode::LESS);
+            emitByte(typedOp(type, OpCode::LESS, OpCode::LESS_NUMBER, OpCode::LESS_INT));
             break;
         case TokenType::LESS_EQUAL:
             // a <= b is the same as !(a > b)
-            emitByte(OpCode::GREATER);
-            emitByte(OpCode::NOT);
+            if (type == StaticType::NUMBER || type == StaticType::INT) {
+                emitByte(typedOp(type, OpCode::GREATER, OpCode::GREATER_NUMBER, OpCode::GREATER_INT));
+                emitByte(OpCode::NOT);
+            } else {
+                emitByte(OpCode::LESS_EQUAL);
+            }
             break;
         default:
             error("Unknown binary operator: " + expr->op.lexeme);
@@ -132,9 +208,105 @@ void Compiler::visitBinaryExpression(BinaryExpression* expr) {
     }
 }
 
+void Compiler::visitLogicalExpression(LogicalExpression* expr) {
+    // The deciding operand is the result: 'and' keeps a falsy left
+    // operand, 'or' a truthy one, without evaluating the right.
+    expr->left->accept(this);
+    currentLine = expr->op.line;
+    int endJump = emitJump(expr->op.type == TokenType::AND ? OpCode::JUMP_IF_FALSE_OR_POP
+                                                           : OpCode::JUMP_IF_TRUE_OR_POP);
+    expr->right->accept(this);
+    patchJump(endJump);
+}
+
 void Compiler::visitVariableExpression(VariableExpression* expr) {
-    // For now, we don't support variables, so this is an error
-    error("Variables not supported yet: " + expr->name.lexeme);
+    currentLine = expr->name.line;
+    auto it = locals.find(expr->name.lexeme);
+    if (it == locals.end()) {
+        error("Undefined variable '" + expr->name.lexeme + "'.");
+        return;
+    }
+    bool built = builtStrings.count(expr->name.lexeme) > 0;
+    emitBytes(built ? OpCode::GET_STRING_LOCAL : OpCode::GET_LOCAL, it->second);
+}
+
+void Compiler::visitAwaitExpression(AwaitExpression* expr) {
+    currentLine = expr->keyword.line;
+    expr->operand->accept(this);
+    currentLine = expr->keyword.line;
+    emitByte(OpCode::AWAIT);
+}
+
+void Compiler::visitArrayExpression(ArrayExpression* expr) {
+    for (auto& element : expr->elements) {
+        element->accept(this);
+    }
+    currentLine = expr->bracket.line;
+    if (expr->elements.size() > UINT8_MAX) {
+        error("Too many elements in an array literal; use array(n) instead.");
+        return;
+    }
+    emitBytes(OpCode::BUILD_ARRAY, static_cast<uint8_t>(expr->elements.size()));
+}
+
+void Compiler::visitDictExpression(DictExpression* expr) {
+    for (size_t i = 0; i < expr->keys.size(); i++) {
+        expr->keys[i]->accept(this);
+        expr->values[i]->accept(this);
+    }
+    currentLine = expr->brace.line;
+    if (expr->keys.size() > UINT8_MAX) {
+        error("Too many entries in a dict literal; add the rest by index.");
+        return;
+    }
+    emitBytes(OpCode::BUILD_DICT, static_cast<uint8_t>(expr->keys.size()));
+}
+
+void Compiler::visitIndexExpression(IndexExpression* expr) {
+    expr->array->accept(this);
+    expr->index->accept(this);
+    currentLine = expr->bracket.line;
+    emitByte(OpCode::GET_INDEX);
+}
+
+void Compiler::visitCallExpression(CallExpression* expr) {
+    for (auto& argument : expr->arguments) {
+        argument->accept(this);
+    }
+    currentLine = expr->name.line;
+    
+    // The type checker already rejected unknown names and bad arities.
+    Builtin builtin;
+    int minArity, maxArity;
+    if (!findBuiltin(expr->name.lexeme, builtin, minArity, maxArity)) {
+        error("Unknown function '" + expr->name.lexeme + "'.");
+        return;
+    }
+    emitBytes(OpCode::CALL_BUILTIN, static_cast<uint8_t>(builtin));
+    emitOperand(static_cast<uint8_t>(expr->arguments.size()));
+}
+
+void Compiler::visitMemberExpression(MemberExpression* expr) {
+    currentLine = expr->name.line;
+    Chunk* chunk = currentChunk();
+    auto module = std::find(chunk->imports.begin(), chunk->imports.end(), expr->module.lexeme);
+    if (module == chunk->imports.end()) {
+        error("Module '" + expr->module.lexeme + "' is not imported.");
+        return;
+    }
+    
+    Chunk::Member member{static_cast<uint8_t>(module - chunk->imports.begin()), expr->name.lexeme};
+    auto it = std::find_if(chunk->members.begin(), chunk->members.end(), [&](const Chunk::Member& m) {
+        return m.module == member.module && m.name == member.name;
+    });
+    if (it == chunk->members.end()) {
+        if (chunk->members.size() > UINT8_MAX) {
+            error("Too many module variables used in one chunk.");
+            return;
+        }
+        it = chunk->members.insert(chunk->members.end(), member);
+    }
+    emitBytes(OpCode::GET_MEMBER, static_cast<uint8_t>(it - chunk->members.begin()));
 }
 
 // Statement visitor methods
@@ -159,6 +331,154 @@ void Compiler::visitTaskStatement(TaskStatement* stmt) {
     error("Task declarations not supported in bytecode compiler yet.");
 }
 
+void Compiler::visitAssignStatement(AssignStatement* stmt) {
+    // In a loop, append in place; the pieces are all evaluated first, as
+    // they would be before the concatenation.
+    std::vector<Expression*> pieces;
+    if (!loops.empty() && appendPieces(stmt, pieces)) {
+        for (Expression* piece : pieces) {
+            piece->accept(this);
+        }
+        currentLine = stmt->name.line;
+        emitBytes(OpCode::APPEND_LOCAL, locals[stmt->name.lexeme]);
+        emitOperand(static_cast<uint8_t>(pieces.size()));
+        return;
+    }
+    
+    stmt->value->accept(this);
+    currentLine = stmt->name.line;
+    int slot = declareLocal(stmt->name.lexeme);
+    if (slot >= 0) emitBytes(OpCode::SET_LOCAL, slot);
+}
+
+void Compiler::visitSetIndexStatement(SetIndexStatement* stmt) {
+    stmt->target->array->accept(this);
+    stmt->target->index->accept(this);
+    stmt->value->accept(this);
+    currentLine = stmt->target->bracket.line;
+    emitByte(OpCode::SET_INDEX);
+}
+
+void Compiler::visitIfStatement(IfStatement* stmt) {
+    currentLine = stmt->keyword.line;
+    std::vector<int> elseJumps;
+    emitCondition(stmt->condition.get(), false, elseJumps);
+    compileBlock(stmt->thenBranch);
+    
+    if (stmt->elseBranch.empty()) {
+        for (int jump : elseJumps) patchJump(jump);
+        return;
+    }
+    
+    int endJump = emitJump(OpCode::JUMP);
+    for (int jump : elseJumps) patchJump(jump);
+    compileBlock(stmt->elseBranch);
+    patchJump(endJump);
+}
+
+void Compiler::visitWhileStatement(WhileStatement* stmt) {
+    currentLine = stmt->keyword.line;
+    int index = addLoop();
+    if (index < 0) return;
+    
+    Loop loop{static_cast<int>(currentChunk()->code.size()), static_cast<uint8_t>(index), false, {}, {}};
+    std::vector<int> exitJumps;
+    emitCondition(stmt->condition.get(), false, exitJumps);
+    
+    loops.push_back(loop);
+    compileBlock(stmt->body);
+    loop = std::move(loops.back());
+    loops.pop_back();
+    
+    emitLoop(loop);
+    for (int jump : exitJumps) patchJump(jump);
+    for (int jump : loop.breakJumps) patchJump(jump);
+}
+
+void Compiler::visitForStatement(ForStatement* stmt) {
+    currentLine = stmt->keyword.line;
+    int slot = declareLocal(stmt->variable.lexeme);
+    int index = addLoop();
+    if (slot < 0 || index < 0) return;
+    
+    stmt->start->accept(this);
+    emitBytes(OpCode::SET_LOCAL, slot);
+    
+    // The bound is evaluated once. A literal is simply reloaded; anything
+    // else is kept in a hidden slot.
+    bool literalStop = dynamic_cast<Literal*>(stmt->stop.get()) != nullptr;
+    int stopSlot = -1;
+    if (!literalStop) {
+        stopSlot = declareLocal("(for bound " + std::to_string(currentChunk()->code.size()) + ")");
+        if (stopSlot < 0) return;
+        stmt->stop->accept(this);
+        emitBytes(OpCode::SET_LOCAL, stopSlot);
+    }
+    
+    Loop loop{static_cast<int>(currentChunk()->code.size()), static_cast<uint8_t>(index), true, {}, {}};
+    emitBytes(OpCode::GET_LOCAL, slot);
+    if (literalStop) {
+        stmt->stop->accept(this);
+    } else {
+        emitBytes(OpCode::GET_LOCAL, stopSlot);
+    }
+    int exitJump = emitJump(stmt->step > 0 ? OpCode::LESS_JUMP : OpCode::GREATER_JUMP);
+    
+    loops.push_back(loop);
+    compileBlock(stmt->body);
+    loop = std::move(loops.back());
+    loops.pop_back();
+    
+    // continue lands on the increment
+    for (int jump : loop.continueJumps) patchJump(jump);
+    currentLine = stmt->keyword.line;
+    emitBytes(OpCode::GET_LOCAL, slot);
+    emitConstant(stmt->step);
+    bool ints = types.variableType(stmt->variable.lexeme) == StaticType::INT;
+    emitByte(ints ? OpCode::ADD_INT : OpCode::ADD);
+    emitBytes(OpCode::SET_LOCAL, slot);
+    
+    emitLoop(loop);
+    patchJump(exitJump);
+    for (int jump : loop.breakJumps) patchJump(jump);
+}
+
+void Compiler::visitBreakStatement(BreakStatement* stmt) {
+    currentLine = stmt->keyword.line;
+    if (loops.empty()) {
+        error("Can't use 'break' outside of a loop.");
+        return;
+    }
+    loops.back().breakJumps.push_back(emitJump(OpCode::JUMP));
+}
+
+void Compiler::visitContinueStatement(ContinueStatement* stmt) {
+    currentLine = stmt->keyword.line;
+    if (loops.empty()) {
+        error("Can't use 'continue' outside of a loop.");
+        return;
+    }
+    
+    Loop& loop = loops.back();
+    if (loop.continueForward) {
+        loop.continueJumps.push_back(emitJump(OpCode::JUMP));
+    } else {
+        emitLoop(loop);
+    }
+}
+
+void Compiler::visitImportStatement(ImportStatement* stmt) {
+    // Only recorded: the VM loads the module when the chunk first reads it.
+    currentLine = stmt->name.line;
+    std::vector<std::string>& imports = currentChunk()->imports;
+    if (std::find(imports.begin(), imports.end(), stmt->name.lexeme) != imports.end()) return;
+    if (imports.size() > UINT8_MAX) {
+        error("Too many imports in one chunk.");
+        return;
+    }
+    imports.push_back(stmt->name.lexeme);
+}
+
 // Helper methods
 
 void Compiler::emitByte(OpCode byte) {
@@ -167,7 +487,11 @@ void Compiler::emitByte(OpCode byte) {
 
 void Compiler::emitBytes(OpCode byte1, uint8_t byte2) {
     emitByte(byte1);
-    currentChunk()->code.push_back(byte2);
+    emitOperand(byte2);
+}
+
+void Compiler::emitOperand(uint8_t byte) {
+    currentChunk()->code.push_back(byte);
     currentChunk()->lines.push_back(currentLine);
 }
 
@@ -180,6 +504,182 @@ void Compiler::emitReturn() {
     emitByte(OpCode::RETURN);
 }
 
+int Compiler::emitJump(OpCode op) {
+    emitByte(op);
+    emitOperand(0xFF);
+    emitOperand(0xFF);
+    return static_cast<int>(currentChunk()->code.size()) - 2;
+}
+
+void Compiler::patchJump(int operand) {
+    // Counted from the end of the jump instruction
+    int distance = static_cast<int>(currentChunk()->code.size()) - operand - 2;
+    if (distance > UINT16_MAX) {
+        error("Too much code to jump over.");
+        return;
+    }
+    currentChunk()->code[operand] = static_cast<uint8_t>(distance >> 8);
+    currentChunk()->code[operand + 1] = static_cast<uint8_t>(distance);
+}
+
+void Compiler::emitLoop(const Loop& loop) {
+    emitByte(OpCode::LOOP);
+    int distance = static_cast<int>(currentChunk()->code.size()) + 3 - loop.start;
+    if (distance > UINT16_MAX) {
+        error("Loop body too large.");
+        distance = 0;
+    }
+    emitOperand(static_cast<uint8_t>(distance >> 8));
+    emitOperand(static_cast<uint8_t>(distance));
+    emitOperand(loop.index);
+}
+
+void Compiler::emitCondition(Expression* condition, bool jumpWhen, std::vector<int>& jumps) {
+    while (auto* grouping = dynamic_cast<GroupingExpression*>(condition)) {
+        condition = grouping->expression.get();
+    }
+    
+    if (auto* unary = dynamic_cast<UnaryExpression*>(condition)) {
+        if (unary->op.type == TokenType::NOT || unary->op.type == TokenType::BANG) {
+            emitCondition(unary->right.get(), !jumpWhen, jumps);
+            return;
+        }
+    }
+    
+    // 'a and b' is false as soon as a is, 'a or b' true as soon as a is.
+    // When the left operand decides the other way, it jumps past the right
+    // one instead.
+    if (auto* logical = dynamic_cast<LogicalExpression*>(condition)) {
+        bool decides = logical->op.type == TokenType::OR;
+        if (decides == jumpWhen) {
+            emitCondition(logical->left.get(), jumpWhen, jumps);
+            emitCondition(logical->right.get(), jumpWhen, jumps);
+        } else {
+            std::vector<int> skips;
+            emitCondition(logical->left.get(), !jumpWhen, skips);
+            emitCondition(logical->right.get(), jumpWhen, jumps);
+            for (int jump : skips) patchJump(jump);
+        }
+        return;
+    }
+    
+    // A comparison branches directly instead of pushing a bool. The fused
+    // opcodes jump when their condition fails; jumping when it holds uses
+    // the negated one (< and >= are exact negations, NaN included).
+    if (auto* binary = dynamic_cast<BinaryExpression*>(condition)) {
+        OpCode fused;
+        bool comparison = true;
+        switch (binary->op.type) {
+            case TokenType::EQUAL_EQUAL:
+                fused = jumpWhen ? OpCode::NOT_EQUAL_JUMP : OpCode::EQUAL_JUMP;
+                break;
+            case TokenType::BANG_EQUAL:
+                fused = jumpWhen ? OpCode::EQUAL_JUMP : OpCode::NOT_EQUAL_JUMP;
+                break;
+            case TokenType::LESS:
+                fused = jumpWhen ? OpCode::GREATER_EQUAL_JUMP : OpCode::LESS_JUMP;
+                break;
+            case TokenType::LESS_EQUAL:
+                fused = jumpWhen ? OpCode::GREATER_JUMP : OpCode::LESS_EQUAL_JUMP;
+                break;
+            case TokenType::GREATER:
+                fused = jumpWhen ? OpCode::LESS_EQUAL_JUMP : OpCode::GREATER_JUMP;
+                break;
+            case TokenType::GREATER_EQUAL:
+                fused = jumpWhen ? OpCode::LESS_JUMP : OpCode::GREATER_EQUAL_JUMP;
+                break;
+            default:
+                comparison = false;
+                break;
+        }
+        if (comparison) {
+            binary->left->accept(this);
+            binary->right->accept(this);
+            currentLine = binary->op.line;
+            jumps.push_back(emitJump(fused));
+            return;
+        }
+    }
+    
+    condition->accept(this);
+    jumps.push_back(emitJump(jumpWhen ? OpCode::JUMP_IF_TRUE : OpCode::JUMP_IF_FALSE));
+}
+
+void Compiler::compileBlock(const std::vector<std::unique_ptr<Statement>>& statements) {
+    for (const auto& stmt : statements) {
+        stmt->accept(this);
+    }
+}
+
+bool Compiler::appendPieces(AssignStatement* stmt, std::vector<Expression*>& pieces) {
+    const std::string& name = stmt->name.lexeme;
+    if (types.variableType(name) != StaticType::STRING) return false;
+    
+    Expression* expr = stmt->value.get();
+    while (auto* binary = dynamic_cast<BinaryExpression*>(expr)) {
+        if (binary->op.type != TokenType::PLUS || types.typeOf(binary->right.get()) != StaticType::STRING) {
+            return false;
+        }
+        pieces.insert(pieces.begin(), binary->right.get());
+        expr = binary->left.get();
+    }
+    auto* variable = dynamic_cast<VariableExpression*>(expr);
+    return variable != nullptr && variable->name.lexeme == name && !pieces.empty() &&
+           pieces.size() <= UINT8_MAX;
+}
+
+void Compiler::findAppends(const std::vector<std::unique_ptr<Statement>>& statements, bool inLoop) {
+    for (auto& stmt : statements) {
+        if (auto* assign = dynamic_cast<AssignStatement*>(stmt.get())) {
+            std::vector<Expression*> pieces;
+            if (inLoop && appendPieces(assign, pieces)) builtStrings.insert(assign->name.lexeme);
+        } else if (auto* branch = dynamic_cast<IfStatement*>(stmt.get())) {
+            findAppends(branch->thenBranch, inLoop);
+            findAppends(branch->elseBranch, inLoop);
+        } else if (auto* loop = dynamic_cast<WhileStatement*>(stmt.get())) {
+            findAppends(loop->body, true);
+        } else if (auto* loop = dynamic_cast<ForStatement*>(stmt.get())) {
+            findAppends(loop->body, true);
+        }
+    }
+}
+
+int Compiler::declareLocal(const std::string& name) {
+    auto it = locals.find(name);
+    if (it != locals.end()) return it->second;
+    
+    if (locals.size() > UINT8_MAX) {
+        error("Too many variables in one chunk.");
+        return -1;
+    }
+    uint8_t slot = static_cast<uint8_t>(locals.size());
+    locals[name] = slot;
+    return slot;
+}
+
+int Compiler::addLoop() {
+    std::vector<uint64_t>& counts = currentChunk()->loopCounts;
+    if (counts.size() > UINT8_MAX) {
+        error("Too many loops in one chunk.");
+        return -1;
+    }
+    counts.push_back(0);
+    return static_cast<int>(counts.size()) - 1;
+}
+
+StaticType Compiler::operandType(BinaryExpression* expr) {
+    StaticType left = types.typeOf(expr->left.get());
+    return left == types.typeOf(expr->right.get()) ? left : StaticType::UNKNOWN;
+}
+
+OpCode Compiler::typedOp(StaticType type, OpCode generic, OpCode number, OpCode integer) {
+    switch (type) {
+        case StaticType::NUMBER: return number;
+        case StaticType::INT: return integer;
+        default: return generic;
+    }
+}
+
 void Compiler::error(const std::string& message) {
     hadError = true;
     std::cerr << "Compiler error: " << message << std::endl;
@@ -0,0 +1,643 @@
+#include "../../include/jit.h"
+#include <algorithm>
+#include <cstring>
+#include <initializer_list>
+#include <unordered_map>
+
+#if defined(__x86_64__) && defined(__linux__)
+#include <sys/mman.h>
+#include <unistd.h>
+#define JIT_SUPPORTED
+#endif
+
+namespace {
+
+// Native entry point shared by every instruction: saves registers, loads the
+// stack top into rbx, the constant table into r12, the stack base (the
+// variable slots) into r13 and the fuel counter into r14, then jumps to
+// target.
+using NativeEntry = JitExit (*)(Value* top, const Value* constants, const void* target, Value* base,
+                                int64_t* fuel);
+
+// Value tags as stored by std::variant, checked once by valueLayoutMatches()
+enum Tag : uint8_t {
+    TAG_NUMBER = 0,
+    TAG_BOOL = 1,
+    TAG_OBJ = 2,
+    TAG_NULL = 3,
+    TAG_INT = 4
+};
+
+// Slot fields relative to rbx, which points one past the top of the stack
+constexpr uint8_t kTopPayload = 0xF0;    // [rbx - 16]
+constexpr uint8_t kTopTag = 0xF8;        // [rbx - 8]
+constexpr uint8_t kSecondPayload = 0xE0; // [rbx - 32]
+constexpr uint8_t kSecondTag = 0xE8;     // [rbx - 24]
+
+// ObjArray fields read by the GET_INDEX template, checked by
+// arrayLayoutMatches()
+constexpr uint8_t kArrayStorage = 8;
+constexpr uint8_t kArrayLength = 12;
+constexpr uint8_t kArrayElements = 16;
+
+// Labels: bytecode offsets name an instruction's bail-out stub, and
+// startLabel() its native code.
+constexpr int kEpilogue = -1;
+
+int startLabel(size_t ip) { return -2 - static_cast<int>(ip); }
+
+// The templates read and write Values as an 8-byte payload followed by a
+// one-byte tag. That is how libstdc++ lays out this variant, but make sure
+// before trusting it.
+bool valueLayoutMatches() {
+    if (sizeof(Value) != 16 || alignof(Value) != 8) return false;
+    
+    auto tagOf = [](const Value& value) {
+        uint8_t bytes[sizeof(Value)];
+        std::memcpy(bytes, &value, sizeof(Value));
+        return bytes[8];
+    };
+    Value number = 2.5;
+    Value flag = true;
+    Value object = static_cast<Obj*>(nullptr);
+    Value null = nullptr;
+    Value integer = int64_t(-7);
+    if (tagOf(number) != TAG_NUMBER || tagOf(flag) != TAG_BOOL ||
+        tagOf(object) != TAG_OBJ || tagOf(null) != TAG_NULL || tagOf(integer) != TAG_INT) {
+        return false;
+    }
+    
+    double payload;
+    std::memcpy(&payload, &number, sizeof(double));
+    uint8_t boolByte;
+    std::memcpy(&boolByte, &flag, 1);
+    int64_t intPayload;
+    std::memcpy(&intPayload, &integer, sizeof(int64_t));
+    return payload == 2.5 && boolByte == 1 && intPayload == -7;
+}
+
+bool arrayLayoutMatches() {
+    ObjArray array{};
+    auto offset = [&](const void* field) {
+        return static_cast<const uint8_t*>(field) - reinterpret_cast<const uint8_t*>(&array);
+    };
+    return offsetof(Obj, type) == 0 && offset(&array.storage) == kArrayStorage &&
+           offset(&array.length) == kArrayLength && sizeof(ObjArray) == kArrayElements;
+}
+
+// Byte emitter with rel32 jumps to labels bound later.
+class Assembler {
+public:
+    std::vector<uint8_t> code;
+    
+    size_t size() const { return code.size(); }
+    
+    void bytes(std::initializer_list<uint8_t> list) {
+        code.insert(code.end(), list);
+    }
+    
+    void imm32(uint32_t value) {
+        for (int i = 0; i < 4; i++) {
+            code.push_back(static_cast<uint8_t>(value >> (8 * i)));
+        }
+    }
+    
+    void jump(std::initializer_list<uint8_t> opcode, int label) {
+        bytes(opcode);
+        fixups.push_back({code.size(), label});
+        imm32(0);
+    }
+    
+    void bind(int label) { labels[label] = code.size(); }
+    
+    // A label for code inside one template, distinct from every bytecode
+    // offset and start label.
+    int local() { return kLocalLabels + localCount++; }
+    
+    // Bail-out labels jumped to but not bound yet, in first-use order.
+    std::vector<int> unboundLabels() const {
+        std::vector<int> result;
+        for (const Fixup& fixup : fixups) {
+            if (fixup.label >= 0 && labels.count(fixup.label) == 0 &&
+                std::find(result.begin(), result.end(), fixup.label) == result.end()) {
+                result.push_back(fixup.label);
+            }
+        }
+        return result;
+    }
+    
+    void link() {
+        for (const Fixup& fixup : fixups) {
+            int32_t rel = static_cast<int32_t>(labels.at(fixup.label) - (fixup.at + 4));
+            std::memcpy(&code[fixup.at], &rel, sizeof(rel));
+        }
+    }
+
+private:
+    struct Fixup {
+        size_t at;
+        int label;
+    };
+    
+    static constexpr int kLocalLabels = 1 << 24;  // Above any 16-bit-jump chunk
+    
+    std::unordered_map<int, size_t> labels;
+    int localCount = 0;
+    std::vector<Fixup> fixups;
+};
+
+// cmp byte [rbx + tag], TAG_NUMBER; jne bail
+void guardNumber(Assembler& a, uint8_t tag, int bail) {
+    a.bytes({0x80, 0x7B, tag, TAG_NUMBER});
+    a.jump({0x0F, 0x85}, bail);
+}
+
+// cmp byte [rbx + tag], TAG_INT; jne bail
+void guardInt(Assembler& a, uint8_t tag, int bail) {
+    a.bytes({0x80, 0x7B, tag, TAG_INT});
+    a.jump({0x0F, 0x85}, bail);
+}
+
+// mov rax, rbx; mov edx, ip; jmp epilogue
+void exitTo(Assembler& a, int ip) {
+    a.bytes({0x48, 0x89, 0xD8});
+    a.bytes({0xBA});
+    a.imm32(static_cast<uint32_t>(ip));
+    a.jump({0xE9}, kEpilogue);
+}
+
+// Pop both operands' slots down to one and store al as a bool result.
+void storeBoolResult(Assembler& a) {
+    a.bytes({0x88, 0x43, kSecondPayload});       // mov [rbx - 32], al
+    a.bytes({0xC6, 0x43, kSecondTag, TAG_BOOL}); // mov byte [rbx - 24], TAG_BOOL
+    a.bytes({0x48, 0x83, 0xEB, 0x10});           // sub rbx, 16
+}
+
+// xmm0 = second, xmm1 = top. Typed opcodes skip the guards, the type
+// checker already proved both are numbers.
+void loadNumberOperands(Assembler& a, int bail, bool guarded) {
+    if (guarded) {
+        guardNumber(a, kTopTag, bail);
+        guardNumber(a, kSecondTag, bail);
+    }
+    a.bytes({0xF2, 0x0F, 0x10, 0x43, kSecondPayload}); // movsd xmm0, [rbx - 32]
+    a.bytes({0xF2, 0x0F, 0x10, 0x4B, kTopPayload});    // movsd xmm1, [rbx - 16]
+}
+
+void arithmetic(Assembler& a, uint8_t sseOp, int bail, bool guarded) {
+    loadNumberOperands(a, bail, guarded);
+    if (sseOp == 0x5E) {
+        // Leave division by zero (and NaN divisors) to the interpreter.
+        a.bytes({0x66, 0x0F, 0x57, 0xD2}); // xorpd xmm2, xmm2
+        a.bytes({0x66, 0x0F, 0x2E, 0xCA}); // ucomisd xmm1, xmm2
+        a.jump({0x0F, 0x84}, bail);        // je bail
+    }
+    a.bytes({0xF2, 0x0F, sseOp, 0xC1});                // op xmm0, xmm1
+    a.bytes({0xF2, 0x0F, 0x11, 0x43, kSecondPayload}); // movsd [rbx - 32], xmm0
+    a.bytes({0x48, 0x83, 0xEB, 0x10});                 // sub rbx, 16
+}
+
+// Typed int add/sub/imul on rax; overflow bails so the interpreter raises
+// the error.
+void intArithmetic(Assembler& a, std::initializer_list<uint8_t> op, int bail) {
+    a.bytes({0x48, 0x8B, 0x43, kSecondPayload}); // mov rax, [rbx - 32]
+    a.bytes(op);                                 // op rax, [rbx - 16]
+    a.jump({0x0F, 0x80}, bail);                  // jo bail
+    a.bytes({0x48, 0x89, 0x43, kSecondPayload}); // mov [rbx - 32], rax
+    a.bytes({0x48, 0x83, 0xEB, 0x10});           // sub rbx, 16
+}
+
+// Typed int comparison; setcc is the condition's set instruction.
+void intCompare(Assembler& a, uint8_t setcc) {
+    a.bytes({0x48, 0x8B, 0x43, kSecondPayload}); // mov rax, [rbx - 32]
+    a.bytes({0x48, 0x3B, 0x43, kTopPayload});    // cmp rax, [rbx - 16]
+    a.bytes({0x0F, setcc, 0xC0});                // setcc al
+    storeBoolResult(a);
+}
+
+// Fused compare-and-branch on two ints or two numbers; anything else bails.
+// Pops with lea, which leaves the flags alone, and jumps to target when the
+// condition fails.
+void compareAndBranch(Assembler& a, OpCode op, int bail, int target, int next) {
+    int doubles = a.local();
+    a.bytes({0x0F, 0xB6, 0x43, kTopTag});    // movzx eax, byte [rbx - 8]
+    a.bytes({0x3A, 0x43, kSecondTag});       // cmp al, [rbx - 24]
+    a.jump({0x0F, 0x85}, bail);              // jne bail
+    a.bytes({0x3C, TAG_NUMBER});             // cmp al, TAG_NUMBER
+    a.jump({0x0F, 0x84}, doubles);           // je doubles
+    a.bytes({0x3C, TAG_INT});                // cmp al, TAG_INT
+    a.jump({0x0F, 0x85}, bail);              // jne bail
+    
+    a.bytes({0x48, 0x8B, 0x43, kSecondPayload}); // mov rax, [rbx - 32]
+    a.bytes({0x48, 0x3B, 0x43, kTopPayload});    // cmp rax, [rbx - 16]
+    a.bytes({0x48, 0x8D, 0x5B, 0xE0});           // lea rbx, [rbx - 32]
+    uint8_t fails;
+    switch (op) {
+        case OpCode::EQUAL_JUMP: fails = 0x85; break;         // jne
+        case OpCode::NOT_EQUAL_JUMP: fails = 0x84; break;     // je
+        case OpCode::LESS_JUMP: fails = 0x8D; break;          // jge
+        case OpCode::LESS_EQUAL_JUMP: fails = 0x8F; break;    // jg
+        case OpCode::GREATER_JUMP: fails = 0x8E; break;       // jle
+        default: fails = 0x8C; break;                         // jl
+    }
+    a.jump({0x0F, fails}, target);
+    a.jump({0xE9}, next);
+    
+    // An unordered (NaN) compare fails ==, < and >, and holds for the negated
+    // forms !=, <= and >=, matching branchHolds().
+    a.bind(doubles);
+    a.bytes({0xF2, 0x0F, 0x10, 0x43, kSecondPayload}); // movsd xmm0, [rbx - 32]
+    a.bytes({0xF2, 0x0F, 0x10, 0x4B, kTopPayload});    // movsd xmm1, [rbx - 16]
+    a.bytes({0x48, 0x8D, 0x5B, 0xE0});                 // lea rbx, [rbx - 32]
+    switch (op) {
+        case OpCode::EQUAL_JUMP:
+            a.bytes({0x66, 0x0F, 0x2E, 0xC1}); // ucomisd xmm0, xmm1
+            a.jump({0x0F, 0x85}, target);      // jne
+            a.jump({0x0F, 0x8A}, target);      // jp
+            break;
+        case OpCode::NOT_EQUAL_JUMP:
+            a.bytes({0x66, 0x0F, 0x2E, 0xC1}); // ucomisd xmm0, xmm1
+            a.jump({0x0F, 0x8A}, next);        // jp
+            a.jump({0x0F, 0x84}, target);      // je
+            break;
+        case OpCode::LESS_JUMP:
+            a.bytes({0x66, 0x0F, 0x2E, 0xC8}); // ucomisd xmm1, xmm0
+            a.jump({0x0F, 0x86}, target);      // jbe
+            break;
+        case OpCode::LESS_EQUAL_JUMP:
+            a.bytes({0x66, 0x0F, 0x2E, 0xC1}); // ucomisd xmm0, xmm1
+            a.jump({0x0F, 0x87}, target);      // ja
+            break;
+        case OpCode::GREATER_JUMP:
+            a.bytes({0x66, 0x0F, 0x2E, 0xC1}); // ucomisd xmm0, xmm1
+            a.jump({0x0F, 0x86}, target);      // jbe
+            break;
+        default:
+            a.bytes({0x66, 0x0F, 0x2E, 0xC8}); // ucomisd xmm1, xmm0
+            a.jump({0x0F, 0x87}, target);      // ja
+            break;
+    }
+    a.jump({0xE9}, next);
+}
+    
+} // namespace
+
+std::shared_ptr<JitCode> JitCode::compile(const Chunk& chunk) {
+#ifndef JIT_SUPPORTED
+    (void)chunk;
+    return nullptr;
+#else
+    if (!valueLayoutMatches() || !arrayLayoutMatches()) return nullptr;
+    if (chunk.code.empty() || static_cast<OpCode>(chunk.code.back()) != OpCode::RETURN) {
+        return nullptr;
+    }
+    
+    std::shared_ptr<JitCode> jit(new JitCode());
+    jit->entries.assign(chunk.code.size(), -1);
+    if (!stackDepths(chunk, jit->depths, jit->maxDepth)) return nullptr;
+    
+    Assembler a;
+    a.bytes({0x53});             // push rbx
+    a.bytes({0x41, 0x54});       // push r12
+    a.bytes({0x41, 0x55});       // push r13
+    a.bytes({0x41, 0x56});       // push r14
+    a.bytes({0x48, 0x89, 0xFB}); // mov rbx, rdi
+    a.bytes({0x49, 0x89, 0xF4}); // mov r12, rsi
+    a.bytes({0x49, 0x89, 0xCD}); // mov r13, rcx
+    a.bytes({0x4D, 0x89, 0xC6}); // mov r14, r8
+    a.bytes({0xFF, 0xE2});       // jmp rdx
+    
+    for (size_t offset = 0; offset < chunk.code.size();) {
+        int ip = static_cast<int>(offset);
+        OpCode op = static_cast<OpCode>(chunk.code[offset]);
+        int length, effect;
+        describeOpCode(chunk.code[offset], length, effect);
+        
+        // Unreachable code (after a break, say) gets no template.
+        if (jit->depths[ip] < 0) {
+            offset += length;
+            continue;
+        }
+        
+        int32_t start = static_cast<int32_t>(a.size());
+        a.bind(startLabel(offset));
+        bool native = true;
+        
+        switch (op) {
+            case OpCode::CONSTANT: {
+                uint32_t displacement = chunk.code[offset + 1] * sizeof(Value);
+                a.bytes({0xF3, 0x41, 0x0F, 0x6F, 0x84, 0x24}); // movdqu xmm0, [r12 + disp32]
+                a.imm32(displacement);
+                a.bytes({0xF3, 0x0F, 0x7F, 0x03});             // movdqu [rbx], xmm0
+                a.bytes({0x48, 0x83, 0xC3, 0x10});             // add rbx, 16
+                break;
+            }
+            case OpCode::ADD:
+            case OpCode::ADD_NUMBER:
+                arithmetic(a, 0x58, ip, op == OpCode::ADD);
+                break;
+            case OpCode::SUBTRACT:
+            case OpCode::SUBTRACT_NUMBER:
+                arithmetic(a, 0x5C, ip, op == OpCode::SUBTRACT);
+                break;
+            case OpCode::MULTIPLY:
+            case OpCode::MULTIPLY_NUMBER:
+                arithmetic(a, 0x59, ip, op == OpCode::MULTIPLY);
+                break;
+            case OpCode::DIVIDE:
+            case OpCode::DIVIDE_NUMBER:
+                arithmetic(a, 0x5E, ip, op == OpCode::DIVIDE);
+                break;
+            case OpCode::NEGATE:
+            case OpCode::NEGATE_NUMBER:
+                if (op == OpCode::NEGATE) guardNumber(a, kTopTag, ip);
+                a.bytes({0x48, 0x0F, 0xBA, 0x7B, kTopPayload, 0x3F}); // btc qword [rbx - 16], 63
+                break;
+            case OpCode::NOT:
+                // !v is true for null and false, false for everything else.
+                a.bytes({0x0F, 0xB6, 0x43, kTopTag});       // movzx eax, byte [rbx - 8]
+                a.bytes({0x3C, TAG_NULL});                  // cmp al, TAG_NULL
+                a.bytes({0x0F, 0x94, 0xC1});                // sete cl
+                a.bytes({0x80, 0x7B, kTopPayload, 0x00});   // cmp byte [rbx - 16], 0
+                a.bytes({0x0F, 0x94, 0xC2});                // sete dl
+                a.bytes({0x3C, TAG_BOOL});                  // cmp al, TAG_BOOL
+                a.bytes({0x0F, 0x94, 0xC0});                // sete al
+                a.bytes({0x20, 0xD0});                      // and al, dl
+                a.bytes({0x08, 0xC8});                      // or al, cl
+                a.bytes({0x88, 0x43, kTopPayload});         // mov [rbx - 16], al
+                a.bytes({0xC6, 0x43, kTopTag, TAG_BOOL});   // mov byte [rbx - 8], TAG_BOOL
+                break;
+            case OpCode::EQUALS:
+            case OpCode::EQUALS_NUMBER:
+                // Only number == number is inlined; mixed tags and strings
+                // go through valuesEqual in the interpreter.
+                loadNumberOperands(a, ip, op == OpCode::EQUALS);
+                a.bytes({0x66, 0x0F, 0x2E, 0xC1}); // ucomisd xmm0, xmm1
+                a.bytes({0x0F, 0x94, 0xC0});       // sete al
+                a.bytes({0x0F, 0x9B, 0xC1});       // setnp cl
+                a.bytes({0x20, 0xC8});             // and al, cl
+                storeBoolResult(a);
+                break;
+            case OpCode::GREATER:
+            case OpCode::GREATER_NUMBER:
+                loadNumberOperands(a, ip, op == OpCode::GREATER);
+                a.bytes({0x66, 0x0F, 0x2E, 0xC1}); // ucomisd xmm0, xmm1
+                a.bytes({0x0F, 0x97, 0xC0});       // seta al
+                storeBoolResult(a);
+                break;
+            case OpCode::LESS:
+            case OpCode::LESS_NUMBER:
+                loadNumberOperands(a, ip, op == OpCode::LESS);
+                a.bytes({0x66, 0x0F, 0x2E, 0xC8}); // ucomisd xmm1, xmm0
+                a.bytes({0x0F, 0x97, 0xC0});       // seta al
+                storeBoolResult(a);
+                break;
+            case OpCode::LESS_EQUAL:
+                // !(a > b), so NaN operands give true
+                loadNumberOperands(a, ip, true);
+                a.bytes({0x66, 0x0F, 0x2E, 0xC1}); // ucomisd xmm0, xmm1
+                a.bytes({0x0F, 0x96, 0xC0});       // setbe al
+                storeBoolResult(a);
+                break;
+            case OpCode::GREATER_EQUAL:
+                // !(a < b)
+                loadNumberOperands(a, ip, true);
+                a.bytes({0x66, 0x0F, 0x2E, 0xC8}); // ucomisd xmm1, xmm0
+                a.bytes({0x0F, 0x96, 0xC0});       // setbe al
+                storeBoolResult(a);
+                break;
+            case OpCode::ADD_INT:
+                intArithmetic(a, {0x48, 0x03, 0x43, kTopPayload}, ip);       // add
+                break;
+            case OpCode::SUBTRACT_INT:
+                intArithmetic(a, {0x48, 0x2B, 0x43, kTopPayload}, ip);       // sub
+                break;
+            case OpCode::MULTIPLY_INT:
+                intArithmetic(a, {0x48, 0x0F, 0xAF, 0x43, kTopPayload}, ip); // imul
+                break;
+            case OpCode::NEGATE_INT:
+                a.bytes({0x48, 0x8B, 0x43, kTopPayload}); // mov rax, [rbx - 16]
+                a.bytes({0x48, 0xF7, 0xD8});              // neg rax
+                a.jump({0x0F, 0x80}, ip);                 // jo bail
+                a.bytes({0x48, 0x89, 0x43, kTopPayload}); // mov [rbx - 16], rax
+                break;
+            case OpCode::EQUALS_INT:
+                intCompare(a, 0x94); // sete
+                break;
+            case OpCode::GREATER_INT:
+                intCompare(a, 0x9F); // setg
+                break;
+            case OpCode::LESS_INT:
+                intCompare(a, 0x9C); // setl
+                break;
+            case OpCode::POP:
+                a.bytes({0x48, 0x83, 0xEB, 0x10}); // sub rbx, 16
+                break;
+            case OpCode::BIT_AND:
+            case OpCode::BIT_OR:
+            case OpCode::BIT_XOR: {
+                // Cannot overflow, so the int operands only need their tags checked.
+                uint8_t opcode = op == OpCode::BIT_AND ? 0x23 : op == OpCode::BIT_OR ? 0x0B : 0x33;
+                guardInt(a, kTopTag, ip);
+                guardInt(a, kSecondTag, ip);
+                a.bytes({0x48, 0x8B, 0x43, kSecondPayload}); // mov rax, [rbx - 32]
+                a.bytes({0x48, opcode, 0x43, kTopPayload});  // and/or/xor rax, [rbx - 16]
+                a.bytes({0x48, 0x89, 0x43, kSecondPayload}); // mov [rbx - 32], rax
+                a.bytes({0x48, 0x83, 0xEB, 0x10});           // sub rbx, 16
+                break;
+            }
+            case OpCode::GET_LOCAL: {
+                uint32_t displacement = chunk.code[offset + 1] * sizeof(Value);
+                a.bytes({0xF3, 0x41, 0x0F, 0x6F, 0x85}); // movdqu xmm0, [r13 + disp32]
+                a.imm32(displacement);
+                a.bytes({0xF3, 0x0F, 0x7F, 0x03});       // movdqu [rbx], xmm0
+                a.bytes({0x48, 0x83, 0xC3, 0x10});       // add rbx, 16
+                break;
+            }
+            case OpCode::GET_STRING_LOCAL: {
+                // The variable is proven to hold a string or a builder;
+                // a builder bails to be flattened.
+                constexpr uint8_t kBuilder = static_cast<uint8_t>(ObjType::STRING_BUILDER);
+                uint32_t displacement = chunk.code[offset + 1] * sizeof(Value);
+                a.bytes({0x49, 0x8B, 0x85});             // mov rax, [r13 + disp32]
+                a.imm32(displacement);
+                a.bytes({0x80, 0x38, kBuilder});         // cmp byte [rax], STRING_BUILDER
+                a.jump({0x0F, 0x84}, ip);                // je bail
+                a.bytes({0xF3, 0x41, 0x0F, 0x6F, 0x85}); // movdqu xmm0, [r13 + disp32]
+                a.imm32(displacement);
+                a.bytes({0xF3, 0x0F, 0x7F, 0x03});       // movdqu [rbx], xmm0
+                a.bytes({0x48, 0x83, 0xC3, 0x10});       // add rbx, 16
+                break;
+            }
+            case OpCode::SET_LOCAL: {
+                uint32_t displacement = chunk.code[offset + 1] * sizeof(Value);
+                a.bytes({0x48, 0x83, 0xEB, 0x10});       // sub rbx, 16
+                a.bytes({0xF3, 0x0F, 0x6F, 0x03});       // movdqu xmm0, [rbx]
+                a.bytes({0xF3, 0x41, 0x0F, 0x7F, 0x85}); // movdqu [r13 + disp32], xmm0
+                a.imm32(displacement);
+                break;
+            }
+            case OpCode::GET_INDEX: {
+                // Elements of number and int arrays load inline; other
+                // storage, bad indexes and non-arrays bail.
+                constexpr uint8_t kArray = static_cast<uint8_t>(ObjType::ARRAY);
+                constexpr uint8_t kInts = static_cast<uint8_t>(ArrayStorage::INTS);
+                static_assert(static_cast<uint8_t>(ArrayStorage::NUMBERS) == 0 && kInts == 1 &&
+                              TAG_INT == 4, "the element tag is computed from the storage");
+                guardInt(a, kTopTag, ip);
+                a.bytes({0x80, 0x7B, kSecondTag, TAG_OBJ});     // cmp byte [rbx - 24], TAG_OBJ
+                a.jump({0x0F, 0x85}, ip);                       // jne bail
+                a.bytes({0x48, 0x8B, 0x43, kSecondPayload});    // mov rax, [rbx - 32]
+                a.bytes({0x80, 0x38, kArray});                  // cmp byte [rax], ARRAY
+                a.jump({0x0F, 0x85}, ip);                       // jne bail
+                a.bytes({0x0F, 0xB6, 0x48, kArrayStorage});     // movzx ecx, byte [rax + storage]
+                a.bytes({0x80, 0xF9, kInts});                   // cmp cl, INTS
+                a.jump({0x0F, 0x87}, ip);                       // ja bail
+                a.bytes({0x8B, 0x50, kArrayLength});            // mov edx, [rax + length]
+                a.bytes({0x48, 0x39, 0x53, kTopPayload});       // cmp [rbx - 16], rdx
+                a.jump({0x0F, 0x83}, ip);                       // jae bail (negative too)
+                a.bytes({0x48, 0x8B, 0x53, kTopPayload});       // mov rdx, [rbx - 16]
+                a.bytes({0x48, 0x8B, 0x54, 0xD0, kArrayElements}); // mov rdx, [rax + rdx*8 + 16]
+                a.bytes({0x48, 0x89, 0x53, kSecondPayload});    // mov [rbx - 32], rdx
+                a.bytes({0xC0, 0xE1, 0x02});                    // shl cl, 2: TAG_NUMBER or TAG_INT
+                a.bytes({0x88, 0x4B, kSecondTag});              // mov [rbx - 24], cl
+                a.bytes({0x48, 0x83, 0xEB, 0x10});              // sub rbx, 16
+                break;
+            }
+            case OpCode::JUMP: {
+                long target;
+                jumpTarget(chunk, offset, target);
+                a.jump({0xE9}, startLabel(target));
+                break;
+            }
+            case OpCode::JUMP_IF_FALSE: {
+                // null and false jump; other non-bools are truthy.
+                long target;
+                jumpTarget(chunk, offset, target);
+                a.bytes({0x48, 0x83, 0xEB, 0x10});   // sub rbx, 16
+                a.bytes({0x80, 0x7B, 0x08, TAG_NULL}); // cmp byte [rbx + 8], TAG_NULL
+                a.jump({0x0F, 0x84}, startLabel(target));
+                a.bytes({0x80, 0x7B, 0x08, TAG_BOOL}); // cmp byte [rbx + 8], TAG_BOOL
+                a.jump({0x0F, 0x85}, startLabel(offset + length));
+                a.bytes({0x80, 0x3B, 0x00});         // cmp byte [rbx], 0
+                a.jump({0x0F, 0x84}, startLabel(target));
+                break;
+            }
+            case OpCode::JUMP_IF_TRUE: {
+                long target;
+                jumpTarget(chunk, offset, target);
+                a.bytes({0x48, 0x83, 0xEB, 0x10});     // sub rbx, 16
+                a.bytes({0x80, 0x7B, 0x08, TAG_NULL}); // cmp byte [rbx + 8], TAG_NULL
+                a.jump({0x0F, 0x84}, startLabel(offset + length));
+                a.bytes({0x80, 0x7B, 0x08, TAG_BOOL}); // cmp byte [rbx + 8], TAG_BOOL
+                a.jump({0x0F, 0x85}, startLabel(target));
+                a.bytes({0x80, 0x3B, 0x00});           // cmp byte [rbx], 0
+                a.jump({0x0F, 0x85}, startLabel(target));
+                break;
+            }
+            case OpCode::JUMP_IF_FALSE_OR_POP:
+            case OpCode::JUMP_IF_TRUE_OR_POP: {
+                // Test the top in place; only the fall-through pops it.
+                long target;
+                jumpTarget(chunk, offset, target);
+                bool jumpWhen = op == OpCode::JUMP_IF_TRUE_OR_POP;
+                int pop = a.local();
+                a.bytes({0x80, 0x7B, kTopTag, TAG_NULL});  // cmp byte [rbx - 8], TAG_NULL
+                a.jump({0x0F, 0x84}, jumpWhen ? pop : startLabel(target));
+                a.bytes({0x80, 0x7B, kTopTag, TAG_BOOL});  // cmp byte [rbx - 8], TAG_BOOL
+                a.jump({0x0F, 0x85}, jumpWhen ? startLabel(target) : pop);
+                a.bytes({0x80, 0x7B, kTopPayload, 0x00});  // cmp byte [rbx - 16], 0
+                a.jump({0x0F, static_cast<uint8_t>(jumpWhen ? 0x85 : 0x84)}, startLabel(target));
+                a.bind(pop);
+                a.bytes({0x48, 0x83, 0xEB, 0x10});         // sub rbx, 16
+                break;
+            }
+            case OpCode::LOOP: {
+                long target;
+                jumpTarget(chunk, offset, target);
+                uint64_t counter = reinterpret_cast<uint64_t>(&chunk.loopCounts[chunk.code[offset + 3]]);
+                a.bytes({0x48, 0xB8});             // mov rax, imm64
+                a.imm32(static_cast<uint32_t>(counter));
+                a.imm32(static_cast<uint32_t>(counter >> 32));
+                a.bytes({0x48, 0x83, 0x00, 0x01}); // add qword [rax], 1
+                a.bytes({0x49, 0x83, 0x2E, 0x01}); // sub qword [r14], 1
+                a.jump({0x0F, 0x8D}, startLabel(target)); // jge
+                exitTo(a, static_cast<int>(target));
+                break;
+            }
+            case OpCode::EQUAL_JUMP:
+            case OpCode::NOT_EQUAL_JUMP:
+            case OpCode::LESS_JUMP:
+            case OpCode::LESS_EQUAL_JUMP:
+            case OpCode::GREATER_JUMP:
+            case OpCode::GREATER_EQUAL_JUMP: {
+                long target;
+                jumpTarget(chunk, offset, target);
+                compareAndBranch(a, op, ip, startLabel(target), startLabel(offset + length));
+                break;
+            }
+            case OpCode::FLOOR_DIVIDE:
+            case OpCode::MODULO:
+            case OpCode::BIT_NOT:
+            case OpCode::SHIFT_LEFT:
+            case OpCode::SHIFT_RIGHT:
+            case OpCode::CONCAT:
+            case OpCode::APPEND_LOCAL:
+            case OpCode::GET_MEMBER:
+            case OpCode::BUILD_ARRAY:
+            case OpCode::BUILD_DICT:
+            case OpCode::SET_INDEX:
+            case OpCode::CALL_BUILTIN:
+            case OpCode::PRINT:
+            case OpCode::AWAIT:
+            case OpCode::RETURN:
+                exitTo(a, ip);
+                native = false;
+                break;
+        }
+        
+        if (native) jit->entries[ip] = start;
+        offset += length;
+    }
+    
+    a.bind(kEpilogue);
+    a.bytes({0x41, 0x5E}); // pop r14
+    a.bytes({0x41, 0x5D}); // pop r13
+    a.bytes({0x41, 0x5C}); // pop r12
+    a.bytes({0x5B});       // pop rbx
+    a.bytes({0xC3});       // ret
+    
+    // Guard failures leave the stack as the instruction found it.
+    for (int ip : a.unboundLabels()) {
+        a.bind(ip);
+        exitTo(a, ip);
+    }
+    a.link();
+    
+    size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    size_t size = (a.size() + page - 1) / page * page;
+    void* memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (memory == MAP_FAILED) return nullptr;
+    std::memcpy(memory, a.code.data(), a.size());
+    if (mprotect(memory, size, PROT_READ | PROT_EXEC) != 0) {
+        munmap(memory, size);
+        return nullptr;
+    }
+    
+    jit->memory = static_cast<uint8_t*>(memory);
+    jit->mappedSize = size;
+    return jit;
+#endif
+}
+
+JitCode::~JitCode() {
+#ifdef JIT_SUPPORTED
+    if (memory != nullptr) munmap(memory, mappedSize);
+#endif
+}
+
+JitExit JitCode::enter(Value* base, Value* top, const Value* constants, int ip, int64_t* fuel) const {
+    NativeEntry entry;
+    std::memcpy(&entry, &memory, sizeof(entry));
+    return entry(top, constants, memory + entries[ip], base, fuel);
+}
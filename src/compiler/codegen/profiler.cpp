@@ -0,0 +1,154 @@
+#include "../../include/profiler.h"
+#include <algorithm>
+#include <iomanip>
+#include <map>
+#include <sys/time.h>
+
+namespace {
+
+constexpr long kSampleMicros = 1000;
+constexpr size_t kTopLines = 20;
+
+// Totals for one opcode or one line.
+struct HotSpot {
+    uint64_t count = 0;
+    double elapsed = 0;  // Nanoseconds
+    uint64_t samples = 0;
+};
+
+void printSpots(std::ostream& out, const char* heading,
+                const std::vector<std::pair<std::string, HotSpot>>& spots,
+                double totalElapsed, size_t limit) {
+    out << std::left << std::setw(20) << heading << std::right << std::setw(14) << "count"
+        << std::setw(12) << "ms" << std::setw(8) << "time%" << std::setw(10) << "samples"
+        << std::endl;
+    for (size_t i = 0; i < spots.size() && i < limit; i++) {
+        const HotSpot& spot = spots[i].second;
+        double share = totalElapsed > 0 ? 100.0 * spot.elapsed / totalElapsed : 0;
+        out << std::left << std::setw(20) << spots[i].first << std::right
+            << std::setw(14) << spot.count << std::fixed << std::setprecision(3)
+            << std::setw(12) << spot.elapsed / 1e6 << std::setprecision(1)
+            << std::setw(8) << share << std::setw(10) << spot.samples << std::endl;
+    }
+    if (spots.size() > limit) out << "(" << spots.size() - limit << " more)" << std::endl;
+    out << std::defaultfloat;
+}
+
+// Sorted hottest first: by time, then by count.
+std::vector<std::pair<std::string, HotSpot>> sortSpots(std::vector<std::pair<std::string, HotSpot>> spots) {
+    std::stable_sort(spots.begin(), spots.end(), [](const auto& a, const auto& b) {
+        if (a.second.elapsed != b.second.elapsed) return a.second.elapsed > b.second.elapsed;
+        return a.second.count > b.second.count;
+    });
+    return spots;
+}
+    
+} // namespace
+
+volatile std::sig_atomic_t Profiler::sampleDue = 0;
+
+Profiler::Profiler(const Chunk& chunk)
+    : chunk(chunk), firstTick(ticks()), firstTime(std::chrono::steady_clock::now()) {
+    struct sigaction action = {};
+    action.sa_handler = onTimer;
+    action.sa_flags = SA_RESTART;
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGPROF, &action, nullptr);
+    
+    struct itimerval timer = {};
+    timer.it_interval.tv_usec = kSampleMicros;
+    timer.it_value.tv_usec = kSampleMicros;
+    setitimer(ITIMER_PROF, &timer, nullptr);
+}
+
+Profiler::~Profiler() {
+    struct itimerval timer = {};
+    setitimer(ITIMER_PROF, &timer, nullptr);
+    signal(SIGPROF, SIG_DFL);
+}
+
+void Profiler::onTimer(int) {
+    sampleDue = 1;
+}
+
+void Profiler::grow(size_t ip) {
+    size_t size = std::max(ip + 1, chunk.code.size());
+    counts.resize(size);
+    elapsed.resize(size);
+    samples.resize(size);
+}
+
+void Profiler::takeSample(size_t ip) {
+    sampleDue = 0;
+    samples[ip]++;
+}
+
+void Profiler::pause() {
+    if (running == kNotRunning) return;
+    elapsed[running] += ticks() - started;
+    running = kNotRunning;
+}
+
+void Profiler::reset() {
+    counts.clear();
+    elapsed.clear();
+    samples.clear();
+    running = kNotRunning;
+}
+
+uint64_t Profiler::instructions() const {
+    uint64_t total = 0;
+    for (uint64_t count : counts) {
+        total += count;
+    }
+    return total;
+}
+
+double Profiler::nanosPerTick() const {
+    std::chrono::nanoseconds wall = std::chrono::steady_clock::now() - firstTime;
+    uint64_t elapsedTicks = ticks() - firstTick;
+    return elapsedTicks > 0 ? static_cast<double>(wall.count()) / elapsedTicks : 0;
+}
+
+void Profiler::report(std::ostream& out) const {
+    std::map<uint8_t, HotSpot> byOpCode;
+    std::map<int, HotSpot> byLine;
+    HotSpot total;
+    double scale = nanosPerTick();
+    for (size_t offset = 0; offset < counts.size(); offset++) {
+        if (counts[offset] == 0) continue;
+        HotSpot* spots[] = {&byOpCode[chunk.code[offset]], &byLine[chunk.lines[offset]], &total};
+        for (HotSpot* spot : spots) {
+            spot->count += counts[offset];
+            spot->elapsed += elapsed[offset] * scale;
+            spot->samples += samples[offset];
+        }
+    }
+    
+    std::vector<std::pair<std::string, HotSpot>> opCodes;
+    for (const auto& [op, spot] : byOpCode) {
+        opCodes.emplace_back(opCodeName(op), spot);
+    }
+    std::vector<std::pair<std::string, HotSpot>> lines;
+    for (const auto& [line, spot] : byLine) {
+        lines.emplace_back("line " + std::to_string(line), spot);
+    }
+    
+    out << "== profile ==" << std::endl;
+    out << total.count << " instructions, " << std::fixed << std::setprecision(3)
+        << total.elapsed / 1e6 << " ms, " << total.samples << " samples" << std::endl;
+    out << std::defaultfloat;
+    printSpots(out, "opcode", sortSpots(opCodes), total.elapsed, opCodes.size());
+    printSpots(out, "line", sortSpots(lines), total.elapsed, kTopLines);
+}
+
+void Profiler::writeCollapsed(std::ostream& out) const {
+    // Instructions with the same line and opcode are one frame.
+    std::map<std::pair<int, uint8_t>, uint64_t> stacks;
+    for (size_t offset = 0; offset < samples.size(); offset++) {
+        if (samples[offset] != 0) stacks[{chunk.lines[offset], chunk.code[offset]}] += samples[offset];
+    }
+    for (const auto& [frame, count] : stacks) {
+        out << "script;line " << frame.first << ";" << opCodeName(frame.second) << " " << count << "\n";
+    }
+}
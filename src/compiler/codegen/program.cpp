@@ -0,0 +1,31 @@
+#include "../../include/program.h"
+#include "../../include/compiler.h"
+#include "../../include/gc.h"
+#include "../../include/jit.h"
+#include <iostream>
+
+std::shared_ptr<const Program> Program::compile(const std::string& source) {
+    std::shared_ptr<Program> program(new Program());
+    
+    // Compile against a scratch heap, then intern the string constants in
+    // the program's shared region so the heap can go.
+    Heap scratch;
+    scratch.addRoots(&program->chunk.constants);
+    Compiler compiler(scratch);
+    if (!compiler.compile(source, program->chunk)) return nullptr;
+    for (Value& constant : program->chunk.constants) {
+        if (!isStringValue(constant)) continue;
+        const auto* string = static_cast<const ObjString*>(std::get<Obj*>(constant));
+        constant = static_cast<Obj*>(program->strings.shareString(string->chars(), string->length));
+    }
+    scratch.removeRoots(&program->chunk.constants);
+    
+    std::string error;
+    if (!verifyChunk(program->chunk, error)) {
+        std::cerr << "Invalid bytecode: " << error << "." << std::endl;
+        return nullptr;
+    }
+    
+    program->chunk.jitCode = JitCode::compile(program->chunk);
+    return program;
+}
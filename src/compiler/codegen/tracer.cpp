@@ -0,0 +1,274 @@
+#include "../../include/tracer.h"
+#include "../../include/gc.h"
+#include <cstdlib>
+#include <cstring>
+#include <iterator>
+
+namespace {
+
+constexpr char kMagic[4] = {'F', 'T', 'R', 'C'};
+constexpr uint8_t kVersion = 1;
+
+enum class ConstantTag : uint8_t { NUMBER, INT, BOOL, NIL, STRING };
+
+void writeVarint(std::ostream& out, uint64_t value) {
+    char bytes[10];
+    size_t length = 0;
+    do {
+        uint8_t byte = value & 0x7f;
+        value >>= 7;
+        bytes[length++] = static_cast<char>(value != 0 ? byte | 0x80 : byte);
+    } while (value != 0);
+    out.write(bytes, length);
+}
+
+void writeRaw(std::ostream& out, const void* data, size_t length) {
+    out.write(static_cast<const char*>(data), length);
+}
+
+// Reads a trace held in memory; every read fails once one runs past the end.
+class TraceReader {
+public:
+    TraceReader(const std::string& bytes, size_t position, size_t end)
+        : bytes(bytes), position(position), end(end) {}
+    
+    bool ok() const { return good; }
+    bool atEnd() const { return position >= end; }
+    size_t remaining() const { return end - position; }
+    
+    uint64_t varint() {
+        uint64_t value = 0;
+        for (int shift = 0; shift < 64; shift += 7) {
+            uint8_t byte = next();
+            value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+            if ((byte & 0x80) == 0) return value;
+        }
+        good = false;
+        return 0;
+    }
+    
+    uint8_t next() {
+        if (position >= end) {
+            good = false;
+            return 0;
+        }
+        return static_cast<uint8_t>(bytes[position++]);
+    }
+    
+    void raw(void* data, size_t length) {
+        if (length > end - position) {
+            good = false;
+            position = end;
+            return;
+        }
+        std::memcpy(data, bytes.data() + position, length);
+        position += length;
+    }
+
+private:
+    const std::string& bytes;
+    size_t position;
+    size_t end;
+    bool good = true;
+};
+
+// The chunk section of a trace, with its constants allocated in heap.
+bool readChunk(TraceReader& in, Heap& heap, Chunk& chunk) {
+    uint64_t length = in.varint();
+    if (!in.ok() || length > in.remaining()) return false;
+    chunk.code.resize(length);
+    in.raw(chunk.code.data(), length);
+    chunk.lines.resize(length);
+    for (int& line : chunk.lines) {
+        line = static_cast<int>(in.varint());
+    }
+    
+    uint64_t count = in.varint();
+    for (uint64_t i = 0; i < count && in.ok(); i++) {
+        switch (static_cast<ConstantTag>(in.next())) {
+            case ConstantTag::NUMBER: {
+                double number;
+                in.raw(&number, sizeof(number));
+                chunk.constants.push_back(number);
+                break;
+            }
+            case ConstantTag::INT: {
+                int64_t integer;
+                in.raw(&integer, sizeof(integer));
+                chunk.constants.push_back(integer);
+                break;
+            }
+            case ConstantTag::BOOL:
+                chunk.constants.push_back(in.next() != 0);
+                break;
+            case ConstantTag::NIL:
+                chunk.constants.push_back(nullptr);
+                break;
+            case ConstantTag::STRING: {
+                uint64_t size = in.varint();
+                if (size > in.remaining()) return false;
+                std::string chars(size, '\0');
+                in.raw(chars.data(), chars.size());
+                chunk.constants.push_back(static_cast<Obj*>(heap.copyString(chars.data(), chars.size())));
+                break;
+            }
+            default:
+                return false;
+        }
+    }
+    return in.ok();
+}
+    
+} // namespace
+
+bool TraceFilter::parseLines(const std::string& text) {
+    char* end = nullptr;
+    long first = std::strtol(text.c_str(), &end, 10);
+    long last = first;
+    if (end == text.c_str() || first < 0) return false;
+    if (*end == '-') {
+        const char* start = end + 1;
+        last = std::strtol(start, &end, 10);
+        if (end == start) return false;
+    }
+    if (*end != '\0' || last < first || last > INT_MAX) return false;
+    
+    firstLine = static_cast<int>(first);
+    lastLine = static_cast<int>(last);
+    return true;
+}
+
+bool TraceFilter::parseOpCodes(const std::string& text) {
+    opCodes.assign(256, false);
+    size_t start = 0;
+    while (start <= text.size()) {
+        size_t comma = text.find(',', start);
+        std::string name = text.substr(start, comma == std::string::npos ? std::string::npos : comma - start);
+        int byte = 0;
+        while (byte < 256 && name != opCodeName(static_cast<uint8_t>(byte))) {
+            byte++;
+        }
+        if (byte == 256) return false;
+        opCodes[byte] = true;
+        if (comma == std::string::npos) break;
+        start = comma + 1;
+    }
+    return true;
+}
+
+Tracer::Tracer(const Chunk& chunk, TraceFilter filter, std::ostream& out)
+    : chunk(chunk), filter(std::move(filter)), text(&out) {}
+
+Tracer::Tracer(const Chunk& chunk, TraceFilter filter, const std::string& path)
+    : chunk(chunk), filter(std::move(filter)), file(path, std::ios::binary) {
+    writeRaw(file, kMagic, sizeof(kMagic));
+    writeRaw(file, &kVersion, 1);
+}
+
+Tracer::~Tracer() {
+    close();
+}
+
+void Tracer::record(size_t ip, const std::vector<Value>& stack) {
+    if (closed) return;
+    if (text == nullptr) {
+        recorded = true;
+        writeVarint(file, ip);
+        return;
+    }
+    
+    *text << "Stack: ";
+    for (const auto& value : stack) {
+        *text << "[ " << valueToString(value) << " ]";
+    }
+    *text << "\n";
+    Disassembler::disassembleInstruction(chunk, static_cast<int>(ip), *text);
+}
+
+void Tracer::close() {
+    if (closed) return;
+    closed = true;
+    if (text != nullptr) {
+        text->flush();
+        return;
+    }
+    
+    uint64_t chunkAt = static_cast<uint64_t>(file.tellp());
+    writeVarint(file, chunk.code.size());
+    writeRaw(file, chunk.code.data(), chunk.code.size());
+    for (int line : chunk.lines) {
+        writeVarint(file, static_cast<uint64_t>(line));
+    }
+    
+    writeVarint(file, chunk.constants.size());
+    for (const Value& constant : chunk.constants) {
+        if (const double* number = std::get_if<double>(&constant)) {
+            file.put(static_cast<char>(ConstantTag::NUMBER));
+            writeRaw(file, number, sizeof(*number));
+        } else if (const int64_t* integer = std::get_if<int64_t>(&constant)) {
+            file.put(static_cast<char>(ConstantTag::INT));
+            writeRaw(file, integer, sizeof(*integer));
+        } else if (const bool* boolean = std::get_if<bool>(&constant)) {
+            file.put(static_cast<char>(ConstantTag::BOOL));
+            file.put(*boolean ? 1 : 0);
+        } else if (isStringValue(constant)) {
+            auto* string = static_cast<ObjString*>(std::get<Obj*>(constant));
+            file.put(static_cast<char>(ConstantTag::STRING));
+            writeVarint(file, string->length);
+            writeRaw(file, string->chars(), string->length);
+        } else {
+            file.put(static_cast<char>(ConstantTag::NIL));
+        }
+    }
+    writeRaw(file, &chunkAt, sizeof(chunkAt));
+    file.close();
+}
+
+void Tracer::chunkReplaced() {
+    if (text == nullptr && recorded) close();
+}
+
+bool replayTrace(const std::string& path, std::ostream& out, std::ostream& err) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        err << "Could not open file \"" << path << "\"." << std::endl;
+        return false;
+    }
+    std::string bytes((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    
+    uint64_t chunkAt = 0;
+    size_t header = sizeof(kMagic) + 1;
+    bool valid = bytes.size() >= header + sizeof(chunkAt) &&
+                 std::memcmp(bytes.data(), kMagic, sizeof(kMagic)) == 0 &&
+                 static_cast<uint8_t>(bytes[sizeof(kMagic)]) == kVersion;
+    if (valid) {
+        std::memcpy(&chunkAt, bytes.data() + bytes.size() - sizeof(chunkAt), sizeof(chunkAt));
+        valid = chunkAt >= header && chunkAt <= bytes.size() - sizeof(chunkAt);
+    }
+    
+    Chunk chunk;  // Outlives the heap that roots its constants
+    Heap heap;
+    heap.addRoots(&chunk.constants);
+    if (valid) {
+        TraceReader section(bytes, chunkAt, bytes.size() - sizeof(chunkAt));
+        valid = readChunk(section, heap, chunk);
+    }
+    if (!valid) {
+        err << "\"" << path << "\" is not an execution trace." << std::endl;
+        return false;
+    }
+    
+    out << "== trace ==" << std::endl;
+    TraceReader records(bytes, header, chunkAt);
+    while (!records.atEnd()) {
+        uint64_t ip = records.varint();
+        int length, effect;
+        if (!records.ok() || ip >= chunk.code.size() || !describeOpCode(chunk.code[ip], length, effect) ||
+            ip + length > chunk.code.size()) {
+            err << "\"" << path << "\" has a corrupt record." << std::endl;
+            return false;
+        }
+        Disassembler::disassembleInstruction(chunk, static_cast<int>(ip), out);
+    }
+    return true;
+}
@@ -0,0 +1,533 @@
+#include "../../include/typechecker.h"
+#include "../../include/builtins.h"
+#include <iostream>
+
+namespace {
+
+bool isNumeric(StaticType type) {
+    return type == StaticType::NUMBER || type == StaticType::INT;
+}
+
+// Arithmetic stays in ints only when both sides are ints; one double makes
+// the result a double. An unproven side may be an array.
+StaticType arithmeticResult(StaticType left, StaticType right) {
+    if (!isNumeric(left) || !isNumeric(right)) return StaticType::UNKNOWN;
+    if (left == StaticType::NUMBER || right == StaticType::NUMBER) return StaticType::NUMBER;
+    return StaticType::INT;
+}
+
+// The type of an operator result that is `type` for scalar operands.
+StaticType scalarResult(StaticType left, StaticType right, StaticType type) {
+    return left == StaticType::UNKNOWN || right == StaticType::UNKNOWN ? StaticType::UNKNOWN : type;
+}
+    
+} // namespace
+
+bool parseTypeName(const std::string& name, StaticType& type) {
+    if (name == "number") type = StaticType::NUMBER;
+    else if (name == "int") type = StaticType::INT;
+    else if (name == "string") type = StaticType::STRING;
+    else if (name == "bool") type = StaticType::BOOL;
+    else if (name == "null") type = StaticType::NULL_TYPE;
+    else if (name == "array") type = StaticType::ARRAY;
+    else if (name == "dict") type = StaticType::DICT;
+    else if (name == "void") type = StaticType::VOID;
+    else if (name == "any") type = StaticType::UNKNOWN;
+    else return false;
+    return true;
+}
+
+const char* typeName(StaticType type) {
+    switch (type) {
+        case StaticType::UNKNOWN: return "any";
+        case StaticType::NUMBER: return "number";
+        case StaticType::INT: return "int";
+        case StaticType::STRING: return "string";
+        case StaticType::BOOL: return "bool";
+        case StaticType::NULL_TYPE: return "null";
+        case StaticType::ARRAY: return "array";
+        case StaticType::DICT: return "dict";
+        case StaticType::VOID: return "void";
+    }
+    return "any";
+}
+
+bool TypeChecker::check(const std::vector<std::unique_ptr<Statement>>& statements) {
+    globals.clear();
+    taskVariables.clear();
+    
+    // Variable types only widen, each at most twice, so this settles quickly.
+    reporting = false;
+    do {
+        changed = false;
+        pass(statements);
+    } while (changed);
+    
+    reporting = true;
+    hadError = false;
+    types.clear();
+    pass(statements);
+    
+    return !hadError;
+}
+
+StaticType TypeChecker::typeOf(const Expression* expr) const {
+    auto it = types.find(expr);
+    return it == types.end() ? StaticType::UNKNOWN : it->second;
+}
+
+StaticType TypeChecker::variableType(const std::string& name) const {
+    auto it = globals.find(name);
+    return it == globals.end() ? StaticType::UNKNOWN : it->second;
+}
+
+// Expression visitor methods
+
+void TypeChecker::visitLiteral(Literal* expr) {
+    if (expr->value == "null") {
+        record(expr, StaticType::NULL_TYPE);
+    } else if (expr->value == "true" || expr->value == "false") {
+        record(expr, StaticType::BOOL);
+    } else if (expr->value[0] == '"') {
+        record(expr, StaticType::STRING);
+    } else if (expr->value.find('.') == std::string::npos) {
+        record(expr, StaticType::INT);
+    } else {
+        record(expr, StaticType::NUMBER);
+    }
+}
+
+void TypeChecker::visitGroupingExpression(GroupingExpression* expr) {
+    record(expr, infer(expr->expression.get()));
+}
+
+void TypeChecker::visitUnaryExpression(UnaryExpression* expr) {
+    StaticType operand = infer(expr->right.get());
+    
+    if (operand == StaticType::ARRAY && expr->op.type != TokenType::NOT &&
+        expr->op.type != TokenType::BANG) {
+        record(expr, StaticType::ARRAY);
+    } else if (expr->op.type == TokenType::MINUS) {
+        expectNumber(operand, expr->op, true);
+        record(expr, isNumeric(operand) ? operand : StaticType::UNKNOWN);
+    } else if (expr->op.type == TokenType::TILDE) {
+        expectInt(operand, expr->op, true);
+        record(expr, operand == StaticType::INT ? StaticType::INT : StaticType::UNKNOWN);
+    } else {
+        record(expr, StaticType::BOOL);
+    }
+}
+
+void TypeChecker::visitBinaryExpression(BinaryExpression* expr) {
+    StaticType left = infer(expr->left.get());
+    StaticType right = infer(expr->right.get());
+    
+    bool equality = expr->op.type == TokenType::EQUAL_EQUAL || expr->op.type == TokenType::BANG_EQUAL;
+    if (!equality && (left == StaticType::ARRAY || right == StaticType::ARRAY)) {
+        expectElementWise(left, right, expr->op);
+        record(expr, StaticType::ARRAY);
+        return;
+    }
+    
+    switch (expr->op.type) {
+        case TokenType::PLUS: {
+            // Two numbers or two strings; one proven side decides the other.
+            auto addable = [](StaticType type) {
+                return type == StaticType::UNKNOWN || isNumeric(type) || type == StaticType::STRING;
+            };
+            bool strings = left == StaticType::STRING || right == StaticType::STRING;
+            bool mixed = strings && left != StaticType::UNKNOWN && right != StaticType::UNKNOWN &&
+                         left != right;
+            if (!addable(left) || !addable(right) || mixed) {
+                error(expr->op.line, std::string("Operands of '+' must be two numbers or two strings, got ") +
+                      typeName(left) + " and " + typeName(right) + ".");
+            }
+            record(expr, strings ? StaticType::STRING : arithmeticResult(left, right));
+            break;
+        }
+        case TokenType::MINUS:
+        case TokenType::STAR:
+        case TokenType::DIV:
+        case TokenType::PERCENT:
+            expectNumber(left, expr->op, false);
+            expectNumber(right, expr->op, false);
+            record(expr, arithmeticResult(left, right));
+            break;
+        case TokenType::SLASH:
+            expectNumber(left, expr->op, false);
+            expectNumber(right, expr->op, false);
+            record(expr, scalarResult(left, right, StaticType::NUMBER));
+            break;
+        case TokenType::AMPERSAND:
+        case TokenType::PIPE:
+        case TokenType::CARET:
+        case TokenType::LESS_LESS:
+        case TokenType::GREATER_GREATER:
+            expectInt(left, expr->op, false);
+            expectInt(right, expr->op, false);
+            record(expr, scalarResult(left, right, StaticType::INT));
+            break;
+        case TokenType::GREATER:
+        case TokenType::GREATER_EQUAL:
+        case TokenType::LESS:
+        case TokenType::LESS_EQUAL:
+            expectNumber(left, expr->op, false);
+            expectNumber(right, expr->op, false);
+            record(expr, scalarResult(left, right, StaticType::BOOL));
+            break;
+        default:
+            record(expr, StaticType::BOOL);
+            break;
+    }
+}
+
+void TypeChecker::visitLogicalExpression(LogicalExpression* expr) {
+    // Any value can be tested; the result is one of the operands.
+    StaticType left = infer(expr->left.get());
+    StaticType right = infer(expr->right.get());
+    record(expr, left == right ? left : StaticType::UNKNOWN);
+}
+
+void TypeChecker::visitVariableExpression(VariableExpression* expr) {
+    const std::string& name = expr->name.lexeme;
+    if (reachable && assigned.count(name) == 0) {
+        error(expr->name.line, "Variable '" + name + "' is used before it is assigned.");
+        record(expr, StaticType::UNKNOWN);
+        return;
+    }
+    
+    auto it = variables->find(name);
+    record(expr, it == variables->end() ? StaticType::UNKNOWN : it->second);
+}
+
+void TypeChecker::visitMemberExpression(MemberExpression* expr) {
+    // Modules are compiled only once the script runs, so nothing is known
+    // about their variables here.
+    record(expr, StaticType::UNKNOWN);
+}
+
+void TypeChecker::visitAwaitExpression(AwaitExpression* expr) {
+    StaticType operand = infer(expr->operand.get());
+    
+    switch (operand) {
+        case StaticType::NUMBER:
+        case StaticType::INT:
+            record(expr, StaticType::NULL_TYPE);  // A sleep
+            break;
+        case StaticType::STRING:
+            record(expr, StaticType::STRING);     // File contents
+            break;
+        case StaticType::UNKNOWN:
+            record(expr, StaticType::UNKNOWN);
+            break;
+        default:
+            error(expr->keyword.line, std::string("Can only await a number of milliseconds or a file path, got ") +
+                  typeName(operand) + ".");
+            record(expr, StaticType::UNKNOWN);
+            break;
+    }
+}
+
+void TypeChecker::visitArrayExpression(ArrayExpression* expr) {
+    for (auto& element : expr->elements) {
+        infer(element.get());
+    }
+    record(expr, StaticType::ARRAY);
+}
+
+void TypeChecker::visitDictExpression(DictExpression* expr) {
+    for (size_t i = 0; i < expr->keys.size(); i++) {
+        StaticType key = infer(expr->keys[i].get());
+        if (key == StaticType::ARRAY || key == StaticType::DICT) {
+            error(expr->brace.line, std::string("Dict keys must be strings, numbers, ints, bools or null, got ") +
+                  typeName(key) + ".");
+        }
+        infer(expr->values[i].get());
+    }
+    record(expr, StaticType::DICT);
+}
+
+void TypeChecker::visitIndexExpression(IndexExpression* expr) {
+    // Element types are not tracked.
+    checkIndex(expr);
+    record(expr, StaticType::UNKNOWN);
+}
+
+void TypeChecker::visitCallExpression(CallExpression* expr) {
+    std::vector<StaticType> args;
+    for (auto& argument : expr->arguments) {
+        args.push_back(infer(argument.get()));
+    }
+    record(expr, StaticType::UNKNOWN);
+    
+    const std::string& name = expr->name.lexeme;
+    Builtin builtin;
+    int minArity, maxArity;
+    if (!findBuiltin(name, builtin, minArity, maxArity)) {
+        error(expr->name.line, "Unknown function '" + name + "'.");
+        return;
+    }
+    int argc = static_cast<int>(args.size());
+    if (argc < minArity || argc > maxArity) {
+        std::string expected = std::to_string(minArity);
+        if (maxArity != minArity) expected += " or " + std::to_string(maxArity);
+        error(expr->name.line, name + "() takes " + expected +
+              (maxArity == 1 ? " argument, got " : " arguments, got ") + std::to_string(argc) + ".");
+        return;
+    }
+    
+    switch (builtin) {
+        case Builtin::LEN:
+            if (args[0] != StaticType::UNKNOWN && args[0] != StaticType::ARRAY &&
+                args[0] != StaticType::STRING && args[0] != StaticType::DICT) {
+                error(expr->name.line, std::string("len() takes an array, a string or a dict, got ") +
+                      typeName(args[0]) + ".");
+            }
+            record(expr, StaticType::INT);
+            return;
+        case Builtin::ARRAY:
+            if (args[0] != StaticType::UNKNOWN && args[0] != StaticType::INT) {
+                error(expr->name.line, std::string("array() length must be an int, got ") +
+                      typeName(args[0]) + ".");
+            }
+            record(expr, StaticType::ARRAY);
+            return;
+        case Builtin::KEYS:
+        case Builtin::VALUES:
+        case Builtin::HAS:
+        case Builtin::GET:
+        case Builtin::REMOVE:
+            if (args[0] != StaticType::UNKNOWN && args[0] != StaticType::DICT) {
+                error(expr->name.line, name + "() takes a dict, got " + typeName(args[0]) + ".");
+            }
+            if (builtin == Builtin::KEYS || builtin == Builtin::VALUES) record(expr, StaticType::ARRAY);
+            if (builtin == Builtin::HAS || builtin == Builtin::REMOVE) record(expr, StaticType::BOOL);
+            return;
+        default:
+            break;
+    }
+    
+    for (StaticType arg : args) {
+        if (arg != StaticType::UNKNOWN && arg != StaticType::ARRAY) {
+            error(expr->name.line, name + "() takes " + (argc > 1 ? "arrays" : "an array") +
+                  ", got " + typeName(arg) + ".");
+        }
+    }
+    if (builtin == Builtin::ALL || builtin == Builtin::ANY) record(expr, StaticType::BOOL);
+}
+
+// Statement visitor methods
+
+void TypeChecker::visitExpressionStatement(ExpressionStatement* stmt) {
+    infer(stmt->expression.get());
+}
+
+void TypeChecker::visitPrintStatement(PrintStatement* stmt) {
+    infer(stmt->expression.get());
+}
+
+void TypeChecker::visitClassStatement(ClassStatement* stmt) {
+    for (auto& method : stmt->methods) {
+        method->accept(this);
+    }
+}
+
+void TypeChecker::visitTaskStatement(TaskStatement* stmt) {
+    // A task has its own variables, starting with its parameters.
+    Variables* outer = variables;
+    auto outerAssigned = std::move(assigned);
+    bool outerReachable = reachable;
+    int outerLoopDepth = loopDepth;
+    
+    variables = &taskVariables[stmt];
+    assigned.clear();
+    reachable = true;
+    loopDepth = 0;
+    
+    for (const auto& param : stmt->params) {
+        StaticType type;
+        if (!parseTypeName(param.second, type) || type == StaticType::VOID) {
+            error(0, "Unknown type '" + param.second + "' for parameter '" + param.first +
+                  "' of task '" + stmt->name + "'.");
+            type = StaticType::UNKNOWN;
+        }
+        assign(param.first, type);
+    }
+    
+    StaticType returnType;
+    if (!parseTypeName(stmt->returnType, returnType)) {
+        error(0, "Unknown return type '" + stmt->returnType + "' of task '" + stmt->name + "'.");
+    }
+    
+    checkBlock(stmt->body);
+    
+    variables = outer;
+    assigned = std::move(outerAssigned);
+    reachable = outerReachable;
+    loopDepth = outerLoopDepth;
+}
+
+void TypeChecker::visitAssignStatement(AssignStatement* stmt) {
+    assign(stmt->name.lexeme, infer(stmt->value.get()));
+}
+
+void TypeChecker::visitSetIndexStatement(SetIndexStatement* stmt) {
+    checkIndex(stmt->target.get());
+    infer(stmt->value.get());
+}
+
+void TypeChecker::visitIfStatement(IfStatement* stmt) {
+    infer(stmt->condition.get());
+    
+    auto before = assigned;
+    bool wasReachable = reachable;
+    checkBlock(stmt->thenBranch);
+    auto thenAssigned = std::move(assigned);
+    bool thenReachable = reachable;
+    
+    assigned = std::move(before);
+    reachable = wasReachable;
+    checkBlock(stmt->elseBranch);
+    
+    // Assigned after the if: on both branches, or on the one that falls through.
+    if (thenReachable && reachable) {
+        for (auto it = assigned.begin(); it != assigned.end();) {
+            it = thenAssigned.count(*it) != 0 ? std::next(it) : assigned.erase(it);
+        }
+    } else if (thenReachable) {
+        assigned = std::move(thenAssigned);
+    }
+    reachable = thenReachable || reachable;
+}
+
+void TypeChecker::visitWhileStatement(WhileStatement* stmt) {
+    infer(stmt->condition.get());
+    
+    // The body may not run at all, so it assigns nothing for the code after.
+    auto before = assigned;
+    bool wasReachable = reachable;
+    loopDepth++;
+    checkBlock(stmt->body);
+    loopDepth--;
+    assigned = std::move(before);
+    reachable = wasReachable;
+}
+
+void TypeChecker::visitForStatement(ForStatement* stmt) {
+    StaticType start = infer(stmt->start.get());
+    StaticType stop = infer(stmt->stop.get());
+    expectNumber(start, stmt->keyword, false);
+    expectNumber(stop, stmt->keyword, false);
+    
+    auto before = assigned;
+    bool wasReachable = reachable;
+    const std::string& name = stmt->variable.lexeme;
+    assign(name, start == StaticType::INT || start == StaticType::NUMBER ? start : StaticType::UNKNOWN);
+    // The increment: variable + int step
+    assign(name, arithmeticResult((*variables)[name], StaticType::INT));
+    
+    loopDepth++;
+    checkBlock(stmt->body);
+    loopDepth--;
+    assigned = std::move(before);
+    reachable = wasReachable;
+}
+
+void TypeChecker::visitBreakStatement(BreakStatement* stmt) {
+    if (loopDepth == 0) error(stmt->keyword.line, "Can't use 'break' outside of a loop.");
+    reachable = false;
+}
+
+void TypeChecker::visitContinueStatement(ContinueStatement* stmt) {
+    if (loopDepth == 0) error(stmt->keyword.line, "Can't use 'continue' outside of a loop.");
+    reachable = false;
+}
+
+void TypeChecker::visitImportStatement(ImportStatement*) {}
+
+// Helper methods
+
+void TypeChecker::pass(const std::vector<std::unique_ptr<Statement>>& statements) {
+    variables = &globals;
+    assigned.clear();
+    reachable = true;
+    loopDepth = 0;
+    checkBlock(statements);
+}
+
+void TypeChecker::checkBlock(const std::vector<std::unique_ptr<Statement>>& statements) {
+    for (const auto& stmt : statements) {
+        stmt->accept(this);
+    }
+}
+
+void TypeChecker::assign(const std::string& name, StaticType type) {
+    auto it = variables->find(name);
+    if (it == variables->end()) {
+        (*variables)[name] = type;
+        changed = true;
+    } else if (it->second != type && it->second != StaticType::UNKNOWN) {
+        it->second = StaticType::UNKNOWN;
+        changed = true;
+    }
+    assigned.insert(name);
+}
+
+StaticType TypeChecker::infer(Expression* expr) {
+    expr->accept(this);
+    return typeOf(expr);
+}
+
+void TypeChecker::record(const Expression* expr, StaticType type) {
+    types[expr] = type;
+}
+
+void TypeChecker::expectNumber(StaticType type, const Token& op, bool unary) {
+    if (!isNumeric(type) && type != StaticType::UNKNOWN) {
+        error(op.line, std::string(unary ? "Operand of '" : "Operands of '") + op.lexeme +
+              (unary ? "' must be a number, got " : "' must be numbers, got ") + typeName(type) + ".");
+    }
+}
+
+void TypeChecker::expectInt(StaticType type, const Token& op, bool unary) {
+    if (type != StaticType::INT && type != StaticType::UNKNOWN) {
+        error(op.line, std::string(unary ? "Operand of '" : "Operands of '") + op.lexeme +
+              (unary ? "' must be an int, got " : "' must be ints, got ") + typeName(type) + ".");
+    }
+}
+
+void TypeChecker::expectElementWise(StaticType left, StaticType right, const Token& op) {
+    auto valid = [](StaticType type) {
+        return type == StaticType::UNKNOWN || type == StaticType::ARRAY || isNumeric(type);
+    };
+    if (!valid(left) || !valid(right)) {
+        error(op.line, "Operands of '" + op.lexeme + "' must be arrays or numbers, got " +
+              typeName(left) + " and " + typeName(right) + ".");
+    }
+}
+
+void TypeChecker::checkIndex(IndexExpression* expr) {
+    StaticType array = infer(expr->array.get());
+    StaticType index = infer(expr->index.get());
+    if (array == StaticType::DICT) {
+        if (index == StaticType::ARRAY || index == StaticType::DICT) {
+            error(expr->bracket.line, std::string("Dict keys must be strings, numbers, ints, bools or null, got ") +
+                  typeName(index) + ".");
+        }
+        return;
+    }
+    if (array != StaticType::UNKNOWN && array != StaticType::ARRAY) {
+        error(expr->bracket.line, std::string("Only arrays and dicts can be indexed, got ") + typeName(array) + ".");
+    }
+    if (array == StaticType::ARRAY && index != StaticType::UNKNOWN && index != StaticType::INT) {
+        error(expr->bracket.line, std::string("Array index must be an int, got ") + typeName(index) + ".");
+    }
+}
+
+void TypeChecker::error(int line, const std::string& message) {
+    if (!reporting) return;
+    hadError = true;
+    std::cerr << "Type error";
+    if (line > 0) std::cerr << " at line " << line;
+    std::cerr << ": " << message << std::endl;
+}
@@ -1,34 +1,175 @@
 #include "../../include/vm.h"
 #include "../../include/compiler.h"
+#include "../../include/arith.h"
+#include "../../include/array.h"
+#include "../../include/builtins.h"
+#include "../../include/dict.h"
+#include "../../include/metrics.h"
+#include "../../include/program.h"
+#include "../../include/stringbuilder.h"
+#include "../../include/timeline.h"
+#include <algorithm>
+#include <fstream>
 #include <iostream>
 #include <sstream>
+#include <cstring>
 
-VM::VM() : ip(0) {}
+VM::VM()
+    : ip(0), ownedLoop(std::make_unique<EventLoop>()), loop(ownedLoop.get()),
+      state(InterpretResult::OK) {
+    heap.addRoots(&stack);
+    heap.addRoots(&sourceChunk.constants);
+}
+
+VM::VM(EventLoop& loop) : ip(0), loop(&loop), state(InterpretResult::OK) {
+    heap.addRoots(&stack);
+    heap.addRoots(&sourceChunk.constants);
+}
 
 InterpretResult VM::interpret(const std::string& source) {
-    Compiler compiler;
-    if (!compiler.compile(source, chunk)) {
-        return InterpretResult::COMPILE_ERROR;
+    start(source);
+    return finish();
+}
+
+InterpretResult VM::interpret(std::shared_ptr<const Program> program) {
+    start(std::move(program));
+    return finish();
+}
+
+InterpretResult VM::finish() {
+    // Each completion resumes run() from its callback until the script
+    // finishes or fails.
+    while (state == InterpretResult::SUSPENDED) {
+        loop->runOnce(-1);
+        if (heapProfiler) heapProfiler->safepoint(heap);
+    }
+    
+    return state;
+}
+
+InterpretResult VM::start(const std::string& source) {
+    if (!load(source)) {
+        state = InterpretResult::COMPILE_ERROR;
+        return state;
+    }
+    proceed();
+    return state;
+}
+
+InterpretResult VM::start(std::shared_ptr<const Program> program) {
+    if (!load(std::move(program))) {
+        state = InterpretResult::COMPILE_ERROR;
+        return state;
+    }
+    proceed();
+    return state;
+}
+
+bool VM::load(const std::string& source) {
+    if (program) {
+        stack.clear();  // May hold the program's strings
+        program = nullptr;
+    }
+    // Start from an empty chunk: compiling appends, and the native code and
+    // loop counts were the last script's. The constants vector stays put,
+    // so it is still the heap's root. The profiler starts over, and a
+    // binary trace is finished while the old code is still there.
+    if (tracer) tracer->chunkReplaced();
+    sourceChunk = Chunk();
+    if (profiler) profiler->reset();
+    chunk = &sourceChunk;
+    Compiler compiler(heap);
+    if (!compiler.compile(source, sourceChunk)) return false;
+    if (dumpBytecode) Disassembler::disassembleChunk(*chunk, "script");
+    std::string error;
+    if (!verifyChunk(sourceChunk, error)) {
+        std::cerr << "Invalid bytecode: " << error << "." << std::endl;
+        return false;
     }
     
+    resetStack();
+    return true;
+}
+
+bool VM::load(std::shared_ptr<const Program> newProgram) {
+    // Program::compile returns null for a script that does not compile.
+    if (!newProgram) return false;
+    // Clear the stack first: it may hold strings of the program replaced.
+    stack.clear();
+    program = std::move(newProgram);
+    chunk = &program->chunk;
+    resetStack();
+    return true;
+}
+
+void VM::resetStack() {
+    // Variables live in the slots at the base of the stack, and verifying
+    // the chunk bounded the operands above them, so pushes never reallocate
+    // and dispatch needs no bounds checks.
+    stack.reserve(chunk->localCount + chunk->maxDepth);
+    stack.assign(chunk->localCount, nullptr);
+    scriptMembers.assign(chunk->members.size(), MemberSlot());
     ip = 0;
-    return run();
 }
 
 InterpretResult VM::run() {
-    #define READ_BYTE() (chunk.code[ip++])
-    #define READ_CONSTANT() (chunk.constants[READ_BYTE()])
+    TimelineScope span("vm", "run");
+    // A run that finds the chunk's native code still valid reuses it.
+    bool compiled = chunk->jitCode != nullptr;
+    countExecution();
+    if (compiled && chunk->jitCode != nullptr) Metrics::add(Metric::JIT_CACHE_HITS);
+    
+    fuel = fuelPerRun == 0 || fuelPerRun > INT64_MAX ? INT64_MAX : static_cast<int64_t>(fuelPerRun);
+    InterpretResult result = profiler || tracer ? dispatch<true>() : dispatch<false>();
+    if (result == InterpretResult::PREEMPTED) Metrics::add(Metric::PREEMPTIONS);
+    return result;
+}
+
+void VM::proceed() {
+    state = run();
+    if (profiler) profiler->pause();
+    if (state != InterpretResult::PREEMPTED) return;
+    
+    // Go to the back of the loop's queue, behind whatever else is ready.
+    state = InterpretResult::SUSPENDED;
+    loop->hold();
+    loop->post([this]() {
+        loop->release();
+        proceed();
+    });
+}
+
+template <bool kInstrumented>
+InterpretResult VM::dispatch() {
+    #define READ_BYTE() (chunk->code[ip++])
+    #define READ_CONSTANT() (chunk->constants[READ_BYTE()])
+    #define READ_SHORT() (ip += 2, static_cast<uint16_t>((chunk->code[ip - 2] << 8) | chunk->code[ip - 1]))
+    
+    // The instruction native code last exited at; the interpreter runs it
+    // before native code is entered again.
+    int exitedAt = -1;
+    
+    // Instructions interpreted, added to the metrics however the loop exits.
+    struct Executed {
+        uint64_t count = 0;
+        ~Executed() { Metrics::add(Metric::INSTRUCTIONS, count); }
+    } executed;
     
     while (true) {
-        #ifdef DEBUG_TRACE_EXECUTION
-        std::cout << "Stack: ";
-        for (const auto& value : stack) {
-            std::cout << "[ " << valueToString(value) << " ]";
+        if constexpr (kInstrumented) {
+            // Both follow the chunk compiled from source, not modules.
+            if (chunk == &sourceChunk) {
+                if (profiler) profiler->step(ip);
+                if (tracer) tracer->step(ip, stack);
+            }
+        } else if (chunk->jitCode != nullptr && ip != exitedAt && chunk->jitCode->canEnter(ip)) {
+            enterJit();
+            exitedAt = ip;
+            // Native code exits at a back edge that used up the fuel.
+            if (fuel < 0) return InterpretResult::PREEMPTED;
         }
-        std::cout << std::endl;
-        Disassembler::disassembleInstruction(chunk, ip);
-        #endif
         
+        executed.count++;
         uint8_t instruction = READ_BYTE();
         switch (static_cast<OpCode>(instruction)) {
             case OpCode::CONSTANT: {
@@ -38,25 +179,21 @@ InterpretResult VM::run() {
             }
             case OpCode::ADD: {
                 if (isString(peek(0)) && isString(peek(1))) {
-                    // String concatenation
-                    std::string b = asString(pop());
-                    std::string a = asString(pop());
-                    push(a + b);
+                    concatenate();
                 } else if (isNumber(peek(0)) && isNumber(peek(1))) {
                     // Numeric addition
                     double b = asNumber(pop());
                     double a = asNumber(pop());
                     push(a + b);
-                } else {
-                    runtimeError("Operands must be two numbers or two strings.");
+                } else if (!binaryNumeric(OpCode::ADD)) {
                     return InterpretResult::RUNTIME_ERROR;
                 }
                 break;
             }
             case OpCode::SUBTRACT: {
                 if (!isNumber(peek(0)) || !isNumber(peek(1))) {
-                    runtimeError("Operands must be numbers.");
-                    return InterpretResult::RUNTIME_ERROR;
+                    if (!binaryNumeric(OpCode::SUBTRACT)) return InterpretResult::RUNTIME_ERROR;
+                    break;
                 }
                 double b = asNumber(pop());
                 double a = asNumber(pop());
@@ -65,8 +202,8 @@ InterpretResult VM::run() {
             }
             case OpCode::MULTIPLY: {
                 if (!isNumber(peek(0)) || !isNumber(peek(1))) {
-                    runtimeError("Operands must be numbers.");
-                    return InterpretResult::RUNTIME_ERROR;
+                    if (!binaryNumeric(OpCode::MULTIPLY)) return InterpretResult::RUNTIME_ERROR;
+                    break;
                 }
                 double b = asNumber(pop());
                 double a = asNumber(pop());
@@ -75,8 +212,8 @@ InterpretResult VM::run() {
             }
             case OpCode::DIVIDE: {
                 if (!isNumber(peek(0)) || !isNumber(peek(1))) {
-                    runtimeError("Operands must be numbers.");
-                    return InterpretResult::RUNTIME_ERROR;
+                    if (!binaryNumeric(OpCode::DIVIDE)) return InterpretResult::RUNTIME_ERROR;
+                    break;
                 }
                 double b = asNumber(pop());
                 if (b == 0) {
@@ -89,8 +226,8 @@ InterpretResult VM::run() {
             }
             case OpCode::NEGATE: {
                 if (!isNumber(peek(0))) {
-                    runtimeError("Operand must be a number.");
-                    return InterpretResult::RUNTIME_ERROR;
+                    if (!unaryNumeric(OpCode::NEGATE)) return InterpretResult::RUNTIME_ERROR;
+                    break;
                 }
                 push(-asNumber(pop()));
                 break;
@@ -106,8 +243,8 @@ InterpretResult VM::run() {
             }
             case OpCode::GREATER: {
                 if (!isNumber(peek(0)) || !isNumber(peek(1))) {
-                    runtimeError("Operands must be numbers.");
-                    return InterpretResult::RUNTIME_ERROR;
+                    if (!binaryNumeric(OpCode::GREATER)) return InterpretResult::RUNTIME_ERROR;
+                    break;
                 }
                 double b = asNumber(pop());
                 double a = asNumber(pop());
@@ -116,95 +253,632 @@ InterpretResult VM::run() {
             }
             case OpCode::LESS: {
                 if (!isNumber(peek(0)) || !isNumber(peek(1))) {
-                    runtimeError("Operands must be numbers.");
-                    return InterpretResult::RUNTIME_ERROR;
+                    if (!binaryNumeric(OpCode::LESS)) return InterpretResult::RUNTIME_ERROR;
+                    break;
                 }
                 double b = asNumber(pop());
                 double a = asNumber(pop());
                 push(a < b);
                 break;
             }
+            case OpCode::LESS_EQUAL: {
+                if (!isNumber(peek(0)) || !isNumber(peek(1))) {
+                    if (!binaryNumeric(OpCode::LESS_EQUAL)) return InterpretResult::RUNTIME_ERROR;
+                    break;
+                }
+                double b = asNumber(pop());
+                double a = asNumber(pop());
+                push(!(a > b));
+                break;
+            }
+            case OpCode::GREATER_EQUAL: {
+                if (!isNumber(peek(0)) || !isNumber(peek(1))) {
+                    if (!binaryNumeric(OpCode::GREATER_EQUAL)) return InterpretResult::RUNTIME_ERROR;
+                    break;
+                }
+                double b = asNumber(pop());
+                double a = asNumber(pop());
+                push(!(a < b));
+                break;
+            }
+            case OpCode::FLOOR_DIVIDE:
+            case OpCode::MODULO:
+            case OpCode::BIT_AND:
+            case OpCode::BIT_OR:
+            case OpCode::BIT_XOR:
+            case OpCode::SHIFT_LEFT:
+            case OpCode::SHIFT_RIGHT:
+                if (!binaryNumeric(static_cast<OpCode>(instruction))) {
+                    return InterpretResult::RUNTIME_ERROR;
+                }
+                break;
+            case OpCode::BIT_NOT:
+                if (!unaryNumeric(OpCode::BIT_NOT)) return InterpretResult::RUNTIME_ERROR;
+                break;
+            case OpCode::ADD_NUMBER: {
+                double b = numberOf(pop());
+                double a = numberOf(pop());
+                push(a + b);
+                break;
+            }
+            case OpCode::SUBTRACT_NUMBER: {
+                double b = numberOf(pop());
+                double a = numberOf(pop());
+                push(a - b);
+                break;
+            }
+            case OpCode::MULTIPLY_NUMBER: {
+                double b = numberOf(pop());
+                double a = numberOf(pop());
+                push(a * b);
+                break;
+            }
+            case OpCode::DIVIDE_NUMBER: {
+                if (numberOf(peek(0)) == 0) {
+                    runtimeError("Division by zero.");
+                    return InterpretResult::RUNTIME_ERROR;
+                }
+                double b = numberOf(pop());
+                double a = numberOf(pop());
+                push(a / b);
+                break;
+            }
+            case OpCode::NEGATE_NUMBER:
+                push(-numberOf(pop()));
+                break;
+            case OpCode::EQUALS_NUMBER: {
+                double b = numberOf(pop());
+                double a = numberOf(pop());
+                push(a == b);
+                break;
+            }
+            case OpCode::GREATER_NUMBER: {
+                double b = numberOf(pop());
+                double a = numberOf(pop());
+                push(a > b);
+                break;
+            }
+            case OpCode::LESS_NUMBER: {
+                double b = numberOf(pop());
+                double a = numberOf(pop());
+                push(a < b);
+                break;
+            }
+            case OpCode::ADD_INT: {
+                int64_t b = intOf(pop());
+                int64_t a = intOf(pop());
+                int64_t sum;
+                if (__builtin_add_overflow(a, b, &sum)) {
+                    runtimeError("Integer overflow.");
+                    return InterpretResult::RUNTIME_ERROR;
+                }
+                push(sum);
+                break;
+            }
+            case OpCode::SUBTRACT_INT: {
+                int64_t b = intOf(pop());
+                int64_t a = intOf(pop());
+                int64_t difference;
+                if (__builtin_sub_overflow(a, b, &difference)) {
+                    runtimeError("Integer overflow.");
+                    return InterpretResult::RUNTIME_ERROR;
+                }
+                push(difference);
+                break;
+            }
+            case OpCode::MULTIPLY_INT: {
+                int64_t b = intOf(pop());
+                int64_t a = intOf(pop());
+                int64_t product;
+                if (__builtin_mul_overflow(a, b, &product)) {
+                    runtimeError("Integer overflow.");
+                    return InterpretResult::RUNTIME_ERROR;
+                }
+                push(product);
+                break;
+            }
+            case OpCode::NEGATE_INT: {
+                int64_t a = intOf(pop());
+                if (a == INT64_MIN) {
+                    runtimeError("Integer overflow.");
+                    return InterpretResult::RUNTIME_ERROR;
+                }
+                push(-a);
+                break;
+            }
+            case OpCode::EQUALS_INT: {
+                int64_t b = intOf(pop());
+                int64_t a = intOf(pop());
+                push(a == b);
+                break;
+            }
+            case OpCode::GREATER_INT: {
+                int64_t b = intOf(pop());
+                int64_t a = intOf(pop());
+                push(a > b);
+                break;
+            }
+            case OpCode::LESS_INT: {
+                int64_t b = intOf(pop());
+                int64_t a = intOf(pop());
+                push(a < b);
+                break;
+            }
+            case OpCode::CONCAT:
+                concatenate();
+                break;
+            case OpCode::GET_LOCAL:
+                push(stack[READ_BYTE()]);
+                break;
+            case OpCode::SET_LOCAL: {
+                uint8_t slot = READ_BYTE();
+                stack[slot] = pop();
+                break;
+            }
+            case OpCode::GET_STRING_LOCAL: {
+                uint8_t slot = READ_BYTE();
+                flattenString(heap, stack[slot]);
+                push(stack[slot]);
+                break;
+            }
+            case OpCode::GET_MEMBER: {
+                uint8_t index = READ_BYTE();
+                MemberSlot& member = (unit != nullptr ? unit->members : scriptMembers)[index];
+                if (member.module == nullptr && !resolveMember(index, member)) {
+                    return InterpretResult::RUNTIME_ERROR;
+                }
+                push(member.module->stack[member.slot]);
+                break;
+            }
+            case OpCode::APPEND_LOCAL: {
+                uint8_t slot = READ_BYTE();
+                uint8_t count = READ_BYTE();
+                size_t base = stack.size() - count;
+                if (const char* message = appendStrings(heap, stack[slot], &stack[base], count)) {
+                    runtimeError(message);
+                    return InterpretResult::RUNTIME_ERROR;
+                }
+                stack.resize(base);
+                break;
+            }
+            case OpCode::BUILD_ARRAY: {
+                uint8_t count = READ_BYTE();
+                if (count == 0) push(nullptr);  // Slot for the result
+                size_t base = stack.size() - (count == 0 ? 1 : count);
+                if (const char* message = buildArray(heap, &stack[base], count, stack[base])) {
+                    runtimeError(message);
+                    return InterpretResult::RUNTIME_ERROR;
+                }
+                stack.resize(base + 1);
+                break;
+            }
+            case OpCode::BUILD_DICT: {
+                uint8_t count = READ_BYTE();
+                if (count == 0) push(nullptr);
+                size_t base = stack.size() - (count == 0 ? 1 : 2 * count);
+                if (const char* message = buildDict(heap, &stack[base], count, stack[base])) {
+                    runtimeError(message);
+                    return InterpretResult::RUNTIME_ERROR;
+                }
+                stack.resize(base + 1);
+                break;
+            }
+            case OpCode::GET_INDEX: {
+                Value& array = stack[stack.size() - 2];
+                if (const char* message = getIndex(array, stack.back(), array)) {
+                    runtimeError(message);
+                    return InterpretResult::RUNTIME_ERROR;
+                }
+                stack.pop_back();
+                break;
+            }
+            case OpCode::SET_INDEX: {
+                size_t top = stack.size();
+                if (const char* message = setIndex(heap, stack[top - 3], stack[top - 2], stack[top - 1])) {
+                    runtimeError(message);
+                    return InterpretResult::RUNTIME_ERROR;
+                }
+                stack.resize(top - 3);
+                break;
+            }
+            case OpCode::CALL_BUILTIN: {
+                Builtin builtin = static_cast<Builtin>(READ_BYTE());
+                uint8_t argc = READ_BYTE();
+                if (argc == 0) push(nullptr);
+                size_t base = stack.size() - (argc == 0 ? 1 : argc);
+                if (const char* message = callBuiltin(heap, builtin, &stack[base], argc, stack[base])) {
+                    runtimeError(message);
+                    return InterpretResult::RUNTIME_ERROR;
+                }
+                stack.resize(base + 1);
+                break;
+            }
+            case OpCode::JUMP: {
+                uint16_t offset = READ_SHORT();
+                ip += offset;
+                break;
+            }
+            case OpCode::JUMP_IF_FALSE: {
+                uint16_t offset = READ_SHORT();
+                if (!isTruthy(pop())) ip += offset;
+                break;
+            }
+            case OpCode::JUMP_IF_TRUE: {
+                uint16_t offset = READ_SHORT();
+                if (isTruthy(pop())) ip += offset;
+                break;
+            }
+            case OpCode::JUMP_IF_FALSE_OR_POP:
+            case OpCode::JUMP_IF_TRUE_OR_POP: {
+                uint16_t offset = READ_SHORT();
+                bool jumpWhen = static_cast<OpCode>(instruction) == OpCode::JUMP_IF_TRUE_OR_POP;
+                if (isTruthy(peek(0)) == jumpWhen) {
+                    ip += offset;
+                } else {
+                    pop();
+                }
+                break;
+            }
+            case OpCode::LOOP: {
+                uint16_t offset = READ_SHORT();
+                // A program's counters are shared by every VM running it;
+                // racing runs may lose counts but never tear them.
+                uint64_t& count = chunk->loopCounts[READ_BYTE()];
+                __atomic_store_n(&count, __atomic_load_n(&count, __ATOMIC_RELAXED) + 1, __ATOMIC_RELAXED);
+                ip -= offset;
+                // Back edges count toward compiling the chunk, so a long
+                // loop tiers up while it runs.
+                countExecution();
+                if (--fuel < 0) return InterpretResult::PREEMPTED;
+                break;
+            }
+            case OpCode::EQUAL_JUMP:
+            case OpCode::NOT_EQUAL_JUMP:
+            case OpCode::LESS_JUMP:
+            case OpCode::LESS_EQUAL_JUMP:
+            case OpCode::GREATER_JUMP:
+            case OpCode::GREATER_EQUAL_JUMP: {
+                uint16_t offset = READ_SHORT();
+                bool holds;
+                if (!compareForBranch(static_cast<OpCode>(instruction), holds)) {
+                    return InterpretResult::RUNTIME_ERROR;
+                }
+                if (!holds) ip += offset;
+                break;
+            }
             case OpCode::PRINT: {
-                std::cout << valueToString(pop()) << std::endl;
+                output.print(pop());
                 break;
             }
             case OpCode::POP:
                 pop();
                 break;
+            case OpCode::AWAIT: {
+                // The stack and ip are the whole frame, so suspending is
+                // just returning; resume() re-enters at the next opcode.
+                if (!beginAwait(pop())) {
+                    return InterpretResult::RUNTIME_ERROR;
+                }
+                output.beforeWait();
+                Metrics::add(Metric::AWAITS_STARTED);
+                awaitStart = Timeline::enabled() ? Timeline::now() : 0;
+                return InterpretResult::SUSPENDED;
+            }
             case OpCode::RETURN:
+                output.flush();
                 return InterpretResult::OK;
         }
     }
     
     #undef READ_BYTE
     #undef READ_CONSTANT
+    #undef READ_SHORT
 }
 
-void VM::push(Value value) {
-    stack.push_back(value);
+void VM::concatenate() {
+    // The operands stay on the stack while allocating so a collection can
+    // move them.
+    size_t length = asObjString(peek(0))->length + asObjString(peek(1))->length;
+    ObjString* result = heap.allocateString(length);
+    ObjString* b = asObjString(peek(0));
+    ObjString* a = asObjString(peek(1));
+    std::memcpy(result->chars(), a->chars(), a->length);
+    std::memcpy(result->chars() + a->length, b->chars(), b->length);
+    pop();
+    pop();
+    push(static_cast<Obj*>(result));
 }
 
-Value VM::pop() {
-    Value value = stack.back();
-    stack.pop_back();
-    return value;
+bool VM::binaryNumeric(OpCode op) {
+    if (isArrayValue(peek(0)) || isArrayValue(peek(1))) {
+        // Element-wise; the operands stay on the stack as roots.
+        size_t top = stack.size();
+        if (const char* message = arrayBinary(heap, op, stack[top - 2], stack[top - 1])) {
+            runtimeError(message);
+            return false;
+        }
+        stack.pop_back();
+        return true;
+    }
+    
+    Value result;
+    if (const char* message = numericBinary(op, peek(1), peek(0), result)) {
+        runtimeError(message);
+        return false;
+    }
+    pop();
+    pop();
+    push(result);
+    return true;
 }
 
-Value VM::peek(int distance) {
-    return stack[stack.size() - 1 - distance];
+bool VM::compareForBranch(OpCode op, bool& holds) {
+    const Value& b = stack[stack.size() - 1];
+    const Value& a = stack[stack.size() - 2];
+    
+    if (isNumber(a) && isNumber(b)) {
+        holds = branchHolds(op, asNumber(a), asNumber(b));
+    } else if (std::holds_alternative<int64_t>(a) && std::holds_alternative<int64_t>(b)) {
+        holds = branchHolds(op, std::get<int64_t>(a), std::get<int64_t>(b));
+    } else if (const char* message = branchCondition(op, a, b, holds)) {
+        runtimeError(message);
+        return false;
+    }
+    
+    stack.pop_back();
+    stack.pop_back();
+    return true;
 }
 
-bool VM::isTruthy(const Value& value) {
-    if (std::holds_alternative<std::nullptr_t>(value)) {
+bool VM::unaryNumeric(OpCode op) {
+    if (isArrayValue(peek(0))) {
+        if (const char* message = arrayUnary(heap, op, stack.back())) {
+            runtimeError(message);
+            return false;
+        }
+        return true;
+    }
+    
+    Value result;
+    if (const char* message = numericUnary(op, peek(0), result)) {
+        runtimeError(message);
         return false;
     }
-    if (std::holds_alternative<bool>(value)) {
-        return std::get<bool>(value);
+    pop();
+    push(result);
+    return true;
+}
+
+bool VM::beginAwait(const Value& operand) {
+    if (isNumber(operand) || std::holds_alternative<int64_t>(operand)) {
+        // await <milliseconds>: sleep on a timer, evaluates to null
+        int64_t milliseconds;
+        if (const char* message = awaitDelay(operand, milliseconds)) {
+            runtimeError(message);
+            return false;
+        }
+        loop->addTimer(milliseconds, [this]() {
+            resume(nullptr);
+        });
+        return true;
+    }
+    
+    if (isString(operand)) {
+        // await "<path>": read the file on the thread pool
+        std::string path = asString(operand);
+        loop->readFile(path, [this, path](bool ok, std::string contents) {
+            if (!ok) {
+                fail("Could not read file \"" + path + "\".");
+                return;
+            }
+            resume(static_cast<Obj*>(heap.copyString(contents.data(), contents.size())));
+        });
+        return true;
+    }
+    
+    runtimeError("Can only await a number of milliseconds or a file path.");
+    return false;
+}
+
+bool VM::resolveMember(uint8_t index, MemberSlot& member) {
+    const Chunk::Member& wanted = chunk->members[index];
+    const std::string& moduleName = chunk->imports[wanted.module];
+    Module* module = loadModule(moduleName);
+    if (module == nullptr) return false;
+    
+    const std::vector<std::string>& names = module->chunk.localNames;
+    auto it = std::find(names.begin(), names.end(), wanted.name);
+    if (it == names.end()) {
+        runtimeError("Module '" + moduleName + "' has no variable '" + wanted.name + "'.");
+        return false;
     }
+    member.module = module;
+    member.slot = static_cast<int>(it - names.begin());
     return true;
 }
 
-bool VM::valuesEqual(const Value& a, const Value& b) {
-    if (a.index() != b.index()) return false;
+VM::Module* VM::loadModule(const std::string& name) {
+    auto found = modules.find(name);
+    if (found != modules.end()) {
+        if (!found->second->running) return found->second.get();
+        runtimeError("Module '" + name + "' is imported while it is still loading.");
+        return nullptr;
+    }
     
-    if (std::holds_alternative<std::nullptr_t>(a)) {
-        return true;  // null == null
+    std::ifstream file;
+    for (const std::string& directory : modulePaths) {
+        file.open(directory + "/" + name + ".fs", std::ios::binary);
+        if (file) break;
+        file.clear();
+    }
+    if (!file.is_open()) {
+        runtimeError("Could not find module '" + name + "'.");
+        return nullptr;
     }
-    if (std::holds_alternative<bool>(a)) {
-        return std::get<bool>(a) == std::get<bool>(b);
+    std::ostringstream source;
+    source << file.rdbuf();
+    
+    TimelineScope span("vm", "import");
+    auto module = std::make_unique<Module>();
+    module->name = name;
+    heap.addRoots(&module->chunk.constants);
+    heap.addRoots(&module->stack);
+    auto discard = [&](const std::string& message) {
+        heap.removeRoots(&module->chunk.constants);
+        heap.removeRoots(&module->stack);
+        runtimeError(message);
+        return nullptr;
+    };
+    
+    Compiler compiler(heap);
+    std::string error;
+    if (!compiler.compile(source.str(), module->chunk)) {
+        return discard("Could not compile module '" + name + "'.");
     }
-    if (std::holds_alternative<double>(a)) {
-        return std::get<double>(a) == std::get<double>(b);
+    if (!verifyChunk(module->chunk, error)) {
+        return discard("Invalid bytecode in module '" + name + "': " + error + ".");
     }
-    if (std::holds_alternative<std::string>(a)) {
-        return std::get<std::string>(a) == std::get<std::string>(b);
+    // Modules run to completion inside the instruction that first reads
+    // them, so there is nothing an await could suspend back to.
+    for (size_t offset = 0; offset < module->chunk.code.size();) {
+        int length, effect;
+        describeOpCode(module->chunk.code[offset], length, effect);
+        if (static_cast<OpCode>(module->chunk.code[offset]) == OpCode::AWAIT) {
+            return discard("Module '" + name + "' cannot await at the top level.");
+        }
+        offset += length;
     }
+    if (dumpBytecode) Disassembler::disassembleChunk(module->chunk, "module " + name);
     
-    return false;  // Shouldn't reach here
+    // Run the top level on the VM's stack, with the importer's set aside in
+    // the module's (both are roots); preempting it could not be resumed
+    // either.
+    Module* loaded = module.get();
+    loaded->members.assign(loaded->chunk.members.size(), MemberSlot());
+    loaded->stack.reserve(loaded->chunk.localCount + loaded->chunk.maxDepth);
+    loaded->stack.assign(loaded->chunk.localCount, nullptr);
+    loaded->running = true;
+    modules.emplace(name, std::move(module));
+    Chunk* importer = chunk;
+    Module* importerUnit = unit;
+    int importerIp = ip;
+    int64_t importerFuel = fuel;
+    chunk = &loaded->chunk;
+    unit = loaded;
+    ip = 0;
+    fuel = INT64_MAX;
+    stack.swap(loaded->stack);
+    InterpretResult result = profiler || tracer ? dispatch<true>() : dispatch<false>();
+    stack.swap(loaded->stack);
+    chunk = importer;
+    unit = importerUnit;
+    ip = importerIp;
+    fuel = importerFuel;
+    loaded->running = false;
+    if (result != InterpretResult::OK) {
+        heap.removeRoots(&loaded->chunk.constants);
+        heap.removeRoots(&loaded->stack);
+        modules.erase(name);
+        return nullptr;
+    }
+    
+    // Strings the top level built in place are read as ordinary strings.
+    for (Value& variable : loaded->stack) {
+        if (std::holds_alternative<Obj*>(variable)) flattenString(heap, variable);
+    }
+    return loaded;
+}
+
+void VM::enableProfiling() {
+    profiler = std::make_unique<Profiler>(sourceChunk);
+    sourceChunk.jitCode = nullptr;
+}
+
+void VM::enableHeapProfiling(const std::string& snapshotPath) {
+    heapProfiler = std::make_unique<HeapProfiler>(chunk, ip);
+    heapProfiler->nameRoots(&stack, "stack", &sourceChunk.localNames);
+    heapProfiler->nameRoots(&sourceChunk.constants, "constant");
+    heapProfiler->setSnapshotPath(snapshotPath);
+    heap.setProfiler(heapProfiler.get());
 }
 
-std::string VM::valueToString(const Value& value) {
-    if (std::holds_alternative<double>(value)) {
-        std::ostringstream ss;
-        ss << std::get<double>(value);
-        return ss.str();
-    } else if (std::holds_alternative<bool>(value)) {
-        return std::get<bool>(value) ? "true" : "false";
-    } else if (std::holds_alternative<std::string>(value)) {
-        return std::get<std::string>(value);
-    } else if (std::holds_alternative<std::nullptr_t>(value)) {
-        return "null";
+void VM::setTracer(std::unique_ptr<Tracer> newTracer) {
+    tracer = std::move(newTracer);
+    sourceChunk.jitCode = nullptr;
+}
+
+void VM::countExecution() {
+    // Programs are compiled up front, and shared.
+    if (program && chunk == &program->chunk) return;
+    
+    // Code compiled before the chunk grew (REPL lines) no longer covers it.
+    if (chunk->jitCode != nullptr && chunk->jitCode->codeLength() != chunk->code.size()) {
+        chunk->jitCode = nullptr;
+        chunk->executionCount = 0;
+    }
+    
+    if (chunk->jitCode == nullptr && !profiler && !tracer && ++chunk->executionCount == kJitThreshold) {
+        TimelineScope span("vm", "jit compile");
+        chunk->jitCode = JitCode::compile(*chunk);
+        Metrics::add(Metric::JIT_COMPILES);
     }
+}
+
+void VM::enterJit() {
+    const JitCode& code = *chunk->jitCode;
+    Metrics::add(Metric::JIT_ENTRIES);
     
-    return "unknown";
+    // Native code pushes into slots that already exist, and the collector
+    // never runs while it does, so give it its headroom up front and trim
+    // the stack back to the real top afterwards.
+    size_t top = stack.size();
+    stack.resize(top + code.headroom(ip));
+    JitExit exit = code.enter(stack.data(), stack.data() + top, chunk->constants.data(), ip, &fuel);
+    stack.resize(exit.top - stack.data());
+    ip = static_cast<int>(exit.ip);
+}
+
+void VM::resume(Value result) {
+    finishAwait();
+    push(result);
+    proceed();
+}
+
+void VM::fail(const std::string& message) {
+    finishAwait();
+    runtimeError(message);
+    state = InterpretResult::RUNTIME_ERROR;
+}
+
+void VM::finishAwait() {
+    Metrics::add(Metric::AWAITS_FINISHED);
+    if (awaitStart == 0) return;
+    Timeline::complete("task", "await", awaitStart, Timeline::now());
+    awaitStart = 0;
+}
+
+void VM::push(Value value) {
+    stack.push_back(value);
+}
+
+Value VM::pop() {
+    Value value = stack.back();
+    stack.pop_back();
+    return value;
+}
+
+Value VM::peek(int distance) {
+    return stack[stack.size() - 1 - distance];
 }
 
 void VM::runtimeError(const std::string& message) {
+    output.flush();
     std::cerr << message << std::endl;
     
     size_t instruction = ip - 1;
-    int line = chunk.lines[instruction];
-    std::cerr << "[line " << line << "] in script" << std::endl;
+    int line = chunk->lines[instruction];
+    std::cerr << "[line " << line << "] in "
+              << (unit != nullptr ? "module " + unit->name : std::string("script")) << std::endl;
     
     stack.clear();
 }
@@ -214,13 +888,18 @@ bool VM::isNumber(const Value& value) {
 }
 
 bool VM::isString(const Value& value) {
-    return std::holds_alternative<std::string>(value);
+    return std::holds_alternative<Obj*>(value) &&
+           isObjType(std::get<Obj*>(value), ObjType::STRING);
 }
 
 double VM::asNumber(const Value& value) {
     return std::get<double>(value);
 }
 
+ObjString* VM::asObjString(const Value& value) {
+    return static_cast<ObjString*>(std::get<Obj*>(value));
+}
+
 std::string VM::asString(const Value& value) {
-    return std::get<std::string>(value);
+    return stringOf(asObjString(value));
 }
\ No newline at end of file
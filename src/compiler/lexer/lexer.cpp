@@ -9,16 +9,21 @@ static std::unordered_map<std::string, TokenType> keywords = {
     {"parallel", TokenType::PARALLEL},
     {"async", TokenType::ASYNC},
     {"await", TokenType::AWAIT},
+    {"import", TokenType::IMPORT},
     {"if", TokenType::IF},
     {"else", TokenType::ELSE},
     {"for", TokenType::FOR},
+    {"in", TokenType::IN},
     {"while", TokenType::WHILE},
     {"return", TokenType::RETURN},
     {"and", TokenType::AND},
     {"or", TokenType::OR},
     {"not", TokenType::NOT},
     {"pass", TokenType::PASS},
+    {"break", TokenType::BREAK},
+    {"continue", TokenType::CONTINUE},
     {"print", TokenType::PRINT},
+    {"div", TokenType::DIV},
 };
 
 Lexer::Lexer(const std::string& source) : source(source) {}
@@ -29,6 +34,16 @@ std::vector<Token> Lexer::scanTokens() {
         scanToken();
     }
     
+    // Close the blocks still open at the end of the file, ending the last
+    // statement first if the file has no trailing newline.
+    if (indentStack.size() > 1 && !tokens.empty() && tokens.back().type != TokenType::NEWLINE) {
+        tokens.push_back({TokenType::NEWLINE, "", line});
+    }
+    while (indentStack.size() > 1) {
+        indentStack.pop_back();
+        tokens.push_back({TokenType::DEDENT, "", line});
+    }
+    
     tokens.push_back({TokenType::EOF_TOKEN, "", line});
     return tokens;
 }
@@ -44,8 +59,14 @@ void Lexer::scanToken() {
             advance();
         }
 
+        // Blank and comment-only lines leave the indentation alone.
+        bool blank = isAtEnd() || peek() == '\n' || peek() == '\r' ||
+                     (peek() == '/' && peekNext() == '/');
+
         int currentIndent = indentStack.back();
-        if (indentCount > currentIndent) {
+        if (blank) {
+            // Nothing to open or close
+        } else if (indentCount > currentIndent) {
             indentStack.push_back(indentCount);
             addToken(TokenType::INDENT);
         } else {
@@ -89,6 +110,11 @@ void Lexer::scanToken() {
         case '+': addToken(TokenType::PLUS); break;
         case '-': addToken(TokenType::MINUS); break;
         case '*': addToken(TokenType::STAR); break;
+        case '%': addToken(TokenType::PERCENT); break;
+        case '&': addToken(TokenType::AMPERSAND); break;
+        case '|': addToken(TokenType::PIPE); break;
+        case '^': addToken(TokenType::CARET); break;
+        case '~': addToken(TokenType::TILDE); break;
         case '/':
             if (match('/')) {
                 while (peek() != '\n' && !isAtEnd()) advance(); // line comment
@@ -105,8 +131,14 @@ void Lexer::scanToken() {
 
         case '=': addToken(match('=') ? TokenType::EQUAL_EQUAL : TokenType::ASSIGN); break;
         case '!': addToken(match('=') ? TokenType::BANG_EQUAL : TokenType::IDENTIFIER); break;
-        case '<': addToken(match('=') ? TokenType::LESS_EQUAL : TokenType::LESS); break;
-        case '>': addToken(match('=') ? TokenType::GREATER_EQUAL : TokenType::GREATER); break;
+        case '<':
+            if (match('<')) addToken(TokenType::LESS_LESS);
+            else addToken(match('=') ? TokenType::LESS_EQUAL : TokenType::LESS);
+            break;
+        case '>':
+            if (match('>')) addToken(TokenType::GREATER_GREATER);
+            else addToken(match('=') ? TokenType::GREATER_EQUAL : TokenType::GREATER);
+            break;
 
         // Whitespace (skip)
         case ' ':
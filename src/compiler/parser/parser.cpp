@@ -29,11 +29,13 @@ void Parser::synchronize() {
         switch (peek().type) {
             case TokenType::CLASS:
             case TokenType::TASK:
+            case TokenType::ASYNC:
             case TokenType::FOR:
             case TokenType::IF:
             case TokenType::WHILE:
             case TokenType::PRINT:
             case TokenType::RETURN:
+            case TokenType::IMPORT:
                 return;
         }
         
@@ -46,7 +48,32 @@ std::unique_ptr<Statement> Parser::declaration() {
 
     if (match(TokenType::CLASS)) return classDeclaration();
     if (match(TokenType::TASK)) return taskDeclaration();
+    if (match(TokenType::ASYNC)) {
+        consume(TokenType::TASK, "Expect 'task' after 'async'.");
+        auto task = taskDeclaration();
+        task->isAsync = true;
+        return task;
+    }
     if (match(TokenType::PRINT)) return printStatement();
+    if (match(TokenType::IF)) return ifStatement();
+    if (match(TokenType::WHILE)) return whileStatement();
+    if (match(TokenType::FOR)) return forStatement();
+    if (match(TokenType::BREAK)) {
+        Token keyword = previous();
+        consumeEndOfStatement();
+        return std::make_unique<BreakStatement>(keyword);
+    }
+    if (match(TokenType::CONTINUE)) {
+        Token keyword = previous();
+        consumeEndOfStatement();
+        return std::make_unique<ContinueStatement>(keyword);
+    }
+    if (match(TokenType::IMPORT)) {
+        Token name = consume(TokenType::IDENTIFIER, "Expect module name after 'import'.");
+        consumeEndOfStatement();
+        return std::make_unique<ImportStatement>(name);
+    }
+    if (check(TokenType::IDENTIFIER) && checkNext(TokenType::ASSIGN)) return assignment();
     
     return expressionStatement();
 }
@@ -135,8 +162,133 @@ std::unique_ptr<Statement> Parser::printStatement() {
     return std::make_unique<PrintStatement>(std::move(value));
 }
 
+std::unique_ptr<Statement> Parser::assignment() {
+    Token name = advance();
+    advance(); // '='
+    auto value = expression();
+    consumeEndOfStatement();
+    return std::make_unique<AssignStatement>(name, std::move(value));
+}
+
+std::unique_ptr<Statement> Parser::ifStatement() {
+    Token keyword = previous();
+    auto condition = expression();
+    auto thenBranch = block("if");
+    
+    std::vector<std::unique_ptr<Statement>> elseBranch;
+    if (match(TokenType::ELSE)) {
+        if (match(TokenType::IF)) {
+            elseBranch.push_back(ifStatement());
+        } else {
+            elseBranch = block("else");
+        }
+    }
+    
+    return std::make_unique<IfStatement>(keyword, std::move(condition),
+                                         std::move(thenBranch), std::move(elseBranch));
+}
+
+std::unique_ptr<Statement> Parser::whileStatement() {
+    Token keyword = previous();
+    auto condition = expression();
+    auto body = block("while");
+    return std::make_unique<WhileStatement>(keyword, std::move(condition), std::move(body));
+}
+
+std::unique_ptr<Statement> Parser::forStatement() {
+    Token keyword = previous();
+    Token variable = consume(TokenType::IDENTIFIER, "Expect loop variable after 'for'.");
+    consume(TokenType::IN, "Expect 'in' after loop variable.");
+    
+    Token range = consume(TokenType::IDENTIFIER, "Expect 'range' after 'in'.");
+    if (range.lexeme != "range") {
+        throw std::runtime_error("Error at line " + std::to_string(range.line) +
+                                 ": Can only loop over range(...).");
+    }
+    consume(TokenType::LEFT_PAREN, "Expect '(' after 'range'.");
+    
+    // range(stop), range(start, stop) or range(start, stop, step)
+    std::unique_ptr<Expression> start;
+    std::unique_ptr<Expression> stop = expression();
+    int64_t step = 1;
+    if (match(TokenType::COMMA)) {
+        start = std::move(stop);
+        stop = expression();
+        if (match(TokenType::COMMA)) {
+            bool negative = match(TokenType::MINUS);
+            Token literal = consume(TokenType::NUMBER, "Expect an integer literal as the range step.");
+            if (literal.lexeme.find('.') != std::string::npos) {
+                throw std::runtime_error("Error at line " + std::to_string(literal.line) +
+                                         ": The range step must be an integer literal.");
+            }
+            try {
+                step = std::stoll(literal.lexeme);
+            } catch (const std::exception&) {
+                throw std::runtime_error("Error at line " + std::to_string(literal.line) +
+                                         ": The range step is out of range.");
+            }
+            if (negative) step = -step;
+            if (step == 0) {
+                throw std::runtime_error("Error at line " + std::to_string(literal.line) +
+                                         ": The range step must not be zero.");
+            }
+        }
+    } else {
+        start = std::make_unique<Literal>("0", range.line);
+    }
+    consume(TokenType::RIGHT_PAREN, "Expect ')' after range arguments.");
+    
+    auto body = block("for");
+    return std::make_unique<ForStatement>(keyword, variable, std::move(start), std::move(stop),
+                                          step, std::move(body));
+}
+
+std::vector<std::unique_ptr<Statement>> Parser::block(const std::string& owner) {
+    std::vector<std::unique_ptr<Statement>> statements;
+    
+    if (match(TokenType::LEFT_BRACE)) {
+        // Go-style block; the lexer still reports its indentation, which
+        // means nothing between braces.
+        while (!check(TokenType::RIGHT_BRACE) && !isAtEnd()) {
+            while (match(TokenType::NEWLINE) || match(TokenType::INDENT) || match(TokenType::DEDENT)) {}
+            if (check(TokenType::RIGHT_BRACE)) break;
+            statements.push_back(declaration());
+        }
+        consume(TokenType::RIGHT_BRACE, "Expect '}' after " + owner + " body.");
+    } else {
+        // Python-style indentation block
+        consume(TokenType::COLON, "Expect ':' or '{' after " + owner + ".");
+        consume(TokenType::NEWLINE, "Expect newline after ':'.");
+        skipNewlines();
+        consume(TokenType::INDENT, "Expect indented block after " + owner + ".");
+        while (!check(TokenType::DEDENT) && !isAtEnd()) {
+            skipNewlines();
+            if (check(TokenType::DEDENT)) break;
+            statements.push_back(declaration());
+        }
+        consume(TokenType::DEDENT, "Expect dedent after " + owner + " body.");
+    }
+    
+    return statements;
+}
+
 std::unique_ptr<Statement> Parser::expressionStatement() {
     auto expr = expression();
+    
+    if (match(TokenType::ASSIGN)) {
+        int line = previous().line;
+        auto* target = dynamic_cast<IndexExpression*>(expr.get());
+        if (target == nullptr) {
+            throw std::runtime_error("Error at line " + std::to_string(line) +
+                                     ": Invalid assignment target.");
+        }
+        expr.release();
+        auto value = expression();
+        consumeEndOfStatement();
+        return std::make_unique<SetIndexStatement>(std::unique_ptr<IndexExpression>(target),
+                                                   std::move(value));
+    }
+    
     consumeEndOfStatement();
     return std::make_unique<ExpressionStatement>(std::move(expr));
 }
@@ -161,6 +313,41 @@ void Parser::skipNewlines() {
 }
 
 std::unique_ptr<Expression> Parser::expression() {
+    return logicalOr();
+}
+
+std::unique_ptr<Expression> Parser::logicalOr() {
+    auto expr = logicalAnd();
+    
+    while (match(TokenType::OR)) {
+        Token op = previous();
+        auto right = logicalAnd();
+        expr = std::make_unique<LogicalExpression>(std::move(expr), op, std::move(right));
+    }
+    
+    return expr;
+}
+
+std::unique_ptr<Expression> Parser::logicalAnd() {
+    auto expr = logicalNot();
+    
+    while (match(TokenType::AND)) {
+        Token op = previous();
+        auto right = logicalNot();
+        expr = std::make_unique<LogicalExpression>(std::move(expr), op, std::move(right));
+    }
+    
+    return expr;
+}
+
+// 'not' binds looser than comparisons: not a == b is not (a == b).
+std::unique_ptr<Expression> Parser::logicalNot() {
+    if (match(TokenType::NOT)) {
+        Token op = previous();
+        auto right = logicalNot();
+        return std::make_unique<UnaryExpression>(op, std::move(right));
+    }
+    
     return equality();
 }
 
@@ -177,11 +364,61 @@ std::unique_ptr<Expression> Parser::equality() {
 }
 
 std::unique_ptr<Expression> Parser::comparison() {
-    auto expr = term();
+    auto expr = bitOr();
     
     while (match(TokenType::GREATER) || match(TokenType::GREATER_EQUAL) ||
            match(TokenType::LESS) || match(TokenType::LESS_EQUAL)) {
         Token op = previous();
+        auto right = bitOr();
+        expr = std::make_unique<BinaryExpression>(std::move(expr), op, std::move(right));
+    }
+    
+    return expr;
+}
+
+// Bitwise operators bind tighter than comparisons, as in Python:
+// a & mask == 0 means (a & mask) == 0.
+std::unique_ptr<Expression> Parser::bitOr() {
+    auto expr = bitXor();
+    
+    while (match(TokenType::PIPE)) {
+        Token op = previous();
+        auto right = bitXor();
+        expr = std::make_unique<BinaryExpression>(std::move(expr), op, std::move(right));
+    }
+    
+    return expr;
+}
+
+std::unique_ptr<Expression> Parser::bitXor() {
+    auto expr = bitAnd();
+    
+    while (match(TokenType::CARET)) {
+        Token op = previous();
+        auto right = bitAnd();
+        expr = std::make_unique<BinaryExpression>(std::move(expr), op, std::move(right));
+    }
+    
+    return expr;
+}
+
+std::unique_ptr<Expression> Parser::bitAnd() {
+    auto expr = shift();
+    
+    while (match(TokenType::AMPERSAND)) {
+        Token op = previous();
+        auto right = shift();
+        expr = std::make_unique<BinaryExpression>(std::move(expr), op, std::move(right));
+    }
+    
+    return expr;
+}
+
+std::unique_ptr<Expression> Parser::shift() {
+    auto expr = term();
+    
+    while (match(TokenType::LESS_LESS) || match(TokenType::GREATER_GREATER)) {
+        Token op = previous();
         auto right = term();
         expr = std::make_unique<BinaryExpression>(std::move(expr), op, std::move(right));
     }
@@ -204,7 +441,8 @@ std::unique_ptr<Expression> Parser::term() {
 std::unique_ptr<Expression> Parser::factor() {
     auto expr = unary();
     
-    while (match(TokenType::STAR) || match(TokenType::SLASH)) {
+    while (match(TokenType::STAR) || match(TokenType::SLASH) ||
+           match(TokenType::DIV) || match(TokenType::PERCENT)) {
         Token op = previous();
         auto right = unary();
         expr = std::make_unique<BinaryExpression>(std::move(expr), op, std::move(right));
@@ -214,26 +452,80 @@ std::unique_ptr<Expression> Parser::factor() {
 }
 
 std::unique_ptr<Expression> Parser::unary() {
-    if (match(TokenType::BANG) || match(TokenType::MINUS)) {
+    if (match(TokenType::AWAIT)) {
+        Token keyword = previous();
+        auto operand = unary();
+        return std::make_unique<AwaitExpression>(keyword, std::move(operand));
+    }
+    
+    if (match(TokenType::BANG) || match(TokenType::MINUS) || match(TokenType::TILDE)) {
         Token op = previous();
         auto right = unary();
         return std::make_unique<UnaryExpression>(op, std::move(right));
     }
     
-    return primary();
+    return call();
+}
+
+// Postfix indexing binds tightest: -a[i] is -(a[i]).
+std::unique_ptr<Expression> Parser::call() {
+    auto expr = primary();
+    
+    while (match(TokenType::LEFT_BRACKET)) {
+        Token bracket = previous();
+        auto index = expression();
+        consume(TokenType::RIGHT_BRACKET, "Expect ']' after index.");
+        expr = std::make_unique<IndexExpression>(std::move(expr), bracket, std::move(index));
+    }
+    
+    return expr;
 }
 
 std::unique_ptr<Expression> Parser::primary() {
-    if (match(TokenType::FALSE)) return std::make_unique<Literal>("false");
-    if (match(TokenType::TRUE)) return std::make_unique<Literal>("true");
-    if (match(TokenType::NULL_TOKEN)) return std::make_unique<Literal>("null");
+    if (match(TokenType::FALSE)) return std::make_unique<Literal>("false", previous().line);
+    if (match(TokenType::TRUE)) return std::make_unique<Literal>("true", previous().line);
+    if (match(TokenType::NULL_TOKEN)) return std::make_unique<Literal>("null", previous().line);
     
     if (match(TokenType::NUMBER) || match(TokenType::STRING)) {
-        return std::make_unique<Literal>(previous().lexeme);
+        return std::make_unique<Literal>(previous().lexeme, previous().line);
     }
     
     if (match(TokenType::IDENTIFIER)) {
-        return std::make_unique<VariableExpression>(previous());
+        Token name = previous();
+        if (match(TokenType::LEFT_PAREN)) {
+            auto args = arguments(TokenType::RIGHT_PAREN, "Expect ')' after arguments.");
+            return std::make_unique<CallExpression>(name, std::move(args));
+        }
+        if (match(TokenType::DOT)) {
+            Token member = consume(TokenType::IDENTIFIER, "Expect variable name after '.'.");
+            return std::make_unique<MemberExpression>(name, member);
+        }
+        return std::make_unique<VariableExpression>(name);
+    }
+    
+    if (match(TokenType::LEFT_BRACKET)) {
+        Token bracket = previous();
+        auto elements = arguments(TokenType::RIGHT_BRACKET, "Expect ']' after array elements.");
+        return std::make_unique<ArrayExpression>(bracket, std::move(elements));
+    }
+    
+    // A dict literal may span lines; as in a braced block, the layout
+    // tokens between the braces mean nothing.
+    if (match(TokenType::LEFT_BRACE)) {
+        Token brace = previous();
+        std::vector<std::unique_ptr<Expression>> keys;
+        std::vector<std::unique_ptr<Expression>> values;
+        while (match(TokenType::NEWLINE) || match(TokenType::INDENT) || match(TokenType::DEDENT)) {}
+        while (!check(TokenType::RIGHT_BRACE)) {
+            keys.push_back(expression());
+            consume(TokenType::COLON, "Expect ':' after dict key.");
+            values.push_back(expression());
+            bool more = match(TokenType::COMMA);
+            while (match(TokenType::NEWLINE) || match(TokenType::INDENT) || match(TokenType::DEDENT)) {}
+            if (!more) break;
+        }
+        consume(TokenType::RIGHT_BRACE, "Expect '}' after dict entries.");
+        return std::make_unique<DictExpression>(brace, std::move(keys), std::move(values));
     }
     
     if (match(TokenType::LEFT_PAREN)) {
@@ -245,6 +537,18 @@ std::unique_ptr<Expression> Parser::primary() {
     throw std::runtime_error("Expect expression.");
 }
 
+// Comma-separated expressions up to the closing token, which is consumed.
+std::vector<std::unique_ptr<Expression>> Parser::arguments(TokenType closing, const std::string& message) {
+    std::vector<std::unique_ptr<Expression>> list;
+    if (!check(closing)) {
+        do {
+            list.push_back(expression());
+        } while (match(TokenType::COMMA));
+    }
+    consume(closing, message);
+    return list;
+}
+
 // Token helpers
 
 bool Parser::match(TokenType type) {
@@ -260,6 +564,11 @@ bool Parser::check(TokenType type) {
     return peek().type == type;
 }
 
+bool Parser::checkNext(TokenType type) {
+    if (isAtEnd() || static_cast<size_t>(current + 1) >= tokens.size()) return false;
+    return tokens[current + 1].type == type;
+}
+
 Token Parser::advance() {
     if (!isAtEnd()) current++;
     return previous();
@@ -0,0 +1,208 @@
+#include "../../include/arith.h"
+#include "../../include/eventloop.h"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+bool isNumeric(const Value& value) {
+    return std::holds_alternative<double>(value) || std::holds_alternative<int64_t>(value);
+}
+
+// Mixed comparisons go through long double, whose 64-bit mantissa holds
+// every int exactly on x86-64.
+long double wideOf(const Value& value) {
+    if (std::holds_alternative<int64_t>(value)) return std::get<int64_t>(value);
+    return std::get<double>(value);
+}
+
+bool isBitwise(OpCode op) {
+    return op == OpCode::BIT_AND || op == OpCode::BIT_OR || op == OpCode::BIT_XOR ||
+           op == OpCode::SHIFT_LEFT || op == OpCode::SHIFT_RIGHT;
+}
+
+double doubleOf(const Value& value) {
+    if (std::holds_alternative<int64_t>(value)) {
+        return static_cast<double>(std::get<int64_t>(value));
+    }
+    return std::get<double>(value);
+}
+
+const char* intBinary(OpCode op, int64_t a, int64_t b, Value& result) {
+    switch (op) {
+        case OpCode::ADD:
+            return addInts(a, b, result);
+        case OpCode::SUBTRACT:
+            return subtractInts(a, b, result);
+        case OpCode::MULTIPLY:
+            return multiplyInts(a, b, result);
+        case OpCode::DIVIDE:
+            if (b == 0) return "Division by zero.";
+            result = static_cast<double>(a) / static_cast<double>(b);
+            return nullptr;
+        case OpCode::FLOOR_DIVIDE: {
+            if (b == 0) return "Division by zero.";
+            if (a == INT64_MIN && b == -1) return "Integer overflow.";
+            int64_t quotient = a / b;
+            if (a % b != 0 && (a < 0) != (b < 0)) quotient--;
+            result = quotient;
+            return nullptr;
+        }
+        case OpCode::MODULO: {
+            if (b == 0) return "Division by zero.";
+            if (b == -1) {
+                result = int64_t(0);  // INT64_MIN % -1 traps in hardware
+                return nullptr;
+            }
+            int64_t remainder = a % b;
+            if (remainder != 0 && (remainder < 0) != (b < 0)) remainder += b;
+            result = remainder;
+            return nullptr;
+        }
+        case OpCode::GREATER:
+            result = a > b;
+            return nullptr;
+        case OpCode::LESS:
+            result = a < b;
+            return nullptr;
+        case OpCode::LESS_EQUAL:
+            result = a <= b;
+            return nullptr;
+        case OpCode::GREATER_EQUAL:
+            result = a >= b;
+            return nullptr;
+        case OpCode::BIT_AND:
+            result = a & b;
+            return nullptr;
+        case OpCode::BIT_OR:
+            result = a | b;
+            return nullptr;
+        case OpCode::BIT_XOR:
+            result = a ^ b;
+            return nullptr;
+        case OpCode::SHIFT_LEFT:
+            if (b < 0 || b > 63) return "Shift count out of range.";
+            // Bits shifted out are dropped, as in every C-family language.
+            result = static_cast<int64_t>(static_cast<uint64_t>(a) << b);
+            return nullptr;
+        case OpCode::SHIFT_RIGHT:
+            if (b < 0 || b > 63) return "Shift count out of range.";
+            result = a >> b;  // Arithmetic: keeps the sign
+            return nullptr;
+        default:
+            return "Unsupported operator.";
+    }
+}
+
+const char* doubleBinary(OpCode op, const Value& left, const Value& right, Value& result) {
+    double a = doubleOf(left);
+    double b = doubleOf(right);
+    switch (op) {
+        case OpCode::ADD:
+            result = a + b;
+            return nullptr;
+        case OpCode::SUBTRACT:
+            result = a - b;
+            return nullptr;
+        case OpCode::MULTIPLY:
+            result = a * b;
+            return nullptr;
+        case OpCode::DIVIDE:
+            if (b == 0) return "Division by zero.";
+            result = a / b;
+            return nullptr;
+        case OpCode::FLOOR_DIVIDE:
+            if (b == 0) return "Division by zero.";
+            result = std::floor(a / b);
+            return nullptr;
+        case OpCode::MODULO: {
+            if (b == 0) return "Division by zero.";
+            double remainder = std::fmod(a, b);
+            if (remainder != 0 && (remainder < 0) != (b < 0)) remainder += b;
+            result = remainder;
+            return nullptr;
+        }
+        case OpCode::GREATER:
+            result = wideOf(left) > wideOf(right);
+            return nullptr;
+        case OpCode::LESS:
+            result = wideOf(left) < wideOf(right);
+            return nullptr;
+        case OpCode::LESS_EQUAL:
+            result = !(wideOf(left) > wideOf(right));
+            return nullptr;
+        case OpCode::GREATER_EQUAL:
+            result = !(wideOf(left) < wideOf(right));
+            return nullptr;
+        default:
+            return "Unsupported operator.";
+    }
+}
+    
+} // namespace
+
+const char* numericBinary(OpCode op, const Value& a, const Value& b, Value& result) {
+    bool ints = std::holds_alternative<int64_t>(a) && std::holds_alternative<int64_t>(b);
+    if (isBitwise(op) && !ints) return "Operands must be integers.";
+    if (!isNumeric(a) || !isNumeric(b)) {
+        return op == OpCode::ADD ? "Operands must be two numbers or two strings."
+                                 : "Operands must be numbers.";
+    }
+    
+    if (ints) {
+        return intBinary(op, std::get<int64_t>(a), std::get<int64_t>(b), result);
+    }
+    return doubleBinary(op, a, b, result);
+}
+
+const char* numericUnary(OpCode op, const Value& a, Value& result) {
+    if (op == OpCode::BIT_NOT) {
+        if (!std::holds_alternative<int64_t>(a)) return "Operand must be an integer.";
+        result = ~std::get<int64_t>(a);
+        return nullptr;
+    }
+    
+    if (std::holds_alternative<int64_t>(a)) return negateInt(std::get<int64_t>(a), result);
+    if (std::holds_alternative<double>(a)) {
+        result = -std::get<double>(a);
+        return nullptr;
+    }
+    return "Operand must be a number.";
+}
+
+const char* branchCondition(OpCode op, const Value& a, const Value& b, bool& holds) {
+    if (op == OpCode::EQUAL_JUMP || op == OpCode::NOT_EQUAL_JUMP) {
+        holds = valuesEqual(a, b) == (op == OpCode::EQUAL_JUMP);
+        return nullptr;
+    }
+    
+    if (isArrayValue(a) || isArrayValue(b)) {
+        return "Array comparisons give an array of bools; test it with all() or any().";
+    }
+    
+    bool less = op == OpCode::LESS_JUMP || op == OpCode::GREATER_EQUAL_JUMP;
+    Value result;
+    if (const char* message = numericBinary(less ? OpCode::LESS : OpCode::GREATER, a, b, result)) {
+        return message;
+    }
+    bool value = std::get<bool>(result);
+    holds = op == OpCode::LESS_JUMP || op == OpCode::GREATER_JUMP ? value : !value;
+    return nullptr;
+}
+
+const char* awaitDelay(const Value& operand, int64_t& milliseconds) {
+    if (std::holds_alternative<int64_t>(operand)) {
+        milliseconds = std::get<int64_t>(operand);
+        if (milliseconds < 0) return "Cannot await a negative number of milliseconds.";
+        milliseconds = std::min(milliseconds, EventLoop::kMaxDelayMs);
+        return nullptr;
+    }
+    
+    // Compared before converting: the cast is undefined outside int64_t.
+    double delay = std::get<double>(operand);
+    if (std::isnan(delay)) return "Cannot await NaN milliseconds.";
+    if (delay < 0) return "Cannot await a negative number of milliseconds.";
+    milliseconds = delay >= static_cast<double>(EventLoop::kMaxDelayMs)
+        ? EventLoop::kMaxDelayMs : static_cast<int64_t>(delay);
+    return nullptr;
+}
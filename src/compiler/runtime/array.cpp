@@ -0,0 +1,357 @@
+#include "../../include/array.h"
+#include "../../include/arith.h"
+#include "../../include/dict.h"
+#include "../../include/kernels.h"
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+ObjArray* asArray(const Value& value) {
+    return static_cast<ObjArray*>(std::get<Obj*>(value));
+}
+
+const char* storageName(ArrayStorage storage) {
+    switch (storage) {
+        case ArrayStorage::NUMBERS: return "number";
+        case ArrayStorage::INTS: return "int";
+        case ArrayStorage::BOOLS: return "bool";
+        case ArrayStorage::VALUES: return "value";
+    }
+    return "value";
+}
+
+const char* kindName(const Value& value) {
+    if (std::holds_alternative<double>(value)) return "number";
+    if (std::holds_alternative<int64_t>(value)) return "int";
+    if (std::holds_alternative<bool>(value)) return "bool";
+    if (std::holds_alternative<std::nullptr_t>(value)) return "null";
+    if (isStringValue(value)) return "string";
+    if (isArrayValue(value)) return "array";
+    if (isDictValue(value)) return "dict";
+    return "object";
+}
+
+// Packed when every value allows it; ints mixed with numbers are widened.
+ArrayStorage storageFor(const Value* values, size_t count) {
+    bool ints = true;
+    bool numbers = true;
+    bool bools = true;
+    for (size_t i = 0; i < count; i++) {
+        bool isInt = std::holds_alternative<int64_t>(values[i]);
+        ints = ints && isInt;
+        numbers = numbers && (isInt || std::holds_alternative<double>(values[i]));
+        bools = bools && std::holds_alternative<bool>(values[i]);
+    }
+    
+    if (count == 0 || (numbers && !ints)) return ArrayStorage::NUMBERS;
+    if (ints) return ArrayStorage::INTS;
+    if (bools) return ArrayStorage::BOOLS;
+    return ArrayStorage::VALUES;
+}
+
+// Storage of an array operand, or the packed storage a scalar matches.
+ArrayStorage operandStorage(const Value& value) {
+    if (isArrayValue(value)) return asArray(value)->storage;
+    if (std::holds_alternative<double>(value)) return ArrayStorage::NUMBERS;
+    if (std::holds_alternative<int64_t>(value)) return ArrayStorage::INTS;
+    return ArrayStorage::VALUES;
+}
+
+bool accepts(ArrayStorage storage, const Value& value) {
+    switch (storage) {
+        case ArrayStorage::NUMBERS:
+            return std::holds_alternative<double>(value) || std::holds_alternative<int64_t>(value);
+        case ArrayStorage::INTS: return std::holds_alternative<int64_t>(value);
+        case ArrayStorage::BOOLS: return std::holds_alternative<bool>(value);
+        case ArrayStorage::VALUES: return true;
+    }
+    return false;
+}
+
+// value must be accepted by the array's storage.
+void putElement(Heap& heap, ObjArray* array, size_t i, const Value& value) {
+    switch (array->storage) {
+        case ArrayStorage::NUMBERS:
+            array->numbers()[i] = std::holds_alternative<int64_t>(value)
+                ? static_cast<double>(std::get<int64_t>(value))
+                : std::get<double>(value);
+            break;
+        case ArrayStorage::INTS:
+            array->ints()[i] = std::get<int64_t>(value);
+            break;
+        case ArrayStorage::BOOLS:
+            array->bools()[i] = std::get<bool>(value);
+            break;
+        case ArrayStorage::VALUES:
+            heap.storeValue(array, &arrayValues(array)[i], value);
+            break;
+    }
+}
+
+// Elements of a kernel operand: an array's, or a scalar repeated with
+// step 0. Taken only once the result is allocated, since a collection
+// moves arrays.
+struct Operand {
+    const double* numbers = nullptr;
+    const int64_t* ints = nullptr;
+    size_t step = 1;
+    double number = 0;
+    int64_t integer = 0;
+    std::vector<double> widened;
+};
+
+void viewNumbers(const Value& value, Operand& operand) {
+    if (isArrayValue(value)) {
+        operand.numbers = arrayNumbers(asArray(value), operand.widened);
+        return;
+    }
+    operand.number = std::holds_alternative<int64_t>(value)
+        ? static_cast<double>(std::get<int64_t>(value))
+        : std::get<double>(value);
+    operand.numbers = &operand.number;
+    operand.step = 0;
+}
+
+void viewInts(const Value& value, Operand& operand) {
+    if (isArrayValue(value)) {
+        operand.ints = asArray(value)->ints();
+        return;
+    }
+    operand.integer = std::get<int64_t>(value);
+    operand.ints = &operand.integer;
+    operand.step = 0;
+}
+
+// Whether the ints of an operand are all exact doubles, so comparing them
+// with numbers in double gives what long double would (see arith.h).
+bool exactAsDoubles(const Value& value) {
+    constexpr int64_t limit = int64_t(1) << 53;
+    auto exact = [](int64_t x) { return x >= -limit && x <= limit; };
+    if (std::holds_alternative<int64_t>(value)) return exact(std::get<int64_t>(value));
+    if (!isArrayValue(value) || asArray(value)->storage != ArrayStorage::INTS) return true;
+    
+    const ObjArray* array = asArray(value);
+    return std::all_of(array->ints(), array->ints() + array->length, exact);
+}
+
+// Operators without a kernel, and boxed or bool storage: one element at a
+// time with the scalar rules. The results are never objects, so they need
+// no rooting while the array is built.
+const char* elementWise(Heap& heap, OpCode op, Value& a, const Value& b, size_t length) {
+    std::vector<Value> results(length);
+    for (size_t i = 0; i < length; i++) {
+        Value x = isArrayValue(a) ? arrayElement(asArray(a), i) : a;
+        Value y = isArrayValue(b) ? arrayElement(asArray(b), i) : b;
+        if (const char* message = numericBinary(op, x, y, results[i])) return message;
+    }
+    return buildArray(heap, results.data(), length, a);
+}
+    
+} // namespace
+
+const char* buildArray(Heap& heap, Value* elements, size_t count, Value& result) {
+    ArrayStorage storage = storageFor(elements, count);
+    if (count > maxArrayLength(storage)) return "Array too large.";
+    
+    ObjArray* array = heap.allocateArray(storage, count);
+    for (size_t i = 0; i < count; i++) {
+        putElement(heap, array, i, elements[i]);
+    }
+    result = static_cast<Obj*>(array);
+    return nullptr;
+}
+
+const char* fillArray(Heap& heap, size_t length, const Value& fill, Value& result) {
+    ArrayStorage storage = storageFor(&fill, 1);
+    if (length > maxArrayLength(storage)) return "Array too large.";
+    
+    ObjArray* array = heap.allocateArray(storage, length);
+    switch (storage) {
+        case ArrayStorage::NUMBERS:
+            std::fill_n(array->numbers(), length, std::get<double>(fill));
+            break;
+        case ArrayStorage::INTS:
+            std::fill_n(array->ints(), length, std::get<int64_t>(fill));
+            break;
+        case ArrayStorage::BOOLS:
+            std::memset(array->bools(), std::get<bool>(fill), length);
+            break;
+        case ArrayStorage::VALUES:
+            for (size_t i = 0; i < length; i++) putElement(heap, array, i, fill);
+            break;
+    }
+    result = static_cast<Obj*>(array);
+    return nullptr;
+}
+
+const char* getIndex(const Value& array, const Value& index, Value& result) {
+    if (isDictValue(array)) return dictGet(static_cast<ObjDict*>(std::get<Obj*>(array)), index, result);
+    if (!isArrayValue(array)) return "Only arrays and dicts can be indexed.";
+    if (!std::holds_alternative<int64_t>(index)) return "Array index must be an int.";
+    
+    const ObjArray* elements = asArray(array);
+    int64_t i = std::get<int64_t>(index);
+    if (i < 0 || i >= elements->length) return "Array index out of range.";
+    result = arrayElement(elements, static_cast<size_t>(i));
+    return nullptr;
+}
+
+const char* setIndex(Heap& heap, const Value& array, const Value& index, const Value& value) {
+    if (isDictValue(array)) return dictSet(heap, array, index, value);
+    if (!isArrayValue(array)) return "Only arrays and dicts can be indexed.";
+    if (!std::holds_alternative<int64_t>(index)) return "Array index must be an int.";
+    
+    ObjArray* elements = asArray(array);
+    int64_t i = std::get<int64_t>(index);
+    if (i < 0 || i >= elements->length) return "Array index out of range.";
+    if (!accepts(elements->storage, value)) {
+        // The storage is fixed at creation (see ObjArray).
+        static thread_local std::string message;
+        message = std::string("Cannot store a ") + kindName(value) + " in " +
+                  (elements->storage == ArrayStorage::INTS ? "an " : "a ") +
+                  storageName(elements->storage) + " array.";
+        return message.c_str();
+    }
+    putElement(heap, elements, static_cast<size_t>(i), value);
+    return nullptr;
+}
+
+const char* arrayBinary(Heap& heap, OpCode op, Value& a, const Value& b) {
+    if (isArrayValue(a) && isArrayValue(b) && asArray(a)->length != asArray(b)->length) {
+        return "Array lengths differ.";
+    }
+    size_t length = isArrayValue(a) ? asArray(a)->length : asArray(b)->length;
+    
+    Kernel kernel = Kernel::ADD;
+    Compare compare = Compare::LESS;
+    bool comparison = false;
+    bool hasKernel = true;
+    switch (op) {
+        case OpCode::ADD: kernel = Kernel::ADD; break;
+        case OpCode::SUBTRACT: kernel = Kernel::SUBTRACT; break;
+        case OpCode::MULTIPLY: kernel = Kernel::MULTIPLY; break;
+        case OpCode::DIVIDE: kernel = Kernel::DIVIDE; break;
+        case OpCode::LESS: compare = Compare::LESS; comparison = true; break;
+        case OpCode::GREATER: compare = Compare::GREATER; comparison = true; break;
+        case OpCode::LESS_EQUAL: compare = Compare::LESS_EQUAL; comparison = true; break;
+        case OpCode::GREATER_EQUAL: compare = Compare::GREATER_EQUAL; comparison = true; break;
+        default: hasKernel = false; break;
+    }
+    
+    ArrayStorage left = operandStorage(a);
+    ArrayStorage right = operandStorage(b);
+    auto packed = [](ArrayStorage storage) {
+        return storage == ArrayStorage::NUMBERS || storage == ArrayStorage::INTS;
+    };
+    bool ints = left == ArrayStorage::INTS && right == ArrayStorage::INTS;
+    if (comparison && !ints && !(exactAsDoubles(a) && exactAsDoubles(b))) hasKernel = false;
+    if (!hasKernel || !packed(left) || !packed(right)) return elementWise(heap, op, a, b, length);
+    
+    // '/' always divides in double.
+    ArrayStorage storage = comparison ? ArrayStorage::BOOLS
+                         : ints && op != OpCode::DIVIDE ? ArrayStorage::INTS
+                         : ArrayStorage::NUMBERS;
+    ObjArray* result = heap.allocateArray(storage, length);
+    
+    Operand x;
+    Operand y;
+    if (ints && op != OpCode::DIVIDE) {
+        viewInts(a, x);
+        viewInts(b, y);
+        if (comparison) {
+            compareInts(compare, x.ints, x.step, y.ints, y.step, result->bools(), length);
+        } else if (!binaryInts(kernel, x.ints, x.step, y.ints, y.step, result->ints(), length)) {
+            return "Integer overflow.";
+        }
+    } else {
+        viewNumbers(a, x);
+        viewNumbers(b, y);
+        if (comparison) {
+            compareDoubles(compare, x.numbers, x.step, y.numbers, y.step, result->bools(), length);
+        } else {
+            if (op == OpCode::DIVIDE && containsZero(y.numbers, y.step != 0 ? length : std::min<size_t>(length, 1))) {
+                return "Division by zero.";
+            }
+            binaryDoubles(kernel, x.numbers, x.step, y.numbers, y.step, result->numbers(), length);
+        }
+    }
+    
+    a = static_cast<Obj*>(result);
+    return nullptr;
+}
+
+const char* arrayUnary(Heap& heap, OpCode op, Value& a) {
+    size_t length = asArray(a)->length;
+    ArrayStorage storage = asArray(a)->storage;
+    
+    if (op == OpCode::NEGATE && storage == ArrayStorage::NUMBERS) {
+        ObjArray* result = heap.allocateArray(storage, length);
+        negateDoubles(asArray(a)->numbers(), result->numbers(), length);
+        a = static_cast<Obj*>(result);
+        return nullptr;
+    }
+    
+    if (storage == ArrayStorage::INTS) {
+        ObjArray* result = heap.allocateArray(storage, length);
+        const int64_t* source = asArray(a)->ints();
+        int64_t* target = result->ints();
+        for (size_t i = 0; i < length; i++) {
+            if (op == OpCode::BIT_NOT) {
+                target[i] = ~source[i];
+            } else if (source[i] == INT64_MIN) {
+                return "Integer overflow.";
+            } else {
+                target[i] = -source[i];
+            }
+        }
+        a = static_cast<Obj*>(result);
+        return nullptr;
+    }
+    
+    std::vector<Value> results(length);
+    for (size_t i = 0; i < length; i++) {
+        if (const char* message = numericUnary(op, arrayElement(asArray(a), i), results[i])) {
+            return message;
+        }
+    }
+    return buildArray(heap, results.data(), length, a);
+}
+
+Value arrayElement(const ObjArray* array, size_t i) {
+    switch (array->storage) {
+        case ArrayStorage::NUMBERS: return array->numbers()[i];
+        case ArrayStorage::INTS: return array->ints()[i];
+        case ArrayStorage::BOOLS: return array->bools()[i] != 0;
+        case ArrayStorage::VALUES: return arrayValues(array)[i];
+    }
+    return nullptr;
+}
+
+const double* arrayNumbers(const ObjArray* array, std::vector<double>& scratch) {
+    if (array->storage == ArrayStorage::NUMBERS) return array->numbers();
+    scratch.assign(array->ints(), array->ints() + array->length);
+    return scratch.data();
+}
+
+bool arraysEqual(const ObjArray* a, const ObjArray* b) {
+    if (a == b) return true;
+    if (a->length != b->length) return false;
+    
+    if (a->storage == b->storage) {
+        switch (a->storage) {
+            case ArrayStorage::NUMBERS:
+                return equalDoubles(a->numbers(), b->numbers(), a->length);
+            case ArrayStorage::INTS:
+            case ArrayStorage::BOOLS:
+                return std::memcmp(a + 1, b + 1, a->length * arrayElementSize(a->storage)) == 0;
+            case ArrayStorage::VALUES:
+                break;
+        }
+    }
+    
+    for (uint32_t i = 0; i < a->length; i++) {
+        if (!valuesEqual(arrayElement(a, i), arrayElement(b, i))) return false;
+    }
+    return true;
+}
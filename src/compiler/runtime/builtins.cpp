@@ -0,0 +1,257 @@
+#include "../../include/builtins.h"
+#include "../../include/arith.h"
+#include "../../include/array.h"
+#include "../../include/dict.h"
+#include "../../include/kernels.h"
+
+namespace {
+
+struct BuiltinInfo {
+    const char* name;
+    int minArity;
+    int maxArity;
+};
+
+// Indexed by Builtin
+const BuiltinInfo kBuiltins[] = {
+    {"len", 1, 1},
+    {"array", 1, 2},
+    {"sum", 1, 1},
+    {"min", 1, 1},
+    {"max", 1, 1},
+    {"dot", 2, 2},
+    {"all", 1, 1},
+    {"any", 1, 1},
+    {"keys", 1, 1},
+    {"values", 1, 1},
+    {"has", 2, 2},
+    {"get", 2, 3},
+    {"remove", 2, 2},
+};
+
+ObjArray* asArray(const Value& value) {
+    return static_cast<ObjArray*>(std::get<Obj*>(value));
+}
+
+bool isPacked(const ObjArray* array) {
+    return array->storage == ArrayStorage::NUMBERS || array->storage == ArrayStorage::INTS;
+}
+
+const char* sum(const ObjArray* array, Value& result) {
+    switch (array->storage) {
+        case ArrayStorage::NUMBERS:
+            result = sumDoubles(array->numbers(), array->length);
+            return nullptr;
+        case ArrayStorage::INTS: {
+            int64_t total;
+            if (!sumInts(array->ints(), array->length, total)) return "Integer overflow.";
+            result = total;
+            return nullptr;
+        }
+        case ArrayStorage::BOOLS:
+            result = static_cast<int64_t>(countBools(array->bools(), array->length));
+            return nullptr;
+        case ArrayStorage::VALUES:
+            break;
+    }
+    
+    Value total = int64_t(0);
+    for (uint32_t i = 0; i < array->length; i++) {
+        if (const char* message = numericBinary(OpCode::ADD, total, arrayElement(array, i), total)) {
+            return message;
+        }
+    }
+    result = total;
+    return nullptr;
+}
+
+const char* extreme(const ObjArray* array, bool largest, Value& result) {
+    if (array->length == 0) return largest ? "max() of an empty array." : "min() of an empty array.";
+    
+    if (array->storage == ArrayStorage::NUMBERS) {
+        result = extremeDoubles(array->numbers(), array->length, largest);
+        return nullptr;
+    }
+    if (array->storage == ArrayStorage::INTS) {
+        result = extremeInts(array->ints(), array->length, largest);
+        return nullptr;
+    }
+    
+    Value best = arrayElement(array, 0);
+    for (uint32_t i = 1; i < array->length; i++) {
+        Value element = arrayElement(array, i);
+        Value better;
+        OpCode op = largest ? OpCode::GREATER : OpCode::LESS;
+        if (const char* message = numericBinary(op, element, best, better)) return message;
+        if (std::get<bool>(better)) best = element;
+    }
+    result = best;
+    return nullptr;
+}
+
+const char* dot(const ObjArray* a, const ObjArray* b, Value& result) {
+    if (a->length != b->length) return "Array lengths differ.";
+    
+    if (a->storage == ArrayStorage::INTS && b->storage == ArrayStorage::INTS) {
+        int64_t total;
+        if (!dotInts(a->ints(), b->ints(), a->length, total)) return "Integer overflow.";
+        result = total;
+        return nullptr;
+    }
+    if (isPacked(a) && isPacked(b)) {
+        std::vector<double> left;
+        std::vector<double> right;
+        result = dotDoubles(arrayNumbers(a, left), arrayNumbers(b, right), a->length);
+        return nullptr;
+    }
+    
+    Value total = int64_t(0);
+    for (uint32_t i = 0; i < a->length; i++) {
+        Value product;
+        if (const char* message = numericBinary(OpCode::MULTIPLY, arrayElement(a, i),
+                                                arrayElement(b, i), product)) {
+            return message;
+        }
+        if (const char* message = numericBinary(OpCode::ADD, total, product, total)) return message;
+    }
+    result = total;
+    return nullptr;
+}
+
+// all() when every is set, else any()
+bool truthful(const ObjArray* array, bool every) {
+    if (array->storage == ArrayStorage::BOOLS) {
+        size_t count = countBools(array->bools(), array->length);
+        return every ? count == array->length : count > 0;
+    }
+    // Numbers and ints are always truthy.
+    if (isPacked(array)) return every || array->length > 0;
+    
+    for (uint32_t i = 0; i < array->length; i++) {
+        if (isTruthy(arrayValues(array)[i]) != every) return !every;
+    }
+    return every;
+}
+
+// keys() and values()
+const char* entries(Heap& heap, const ObjDict* dict, bool keys, Value& result) {
+    // Rooted: building the array allocates.
+    std::vector<Value> items(dict->count);
+    for (uint32_t i = 0; i < dict->count; i++) {
+        items[i] = keys ? dictKey(dict, i) : dictValue(dict, i);
+    }
+    heap.addRoots(&items);
+    const char* message = buildArray(heap, items.data(), items.size(), result);
+    heap.removeRoots(&items);
+    return message;
+}
+
+const char* dictBuiltin(Heap& heap, Builtin builtin, Value* args, int argc, Value& result) {
+    if (!isDictValue(args[0])) {
+        static thread_local std::string message;
+        message = std::string(builtinName(builtin)) + "() takes a dict.";
+        return message.c_str();
+    }
+    
+    auto* dict = static_cast<ObjDict*>(std::get<Obj*>(args[0]));
+    bool found;
+    switch (builtin) {
+        case Builtin::KEYS: return entries(heap, dict, true, result);
+        case Builtin::VALUES: return entries(heap, dict, false, result);
+        case Builtin::HAS: {
+            Value value;
+            if (const char* message = dictFind(dict, args[1], found, value)) return message;
+            result = found;
+            return nullptr;
+        }
+        case Builtin::GET: {
+            Value value = argc > 2 ? args[2] : Value(nullptr);
+            if (const char* message = dictFind(dict, args[1], found, value)) return message;
+            result = value;
+            return nullptr;
+        }
+        case Builtin::REMOVE:
+            if (const char* message = dictRemove(heap, dict, args[1], found)) return message;
+            result = found;
+            return nullptr;
+        default:
+            return "Unknown builtin.";
+    }
+}
+    
+} // namespace
+
+bool findBuiltin(const std::string& name, Builtin& builtin, int& minArity, int& maxArity) {
+    for (size_t i = 0; i < sizeof(kBuiltins) / sizeof(kBuiltins[0]); i++) {
+        if (name == kBuiltins[i].name) {
+            builtin = static_cast<Builtin>(i);
+            minArity = kBuiltins[i].minArity;
+            maxArity = kBuiltins[i].maxArity;
+            return true;
+        }
+    }
+    return false;
+}
+
+const char* builtinName(Builtin builtin) {
+    return kBuiltins[static_cast<size_t>(builtin)].name;
+}
+
+bool builtinArity(uint8_t id, int& minArity, int& maxArity) {
+    if (id >= sizeof(kBuiltins) / sizeof(kBuiltins[0])) return false;
+    minArity = kBuiltins[id].minArity;
+    maxArity = kBuiltins[id].maxArity;
+    return true;
+}
+
+const char* callBuiltin(Heap& heap, Builtin builtin, Value* args, int argc, Value& result) {
+    if (builtin == Builtin::LEN) {
+        if (isArrayValue(args[0])) {
+            result = static_cast<int64_t>(asArray(args[0])->length);
+        } else if (isStringValue(args[0])) {
+            result = static_cast<int64_t>(static_cast<ObjString*>(std::get<Obj*>(args[0]))->length);
+        } else if (isDictValue(args[0])) {
+            result = static_cast<int64_t>(static_cast<ObjDict*>(std::get<Obj*>(args[0]))->count);
+        } else {
+            return "len() takes an array, a string or a dict.";
+        }
+        return nullptr;
+    }
+    
+    if (builtin == Builtin::ARRAY) {
+        if (!std::holds_alternative<int64_t>(args[0]) || std::get<int64_t>(args[0]) < 0) {
+            return "array() length must be a non-negative int.";
+        }
+        size_t length = static_cast<size_t>(std::get<int64_t>(args[0]));
+        // args[1] itself, not a copy: the fill may move during allocation.
+        if (argc > 1) return fillArray(heap, length, args[1], result);
+        return fillArray(heap, length, 0.0, result);
+    }
+    
+    if (builtin >= Builtin::KEYS) return dictBuiltin(heap, builtin, args, argc, result);
+    
+    for (int i = 0; i < argc; i++) {
+        if (!isArrayValue(args[i])) {
+            static thread_local std::string message;
+            message = std::string(builtinName(builtin)) + "() takes " +
+                      (argc > 1 ? "arrays." : "an array.");
+            return message.c_str();
+        }
+    }
+    
+    const ObjArray* array = asArray(args[0]);
+    switch (builtin) {
+        case Builtin::SUM: return sum(array, result);
+        case Builtin::MIN: return extreme(array, false, result);
+        case Builtin::MAX: return extreme(array, true, result);
+        case Builtin::DOT: return dot(array, asArray(args[1]), result);
+        case Builtin::ALL:
+            result = truthful(array, true);
+            return nullptr;
+        case Builtin::ANY:
+            result = truthful(array, false);
+            return nullptr;
+        default:
+            return "Unknown builtin.";
+    }
+}
@@ -0,0 +1,300 @@
+#include "../../include/dict.h"
+#include <cmath>
+#include <cstring>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#include <emmintrin.h>
+#define DICT_SSE2
+#endif
+
+namespace {
+
+constexpr uint8_t kHashBits = 0x7f;  // Hash bits kept in a control byte
+constexpr size_t kMaxLoad = 8;       // A table fills capacity = slots * 7/8
+
+ObjDict* asDict(const Value& value) {
+    return static_cast<ObjDict*>(std::get<Obj*>(value));
+}
+
+ObjDictTable* tableOf(const ObjDict* dict) {
+    return static_cast<ObjDictTable*>(dict->table);
+}
+
+uint32_t mix(uint64_t x) {
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdull;
+    x ^= x >> 33;
+    x *= 0xc4ceb9fe1a85ec53ull;
+    x ^= x >> 33;
+    return static_cast<uint32_t>(x);
+}
+
+// Hash of a valid key, or the error message for an invalid one. Keys that
+// valuesEqual() matches hash alike: a double with an int value hashes as
+// that int.
+const char* hashKey(const Value& key, uint32_t& hash) {
+    if (const int64_t* i = std::get_if<int64_t>(&key)) {
+        hash = mix(static_cast<uint64_t>(*i));
+    } else if (const double* d = std::get_if<double>(&key)) {
+        if (std::isnan(*d)) return "Dict key cannot be NaN.";
+        if (*d >= -0x1p63 && *d < 0x1p63 && std::trunc(*d) == *d) {
+            hash = mix(static_cast<uint64_t>(static_cast<int64_t>(*d)));
+        } else {
+            uint64_t bits;
+            std::memcpy(&bits, d, sizeof(bits));
+            hash = mix(bits);
+        }
+    } else if (const bool* b = std::get_if<bool>(&key)) {
+        hash = mix(*b ? 0x74727565 : 0x66616c73);
+    } else if (std::holds_alternative<std::nullptr_t>(key)) {
+        hash = mix(0x6e756c6c);
+    } else if (isStringValue(key)) {
+        // Shared strings are hashed when shared, so only private ones are
+        // written here.
+        auto* string = static_cast<ObjString*>(std::get<Obj*>(key));
+        if (string->hash == 0) string->hash = hashChars(string->chars(), string->length);
+        hash = string->hash;
+    } else {
+        return "Dict keys must be strings, numbers, ints, bools or null.";
+    }
+    return nullptr;
+}
+
+// First slot of a hash's probe run. Multiplying spreads every hash bit
+// into the top ones, which pick the slot.
+size_t homeSlot(uint32_t hash, uint32_t slots) {
+    return (static_cast<uint64_t>(hash) * 0x9e3779b97f4a7c15ull) >> (64 - __builtin_ctz(slots));
+}
+
+// Bit i set for each of the group's control bytes that equals h, and for
+// each free slot.
+struct GroupMatch {
+    uint32_t matches;
+    uint32_t empties;
+};
+
+GroupMatch matchGroup(const uint8_t* control, uint8_t h) {
+    #ifdef DICT_SSE2
+    __m128i group = _mm_loadu_si128(reinterpret_cast<const __m128i*>(control));
+    __m128i hashes = _mm_set1_epi8(static_cast<char>(h));
+    // kDictEmpty is the only control byte with the top bit set.
+    return {static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(group, hashes))),
+            static_cast<uint32_t>(_mm_movemask_epi8(group))};
+    #else
+    GroupMatch result{0, 0};
+    for (size_t i = 0; i < kDictGroupWidth; i++) {
+        if (control[i] == h) result.matches |= 1u << i;
+        if (control[i] == kDictEmpty) result.empties |= 1u << i;
+    }
+    return result;
+    #endif
+}
+
+// Slot holding key, or the free slot ending its probe run (found false).
+size_t findSlot(const ObjDictTable* table, const Value& key, uint32_t hash, bool& found) {
+    size_t mask = table->slots - 1;
+    const uint8_t* control = table->control();
+    const uint32_t* slotEntries = table->slotEntries();
+    const uint32_t* hashes = table->hashes();
+    const Value* values = dictTableValues(table);
+    
+    for (size_t group = homeSlot(hash, table->slots);; group = (group + kDictGroupWidth) & mask) {
+        GroupMatch match = matchGroup(control + group, hash & kHashBits);
+        // The probe run ends at the first free slot; later matches belong
+        // to other runs.
+        uint32_t run = match.empties != 0 ? (match.empties & (0u - match.empties)) - 1 : 0xffffu;
+        for (uint32_t bits = match.matches & run; bits != 0; bits &= bits - 1) {
+            size_t slot = (group + __builtin_ctz(bits)) & mask;
+            uint32_t entry = slotEntries[slot];
+            if (hashes[entry] == hash && valuesEqual(values[2 * entry], key)) {
+                found = true;
+                return slot;
+            }
+        }
+        if (match.empties != 0) {
+            found = false;
+            return (group + __builtin_ctz(match.empties)) & mask;
+        }
+    }
+}
+
+// First free slot of a hash's probe run, for a key that is not there.
+size_t freeSlot(const ObjDictTable* table, uint32_t hash) {
+    size_t mask = table->slots - 1;
+    for (size_t group = homeSlot(hash, table->slots);; group = (group + kDictGroupWidth) & mask) {
+        uint32_t empties = matchGroup(table->control() + group, kDictEmpty).empties;
+        if (empties != 0) return (group + __builtin_ctz(empties)) & mask;
+    }
+}
+
+void setControl(ObjDictTable* table, size_t slot, uint8_t byte) {
+    uint8_t* control = table->control();
+    control[slot] = byte;
+    if (slot < kDictGroupWidth) control[table->slots + slot] = byte;
+}
+
+void occupy(ObjDictTable* table, size_t slot, uint32_t hash, uint32_t entry) {
+    setControl(table, slot, hash & kHashBits);
+    table->slotEntries()[slot] = entry;
+}
+
+// Move the entries into a table with twice the slots, or the first table.
+const char* grow(Heap& heap, const Value& dictValue) {
+    const ObjDict* dict = asDict(dictValue);
+    size_t slots = dict->table != nullptr ? 2 * size_t(tableOf(dict)->slots) : kDictGroupWidth;
+    size_t capacity = slots / kMaxLoad * (kMaxLoad - 1);
+    if (dictTableAllocationSize(capacity, slots) > UINT32_MAX - kObjAlignment) return "Dict too large.";
+    
+    ObjDictTable* table = heap.allocateDictTable(capacity, slots);
+    ObjDict* owner = asDict(dictValue);
+    if (const ObjDictTable* old = tableOf(owner)) {
+        const Value* from = dictTableValues(old);
+        Value* to = dictTableValues(table);
+        for (uint32_t i = 0; i < 2 * owner->count; i++) {
+            heap.storeValue(table, &to[i], from[i]);
+        }
+        std::memcpy(table->hashes(), old->hashes(), owner->count * sizeof(uint32_t));
+        for (uint32_t i = 0; i < owner->count; i++) {
+            uint32_t hash = table->hashes()[i];
+            occupy(table, freeSlot(table, hash), hash, i);
+        }
+    }
+    heap.storeField(owner, &owner->table, table);
+    return nullptr;
+}
+    
+} // namespace
+
+const char* buildDict(Heap& heap, Value* pairs, size_t count, Value& result) {
+    // The dict is not on the stack yet; keep it rooted while it grows.
+    std::vector<Value> dict{Value(static_cast<Obj*>(heap.allocateDict()))};
+    heap.addRoots(&dict);
+    const char* message = nullptr;
+    for (size_t i = 0; i < count && message == nullptr; i++) {
+        message = dictSet(heap, dict[0], pairs[2 * i], pairs[2 * i + 1]);
+    }
+    heap.removeRoots(&dict);
+    
+    if (message == nullptr) result = dict[0];
+    return message;
+}
+
+const char* dictGet(const ObjDict* dict, const Value& key, Value& result) {
+    bool found;
+    if (const char* message = dictFind(dict, key, found, result)) return message;
+    if (!found) {
+        static thread_local std::string message;
+        message = "Key '" + valueToString(key) + "' not found.";
+        return message.c_str();
+    }
+    return nullptr;
+}
+
+const char* dictSet(Heap& heap, const Value& dict, const Value& key, const Value& value) {
+    uint32_t hash;
+    if (const char* message = hashKey(key, hash)) return message;
+    
+    ObjDict* owner = asDict(dict);
+    bool found = false;
+    size_t slot = 0;
+    if (owner->table != nullptr) slot = findSlot(tableOf(owner), key, hash, found);
+    if (found) {
+        ObjDictTable* table = tableOf(owner);
+        heap.storeValue(table, &dictTableValues(table)[2 * table->slotEntries()[slot] + 1], value);
+        return nullptr;
+    }
+    
+    if (owner->table == nullptr || owner->count == tableOf(owner)->capacity) {
+        if (const char* message = grow(heap, dict)) return message;
+        owner = asDict(dict);
+        slot = freeSlot(tableOf(owner), hash);
+    }
+    
+    ObjDictTable* table = tableOf(owner);
+    uint32_t entry = owner->count++;
+    heap.storeValue(table, &dictTableValues(table)[2 * entry], key);
+    heap.storeValue(table, &dictTableValues(table)[2 * entry + 1], value);
+    table->hashes()[entry] = hash;
+    occupy(table, slot, hash, entry);
+    return nullptr;
+}
+
+const char* dictFind(const ObjDict* dict, const Value& key, bool& found, Value& result) {
+    uint32_t hash;
+    if (const char* message = hashKey(key, hash)) return message;
+    
+    found = false;
+    if (dict->table == nullptr) return nullptr;
+    const ObjDictTable* table = tableOf(dict);
+    size_t slot = findSlot(table, key, hash, found);
+    if (found) result = dictTableValues(table)[2 * table->slotEntries()[slot] + 1];
+    return nullptr;
+}
+
+const char* dictRemove(Heap& heap, ObjDict* dict, const Value& key, bool& removed) {
+    uint32_t hash;
+    if (const char* message = hashKey(key, hash)) return message;
+    
+    removed = false;
+    if (dict->table == nullptr) return nullptr;
+    ObjDictTable* table = tableOf(dict);
+    size_t hole = findSlot(table, key, hash, removed);
+    if (!removed) return nullptr;
+    uint32_t entry = table->slotEntries()[hole];
+    
+    // Shift back each later slot of the run that may move: one whose home
+    // is not between the hole and itself. Every key stays reachable from
+    // its home without crossing a free slot.
+    size_t mask = table->slots - 1;
+    const uint8_t* control = table->control();
+    for (size_t next = (hole + 1) & mask; control[next] != kDictEmpty; next = (next + 1) & mask) {
+        uint32_t moving = table->slotEntries()[next];
+        size_t home = homeSlot(table->hashes()[moving], table->slots);
+        if (((next - home) & mask) >= ((next - hole) & mask)) {
+            occupy(table, hole, table->hashes()[moving], moving);
+            hole = next;
+        }
+    }
+    setControl(table, hole, kDictEmpty);
+    
+    // Keep the entries dense and in insertion order: the later ones move
+    // down a place, and so do the indexes of the slots pointing at them.
+    Value* values = dictTableValues(table);
+    uint32_t last = dict->count - 1;
+    for (uint32_t i = entry; i < last; i++) {
+        heap.storeValue(table, &values[2 * i], values[2 * i + 2]);
+        heap.storeValue(table, &values[2 * i + 1], values[2 * i + 3]);
+        table->hashes()[i] = table->hashes()[i + 1];
+    }
+    if (entry != last) {
+        uint32_t* slotEntries = table->slotEntries();
+        for (size_t slot = 0; slot < table->slots; slot++) {
+            if (control[slot] != kDictEmpty && slotEntries[slot] > entry) slotEntries[slot]--;
+        }
+    }
+    heap.storeValue(table, &values[2 * last], nullptr);
+    heap.storeValue(table, &values[2 * last + 1], nullptr);
+    dict->count--;
+    return nullptr;
+}
+
+Value dictKey(const ObjDict* dict, size_t i) {
+    return dictTableValues(tableOf(dict))[2 * i];
+}
+
+Value dictValue(const ObjDict* dict, size_t i) {
+    return dictTableValues(tableOf(dict))[2 * i + 1];
+}
+
+bool dictsEqual(const ObjDict* a, const ObjDict* b) {
+    if (a == b) return true;
+    if (a->count != b->count) return false;
+    
+    for (uint32_t i = 0; i < a->count; i++) {
+        bool found;
+        Value value;
+        dictFind(b, dictKey(a, i), found, value);
+        if (!found || !valuesEqual(dictValue(a, i), value)) return false;
+    }
+    return true;
+}
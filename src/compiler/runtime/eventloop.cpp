@@ -0,0 +1,233 @@
+#include "../../include/eventloop.h"
+#include "../../include/metrics.h"
+#include "../../include/timeline.h"
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <algorithm>
+#include <cerrno>
+#include <ctime>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+EventLoop::EventLoop(int workerThreads) : workerCount(workerThreads) {
+    epollFd = epoll_create1(EPOLL_CLOEXEC);
+    timerFd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (epollFd < 0 || timerFd < 0 || wakeFd < 0) {
+        throw std::runtime_error("Could not create event loop descriptors.");
+    }
+    
+    epoll_event event{};
+    event.events = EPOLLIN;
+    event.data.fd = timerFd;
+    epoll_ctl(epollFd, EPOLL_CTL_ADD, timerFd, &event);
+    event.data.fd = wakeFd;
+    epoll_ctl(epollFd, EPOLL_CTL_ADD, wakeFd, &event);
+}
+
+EventLoop::~EventLoop() {
+    {
+        std::lock_guard<std::mutex> lock(workMutex);
+        stopping = true;
+    }
+    workReady.notify_all();
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    
+    close(wakeFd);
+    close(timerFd);
+    close(epollFd);
+}
+
+void EventLoop::addTimer(int64_t milliseconds, Callback callback) {
+    milliseconds = std::clamp<int64_t>(milliseconds, 0, kMaxDelayMs);
+    timers.push({now() + milliseconds * 1000000, timerSequence++, std::move(callback)});
+    Metrics::add(Metric::TIMERS_ADDED);
+    armTimer();
+}
+
+void EventLoop::watch(int fd, uint32_t events, FdCallback callback) {
+    epoll_event event{};
+    event.events = events | EPOLLONESHOT;
+    event.data.fd = fd;
+    
+    int op = watches.count(fd) ? EPOLL_CTL_MOD : EPOLL_CTL_ADD;
+    if (epoll_ctl(epollFd, op, fd, &event) < 0) {
+        throw std::runtime_error("Could not watch file descriptor.");
+    }
+    watches[fd] = std::move(callback);
+}
+
+void EventLoop::unwatch(int fd) {
+    if (watches.erase(fd)) {
+        epoll_ctl(epollFd, EPOLL_CTL_DEL, fd, nullptr);
+    }
+}
+
+void EventLoop::submit(Work work) {
+    // Workers start on first use so scripts that never block pay nothing.
+    if (workers.empty()) {
+        for (int i = 0; i < workerCount; i++) {
+            workers.emplace_back(&EventLoop::workerLoop, this);
+        }
+    }
+    
+    jobsInFlight++;
+    Metrics::add(Metric::JOBS_SUBMITTED);
+    Timeline::instant("task", "submit");
+    {
+        std::lock_guard<std::mutex> lock(workMutex);
+        workQueue.push_back(std::move(work));
+    }
+    workReady.notify_one();
+}
+
+void EventLoop::readFile(const std::string& path,
+                         std::function<void(bool ok, std::string contents)> callback) {
+    submit([path, callback]() -> Callback {
+        std::ifstream file(path, std::ios::binary);
+        if (!file) {
+            return [callback]() { callback(false, std::string()); };
+        }
+        
+        std::stringstream contents;
+        contents << file.rdbuf();
+        return [callback, data = contents.str()]() { callback(true, data); };
+    });
+}
+
+void EventLoop::post(Callback callback) {
+    {
+        std::lock_guard<std::mutex> lock(completionMutex);
+        completions.push_back(std::move(callback));
+    }
+    
+    uint64_t one = 1;
+    ssize_t written = write(wakeFd, &one, sizeof(one));
+    (void)written;
+}
+
+void EventLoop::hold() {
+    holds++;
+}
+
+void EventLoop::release() {
+    holds--;
+}
+
+size_t EventLoop::pending() const {
+    return timers.size() + watches.size() + jobsInFlight + holds;
+}
+
+void EventLoop::run() {
+    while (pending() > 0) {
+        runOnce(-1);
+    }
+}
+
+void EventLoop::runOnce(int timeoutMs) {
+    epoll_event events[64];
+    int count = epoll_wait(epollFd, events, 64, timeoutMs);
+    if (count < 0) {
+        if (errno == EINTR) return;
+        throw std::runtime_error("epoll_wait failed.");
+    }
+    
+    for (int i = 0; i < count; i++) {
+        int fd = events[i].data.fd;
+        
+        if (fd == timerFd) {
+            uint64_t expirations;
+            while (read(timerFd, &expirations, sizeof(expirations)) > 0) {}
+            fireTimers();
+        } else if (fd == wakeFd) {
+            uint64_t value;
+            while (read(wakeFd, &value, sizeof(value)) > 0) {}
+            drainCompletions();
+        } else {
+            auto it = watches.find(fd);
+            if (it == watches.end()) continue;
+            
+            // Watches are one-shot: detach before the callback so it can re-arm.
+            FdCallback callback = std::move(it->second);
+            watches.erase(it);
+            epoll_ctl(epollFd, EPOLL_CTL_DEL, fd, nullptr);
+            callback(events[i].events);
+        }
+    }
+}
+
+void EventLoop::workerLoop() {
+    Timeline::nameThread("io worker");
+    while (true) {
+        Work work;
+        {
+            std::unique_lock<std::mutex> lock(workMutex);
+            workReady.wait(lock, [this]() { return stopping || !workQueue.empty(); });
+            if (stopping && workQueue.empty()) return;
+            work = std::move(workQueue.front());
+            workQueue.pop_front();
+        }
+        
+        Callback completion;
+        {
+            TimelineScope span("task", "work");
+            completion = work();
+        }
+        post([this, completion]() {
+            jobsInFlight--;
+            Metrics::add(Metric::JOBS_FINISHED);
+            completion();
+        });
+    }
+}
+
+void EventLoop::armTimer() {
+    int64_t deadline = timers.empty() ? 0 : timers.top().deadline;
+    if (deadline == armedDeadline) return;
+    armedDeadline = deadline;
+    
+    // A zero it_value disarms the timerfd.
+    itimerspec spec{};
+    if (deadline != 0) {
+        spec.it_value.tv_sec = deadline / 1000000000;
+        spec.it_value.tv_nsec = deadline % 1000000000;
+    }
+    timerfd_settime(timerFd, TFD_TIMER_ABSTIME, &spec, nullptr);
+}
+
+void EventLoop::fireTimers() {
+    int64_t current = now();
+    while (!timers.empty() && timers.top().deadline <= current) {
+        Callback callback = timers.top().callback;
+        timers.pop();
+        Metrics::add(Metric::TIMERS_FIRED);
+        callback();
+    }
+    
+    armedDeadline = -1;  // force re-arm, the fd was consumed
+    armTimer();
+}
+
+void EventLoop::drainCompletions() {
+    std::vector<Callback> ready;
+    {
+        std::lock_guard<std::mutex> lock(completionMutex);
+        ready.swap(completions);
+    }
+    
+    for (auto& callback : ready) {
+        callback();
+    }
+}
+
+int64_t EventLoop::now() {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<int64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
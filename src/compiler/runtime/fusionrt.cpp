@@ -0,0 +1,126 @@
+#include "../../include/fusionrt.h"
+#include "../../include/array.h"
+#include "../../include/dict.h"
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+NativeRuntime::NativeRuntime(size_t slotCount, size_t constantCount)
+    : slots(slotCount), constants(constantCount) {
+    // Output is flushed before anything that waits and at exit, not per line.
+    std::ios::sync_with_stdio(false);
+    heap.addRoots(&slots);
+    heap.addRoots(&constants);
+}
+
+void NativeRuntime::defineString(size_t index, const char* chars, size_t length) {
+    constants[index] = static_cast<Obj*>(heap.copyTenuredString(chars, length));
+}
+
+void NativeRuntime::concatenate(Value& a, const Value& b) {
+    // a and b are slots, so re-read them after the allocation.
+    size_t length = static_cast<ObjString*>(std::get<Obj*>(a))->length +
+                    static_cast<ObjString*>(std::get<Obj*>(b))->length;
+    ObjString* result = heap.allocateString(length);
+    auto* left = static_cast<ObjString*>(std::get<Obj*>(a));
+    auto* right = static_cast<ObjString*>(std::get<Obj*>(b));
+    std::memcpy(result->chars(), left->chars(), left->length);
+    std::memcpy(result->chars() + left->length, right->chars(), right->length);
+    a = static_cast<Obj*>(result);
+}
+
+void NativeRuntime::append(Value& variable, const Value* pieces, int count, int line) {
+    if (const char* message = appendStrings(heap, variable, pieces, count)) error(message, line);
+}
+
+void NativeRuntime::binary(OpCode op, Value& a, const Value& b, int line) {
+    if (isArrayValue(a) || isArrayValue(b)) {
+        if (const char* message = arrayBinary(heap, op, a, b)) error(message, line);
+        return;
+    }
+    Value result;
+    if (const char* message = numericBinary(op, a, b, result)) error(message, line);
+    a = result;
+}
+
+void NativeRuntime::unary(OpCode op, Value& a, int line) {
+    if (isArrayValue(a)) {
+        if (const char* message = arrayUnary(heap, op, a)) error(message, line);
+        return;
+    }
+    Value result;
+    if (const char* message = numericUnary(op, a, result)) error(message, line);
+    a = result;
+}
+
+void NativeRuntime::buildArray(Value* elements, int count, int line) {
+    if (const char* message = ::buildArray(heap, elements, count, elements[0])) error(message, line);
+}
+
+void NativeRuntime::buildDict(Value* pairs, int count, int line) {
+    if (const char* message = ::buildDict(heap, pairs, count, pairs[0])) error(message, line);
+}
+
+void NativeRuntime::getIndex(Value& array, const Value& index, int line) {
+    if (const char* message = ::getIndex(array, index, array)) error(message, line);
+}
+
+void NativeRuntime::setIndex(const Value& array, const Value& index, const Value& value, int line) {
+    if (const char* message = ::setIndex(heap, array, index, value)) error(message, line);
+}
+
+void NativeRuntime::call(Builtin builtin, Value* args, int argc, int line) {
+    if (const char* message = callBuiltin(heap, builtin, args, argc, args[0])) error(message, line);
+}
+
+void NativeRuntime::print(const Value& value) {
+    output.print(value);
+}
+
+void NativeRuntime::await(Value& operand, int line) {
+    output.beforeWait();
+    if (loop == nullptr) loop = std::make_unique<EventLoop>();
+    
+    bool done = false;
+    Value result = nullptr;
+    std::string failure;
+    
+    if (std::holds_alternative<double>(operand) || std::holds_alternative<int64_t>(operand)) {
+        int64_t milliseconds;
+        if (const char* message = awaitDelay(operand, milliseconds)) error(message, line);
+        loop->addTimer(milliseconds, [&]() {
+            done = true;
+        });
+    } else if (isStringValue(operand)) {
+        std::string path = stringOf(static_cast<ObjString*>(std::get<Obj*>(operand)));
+        loop->readFile(path, [&, path](bool ok, std::string contents) {
+            if (ok) {
+                result = static_cast<Obj*>(heap.copyString(contents.data(), contents.size()));
+            } else {
+                failure = "Could not read file \"" + path + "\".";
+            }
+            done = true;
+        });
+    } else {
+        error("Can only await a number of milliseconds or a file path.", line);
+    }
+    
+    while (!done) {
+        loop->runOnce(-1);
+    }
+    
+    if (!failure.empty()) error(failure, line);
+    operand = result;
+}
+
+int NativeRuntime::finish() {
+    output.flush();
+    return 0;
+}
+
+void NativeRuntime::error(const std::string& message, int line) {
+    output.flush();
+    std::cerr << message << std::endl;
+    std::cerr << "[line " << line << "] in script" << std::endl;
+    std::exit(70);
+}
@@ -0,0 +1,1084 @@
+#include "../../include/gc.h"
+#include "../../include/metrics.h"
+#include "../../include/timeline.h"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <unordered_map>
+
+namespace {
+
+constexpr size_t kSegmentHeaderSize = 1024;
+constexpr size_t kMinMajorThreshold = 4 << 20;
+constexpr size_t kSatbBatch = 256;
+constexpr size_t kDeferredSlice = 256;   // Slots traced between clock checks
+constexpr int kCardReadAttempts = 4;     // Reads of a changing card before the mutator gets it
+
+using Clock = std::chrono::steady_clock;
+
+bool isMarkedAtomic(const Obj* obj) {
+    return __atomic_load_n(&obj->flags, __ATOMIC_ACQUIRE) & OBJ_MARKED;
+}
+
+bool isSharedAtomic(const Obj* obj) {
+    return __atomic_load_n(&obj->flags, __ATOMIC_ACQUIRE) & OBJ_SHARED;
+}
+
+// A Value moves between the mutator and the marker as two words, each
+// loaded or stored atomically; only a read the card version vouches for
+// is turned back into a Value. Release and acquire also publish the
+// object a stored reference points to.
+static_assert(sizeof(Value) == 2 * sizeof(uint64_t) && std::is_trivially_copyable<Value>::value,
+              "Value must be two plain words");
+
+void loadWords(const Value* slot, uint64_t* words) {
+    const uint64_t* from = reinterpret_cast<const uint64_t*>(slot);
+    words[0] = __atomic_load_n(&from[0], __ATOMIC_ACQUIRE);
+    words[1] = __atomic_load_n(&from[1], __ATOMIC_ACQUIRE);
+}
+
+void storeWords(Value* slot, const Value& value) {
+    uint64_t words[2];
+    std::memcpy(words, &value, sizeof(Value));
+    uint64_t* to = reinterpret_cast<uint64_t*>(slot);
+    __atomic_store_n(&to[0], words[0], __ATOMIC_RELEASE);
+    __atomic_store_n(&to[1], words[1], __ATOMIC_RELEASE);
+}
+
+// Invoke visit(Obj*&) on every reference slot inside obj.
+template <typename Visitor>
+void traceChildren(Obj* obj, Visitor&& visit) {
+    switch (obj->type) {
+        case ObjType::ARRAY: {
+            auto* array = static_cast<ObjArray*>(obj);
+            if (array->storage != ArrayStorage::VALUES) break;
+            Value* values = arrayValues(array);
+            for (uint32_t i = 0; i < array->length; i++) {
+                if (Obj** slot = std::get_if<Obj*>(&values[i])) visit(*slot);
+            }
+            break;
+        }
+        case ObjType::DICT: {
+            auto* dict = static_cast<ObjDict*>(obj);
+            if (dict->table != nullptr) visit(dict->table);
+            break;
+        }
+        case ObjType::DICT_TABLE: {
+            auto* table = static_cast<ObjDictTable*>(obj);
+            Value* values = dictTableValues(table);
+            for (uint32_t i = 0; i < 2 * table->capacity; i++) {
+                if (Obj** slot = std::get_if<Obj*>(&values[i])) visit(*slot);
+            }
+            break;
+        }
+        case ObjType::STRING:
+        case ObjType::STRING_BUILDER:
+        case ObjType::FREE:
+            break;
+    }
+}
+
+// Indices of the Values in values[0, count) that start in [begin, end).
+std::pair<size_t, size_t> valuesIn(const Value* values, size_t count, const uint8_t* begin,
+                                   const uint8_t* end) {
+    const uint8_t* base = reinterpret_cast<const uint8_t*>(values);
+    auto index = [&](const uint8_t* at) -> size_t {
+        if (at <= base) return 0;
+        return std::min(count, (static_cast<size_t>(at - base) + sizeof(Value) - 1) / sizeof(Value));
+    };
+    return {index(begin), index(end)};
+}
+
+// Like traceChildren, for the reference slots that start in [begin, end).
+template <typename Visitor>
+void traceChildrenIn(Obj* obj, const uint8_t* begin, const uint8_t* end, Visitor&& visit) {
+    auto visitValues = [&](Value* values, size_t count) {
+        auto [first, last] = valuesIn(values, count, begin, end);
+        for (size_t i = first; i < last; i++) {
+            if (Obj** slot = std::get_if<Obj*>(&values[i])) visit(*slot);
+        }
+    };
+    
+    switch (obj->type) {
+        case ObjType::ARRAY: {
+            auto* array = static_cast<ObjArray*>(obj);
+            if (array->storage == ArrayStorage::VALUES) visitValues(arrayValues(array), array->length);
+            break;
+        }
+        case ObjType::DICT: {
+            auto* dict = static_cast<ObjDict*>(obj);
+            const uint8_t* field = reinterpret_cast<const uint8_t*>(&dict->table);
+            if (dict->table != nullptr && field >= begin && field < end) visit(dict->table);
+            break;
+        }
+        case ObjType::DICT_TABLE: {
+            auto* table = static_cast<ObjDictTable*>(obj);
+            visitValues(dictTableValues(table), 2 * table->capacity);
+            break;
+        }
+        case ObjType::STRING:
+        case ObjType::STRING_BUILDER:
+        case ObjType::FREE:
+            break;
+    }
+}
+
+// The Value slots of a VALUES array or dict table; none for other objects.
+std::pair<Value*, size_t> valueSlots(Obj* obj) {
+    switch (obj->type) {
+        case ObjType::ARRAY: {
+            auto* array = static_cast<ObjArray*>(obj);
+            if (array->storage != ArrayStorage::VALUES) break;
+            return {arrayValues(array), array->length};
+        }
+        case ObjType::DICT_TABLE: {
+            auto* table = static_cast<ObjDictTable*>(obj);
+            return {dictTableValues(table), 2 * table->capacity};
+        }
+        default:
+            break;
+    }
+    return {nullptr, 0};
+}
+
+    
+} // namespace
+
+uint8_t* Heap::Segment::begin() {
+    return reinterpret_cast<uint8_t*>(this) + kSegmentHeaderSize;
+}
+
+Heap::Heap(size_t nurserySize) : nextMajorThreshold(kMinMajorThreshold) {
+    static_assert(sizeof(Segment) <= kSegmentHeaderSize, "segment header too large");
+    
+    nurseryStart = static_cast<uint8_t*>(std::aligned_alloc(kObjAlignment, nurserySize));
+    if (nurseryStart == nullptr) throw std::bad_alloc();
+    nurseryTop = nurseryStart;
+    nurseryEnd = nurseryStart + nurserySize;
+}
+
+Heap::~Heap() {
+    if (marker.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(markMutex);
+            markerStop = true;
+        }
+        markerWake.notify_one();
+        marker.join();
+    }
+    
+    std::free(nurseryStart);
+    for (Segment* segment : segments) {
+        if (segment->cards != segment->smallCards) std::free(segment->cards);
+        std::free(segment->cardVersions);
+        std::free(segment);
+    }
+}
+
+void Heap::setConcurrent(std::chrono::nanoseconds maxPause) {
+    concurrent = true;
+    pauseBudget = maxPause;
+    if (!marker.joinable()) {
+        marker = std::thread(&Heap::markerLoop, this);
+    }
+}
+
+ObjString* Heap::allocateString(size_t length) {
+    auto* string = static_cast<ObjString*>(allocate(ObjType::STRING, stringAllocationSize(length)));
+    string->length = static_cast<uint32_t>(length);
+    string->hash = 0;
+    string->chars()[length] = '\0';
+    return string;
+}
+
+ObjString* Heap::copyString(const char* chars, size_t length) {
+    ObjString* string = allocateString(length);
+    std::memcpy(string->chars(), chars, length);
+    return string;
+}
+
+ObjString* Heap::copyTenuredString(const char* chars, size_t length) {
+    size_t size = stringAllocationSize(length);
+    auto* string = static_cast<ObjString*>(allocateOld(size));
+    string->type = ObjType::STRING;
+    string->length = static_cast<uint32_t>(length);
+    string->hash = 0;
+    std::memcpy(string->chars(), chars, length);
+    string->chars()[length] = '\0';
+    counters.bytesAllocated += size;
+    Metrics::add(Metric::ALLOCATIONS);
+    Metrics::add(Metric::ALLOCATED_BYTES, size);
+    if (profiler) profiler->allocated(string, size);
+    return string;
+}
+
+ObjStringBuilder* Heap::allocateStringBuilder(size_t capacity) {
+    size_t size = alignObjectSize(sizeof(ObjStringBuilder) + capacity);
+    auto* builder = static_cast<ObjStringBuilder*>(allocate(ObjType::STRING_BUILDER, size));
+    builder->length = 0;
+    builder->capacity = static_cast<uint32_t>(capacity);
+    return builder;
+}
+
+ObjArray* Heap::allocateArray(ArrayStorage storage, size_t length) {
+    static_assert(sizeof(Value) == 16 && alignof(Value) <= kObjAlignment,
+                  "arrayElementSize() assumes 16-byte Values");
+    
+    size_t size = arrayAllocationSize(storage, length);
+    auto* array = static_cast<ObjArray*>(allocate(ObjType::ARRAY, size));
+    array->storage = storage;
+    array->length = static_cast<uint32_t>(length);
+    if (storage == ArrayStorage::VALUES) {
+        std::uninitialized_fill_n(arrayValues(array), length, Value(nullptr));
+    }
+    return array;
+}
+
+ObjDict* Heap::allocateDict() {
+    auto* dict = static_cast<ObjDict*>(allocate(ObjType::DICT, alignObjectSize(sizeof(ObjDict))));
+    dict->count = 0;
+    dict->table = nullptr;
+    return dict;
+}
+
+ObjDictTable* Heap::allocateDictTable(size_t capacity, size_t slots) {
+    size_t size = dictTableAllocationSize(capacity, slots);
+    auto* table = static_cast<ObjDictTable*>(allocate(ObjType::DICT_TABLE, size));
+    table->capacity = static_cast<uint32_t>(capacity);
+    table->slots = static_cast<uint32_t>(slots);
+    std::uninitialized_fill_n(dictTableValues(table), 2 * capacity, Value(nullptr));
+    std::memset(table->control(), kDictEmpty, slots + kDictGroupWidth);
+    return table;
+}
+
+Value Heap::exportValue(const Value& value, SharedHeap& shared) {
+    Obj* const* slot = std::get_if<Obj*>(&value);
+    if (slot == nullptr || *slot == nullptr || (*slot)->isShared()) return value;
+    
+    // Lay the message out first: each object reached gets one place in the
+    // block however often it is reached, so shared structure and cycles
+    // survive. Builders travel as the strings they hold, and objects
+    // already shared (a program's constants) by reference.
+    std::unordered_map<const Obj*, size_t> offsets;
+    std::vector<Obj*> order;
+    size_t size = 0;
+    auto place = [&](Obj* obj) {
+        if (obj == nullptr || obj->isShared() || offsets.count(obj) != 0) return;
+        offsets.emplace(obj, size);
+        order.push_back(obj);
+        if (obj->type == ObjType::STRING_BUILDER) {
+            size += stringAllocationSize(static_cast<const ObjStringBuilder*>(obj)->length);
+        } else {
+            size += obj->size;
+        }
+    };
+    place(*slot);
+    for (size_t i = 0; i < order.size(); i++) {
+        traceChildren(order[i], [&](Obj*& child) { place(child); });
+    }
+    
+    uint8_t* block = shared.allocateMessage(size);
+    auto copyOf = [&](Obj* obj) -> Obj* {
+        if (obj == nullptr || obj->isShared()) return obj;
+        return reinterpret_cast<Obj*>(block + offsets[obj]);
+    };
+    for (Obj* obj : order) {
+        Obj* copy = copyOf(obj);
+        if (obj->type == ObjType::STRING_BUILDER) {
+            const auto* builder = static_cast<const ObjStringBuilder*>(obj);
+            auto* string = static_cast<ObjString*>(copy);
+            string->type = ObjType::STRING;
+            string->size = static_cast<uint32_t>(stringAllocationSize(builder->length));
+            string->length = builder->length;
+            string->hash = 0;
+            std::memcpy(string->chars(), builder->chars(), builder->length);
+            string->chars()[builder->length] = '\0';
+        } else {
+            std::memcpy(copy, obj, obj->size);
+            traceChildren(copy, [&](Obj*& child) { child = copyOf(child); });
+        }
+        copy->flags = OBJ_SHARED | OBJ_MESSAGE;
+    }
+    return reinterpret_cast<Obj*>(block);
+}
+
+Value Heap::importValue(const Value& message) {
+    Obj* const* slot = std::get_if<Obj*>(&message);
+    if (slot == nullptr || *slot == nullptr || !(*slot)->isInMessage()) return message;
+    
+    // Copy every object of the message, keeping its shape; allocating here
+    // may collect and move the copies made so far, so they are rooted and
+    // found again by index after every allocation.
+    std::vector<Value> copies;
+    std::unordered_map<const Obj*, size_t> copied;
+    addRoots(&copies);
+    auto adopt = [&](Obj* obj) -> Obj* {
+        if (obj == nullptr || !obj->isInMessage()) return obj;
+        auto it = copied.find(obj);
+        if (it != copied.end()) return std::get<Obj*>(copies[it->second]);
+        Obj* copy = allocate(obj->type, obj->size);
+        std::memcpy(copy + 1, obj + 1, obj->size - sizeof(Obj));
+        copied.emplace(obj, copies.size());
+        copies.push_back(copy);
+        return copy;
+    };
+    
+    adopt(*slot);
+    for (size_t i = 0; i < copies.size(); i++) {
+        if (std::get<Obj*>(copies[i])->type == ObjType::DICT) {
+            Obj* table = adopt(static_cast<ObjDict*>(std::get<Obj*>(copies[i]))->table);
+            auto* dict = static_cast<ObjDict*>(std::get<Obj*>(copies[i]));
+            storeField(dict, &dict->table, table);
+            continue;
+        }
+        size_t count = valueSlots(std::get<Obj*>(copies[i])).second;
+        for (size_t j = 0; j < count; j++) {
+            Obj* const* element = std::get_if<Obj*>(&valueSlots(std::get<Obj*>(copies[i])).first[j]);
+            if (element == nullptr) continue;
+            Obj* child = *element;
+            Obj* copy = adopt(child);
+            if (copy == child) continue;
+            Obj* owner = std::get<Obj*>(copies[i]);
+            storeValue(owner, &valueSlots(owner).first[j], copy);
+        }
+    }
+    Value result = copies[0];
+    removeRoots(&copies);
+    SharedHeap::releaseMessage(*slot);
+    return result;
+}
+
+void Heap::addRoots(std::vector<Value>* values) {
+    roots.push_back(values);
+}
+
+void Heap::removeRoots(std::vector<Value>* values) {
+    roots.erase(std::remove(roots.begin(), roots.end(), values), roots.end());
+}
+
+void Heap::forEachRoot(const std::function<void(const std::vector<Value>* roots, size_t index, Obj* obj)>& visit) const {
+    for (const std::vector<Value>* values : roots) {
+        for (size_t i = 0; i < values->size(); i++) {
+            if (Obj* const* slot = std::get_if<Obj*>(&(*values)[i])) {
+                if (*slot != nullptr) visit(values, i, *slot);
+            }
+        }
+    }
+}
+
+void Heap::forEachChild(Obj* obj, const std::function<void(Obj* child)>& visit) {
+    traceChildren(obj, [&visit](Obj*& child) {
+        if (child != nullptr) visit(child);
+    });
+}
+
+Obj* Heap::allocate(ObjType type, size_t size) {
+    if (profiler) profiler->safepoint(*this);
+    if (phase != Phase::IDLE) {
+        concurrentStep();
+    } else if (majorRequested) {
+        if (concurrent) {
+            startConcurrentCycle();
+        } else {
+            collectMajor();
+        }
+    }
+    
+    #ifdef DEBUG_STRESS_GC
+    collectMinor();
+    #endif
+    
+    Obj* obj;
+    if (size > static_cast<size_t>(nurseryEnd - nurseryStart) / 4) {
+        // Large objects would only be copied once more; pretenure them.
+        obj = allocateOld(size);
+    } else {
+        if (nurseryTop + size > nurseryEnd) {
+            collectMinor();
+        }
+        obj = reinterpret_cast<Obj*>(nurseryTop);
+        nurseryTop += size;
+        obj->size = static_cast<uint32_t>(size);
+        obj->flags = 0;
+    }
+    
+    obj->type = type;
+    counters.bytesAllocated += size;
+    Metrics::add(Metric::ALLOCATIONS);
+    Metrics::add(Metric::ALLOCATED_BYTES, size);
+    if (profiler) profiler->allocated(obj, size);
+    return obj;
+}
+
+Obj* Heap::allocateOld(size_t size) {
+    Obj* obj = nullptr;
+    
+    if (size > kSegmentSize - kSegmentHeaderSize) {
+        Segment* segment = newSegment(size);
+        obj = reinterpret_cast<Obj*>(segment->top);
+        segment->top += size;
+    } else if (currentSegment != nullptr &&
+               currentSegment->top + size <= currentSegment->end) {
+        obj = reinterpret_cast<Obj*>(currentSegment->top);
+        currentSegment->top += size;
+    } else {
+        auto it = freeList.lower_bound(static_cast<uint32_t>(size));
+        if (it != freeList.end()) {
+            obj = it->second;
+            size_t available = it->first;
+            freeList.erase(it);
+            
+            // Split off the remainder when it can hold an object of its own.
+            if (available - size >= kMinObjectSize) {
+                Obj* rest = makeFree(reinterpret_cast<uint8_t*>(obj) + size, available - size);
+                freeList.emplace(rest->size, rest);
+            } else {
+                size = available;
+            }
+        } else {
+            currentSegment = newSegment(kSegmentSize - kSegmentHeaderSize);
+            obj = reinterpret_cast<Obj*>(currentSegment->top);
+            currentSegment->top += size;
+        }
+    }
+    
+    obj->size = static_cast<uint32_t>(size);
+    obj->flags = allocationFlags(segmentOf(obj));
+    counters.oldBytes += size;
+    if (counters.oldBytes > nextMajorThreshold) {
+        majorRequested = true;
+    }
+    return obj;
+}
+
+uint8_t Heap::allocationFlags(const Segment* segment) const {
+    // Allocate black while marking, and in segments the lazy sweeper has
+    // not reached yet, so neither the marker nor the sweeper drops the
+    // new object.
+    if (phase == Phase::MARKING) return OBJ_MARKED;
+    if (phase == Phase::SWEEPING && !segment->swept) return OBJ_MARKED;
+    return 0;
+}
+
+Heap::Segment* Heap::newSegment(size_t payload) {
+    size_t blockSize = (kSegmentHeaderSize + payload + kSegmentSize - 1) & ~(kSegmentSize - 1);
+    void* block = std::aligned_alloc(kSegmentSize, blockSize);
+    if (block == nullptr) throw std::bad_alloc();
+    
+    Segment* segment = static_cast<Segment*>(block);
+    segment->top = segment->begin();
+    segment->end = static_cast<uint8_t*>(block) + blockSize;
+    segment->dirty = false;
+    segment->swept = true;
+    segment->cardCount = blockSize / kCardSize;
+    segment->cards = segment->smallCards;
+    if (segment->cardCount > kCardsPerSegment) {
+        segment->cards = static_cast<uint8_t*>(std::malloc(segment->cardCount));
+        if (segment->cards == nullptr) {
+            std::free(block);
+            throw std::bad_alloc();
+        }
+    }
+    std::memset(segment->cards, 0, segment->cardCount);
+    segment->cardVersions = static_cast<uint32_t*>(std::calloc(segment->cardCount, sizeof(uint32_t)));
+    if (segment->cardVersions == nullptr) {
+        if (segment->cards != segment->smallCards) std::free(segment->cards);
+        std::free(block);
+        throw std::bad_alloc();
+    }
+    segments.push_back(segment);
+    return segment;
+}
+
+void Heap::releaseSegment(Segment* segment) {
+    if (segment == currentSegment) currentSegment = nullptr;
+    segments.erase(std::find(segments.begin(), segments.end(), segment));
+    if (segment->cards != segment->smallCards) std::free(segment->cards);
+    std::free(segment->cardVersions);
+    std::free(segment);
+}
+
+Heap::Segment* Heap::segmentOf(const Obj* obj) {
+    // Object headers always lie in the first kSegmentSize bytes of their
+    // block, including the single object of an oversized segment.
+    return reinterpret_cast<Segment*>(reinterpret_cast<uintptr_t>(obj) & ~(kSegmentSize - 1));
+}
+
+void Heap::dirtyCard(const Obj* owner, const void* slot) {
+    Segment* segment = segmentOf(owner);
+    size_t offset = static_cast<const uint8_t*>(slot) - reinterpret_cast<uint8_t*>(segment);
+    segment->cards[offset / kCardSize] = 1;
+    segment->dirty = true;
+}
+
+Obj* Heap::makeFree(uint8_t* at, size_t size) {
+    Obj* hole = reinterpret_cast<Obj*>(at);
+    hole->type = ObjType::FREE;
+    hole->flags = 0;
+    hole->size = static_cast<uint32_t>(size);
+    return hole;
+}
+
+// Minor collection
+
+void Heap::collectMinor() {
+    Clock::time_point start = Clock::now();
+    minorCollection();
+    recordPause(start, "minor");
+}
+
+void Heap::minorCollection() {
+    size_t promotedBefore = counters.bytesPromoted;
+    
+    // Old objects recorded by the barrier are roots for the nursery.
+    scanDirtyCards();
+    
+    for (std::vector<Value>* values : roots) {
+        for (Value& value : *values) {
+            Obj** slot = std::get_if<Obj*>(&value);
+            if (slot != nullptr && *slot != nullptr && isYoung(*slot)) {
+                *slot = evacuate(*slot);
+            }
+        }
+    }
+    
+    // Promoted copies may still point into the nursery.
+    while (!grayStack.empty()) {
+        Obj* obj = grayStack.back();
+        grayStack.pop_back();
+        traceChildren(obj, [this](Obj*& child) {
+            if (child != nullptr && isYoung(child)) child = evacuate(child);
+        });
+    }
+    
+    if (profiler) profiler->afterMinor(*this);
+    nurseryTop = nurseryStart;
+    counters.minorCollections++;
+    Metrics::add(Metric::MINOR_COLLECTIONS);
+    
+    #ifdef DEBUG_LOG_GC
+    std::cerr << "-- gc minor: promoted " << counters.bytesPromoted - promotedBefore
+              << " bytes, old generation " << counters.oldBytes << " bytes" << std::endl;
+    #else
+    (void)promotedBefore;
+    #endif
+}
+
+Obj* Heap::evacuate(Obj* obj) {
+    if (obj->isForwarded()) return obj->forwardee();
+    
+    // Survivors are promoted straight into the old generation.
+    Obj* copy = allocateOld(obj->size);
+    uint32_t size = copy->size;  // may have grown to absorb a small hole
+    uint8_t flags = copy->flags;
+    std::memcpy(copy, obj, obj->size);
+    copy->size = size;
+    copy->flags = flags;
+    
+    obj->forwardTo(copy);
+    counters.bytesPromoted += size;
+    grayStack.push_back(copy);
+    return copy;
+}
+
+void Heap::scanDirtyCards() {
+    // Collect first: evacuating allocates in the segments being walked.
+    std::vector<DirtyRange> dirtyRanges;
+    for (Segment* segment : segments) {
+        if (!segment->dirty) continue;
+        
+        uint8_t* base = reinterpret_cast<uint8_t*>(segment);
+        for (uint8_t* p = segment->begin(); p < segment->top;) {
+            Obj* obj = reinterpret_cast<Obj*>(p);
+            uint8_t* objEnd = p + obj->size;
+            if (obj->type == ObjType::FREE) {
+                p = objEnd;
+                continue;
+            }
+            
+            // Each run of dirty cards over the object is one range.
+            size_t last = (objEnd - 1 - base) / kCardSize;
+            for (size_t card = (p - base) / kCardSize; card <= last;) {
+                if (!segment->cards[card]) {
+                    card++;
+                    continue;
+                }
+                size_t runStart = card;
+                while (card <= last && segment->cards[card]) card++;
+                dirtyRanges.push_back({obj, std::max(p, base + runStart * kCardSize),
+                                       std::min(objEnd, base + card * kCardSize)});
+            }
+            p = objEnd;
+        }
+        
+        // Every young object gets promoted, so no old->young edge survives.
+        std::memset(segment->cards, 0, segment->cardCount);
+        segment->dirty = false;
+    }
+    
+    for (const DirtyRange& range : dirtyRanges) {
+        traceChildrenIn(range.obj, range.begin, range.end, [this](Obj*& child) {
+            counters.cardSlotsScanned++;
+            // Atomic: the concurrent marker may be reading the slot. Only
+            // the pointer word changes, so it needs no card version.
+            if (child != nullptr && isYoung(child)) __atomic_store_n(&child, evacuate(child), __ATOMIC_RELEASE);
+        });
+    }
+}
+
+// Major collection
+
+void Heap::collectMajor() {
+    Clock::time_point start = Clock::now();
+    majorRequested = false;
+    bool wasConcurrent = phase != Phase::IDLE;
+    
+    if (phase == Phase::MARKING) {
+        // Trace what was deferred and wait for the marker to drain what
+        // it was handed, with no budget.
+        std::vector<Obj*> reached;
+        while (!(traceDeferred(Clock::time_point::max(), reached) && tryFinishMarking())) {
+            handToMarker(reached);
+            reached.clear();
+            std::this_thread::yield();
+        }
+    } else if (phase == Phase::IDLE) {
+        // With the nursery empty every live object is in the old generation.
+        minorCollection();
+        
+        for (std::vector<Value>* values : roots) {
+            for (Value& value : *values) {
+                if (Obj* const* slot = std::get_if<Obj*>(&value)) {
+                    if (*slot != nullptr) markObject(*slot);
+                }
+            }
+        }
+        
+        while (!grayStack.empty()) {
+            Obj* obj = grayStack.back();
+            grayStack.pop_back();
+            traceChildren(obj, [this](Obj*& child) {
+                if (child != nullptr) markObject(child);
+            });
+        }
+        
+        beginSweep();
+    }
+    
+    while (sweepCursor < segments.size()) {
+        sweepNext();
+    }
+    
+    recordPause(start, "major");
+    finishCycle(wasConcurrent);
+}
+
+void Heap::markObject(Obj* obj) {
+    if (obj->isMarked() || obj->isShared()) return;
+    obj->flags |= OBJ_MARKED;
+    grayStack.push_back(obj);
+}
+
+void Heap::beginSweep() {
+    if (profiler) profiler->afterMark(*this);
+    phase = Phase::SWEEPING;
+    freeList.clear();
+    sweepCursor = 0;
+    for (Segment* segment : segments) {
+        segment->swept = false;
+    }
+}
+
+void Heap::sweepNext() {
+    Segment* segment = segments[sweepCursor];
+    bool empty = sweepSegment(segment);
+    
+    // Holes are only recorded in front of live objects, so an empty
+    // segment has nothing on the free list and can go back to the system.
+    if (empty && segment != currentSegment) {
+        releaseSegment(segment);
+    } else {
+        sweepCursor++;
+    }
+}
+
+bool Heap::sweepSegment(Segment* segment) {
+    uint8_t* holeStart = nullptr;
+    size_t live = 0;
+    size_t dead = 0;
+    
+    for (uint8_t* p = segment->begin(); p < segment->top;) {
+        Obj* obj = reinterpret_cast<Obj*>(p);
+        size_t size = obj->size;
+        
+        if (obj->type != ObjType::FREE && obj->isMarked()) {
+            obj->flags &= ~OBJ_MARKED;
+            live += size;
+            if (holeStart != nullptr) {
+                Obj* hole = makeFree(holeStart, p - holeStart);
+                freeList.emplace(hole->size, hole);
+                holeStart = nullptr;
+            }
+        } else {
+            if (obj->type != ObjType::FREE) dead += size;
+            if (holeStart == nullptr) holeStart = p;
+        }
+        p += size;
+    }
+    
+    // A trailing run of garbage goes back to the bump region.
+    if (holeStart != nullptr) segment->top = holeStart;
+    
+    segment->swept = true;
+    counters.oldBytes -= dead;
+    return live == 0;
+}
+
+void Heap::finishCycle(bool wasConcurrent) {
+    phase = Phase::IDLE;
+    majorRequested = false;
+    counters.majorCollections++;
+    Metrics::add(Metric::MAJOR_COLLECTIONS);
+    nextMajorThreshold = std::max(kMinMajorThreshold, counters.oldBytes * 2);
+    
+    currentCycle.liveBytes = counters.oldBytes;
+    currentCycle.concurrent = wasConcurrent;
+    completedCycles.push_back(currentCycle);
+    currentCycle = GcCycle();
+    
+    #ifdef DEBUG_LOG_GC
+    std::cerr << "-- gc major" << (wasConcurrent ? " (concurrent)" : "")
+              << ": old generation " << counters.oldBytes
+              << " bytes live, next at " << nextMajorThreshold << std::endl;
+    #endif
+}
+
+// Concurrent collection
+
+void Heap::startConcurrentCycle() {
+    Clock::time_point start = Clock::now();
+    majorRequested = false;
+    
+    // Empty the nursery so the snapshot only references old objects.
+    minorCollection();
+    
+    std::vector<Obj*> snapshot;
+    for (std::vector<Value>* values : roots) {
+        for (Value& value : *values) {
+            if (Obj* const* slot = std::get_if<Obj*>(&value)) {
+                if (*slot != nullptr && !(*slot)->isShared()) snapshot.push_back(*slot);
+            }
+        }
+    }
+    
+    // Stores version their card from here on, before the marker can read.
+    phase = Phase::MARKING;
+    marking = true;
+    recordPause(start, "mark start");
+    
+    // Woken after the pause: on a single core the marker may run at once.
+    handToMarker(snapshot);
+}
+
+void Heap::concurrentStep() {
+    if (phase == Phase::MARKING) {
+        // Deferred objects are traced in steps of at most the pause
+        // budget, with at least as long for the mutator between them.
+        if (!deferredWork.empty() || deferredPending.load(std::memory_order_acquire)) {
+            Clock::time_point start = Clock::now();
+            if (start < nextDeferredStep) return;
+            std::vector<Obj*> reached;
+            traceDeferred(start + pauseBudget, reached);
+            recordPause(start, "mark step");
+            // Woken after the pause: on a single core the marker may run
+            // at once.
+            handToMarker(reached);
+            nextDeferredStep = Clock::now() + pauseBudget;
+            return;
+        }
+        
+        // Cheap poll; only take the lock once the marker ran out of work.
+        if (!markerIdle.load(std::memory_order_acquire)) return;
+        
+        Clock::time_point start = Clock::now();
+        tryFinishMarking();
+        recordPause(start, "mark finish");
+        return;
+    }
+    
+    // Lazy sweeping: at least one segment per allocation, more while the
+    // step stays within the pause budget.
+    Clock::time_point start = Clock::now();
+    Clock::time_point deadline = start + pauseBudget;
+    while (sweepCursor < segments.size()) {
+        sweepNext();
+        if (Clock::now() >= deadline) break;
+    }
+    
+    recordPause(start, "sweep");
+    if (sweepCursor >= segments.size()) {
+        finishCycle(true);
+    }
+}
+
+bool Heap::tryFinishMarking() {
+    flushSatb();
+    
+    std::lock_guard<std::mutex> lock(markMutex);
+    if (!markerIdle || !markInbox.empty() || !markDeferred.empty() || !deferredWork.empty()) {
+        return false;
+    }
+    
+    // Everything reachable at the snapshot, plus every shaded overwrite,
+    // is marked; new objects were allocated black.
+    marking = false;
+    counters.markerSlotsTraced += markerSlots.exchange(0, std::memory_order_relaxed);
+    beginSweep();
+    return true;
+}
+
+bool Heap::traceDeferred(Clock::time_point deadline, std::vector<Obj*>& reached) {
+    if (deferredPending.load(std::memory_order_acquire)) {
+        std::lock_guard<std::mutex> lock(markMutex);
+        deferredWork.insert(deferredWork.end(), markDeferred.begin(), markDeferred.end());
+        markDeferred.clear();
+        deferredPending = false;
+    }
+    
+    // Old objects never move, and marked ones are not freed before the
+    // sweep, so work can stop in the middle of a range and pick up there
+    // next step.
+    while (!deferredWork.empty()) {
+        DeferredSlots& work = deferredWork.back();
+        Value* values = valueSlots(work.obj).first;
+        size_t end = std::min(work.end, work.begin + kDeferredSlice);
+        for (size_t i = work.begin; i < end; i++) {
+            Obj* const* child = std::get_if<Obj*>(&values[i]);
+            if (child != nullptr && *child != nullptr && !isYoung(*child) && !isSharedAtomic(*child) &&
+                tryMark(*child)) {
+                reached.push_back(*child);
+            }
+        }
+        counters.mutatorSlotsTraced += end - work.begin;
+        work.begin = end;
+        if (work.begin == work.end) deferredWork.pop_back();
+        if (Clock::now() >= deadline) break;
+    }
+    return deferredWork.empty();
+}
+
+void Heap::handToMarker(const std::vector<Obj*>& gray) {
+    if (gray.empty()) return;
+    
+    {
+        std::lock_guard<std::mutex> lock(markMutex);
+        markInbox.insert(markInbox.end(), gray.begin(), gray.end());
+        markerIdle = false;
+    }
+    markerWake.notify_one();
+}
+
+void Heap::shade(Obj* obj) {
+    if (isYoung(obj) || isSharedAtomic(obj) || isMarkedAtomic(obj)) return;
+    
+    satbLocal.push_back(obj);
+    if (satbLocal.size() >= kSatbBatch) {
+        flushSatb();
+    }
+}
+
+void Heap::flushSatb() {
+    handToMarker(satbLocal);
+    satbLocal.clear();
+}
+
+void Heap::storeWhileMarking(Obj* owner, Value* slot, const Value& value) {
+    // The writing half of a seqlock per card; only the mutator writes. The
+    // words are release stores, so a reader that sees them sees odd too.
+    Segment* segment = segmentOf(owner);
+    size_t offset = reinterpret_cast<uint8_t*>(slot) - reinterpret_cast<uint8_t*>(segment);
+    uint32_t* version = &segment->cardVersions[offset / kCardSize];
+    uint32_t odd = __atomic_load_n(version, __ATOMIC_RELAXED) + 1;
+    __atomic_store_n(version, odd, __ATOMIC_RELAXED);
+    storeWords(slot, value);
+    __atomic_store_n(version, odd + 1, __ATOMIC_RELEASE);
+}
+
+void Heap::markerLoop() {
+    Timeline::nameThread("gc marker");
+    while (true) {
+        std::vector<Obj*> work;
+        {
+            std::unique_lock<std::mutex> lock(markMutex);
+            if (markInbox.empty()) {
+                markerIdle = true;
+            }
+            markerWake.wait(lock, [this]() { return markerStop || !markInbox.empty(); });
+            if (markerStop) return;
+            work.swap(markInbox);
+            markerIdle = false;
+        }
+        TimelineScope batch("gc", "concurrent mark");
+        
+        for (Obj* obj : work) {
+            if (tryMark(obj)) markStack.push_back(obj);
+        }
+        
+        std::vector<DeferredSlots> deferred;
+        size_t slots = 0;
+        while (!markStack.empty()) {
+            Obj* obj = markStack.back();
+            markStack.pop_back();
+            if (obj->type == ObjType::DICT) {
+                // A table the mutator swaps in later is allocated black,
+                // and the one it replaces is shaded.
+                Obj* table = __atomic_load_n(&static_cast<ObjDict*>(obj)->table, __ATOMIC_ACQUIRE);
+                if (table != nullptr && tryMark(table)) markStack.push_back(table);
+                slots++;
+                continue;
+            }
+            auto [values, count] = valueSlots(obj);
+            if (values != nullptr) slots += markValues(obj, values, count, deferred);
+        }
+        markerSlots.fetch_add(slots, std::memory_order_relaxed);
+        
+        if (!deferred.empty()) {
+            std::lock_guard<std::mutex> lock(markMutex);
+            markDeferred.insert(markDeferred.end(), deferred.begin(), deferred.end());
+            deferredPending = true;
+        }
+    }
+}
+
+size_t Heap::markValues(Obj* obj, const Value* values, size_t count, std::vector<DeferredSlots>& deferred) {
+    Segment* segment = segmentOf(obj);
+    const uint8_t* base = reinterpret_cast<const uint8_t*>(segment);
+    uint64_t words[2 * (kCardSize / sizeof(Value) + 1)];
+    size_t read = 0;
+    
+    // A slot belongs to the card holding its first byte, like dirtyCard().
+    for (size_t first = 0; first < count;) {
+        size_t card = (reinterpret_cast<const uint8_t*>(values + first) - base) / kCardSize;
+        size_t last = valuesIn(values, count, base + card * kCardSize, base + (card + 1) * kCardSize).second;
+        const uint32_t* version = &segment->cardVersions[card];
+        
+        bool consistent = false;
+        for (int attempt = 0; attempt < kCardReadAttempts && !consistent; attempt++) {
+            uint32_t before = __atomic_load_n(version, __ATOMIC_ACQUIRE);
+            if (before & 1) continue;
+            for (size_t i = first; i < last; i++) loadWords(&values[i], &words[2 * (i - first)]);
+            consistent = __atomic_load_n(version, __ATOMIC_RELAXED) == before;
+        }
+        
+        if (!consistent) {
+            if (!deferred.empty() && deferred.back().obj == obj && deferred.back().end == first) {
+                deferred.back().end = last;
+            } else {
+                deferred.push_back({obj, first, last});
+            }
+            first = last;
+            continue;
+        }
+        
+        for (size_t i = first; i < last; i++) {
+            Value value;
+            std::memcpy(static_cast<void*>(&value), &words[2 * (i - first)], sizeof(Value));
+            // The nursery belongs to the mutator; young objects are either
+            // unreachable from the snapshot or allocated later. Shared
+            // objects belong to no private heap.
+            Obj* const* child = std::get_if<Obj*>(&value);
+            if (child != nullptr && *child != nullptr && !isYoung(*child) && !isSharedAtomic(*child) &&
+                tryMark(*child)) {
+                markStack.push_back(*child);
+            }
+        }
+        read += last - first;
+        first = last;
+    }
+    return read;
+}
+
+bool Heap::tryMark(Obj* obj) {
+    uint8_t previous = __atomic_fetch_or(&obj->flags, OBJ_MARKED, __ATOMIC_ACQ_REL);
+    return !(previous & OBJ_MARKED);
+}
+
+// Pause accounting
+
+void Heap::recordPause(std::chrono::steady_clock::time_point start, const char* kind) {
+    Clock::time_point end = Clock::now();
+    std::chrono::nanoseconds pause = end - start;
+    allPauses.record(pause);
+    currentCycle.pauses.record(pause);
+    Metrics::recordPause(pause);
+    if (Timeline::enabled()) {
+        auto nanos = [](Clock::time_point at) {
+            return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(at.time_since_epoch()).count());
+        };
+        Timeline::complete("gc", kind, nanos(start), nanos(end));
+    }
+}
+
+void Heap::printPauseReport(std::ostream& out) const {
+    auto micros = [](std::chrono::nanoseconds ns) { return ns.count() / 1000.0; };
+    
+    out << "== gc pauses ==" << std::endl;
+    for (size_t i = 0; i < completedCycles.size(); i++) {
+        const GcCycle& cycle = completedCycles[i];
+        out << "cycle " << i + 1 << (cycle.concurrent ? " concurrent" : " stop-the-world")
+            << ": " << cycle.pauses.count() << " pauses, p50 "
+            << micros(cycle.pauses.percentile(50)) << " us, p99 "
+            << micros(cycle.pauses.percentile(99)) << " us, max "
+            << micros(cycle.pauses.max()) << " us, " << cycle.liveBytes << " bytes live"
+            << std::endl;
+    }
+    out << "all: " << allPauses.count() << " pauses, p50 "
+        << micros(allPauses.percentile(50)) << " us, p99 "
+        << micros(allPauses.percentile(99)) << " us, max "
+        << micros(allPauses.max()) << " us, total " << micros(allPauses.total()) << " us"
+        << std::endl;
+    allPauses.print(out);
+}
+
+void PauseHistogram::record(std::chrono::nanoseconds pause) {
+    int64_t ns = pause.count();
+    uint64_t micros = ns / 1000;
+    
+    size_t bucket = 0;
+    while (bucket + 1 < buckets.size() && micros >= (uint64_t(1) << bucket)) {
+        bucket++;
+    }
+    
+    buckets[bucket]++;
+    samples++;
+    sum += ns;
+    longest = std::max(longest, ns);
+}
+
+std::chrono::nanoseconds PauseHistogram::percentile(double p) const {
+    if (samples == 0) return std::chrono::nanoseconds(0);
+    
+    uint64_t rank = static_cast<uint64_t>(samples * p / 100.0 + 0.5);
+    if (rank == 0) rank = 1;
+    
+    uint64_t seen = 0;
+    for (size_t i = 0; i < buckets.size(); i++) {
+        seen += buckets[i];
+        if (seen >= rank) {
+            int64_t bound = (int64_t(1) << i) * 1000;
+            return std::chrono::nanoseconds(std::min(bound, longest));
+        }
+    }
+    return max();
+}
+
+void PauseHistogram::print(std::ostream& out) const {
+    for (size_t i = 0; i < buckets.size(); i++) {
+        if (buckets[i] == 0) continue;
+        out << "  < " << (uint64_t(1) << i) << " us: " << buckets[i] << std::endl;
+    }
+}
@@ -0,0 +1,434 @@
+#include "../../include/heapprofile.h"
+#include "../../include/gc.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iostream>
+
+namespace {
+
+constexpr uint32_t kNone = UINT32_MAX;
+constexpr size_t kMaxPathDepth = 16;
+
+const char* objTypeName(ObjType type) {
+    switch (type) {
+        case ObjType::STRING: return "STRING";
+        case ObjType::ARRAY: return "ARRAY";
+        case ObjType::DICT: return "DICT";
+        case ObjType::DICT_TABLE: return "DICT_TABLE";
+        case ObjType::STRING_BUILDER: return "STRING_BUILDER";
+        case ObjType::FREE: return "FREE";
+    }
+    return "UNKNOWN";
+}
+
+// The reachable heap as a graph: node 0 stands above every root, then one
+// node per root slot, then one per object. Edges are kept CSR style.
+struct HeapGraph {
+    std::vector<Obj*> objects;  // Null for node 0 and root slots
+    std::vector<std::string> labels;  // Root slots only
+    std::vector<uint32_t> edgeStart{0};
+    std::vector<uint32_t> edges;
+    std::unordered_map<Obj*, uint32_t> index;
+    
+    uint32_t size() const { return static_cast<uint32_t>(objects.size()); }
+};
+
+HeapGraph buildGraph(const Heap& heap, const std::function<std::string(const std::vector<Value>*, size_t)>& name) {
+    HeapGraph graph;
+    graph.objects.push_back(nullptr);
+    graph.labels.emplace_back("(roots)");
+    
+    auto nodeFor = [&graph](Obj* obj) {
+        auto [it, added] = graph.index.emplace(obj, graph.size());
+        if (added) {
+            graph.objects.push_back(obj);
+            graph.labels.emplace_back();
+        }
+        return it->second;
+    };
+    
+    // Root slots first, each with the one edge to its object.
+    std::vector<std::pair<std::string, Obj*>> slots;
+    heap.forEachRoot([&](const std::vector<Value>* roots, size_t index, Obj* obj) {
+        slots.emplace_back(name(roots, index), obj);
+    });
+    for (uint32_t i = 0; i < slots.size(); i++) {
+        graph.edges.push_back(i + 1);
+    }
+    graph.edgeStart.push_back(static_cast<uint32_t>(graph.edges.size()));
+    for (auto& [label, obj] : slots) {
+        graph.objects.push_back(nullptr);
+        graph.labels.push_back(std::move(label));
+    }
+    for (auto& slot : slots) {
+        graph.edges.push_back(nodeFor(slot.second));
+        graph.edgeStart.push_back(static_cast<uint32_t>(graph.edges.size()));
+    }
+    
+    // Objects are numbered as they are found, so visiting nodes in order
+    // visits each exactly once.
+    for (uint32_t node = static_cast<uint32_t>(slots.size()) + 1; node < graph.size(); node++) {
+        Heap::forEachChild(graph.objects[node], [&](Obj* child) {
+            graph.edges.push_back(nodeFor(child));
+        });
+        graph.edgeStart.push_back(static_cast<uint32_t>(graph.edges.size()));
+    }
+    return graph;
+}
+
+// Immediate dominators by the iterative algorithm of Cooper, Harvey and
+// Kennedy, over the reverse postorder of a depth-first walk from node 0.
+std::vector<uint32_t> dominators(const HeapGraph& graph, std::vector<uint32_t>& order) {
+    uint32_t count = graph.size();
+    std::vector<uint32_t> rank(count, kNone);  // Position in reverse postorder
+    
+    // Iterative postorder.
+    order.clear();
+    std::vector<uint8_t> seen(count, 0);
+    std::vector<std::pair<uint32_t, uint32_t>> stack{{0, graph.edgeStart[0]}};
+    seen[0] = 1;
+    while (!stack.empty()) {
+        auto& [node, next] = stack.back();
+        if (next < graph.edgeStart[node + 1]) {
+            uint32_t child = graph.edges[next++];
+            if (!seen[child]) {
+                seen[child] = 1;
+                stack.emplace_back(child, graph.edgeStart[child]);
+            }
+            continue;
+        }
+        order.push_back(node);
+        stack.pop_back();
+    }
+    std::reverse(order.begin(), order.end());
+    for (uint32_t i = 0; i < order.size(); i++) {
+        rank[order[i]] = i;
+    }
+    
+    std::vector<uint32_t> predecessorStart(count + 1, 0);
+    for (uint32_t edge : graph.edges) {
+        predecessorStart[edge + 1]++;
+    }
+    for (uint32_t i = 0; i < count; i++) {
+        predecessorStart[i + 1] += predecessorStart[i];
+    }
+    std::vector<uint32_t> predecessors(graph.edges.size());
+    std::vector<uint32_t> fill(predecessorStart.begin(), predecessorStart.end() - 1);
+    for (uint32_t node = 0; node < count; node++) {
+        for (uint32_t e = graph.edgeStart[node]; e < graph.edgeStart[node + 1]; e++) {
+            predecessors[fill[graph.edges[e]]++] = node;
+        }
+    }
+    
+    std::vector<uint32_t> idom(count, kNone);
+    idom[0] = 0;
+    auto intersect = [&](uint32_t a, uint32_t b) {
+        while (a != b) {
+            while (rank[a] > rank[b]) a = idom[a];
+            while (rank[b] > rank[a]) b = idom[b];
+        }
+        return a;
+    };
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (size_t i = 1; i < order.size(); i++) {
+            uint32_t node = order[i];
+            uint32_t dominator = kNone;
+            for (uint32_t p = predecessorStart[node]; p < predecessorStart[node + 1]; p++) {
+                uint32_t predecessor = predecessors[p];
+                if (idom[predecessor] == kNone) continue;
+                dominator = dominator == kNone ? predecessor : intersect(predecessor, dominator);
+            }
+            if (idom[node] != dominator) {
+                idom[node] = dominator;
+                changed = true;
+            }
+        }
+    }
+    return idom;
+}
+
+// Dominator paths, interned: each is its parent path plus one part.
+class PathTable {
+public:
+    int intern(int parent, const std::string& part) {
+        if (parent >= 0 && depths[parent] >= kMaxPathDepth) {
+            // Everything deeper folds into one "..." path.
+            if (parts[parent] == "...") return parent;
+            return intern(parent, "...");
+        }
+        auto [it, added] = ids.emplace(std::make_pair(parent, part), static_cast<int>(parts.size()));
+        if (added) {
+            parents.push_back(parent);
+            parts.push_back(part);
+            depths.push_back(parent < 0 ? 1 : depths[parent] + 1);
+        }
+        return it->second;
+    }
+    
+    std::string text(int id) const {
+        std::vector<const std::string*> chain;
+        for (; id >= 0; id = parents[id]) {
+            chain.push_back(&parts[id]);
+        }
+        std::string path;
+        for (auto part = chain.rbegin(); part != chain.rend(); ++part) {
+            if (!path.empty()) path += " > ";
+            path += **part;
+        }
+        return path;
+    }
+
+private:
+    std::map<std::pair<int, std::string>, int> ids;
+    std::vector<int> parents;
+    std::vector<std::string> parts;
+    std::vector<size_t> depths;
+};
+
+struct Row {
+    uint64_t objects = 0;
+    uint64_t bytes = 0;
+};
+
+bool readSnapshot(const std::string& path, std::map<std::string, Row>& rows, std::ostream& err) {
+    std::ifstream file(path);
+    if (!file) {
+        err << "Could not open file \"" << path << "\"." << std::endl;
+        return false;
+    }
+    std::string line;
+    if (!std::getline(file, line) || line.rfind("# fusion heap snapshot", 0) != 0) {
+        err << "\"" << path << "\" is not a heap snapshot." << std::endl;
+        return false;
+    }
+    while (std::getline(file, line)) {
+        size_t second = line.find('\t');
+        size_t third = second == std::string::npos ? second : line.find('\t', second + 1);
+        size_t fourth = third == std::string::npos ? third : line.find('\t', third + 1);
+        if (fourth == std::string::npos) {
+            err << "\"" << path << "\" has a malformed row." << std::endl;
+            return false;
+        }
+        Row& row = rows[line.substr(0, third)];
+        row.objects = std::strtoull(line.c_str() + third + 1, nullptr, 10);
+        row.bytes = std::strtoull(line.c_str() + fourth + 1, nullptr, 10);
+    }
+    return true;
+}
+    
+} // namespace
+
+volatile std::sig_atomic_t HeapProfiler::snapshotRequested = 0;
+
+HeapProfiler::HeapProfiler(Chunk* const& chunk, const int& ip, size_t sampleBytes)
+    : chunk(chunk), ip(ip), sampleBytes(static_cast<double>(sampleBytes)), random(std::random_device{}()) {
+    untilSample = nextSampleGap();
+}
+
+void HeapProfiler::nameRoots(const std::vector<Value>* roots, std::string label,
+                             const std::vector<std::string>* slotNames) {
+    rootNames[roots] = {std::move(label), slotNames};
+}
+
+void HeapProfiler::afterMinor(const Heap& heap) {
+    std::vector<std::pair<Obj*, Sampled>> survivors;
+    for (auto it = sampled.begin(); it != sampled.end();) {
+        if (!heap.isYoung(it->first)) {
+            ++it;
+            continue;
+        }
+        if (it->first->isForwarded()) survivors.emplace_back(it->first->forwardee(), it->second);
+        it = sampled.erase(it);
+    }
+    for (auto& [obj, entry] : survivors) {
+        sampled.insert_or_assign(obj, entry);
+    }
+}
+
+void HeapProfiler::afterMark(const Heap& heap) {
+    for (auto it = sampled.begin(); it != sampled.end();) {
+        Obj* obj = it->first;
+        if (!heap.isYoung(obj) && !obj->isShared() && !obj->isMarked()) {
+            it = sampled.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+void HeapProfiler::sample(Obj* obj, size_t size) {
+    untilSample = nextSampleGap();
+    
+    // An allocation of size bytes is sampled with probability
+    // 1 - e^(-size / sampleBytes); weight it by the inverse.
+    double scale = 1.0 / (1.0 - std::exp(-static_cast<double>(size) / sampleBytes));
+    int line = ip > 0 && static_cast<size_t>(ip) <= chunk->lines.size() ? chunk->lines[ip - 1] : 0;
+    auto key = std::make_pair(line, obj->type);
+    auto [it, added] = siteIndex.emplace(key, static_cast<int>(siteKeys.size()));
+    if (added) {
+        siteKeys.push_back(key);
+        allocatedAt.emplace_back();
+    }
+    
+    Site& site = allocatedAt[it->second];
+    site.objects += scale;
+    site.bytes += scale * size;
+    sampled.insert_or_assign(obj, Sampled{it->second, scale, scale * size});
+}
+
+size_t HeapProfiler::nextSampleGap() {
+    std::exponential_distribution<double> gap(1.0 / sampleBytes);
+    return static_cast<size_t>(gap(random)) + 1;
+}
+
+void HeapProfiler::writeRequestedSnapshot(const Heap& heap) {
+    snapshotRequested = 0;
+    if (snapshotPath.empty()) return;
+    writeSnapshot(heap, snapshotPath + "." + std::to_string(++snapshotsWritten));
+}
+
+std::string HeapProfiler::rootName(const std::vector<Value>* roots, size_t index) const {
+    auto it = rootNames.find(roots);
+    if (it == rootNames.end()) return "root[" + std::to_string(index) + "]";
+    const RootNames& names = it->second;
+    if (names.slotNames != nullptr && index < names.slotNames->size() && !(*names.slotNames)[index].empty()) {
+        return (*names.slotNames)[index];
+    }
+    return names.label + "[" + std::to_string(index) + "]";
+}
+
+void HeapProfiler::writeSnapshot(const Heap& heap, std::ostream& out) {
+    HeapGraph graph = buildGraph(heap, [this](const std::vector<Value>* roots, size_t index) {
+        return rootName(roots, index);
+    });
+    std::vector<uint32_t> order;
+    std::vector<uint32_t> idom = dominators(graph, order);
+    
+    // Children follow their dominator in reverse postorder, so one pass
+    // from the back accumulates every subtree.
+    std::vector<uint64_t> retainedBytes(graph.size(), 0);
+    std::vector<uint64_t> retainedObjects(graph.size(), 0);
+    for (uint32_t node = 0; node < graph.size(); node++) {
+        if (graph.objects[node] != nullptr) {
+            retainedBytes[node] = graph.objects[node]->size;
+            retainedObjects[node] = 1;
+        }
+    }
+    for (size_t i = order.size(); i-- > 1;) {
+        uint32_t node = order[i];
+        retainedBytes[idom[node]] += retainedBytes[node];
+        retainedObjects[idom[node]] += retainedObjects[node];
+    }
+    
+    std::map<std::string, Row> rows;
+    Row& total = rows["total\t-"];
+    total.objects = retainedObjects[0];
+    total.bytes = retainedBytes[0];
+    for (Obj* obj : graph.objects) {
+        if (obj == nullptr) continue;
+        Row& row = rows[std::string("type\t") + objTypeName(obj->type)];
+        row.objects++;
+        row.bytes += obj->size;
+    }
+    
+    // Objects at the same dominator path sit side by side in the tree, so
+    // their retained sizes add up without counting anything twice.
+    PathTable paths;
+    std::vector<int> pathOf(graph.size(), -1);
+    std::vector<Row> byPath;
+    for (size_t i = 1; i < order.size(); i++) {
+        uint32_t node = order[i];
+        Obj* obj = graph.objects[node];
+        int parent = -1;
+        if (idom[node] != 0) {
+            parent = pathOf[idom[node]];
+        } else if (obj != nullptr) {
+            parent = paths.intern(-1, "(roots)");  // Reached from more than one root
+        }
+        pathOf[node] = paths.intern(parent, obj == nullptr ? graph.labels[node] : objTypeName(obj->type));
+        if (static_cast<size_t>(pathOf[node]) >= byPath.size()) byPath.resize(pathOf[node] + 1);
+        if (pathOf[node] == parent) continue;  // Folded into an ancestor
+        byPath[pathOf[node]].objects += retainedObjects[node];
+        byPath[pathOf[node]].bytes += retainedBytes[node];
+    }
+    uint64_t threshold = std::max<uint64_t>(retainedBytes[0] / 100, 1);
+    for (size_t id = 0; id < byPath.size(); id++) {
+        if (byPath[id].bytes >= threshold) rows["path\t" + paths.text(static_cast<int>(id))] = byPath[id];
+    }
+    
+    // Sampled objects the walk did not reach are garbage.
+    std::vector<Site> liveAt(allocatedAt.size());
+    for (auto it = sampled.begin(); it != sampled.end();) {
+        if (graph.index.count(it->first) == 0) {
+            it = sampled.erase(it);
+            continue;
+        }
+        liveAt[it->second.site].objects += it->second.objects;
+        liveAt[it->second.site].bytes += it->second.bytes;
+        ++it;
+    }
+    for (size_t i = 0; i < siteKeys.size(); i++) {
+        std::string site = "line " + std::to_string(siteKeys[i].first) + " " + objTypeName(siteKeys[i].second);
+        rows["alloc\t" + site] = {static_cast<uint64_t>(std::llround(allocatedAt[i].objects)),
+                                  static_cast<uint64_t>(std::llround(allocatedAt[i].bytes))};
+        if (liveAt[i].objects > 0) {
+            rows["live\t" + site] = {static_cast<uint64_t>(std::llround(liveAt[i].objects)),
+                                     static_cast<uint64_t>(std::llround(liveAt[i].bytes))};
+        }
+    }
+    
+    out << "# fusion heap snapshot: kind, key, objects, bytes\n";
+    for (const auto& [key, row] : rows) {
+        out << key << "\t" << row.objects << "\t" << row.bytes << "\n";
+    }
+}
+
+bool HeapProfiler::writeSnapshot(const Heap& heap, const std::string& path) {
+    std::ofstream file(path);
+    writeSnapshot(heap, file);
+    if (!file.flush()) {
+        std::cerr << "Could not write \"" << path << "\"." << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool diffHeapSnapshots(const std::string& before, const std::string& after, std::ostream& out,
+                       std::ostream& err) {
+    std::map<std::string, Row> old, current;
+    if (!readSnapshot(before, old, err) || !readSnapshot(after, current, err)) return false;
+    
+    struct Change {
+        std::string key;
+        int64_t objects;
+        int64_t bytes;
+    };
+    std::vector<Change> changes;
+    auto compare = [&changes](const std::string& key, const Row& from, const Row& to) {
+        int64_t objects = static_cast<int64_t>(to.objects) - static_cast<int64_t>(from.objects);
+        int64_t bytes = static_cast<int64_t>(to.bytes) - static_cast<int64_t>(from.bytes);
+        if (objects != 0 || bytes != 0) changes.push_back({key, objects, bytes});
+    };
+    for (const auto& [key, row] : current) {
+        auto it = old.find(key);
+        compare(key, it == old.end() ? Row() : it->second, row);
+    }
+    for (const auto& [key, row] : old) {
+        if (current.count(key) == 0) compare(key, row, Row());
+    }
+    std::stable_sort(changes.begin(), changes.end(), [](const Change& a, const Change& b) {
+        return a.bytes > b.bytes;
+    });
+    
+    out << "# bytes, objects, kind, key\n";
+    for (const Change& change : changes) {
+        out << std::showpos << change.bytes << "\t" << change.objects << std::noshowpos << "\t" << change.key
+            << "\n";
+    }
+    return true;
+}
@@ -0,0 +1,593 @@
+#include "../../include/kernels.h"
+#include <cmath>
+#include <limits>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#include <immintrin.h>
+#define KERNELS_X86
+#endif
+
+namespace {
+
+__extension__ typedef __int128 Wide;
+
+constexpr int kLanes = 4;
+
+double applyDoubles(Kernel op, double x, double y) {
+    switch (op) {
+        case Kernel::ADD: return x + y;
+        case Kernel::SUBTRACT: return x - y;
+        case Kernel::MULTIPLY: return x * y;
+        case Kernel::DIVIDE: return x / y;
+    }
+    return 0;
+}
+
+template <typename T>
+bool holds(Compare op, T x, T y) {
+    switch (op) {
+        case Compare::LESS: return x < y;
+        case Compare::GREATER: return x > y;
+        case Compare::LESS_EQUAL: return !(x > y);
+        case Compare::GREATER_EQUAL: return !(x < y);
+    }
+    return false;
+}
+
+// Scalar loops; the vector versions finish their tails with these.
+
+void binaryDoublesScalar(Kernel op, const double* a, size_t aStep, const double* b, size_t bStep,
+                         double* out, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        out[i] = applyDoubles(op, a[i * aStep], b[i * bStep]);
+    }
+}
+
+bool binaryIntsScalar(Kernel op, const int64_t* a, size_t aStep, const int64_t* b, size_t bStep,
+                      int64_t* out, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        int64_t x = a[i * aStep];
+        int64_t y = b[i * bStep];
+        bool overflow;
+        switch (op) {
+            case Kernel::ADD: overflow = __builtin_add_overflow(x, y, &out[i]); break;
+            case Kernel::SUBTRACT: overflow = __builtin_sub_overflow(x, y, &out[i]); break;
+            case Kernel::MULTIPLY: overflow = __builtin_mul_overflow(x, y, &out[i]); break;
+            default: overflow = true; break;
+        }
+        if (overflow) return false;
+    }
+    return true;
+}
+
+template <typename T>
+void compareScalar(Compare op, const T* a, size_t aStep, const T* b, size_t bStep,
+                   uint8_t* out, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        out[i] = holds(op, a[i * aStep], b[i * bStep]);
+    }
+}
+
+double combineLanes(const double lanes[kLanes]) {
+    return (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+}
+
+#ifndef KERNELS_X86
+// Scalar lane sums over whole blocks of four; returns the elements used.
+size_t sumLanesScalar(const double* a, const double* b, size_t n, double lanes[kLanes]) {
+    size_t i = 0;
+    for (; i + kLanes <= n; i += kLanes) {
+        for (int lane = 0; lane < kLanes; lane++) {
+            lanes[lane] += b != nullptr ? a[i + lane] * b[i + lane] : a[i + lane];
+        }
+    }
+    return i;
+}
+#endif
+
+// Sum (or dot product, when b is set) in the fixed lane order.
+double reduceLanes(const double* a, const double* b, size_t n,
+                   size_t (*blocks)(const double*, const double*, size_t, double*)) {
+    double lanes[kLanes] = {0, 0, 0, 0};
+    size_t i = blocks(a, b, n, lanes);
+    for (; i < n; i++) {
+        lanes[i % kLanes] += b != nullptr ? a[i] * b[i] : a[i];
+    }
+    return combineLanes(lanes);
+}
+
+#ifdef KERNELS_X86
+
+bool hasAvx2() {
+    static const bool avx2 = __builtin_cpu_supports("avx2");
+    return avx2;
+}
+
+void storeMask(uint8_t* out, int mask, int lanes) {
+    for (int lane = 0; lane < lanes; lane++) {
+        out[lane] = (mask >> lane) & 1;
+    }
+}
+
+// AVX2
+
+__attribute__((target("avx2")))
+void binaryDoublesAvx2(Kernel op, const double* a, size_t aStep, const double* b, size_t bStep,
+                       double* out, size_t n) {
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m256d x = aStep ? _mm256_loadu_pd(a + i) : _mm256_set1_pd(a[0]);
+        __m256d y = bStep ? _mm256_loadu_pd(b + i) : _mm256_set1_pd(b[0]);
+        __m256d r;
+        switch (op) {
+            case Kernel::ADD: r = _mm256_add_pd(x, y); break;
+            case Kernel::SUBTRACT: r = _mm256_sub_pd(x, y); break;
+            case Kernel::MULTIPLY: r = _mm256_mul_pd(x, y); break;
+            default: r = _mm256_div_pd(x, y); break;
+        }
+        _mm256_storeu_pd(out + i, r);
+    }
+    binaryDoublesScalar(op, a + i * aStep, aStep, b + i * bStep, bStep, out + i, n - i);
+}
+
+// Signed overflow of x + y (or x - y) shows in the sign bit of
+// (x ^ r) & (y ^ r) (or (x ^ y) & (x ^ r)); the bits are or-ed up and
+// checked once at the end.
+__attribute__((target("avx2")))
+bool binaryIntsAvx2(Kernel op, const int64_t* a, size_t aStep, const int64_t* b, size_t bStep,
+                    int64_t* out, size_t n) {
+    size_t i = 0;
+    __m256i overflow = _mm256_setzero_si256();
+    for (; i + 4 <= n; i += 4) {
+        __m256i x = aStep ? _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i))
+                          : _mm256_set1_epi64x(a[0]);
+        __m256i y = bStep ? _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + i))
+                          : _mm256_set1_epi64x(b[0]);
+        __m256i r;
+        if (op == Kernel::ADD) {
+            r = _mm256_add_epi64(x, y);
+            overflow = _mm256_or_si256(overflow, _mm256_and_si256(_mm256_xor_si256(x, r),
+                                                                  _mm256_xor_si256(y, r)));
+        } else {
+            r = _mm256_sub_epi64(x, y);
+            overflow = _mm256_or_si256(overflow, _mm256_and_si256(_mm256_xor_si256(x, y),
+                                                                  _mm256_xor_si256(x, r)));
+        }
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), r);
+    }
+    if (_mm256_movemask_pd(_mm256_castsi256_pd(overflow)) != 0) return false;
+    return binaryIntsScalar(op, a + i * aStep, aStep, b + i * bStep, bStep, out + i, n - i);
+}
+
+__attribute__((target("avx2")))
+void compareDoublesAvx2(Compare op, const double* a, size_t aStep, const double* b, size_t bStep,
+                        uint8_t* out, size_t n) {
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m256d x = aStep ? _mm256_loadu_pd(a + i) : _mm256_set1_pd(a[0]);
+        __m256d y = bStep ? _mm256_loadu_pd(b + i) : _mm256_set1_pd(b[0]);
+        __m256d r;
+        switch (op) {
+            case Compare::LESS: r = _mm256_cmp_pd(x, y, _CMP_LT_OQ); break;
+            case Compare::GREATER: r = _mm256_cmp_pd(x, y, _CMP_GT_OQ); break;
+            case Compare::LESS_EQUAL: r = _mm256_cmp_pd(x, y, _CMP_NGT_UQ); break;
+            default: r = _mm256_cmp_pd(x, y, _CMP_NLT_UQ); break;
+        }
+        storeMask(out + i, _mm256_movemask_pd(r), 4);
+    }
+    compareScalar(op, a + i * aStep, aStep, b + i * bStep, bStep, out + i, n - i);
+}
+
+__attribute__((target("avx2")))
+void compareIntsAvx2(Compare op, const int64_t* a, size_t aStep, const int64_t* b, size_t bStep,
+                     uint8_t* out, size_t n) {
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m256i x = aStep ? _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i))
+                          : _mm256_set1_epi64x(a[0]);
+        __m256i y = bStep ? _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + i))
+                          : _mm256_set1_epi64x(b[0]);
+        bool greater = op == Compare::GREATER || op == Compare::LESS_EQUAL;
+        __m256i r = greater ? _mm256_cmpgt_epi64(x, y) : _mm256_cmpgt_epi64(y, x);
+        int mask = _mm256_movemask_pd(_mm256_castsi256_pd(r));
+        if (op == Compare::LESS_EQUAL || op == Compare::GREATER_EQUAL) mask ^= 0xF;
+        storeMask(out + i, mask, 4);
+    }
+    compareScalar(op, a + i * aStep, aStep, b + i * bStep, bStep, out + i, n - i);
+}
+
+__attribute__((target("avx2")))
+void negateDoublesAvx2(const double* a, double* out, size_t n) {
+    const __m256d sign = _mm256_set1_pd(-0.0);
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        _mm256_storeu_pd(out + i, _mm256_xor_pd(_mm256_loadu_pd(a + i), sign));
+    }
+    for (; i < n; i++) out[i] = -a[i];
+}
+
+__attribute__((target("avx2")))
+bool containsZeroAvx2(const double* a, size_t n) {
+    const __m256d zero = _mm256_setzero_pd();
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        if (_mm256_movemask_pd(_mm256_cmp_pd(_mm256_loadu_pd(a + i), zero, _CMP_EQ_OQ)) != 0) {
+            return true;
+        }
+    }
+    for (; i < n; i++) {
+        if (a[i] == 0) return true;
+    }
+    return false;
+}
+
+__attribute__((target("avx2")))
+bool equalDoublesAvx2(const double* a, const double* b, size_t n) {
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m256d r = _mm256_cmp_pd(_mm256_loadu_pd(a + i), _mm256_loadu_pd(b + i), _CMP_EQ_OQ);
+        if (_mm256_movemask_pd(r) != 0xF) return false;
+    }
+    for (; i < n; i++) {
+        if (!(a[i] == b[i])) return false;
+    }
+    return true;
+}
+
+// One accumulator holds the four lanes.
+__attribute__((target("avx2")))
+size_t sumLanesAvx2(const double* a, const double* b, size_t n, double lanes[kLanes]) {
+    __m256d sum = _mm256_loadu_pd(lanes);
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m256d x = _mm256_loadu_pd(a + i);
+        if (b != nullptr) x = _mm256_mul_pd(x, _mm256_loadu_pd(b + i));
+        sum = _mm256_add_pd(sum, x);
+    }
+    _mm256_storeu_pd(lanes, sum);
+    return i;
+}
+
+__attribute__((target("avx2")))
+double extremeDoublesAvx2(const double* a, size_t n, bool largest) {
+    __m256d best = _mm256_set1_pd(a[0]);
+    __m256d nan = _mm256_setzero_pd();
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m256d x = _mm256_loadu_pd(a + i);
+        nan = _mm256_or_pd(nan, _mm256_cmp_pd(x, x, _CMP_UNORD_Q));
+        best = largest ? _mm256_max_pd(best, x) : _mm256_min_pd(best, x);
+    }
+    if (_mm256_movemask_pd(nan) != 0) return std::numeric_limits<double>::quiet_NaN();
+    
+    double lanes[4];
+    _mm256_storeu_pd(lanes, best);
+    double result = lanes[0];
+    for (int lane = 1; lane < 4; lane++) {
+        result = largest ? std::fmax(result, lanes[lane]) : std::fmin(result, lanes[lane]);
+    }
+    for (; i < n; i++) {
+        if (std::isnan(a[i])) return a[i];
+        if (largest ? a[i] > result : a[i] < result) result = a[i];
+    }
+    return result;
+}
+
+// Lane sums with the same overflow test as binaryIntsAvx2; an overflowing
+// lane only means the caller has to redo the sum exactly.
+__attribute__((target("avx2")))
+bool sumIntsAvx2(const int64_t* a, size_t n, Wide& sum) {
+    __m256i lanes = _mm256_setzero_si256();
+    __m256i overflow = _mm256_setzero_si256();
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i));
+        __m256i r = _mm256_add_epi64(lanes, x);
+        overflow = _mm256_or_si256(overflow, _mm256_and_si256(_mm256_xor_si256(lanes, r),
+                                                              _mm256_xor_si256(x, r)));
+        lanes = r;
+    }
+    if (_mm256_movemask_pd(_mm256_castsi256_pd(overflow)) != 0) return false;
+    
+    int64_t parts[4];
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(parts), lanes);
+    sum = Wide(parts[0]) + parts[1] + parts[2] + parts[3];
+    for (; i < n; i++) sum += a[i];
+    return true;
+}
+
+__attribute__((target("avx2")))
+int64_t extremeIntsAvx2(const int64_t* a, size_t n, bool largest) {
+    __m256i best = _mm256_set1_epi64x(a[0]);
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i));
+        __m256i better = largest ? _mm256_cmpgt_epi64(x, best) : _mm256_cmpgt_epi64(best, x);
+        best = _mm256_blendv_epi8(best, x, better);
+    }
+    
+    int64_t lanes[4];
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(lanes), best);
+    int64_t result = lanes[0];
+    for (int lane = 1; lane < 4; lane++) {
+        if (largest ? lanes[lane] > result : lanes[lane] < result) result = lanes[lane];
+    }
+    for (; i < n; i++) {
+        if (largest ? a[i] > result : a[i] < result) result = a[i];
+    }
+    return result;
+}
+
+// Bytes are 0 or 1, so summing absolute differences from zero counts them.
+__attribute__((target("avx2")))
+size_t countBoolsAvx2(const uint8_t* a, size_t n) {
+    __m256i counts = _mm256_setzero_si256();
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+        __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i));
+        counts = _mm256_add_epi64(counts, _mm256_sad_epu8(x, _mm256_setzero_si256()));
+    }
+    
+    uint64_t parts[4];
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(parts), counts);
+    size_t count = parts[0] + parts[1] + parts[2] + parts[3];
+    for (; i < n; i++) count += a[i];
+    return count;
+}
+
+// SSE2, part of every x86-64 CPU
+
+void binaryDoublesSse2(Kernel op, const double* a, size_t aStep, const double* b, size_t bStep,
+                       double* out, size_t n) {
+    size_t i = 0;
+    for (; i + 2 <= n; i += 2) {
+        __m128d x = aStep ? _mm_loadu_pd(a + i) : _mm_set1_pd(a[0]);
+        __m128d y = bStep ? _mm_loadu_pd(b + i) : _mm_set1_pd(b[0]);
+        __m128d r;
+        switch (op) {
+            case Kernel::ADD: r = _mm_add_pd(x, y); break;
+            case Kernel::SUBTRACT: r = _mm_sub_pd(x, y); break;
+            case Kernel::MULTIPLY: r = _mm_mul_pd(x, y); break;
+            default: r = _mm_div_pd(x, y); break;
+        }
+        _mm_storeu_pd(out + i, r);
+    }
+    binaryDoublesScalar(op, a + i * aStep, aStep, b + i * bStep, bStep, out + i, n - i);
+}
+
+void compareDoublesSse2(Compare op, const double* a, size_t aStep, const double* b, size_t bStep,
+                        uint8_t* out, size_t n) {
+    size_t i = 0;
+    for (; i + 2 <= n; i += 2) {
+        __m128d x = aStep ? _mm_loadu_pd(a + i) : _mm_set1_pd(a[0]);
+        __m128d y = bStep ? _mm_loadu_pd(b + i) : _mm_set1_pd(b[0]);
+        __m128d r;
+        switch (op) {
+            case Compare::LESS: r = _mm_cmplt_pd(x, y); break;
+            case Compare::GREATER: r = _mm_cmpgt_pd(x, y); break;
+            case Compare::LESS_EQUAL: r = _mm_cmpngt_pd(x, y); break;
+            default: r = _mm_cmpnlt_pd(x, y); break;
+        }
+        storeMask(out + i, _mm_movemask_pd(r), 2);
+    }
+    compareScalar(op, a + i * aStep, aStep, b + i * bStep, bStep, out + i, n - i);
+}
+
+void negateDoublesSse2(const double* a, double* out, size_t n) {
+    const __m128d sign = _mm_set1_pd(-0.0);
+    size_t i = 0;
+    for (; i + 2 <= n; i += 2) {
+        _mm_storeu_pd(out + i, _mm_xor_pd(_mm_loadu_pd(a + i), sign));
+    }
+    for (; i < n; i++) out[i] = -a[i];
+}
+
+bool containsZeroSse2(const double* a, size_t n) {
+    const __m128d zero = _mm_setzero_pd();
+    size_t i = 0;
+    for (; i + 2 <= n; i += 2) {
+        if (_mm_movemask_pd(_mm_cmpeq_pd(_mm_loadu_pd(a + i), zero)) != 0) return true;
+    }
+    return i < n && a[i] == 0;
+}
+
+bool equalDoublesSse2(const double* a, const double* b, size_t n) {
+    size_t i = 0;
+    for (; i + 2 <= n; i += 2) {
+        if (_mm_movemask_pd(_mm_cmpeq_pd(_mm_loadu_pd(a + i), _mm_loadu_pd(b + i))) != 0x3) {
+            return false;
+        }
+    }
+    return i == n || a[i] == b[i];
+}
+
+// Two accumulators hold lanes 0-1 and 2-3.
+size_t sumLanesSse2(const double* a, const double* b, size_t n, double lanes[kLanes]) {
+    __m128d low = _mm_loadu_pd(lanes);
+    __m128d high = _mm_loadu_pd(lanes + 2);
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m128d x = _mm_loadu_pd(a + i);
+        __m128d y = _mm_loadu_pd(a + i + 2);
+        if (b != nullptr) {
+            x = _mm_mul_pd(x, _mm_loadu_pd(b + i));
+            y = _mm_mul_pd(y, _mm_loadu_pd(b + i + 2));
+        }
+        low = _mm_add_pd(low, x);
+        high = _mm_add_pd(high, y);
+    }
+    _mm_storeu_pd(lanes, low);
+    _mm_storeu_pd(lanes + 2, high);
+    return i;
+}
+
+size_t countBoolsSse2(const uint8_t* a, size_t n) {
+    __m128i counts = _mm_setzero_si128();
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i));
+        counts = _mm_add_epi64(counts, _mm_sad_epu8(x, _mm_setzero_si128()));
+    }
+    
+    uint64_t parts[2];
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(parts), counts);
+    size_t count = parts[0] + parts[1];
+    for (; i < n; i++) count += a[i];
+    return count;
+}
+
+#endif // KERNELS_X86
+
+bool fitsInt(Wide value) {
+    return value >= std::numeric_limits<int64_t>::min() &&
+           value <= std::numeric_limits<int64_t>::max();
+}
+    
+} // namespace
+
+void binaryDoubles(Kernel op, const double* a, size_t aStep, const double* b, size_t bStep,
+                   double* out, size_t n) {
+#ifdef KERNELS_X86
+    if (hasAvx2()) return binaryDoublesAvx2(op, a, aStep, b, bStep, out, n);
+    return binaryDoublesSse2(op, a, aStep, b, bStep, out, n);
+#else
+    binaryDoublesScalar(op, a, aStep, b, bStep, out, n);
+#endif
+}
+
+bool binaryInts(Kernel op, const int64_t* a, size_t aStep, const int64_t* b, size_t bStep,
+                int64_t* out, size_t n) {
+#ifdef KERNELS_X86
+    // There is no packed 64-bit multiply before AVX-512.
+    if (hasAvx2() && op != Kernel::MULTIPLY) return binaryIntsAvx2(op, a, aStep, b, bStep, out, n);
+#endif
+    return binaryIntsScalar(op, a, aStep, b, bStep, out, n);
+}
+
+void compareDoubles(Compare op, const double* a, size_t aStep, const double* b, size_t bStep,
+                    uint8_t* out, size_t n) {
+#ifdef KERNELS_X86
+    if (hasAvx2()) return compareDoublesAvx2(op, a, aStep, b, bStep, out, n);
+    return compareDoublesSse2(op, a, aStep, b, bStep, out, n);
+#else
+    compareScalar(op, a, aStep, b, bStep, out, n);
+#endif
+}
+
+void compareInts(Compare op, const int64_t* a, size_t aStep, const int64_t* b, size_t bStep,
+                 uint8_t* out, size_t n) {
+#ifdef KERNELS_X86
+    // SSE2 has no 64-bit compare.
+    if (hasAvx2()) return compareIntsAvx2(op, a, aStep, b, bStep, out, n);
+#endif
+    compareScalar(op, a, aStep, b, bStep, out, n);
+}
+
+void negateDoubles(const double* a, double* out, size_t n) {
+#ifdef KERNELS_X86
+    if (hasAvx2()) return negateDoublesAvx2(a, out, n);
+    return negateDoublesSse2(a, out, n);
+#else
+    for (size_t i = 0; i < n; i++) out[i] = -a[i];
+#endif
+}
+
+bool containsZero(const double* a, size_t n) {
+#ifdef KERNELS_X86
+    if (hasAvx2()) return containsZeroAvx2(a, n);
+    return containsZeroSse2(a, n);
+#else
+    for (size_t i = 0; i < n; i++) {
+        if (a[i] == 0) return true;
+    }
+    return false;
+#endif
+}
+
+bool equalDoubles(const double* a, const double* b, size_t n) {
+#ifdef KERNELS_X86
+    if (hasAvx2()) return equalDoublesAvx2(a, b, n);
+    return equalDoublesSse2(a, b, n);
+#else
+    for (size_t i = 0; i < n; i++) {
+        if (!(a[i] == b[i])) return false;
+    }
+    return true;
+#endif
+}
+
+double sumDoubles(const double* a, size_t n) {
+#ifdef KERNELS_X86
+    return reduceLanes(a, nullptr, n, hasAvx2() ? sumLanesAvx2 : sumLanesSse2);
+#else
+    return reduceLanes(a, nullptr, n, sumLanesScalar);
+#endif
+}
+
+double dotDoubles(const double* a, const double* b, size_t n) {
+#ifdef KERNELS_X86
+    return reduceLanes(a, b, n, hasAvx2() ? sumLanesAvx2 : sumLanesSse2);
+#else
+    return reduceLanes(a, b, n, sumLanesScalar);
+#endif
+}
+
+double extremeDoubles(const double* a, size_t n, bool largest) {
+#ifdef KERNELS_X86
+    if (hasAvx2()) return extremeDoublesAvx2(a, n, largest);
+#endif
+    double result = a[0];
+    for (size_t i = 0; i < n; i++) {
+        if (std::isnan(a[i])) return a[i];
+        if (largest ? a[i] > result : a[i] < result) result = a[i];
+    }
+    return result;
+}
+
+bool sumInts(const int64_t* a, size_t n, int64_t& result) {
+    Wide sum = 0;
+    bool done = false;
+#ifdef KERNELS_X86
+    if (hasAvx2()) done = sumIntsAvx2(a, n, sum);
+#endif
+    if (!done) {
+        sum = 0;
+        for (size_t i = 0; i < n; i++) sum += a[i];
+    }
+    if (!fitsInt(sum)) return false;
+    result = static_cast<int64_t>(sum);
+    return true;
+}
+
+bool dotInts(const int64_t* a, const int64_t* b, size_t n, int64_t& result) {
+    // Each product fits in 128 bits; packed 64-bit multiplies need AVX-512.
+    Wide sum = 0;
+    for (size_t i = 0; i < n; i++) {
+        if (__builtin_add_overflow(sum, Wide(a[i]) * b[i], &sum)) return false;
+    }
+    if (!fitsInt(sum)) return false;
+    result = static_cast<int64_t>(sum);
+    return true;
+}
+
+int64_t extremeInts(const int64_t* a, size_t n, bool largest) {
+#ifdef KERNELS_X86
+    if (hasAvx2()) return extremeIntsAvx2(a, n, largest);
+#endif
+    int64_t result = a[0];
+    for (size_t i = 1; i < n; i++) {
+        if (largest ? a[i] > result : a[i] < result) result = a[i];
+    }
+    return result;
+}
+
+size_t countBools(const uint8_t* a, size_t n) {
+#ifdef KERNELS_X86
+    if (hasAvx2()) return countBoolsAvx2(a, n);
+    return countBoolsSse2(a, n);
+#else
+    size_t count = 0;
+    for (size_t i = 0; i < n; i++) count += a[i];
+    return count;
+#endif
+}
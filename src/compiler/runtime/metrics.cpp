@@ -0,0 +1,224 @@
+#include "../../include/metrics.h"
+#include <csignal>
+#include <condition_variable>
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace {
+
+struct Registry {
+    std::mutex mutex;
+    std::vector<std::unique_ptr<ThreadMetrics>> threads;  // Of running threads
+    MetricsSnapshot retired;  // Folded in from threads that have exited
+};
+
+// Set once this thread's block is retired; counting while the thread's
+// other thread-locals are destroyed gets a block that is never retired.
+thread_local bool exited = false;
+
+Registry& registry() {
+    static Registry instance;
+    return instance;
+}
+
+struct Exporter {
+    std::string path;
+    std::chrono::nanoseconds interval{0};
+    int signal = 0;
+    std::thread thread;
+    std::mutex mutex;
+    std::condition_variable wake;
+    bool stopping = false;
+};
+
+Exporter exporter;
+// Set by the signal handler and taken by the exporter's thread, so it must
+// be an atomic that works without a lock.
+std::atomic<bool> exportRequested{false};
+static_assert(std::atomic<bool>::is_always_lock_free, "the signal handler needs a lock-free flag");
+
+// How often the exporter looks for a signal that arrived.
+constexpr auto kSignalPoll = std::chrono::milliseconds(100);
+
+void requestExport(int) {
+    exportRequested.store(true, std::memory_order_relaxed);
+}
+
+bool writeFile(const std::string& path) {
+    std::string temporary = path + ".tmp";
+    {
+        std::ofstream file(temporary);
+        Metrics::collect().writePrometheus(file);
+        if (!file.flush()) return false;
+    }
+    return std::rename(temporary.c_str(), path.c_str()) == 0;
+}
+
+void exportLoop() {
+    using Clock = std::chrono::steady_clock;
+    Clock::time_point due = Clock::now() + exporter.interval;
+    std::unique_lock<std::mutex> lock(exporter.mutex);
+    while (!exporter.stopping) {
+        exporter.wake.wait_for(lock, kSignalPoll);
+        bool periodic = exporter.interval.count() > 0 && Clock::now() >= due;
+        if (exportRequested.exchange(false, std::memory_order_relaxed) || periodic) {
+            if (periodic) due = Clock::now() + exporter.interval;
+            writeFile(exporter.path);
+        }
+    }
+}
+
+void writeCounter(std::ostream& out, const char* name, const char* help, uint64_t value) {
+    out << "# HELP " << name << " " << help << "\n"
+        << "# TYPE " << name << " counter\n"
+        << name << " " << value << "\n";
+}
+
+void writeGauge(std::ostream& out, const char* name, const char* help, uint64_t added, uint64_t taken) {
+    out << "# HELP " << name << " " << help << "\n"
+        << "# TYPE " << name << " gauge\n"
+        << name << " " << (added > taken ? added - taken : 0) << "\n";
+}
+    
+} // namespace
+
+void MetricsSnapshot::writePrometheus(std::ostream& out) const {
+    const MetricsSnapshot& m = *this;
+    writeCounter(out, "fusion_instructions_total", "Bytecode instructions run by the interpreter.",
+                 m[Metric::INSTRUCTIONS]);
+    writeCounter(out, "fusion_jit_entries_total", "Entries from the interpreter into native code.",
+                 m[Metric::JIT_ENTRIES]);
+    writeCounter(out, "fusion_jit_compiles_total", "Chunks compiled to native code.", m[Metric::JIT_COMPILES]);
+    writeCounter(out, "fusion_jit_cache_hits_total", "Runs that reused already compiled native code.",
+                 m[Metric::JIT_CACHE_HITS]);
+    writeCounter(out, "fusion_preemptions_total", "Runs preempted for using up their fuel.",
+                 m[Metric::PREEMPTIONS]);
+    writeCounter(out, "fusion_allocations_total", "Objects allocated.", m[Metric::ALLOCATIONS]);
+    writeCounter(out, "fusion_allocated_bytes_total", "Bytes allocated.", m[Metric::ALLOCATED_BYTES]);
+    writeCounter(out, "fusion_gc_minor_collections_total", "Nursery collections.", m[Metric::MINOR_COLLECTIONS]);
+    writeCounter(out, "fusion_gc_major_collections_total", "Completed major collection cycles.",
+                 m[Metric::MAJOR_COLLECTIONS]);
+    
+    out << "# HELP fusion_gc_pause_seconds Mutator pauses for garbage collection.\n"
+        << "# TYPE fusion_gc_pause_seconds histogram\n";
+    char bound[32];
+    uint64_t cumulative = 0;
+    for (size_t i = 0; i < kPauseBounds.size(); i++) {
+        cumulative += pauses[i];
+        std::snprintf(bound, sizeof(bound), "%g", kPauseBounds[i] / 1e9);
+        out << "fusion_gc_pause_seconds_bucket{le=\"" << bound << "\"} " << cumulative << "\n";
+    }
+    cumulative += pauses.back();
+    std::snprintf(bound, sizeof(bound), "%.9f", pauseNanos / 1e9);
+    out << "fusion_gc_pause_seconds_bucket{le=\"+Inf\"} " << cumulative << "\n"
+        << "fusion_gc_pause_seconds_sum " << bound << "\n"
+        << "fusion_gc_pause_seconds_count " << cumulative << "\n";
+    
+    writeCounter(out, "fusion_awaits_total", "Awaits started.", m[Metric::AWAITS_STARTED]);
+    writeGauge(out, "fusion_awaits_pending", "Scripts parked on an await.", m[Metric::AWAITS_STARTED],
+               m[Metric::AWAITS_FINISHED]);
+    writeCounter(out, "fusion_pool_jobs_total", "Jobs submitted to the thread pool.", m[Metric::JOBS_SUBMITTED]);
+    writeGauge(out, "fusion_pool_jobs_queued", "Thread pool jobs not yet completed.", m[Metric::JOBS_SUBMITTED],
+               m[Metric::JOBS_FINISHED]);
+    writeCounter(out, "fusion_timers_total", "Timers added to the event loop.", m[Metric::TIMERS_ADDED]);
+    writeGauge(out, "fusion_timers_pending", "Timers not yet fired.", m[Metric::TIMERS_ADDED],
+               m[Metric::TIMERS_FIRED]);
+}
+
+void Metrics::recordPause(std::chrono::nanoseconds pause) {
+    ThreadMetrics& metrics = local();
+    size_t bucket = 0;
+    while (bucket < kPauseBounds.size() && pause.count() > kPauseBounds[bucket]) {
+        bucket++;
+    }
+    bump(metrics.pauses[bucket], 1);
+    bump(metrics.pauseNanos, static_cast<uint64_t>(pause.count()));
+}
+
+MetricsSnapshot Metrics::collect() {
+    Registry& r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    MetricsSnapshot snapshot = r.retired;
+    for (auto& thread : r.threads) {
+        for (size_t i = 0; i < kMetricCount; i++) {
+            snapshot.counters[i] += thread->counters[i].load(std::memory_order_relaxed);
+        }
+        for (size_t i = 0; i < snapshot.pauses.size(); i++) {
+            snapshot.pauses[i] += thread->pauses[i].load(std::memory_order_relaxed);
+        }
+        snapshot.pauseNanos += thread->pauseNanos.load(std::memory_order_relaxed);
+    }
+    return snapshot;
+}
+
+size_t Metrics::threadBlocks() {
+    Registry& r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    return r.threads.size();
+}
+
+bool Metrics::startExport(const std::string& path, std::chrono::nanoseconds interval, int signal) {
+    if (!writeFile(path)) return false;
+    exporter.path = path;
+    exporter.interval = interval;
+    exporter.signal = signal;
+    exporter.stopping = false;
+    std::signal(signal, requestExport);
+    exporter.thread = std::thread(exportLoop);
+    return true;
+}
+
+void Metrics::stopExport() {
+    if (!exporter.thread.joinable()) return;
+    {
+        std::lock_guard<std::mutex> lock(exporter.mutex);
+        exporter.stopping = true;
+    }
+    exporter.wake.notify_one();
+    exporter.thread.join();
+    std::signal(exporter.signal, SIG_DFL);
+    writeFile(exporter.path);
+}
+
+struct Metrics::Retirement {
+    ~Retirement() { detach(); }
+};
+
+ThreadMetrics& Metrics::attach() {
+    Registry& r = registry();
+    {
+        std::lock_guard<std::mutex> lock(r.mutex);
+        r.threads.push_back(std::make_unique<ThreadMetrics>());
+        current = r.threads.back().get();
+    }
+    if (!exited) {
+        // Constructed on the thread's first count, so destroyed as it exits.
+        static thread_local Retirement retirement;
+        (void)retirement;
+    }
+    return *current;
+}
+
+void Metrics::detach() {
+    Registry& r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    for (size_t i = 0; i < kMetricCount; i++) {
+        r.retired.counters[i] += current->counters[i].load(std::memory_order_relaxed);
+    }
+    for (size_t i = 0; i < r.retired.pauses.size(); i++) {
+        r.retired.pauses[i] += current->pauses[i].load(std::memory_order_relaxed);
+    }
+    r.retired.pauseNanos += current->pauseNanos.load(std::memory_order_relaxed);
+    for (auto it = r.threads.begin(); it != r.threads.end(); ++it) {
+        if (it->get() == current) {
+            r.threads.erase(it);
+            break;
+        }
+    }
+    current = nullptr;
+    exited = true;
+}
@@ -0,0 +1,30 @@
+#include "../../include/output.h"
+#include <cerrno>
+#include <cstdio>
+#include <unistd.h>
+
+Output::Output() : policy(isatty(STDOUT_FILENO) ? FlushPolicy::LINE : FlushPolicy::BLOCK) {
+    buffer.reserve(kOutputBlockSize + 256);
+}
+
+Output::~Output() {
+    flush();
+}
+
+void Output::flush() {
+    if (buffer.empty()) return;
+    std::fflush(stdout);
+    
+    const char* data = buffer.data();
+    size_t left = buffer.size();
+    while (left > 0) {
+        ssize_t written = write(STDOUT_FILENO, data, left);
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            break;  // Closed pipe or full disk: drop the output, as stdio would
+        }
+        data += written;
+        left -= static_cast<size_t>(written);
+    }
+    buffer.clear();
+}
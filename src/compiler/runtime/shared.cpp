@@ -0,0 +1,94 @@
+#include "../../include/shared.h"
+#include <cstdlib>
+#include <new>
+
+SharedHeap::~SharedHeap() {
+    for (uint8_t* arena : arenas) {
+        std::free(arena);
+    }
+    while (messages != nullptr) {
+        Message* next = messages->next;
+        std::free(messages);
+        messages = next;
+    }
+}
+
+ObjString* SharedHeap::shareString(const char* chars, size_t length) {
+    std::lock_guard<std::mutex> lock(mutex);
+    
+    auto it = interned.find(std::string_view(chars, length));
+    if (it != interned.end()) return it->second;
+    
+    size_t size = stringAllocationSize(length);
+    auto* string = static_cast<ObjString*>(allocate(size));
+    string->type = ObjType::STRING;
+    string->flags = OBJ_SHARED;
+    string->size = static_cast<uint32_t>(size);
+    string->length = static_cast<uint32_t>(length);
+    // Hashed up front: shared strings are never written again.
+    string->hash = hashChars(chars, length);
+    std::memcpy(string->chars(), chars, length);
+    string->chars()[length] = '\0';
+    
+    interned.emplace(std::string_view(string->chars(), length), string);
+    return string;
+}
+
+uint8_t* SharedHeap::allocateMessage(size_t size) {
+    auto* message = static_cast<Message*>(std::aligned_alloc(kObjAlignment, sizeof(Message) + size));
+    if (message == nullptr) throw std::bad_alloc();
+    message->owner = this;
+    message->size = size;
+    message->prev = nullptr;
+    
+    std::lock_guard<std::mutex> lock(mutex);
+    message->next = messages;
+    if (messages != nullptr) messages->prev = message;
+    messages = message;
+    allocated += size;
+    return reinterpret_cast<uint8_t*>(message + 1);
+}
+
+void SharedHeap::releaseMessage(const Obj* root) {
+    auto* message = reinterpret_cast<Message*>(const_cast<Obj*>(root)) - 1;
+    SharedHeap& region = *message->owner;
+    {
+        std::lock_guard<std::mutex> lock(region.mutex);
+        if (message->prev != nullptr) {
+            message->prev->next = message->next;
+        } else {
+            region.messages = message->next;
+        }
+        if (message->next != nullptr) message->next->prev = message->prev;
+        region.allocated -= message->size;
+    }
+    std::free(message);
+}
+
+size_t SharedHeap::bytesAllocated() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return allocated;
+}
+
+void* SharedHeap::allocate(size_t size) {
+    if (top == nullptr || top + size > end) {
+        size_t arenaSize = size > kArenaSize ? size : kArenaSize;
+        uint8_t* arena = static_cast<uint8_t*>(std::aligned_alloc(kObjAlignment, arenaSize));
+        if (arena == nullptr) throw std::bad_alloc();
+        arenas.push_back(arena);
+        
+        // An oversized string gets an arena of its own; keep bumping in
+        // the previous one if it still has room.
+        if (arenaSize > kArenaSize && top != nullptr) {
+            allocated += size;
+            return arena;
+        }
+        top = arena;
+        end = arena + arenaSize;
+    }
+    
+    void* result = top;
+    top += size;
+    allocated += size;
+    return result;
+}
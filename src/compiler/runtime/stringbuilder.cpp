@@ -0,0 +1,54 @@
+#include "../../include/stringbuilder.h"
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+constexpr size_t kMinCapacity = 64;
+
+const ObjString* asString(const Value& value) {
+    return static_cast<const ObjString*>(std::get<Obj*>(value));
+}
+    
+} // namespace
+
+const char* appendStrings(Heap& heap, Value& variable, const Value* pieces, size_t count) {
+    Obj* target = std::get<Obj*>(variable);
+    bool building = target->type == ObjType::STRING_BUILDER;
+    size_t length = building ? static_cast<ObjStringBuilder*>(target)->length
+                             : static_cast<ObjString*>(target)->length;
+    size_t needed = length;
+    for (size_t i = 0; i < count; i++) {
+        needed += asString(pieces[i])->length;
+    }
+    if (needed > kMaxStringLength) return "String too long.";
+    
+    if (!building || static_cast<ObjStringBuilder*>(target)->capacity < needed) {
+        size_t capacity = std::min(std::max(2 * needed, kMinCapacity), kMaxStringLength);
+        ObjStringBuilder* grown = heap.allocateStringBuilder(capacity);
+        target = std::get<Obj*>(variable);  // May have moved
+        const char* chars = building ? static_cast<ObjStringBuilder*>(target)->chars()
+                                     : static_cast<ObjString*>(target)->chars();
+        std::memcpy(grown->chars(), chars, length);
+        grown->length = static_cast<uint32_t>(length);
+        variable = static_cast<Obj*>(grown);
+    }
+    
+    auto* builder = static_cast<ObjStringBuilder*>(std::get<Obj*>(variable));
+    for (size_t i = 0; i < count; i++) {
+        const ObjString* piece = asString(pieces[i]);
+        std::memcpy(builder->chars() + builder->length, piece->chars(), piece->length);
+        builder->length += piece->length;
+    }
+    return nullptr;
+}
+
+void flattenString(Heap& heap, Value& variable) {
+    if (!isObjType(std::get<Obj*>(variable), ObjType::STRING_BUILDER)) return;
+    
+    size_t length = static_cast<ObjStringBuilder*>(std::get<Obj*>(variable))->length;
+    ObjString* string = heap.allocateString(length);
+    auto* builder = static_cast<ObjStringBuilder*>(std::get<Obj*>(variable));
+    std::memcpy(string->chars(), builder->chars(), length);
+    variable = static_cast<Obj*>(string);
+}
@@ -0,0 +1,186 @@
+#include "../../include/timeline.h"
+#include <array>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace {
+
+constexpr size_t kBufferEvents = 1 << 14;  // Per thread, a power of two
+constexpr auto kFlushInterval = std::chrono::milliseconds(100);
+
+struct Event {
+    const char* category;
+    const char* name;
+    uint64_t start;     // Timeline::now()
+    uint64_t duration;  // 0 for an instant
+    bool instant;
+};
+
+// Ring of one thread's events: only that thread pushes, only the flusher
+// pops.
+struct ThreadBuffer {
+    std::array<Event, kBufferEvents> events;
+    std::atomic<uint64_t> head{0};  // Next slot to write
+    std::atomic<uint64_t> tail{0};  // Next slot to read
+    std::atomic<uint64_t> dropped{0};
+    std::atomic<const char*> name{nullptr};
+    int thread = 0;
+    bool named = false;  // Flusher has written the name
+    
+    void push(const Event& event) {
+        uint64_t at = head.load(std::memory_order_relaxed);
+        if (at - tail.load(std::memory_order_acquire) == kBufferEvents) {
+            dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        events[at % kBufferEvents] = event;
+        head.store(at + 1, std::memory_order_release);
+    }
+};
+
+struct State {
+    std::mutex mutex;  // Guards buffers and the file
+    std::vector<std::unique_ptr<ThreadBuffer>> buffers;
+    std::ofstream file;
+    uint64_t epoch = 0;
+    bool first = true;  // No event written yet
+    
+    std::thread flusher;
+    std::mutex flusherMutex;
+    std::condition_variable flusherWake;
+    bool stopping = false;
+};
+
+State& state() {
+    static State instance;
+    return instance;
+}
+
+thread_local ThreadBuffer* threadBuffer = nullptr;
+
+ThreadBuffer& currentBuffer() {
+    if (threadBuffer == nullptr) {
+        State& s = state();
+        std::lock_guard<std::mutex> lock(s.mutex);
+        s.buffers.push_back(std::make_unique<ThreadBuffer>());
+        threadBuffer = s.buffers.back().get();
+        threadBuffer->thread = static_cast<int>(s.buffers.size());
+    }
+    return *threadBuffer;
+}
+
+void writeSeparator(State& s) {
+    s.file << (s.first ? "\n" : ",\n");
+    s.first = false;
+}
+
+// Write out everything recorded so far; s.mutex must be held.
+void drain(State& s) {
+    char number[64];
+    for (auto& buffer : s.buffers) {
+        const char* name = buffer->name.load(std::memory_order_acquire);
+        if (!buffer->named && name != nullptr) {
+            writeSeparator(s);
+            s.file << "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": " << buffer->thread
+                   << ", \"args\": {\"name\": \"" << name << "\"}}";
+            buffer->named = true;
+        }
+        
+        uint64_t tail = buffer->tail.load(std::memory_order_relaxed);
+        uint64_t head = buffer->head.load(std::memory_order_acquire);
+        for (; tail != head; tail++) {
+            const Event& event = buffer->events[tail % kBufferEvents];
+            writeSeparator(s);
+            // Microseconds, with nanosecond precision.
+            std::snprintf(number, sizeof(number), "%.3f", (event.start - s.epoch) / 1e3);
+            s.file << "{\"name\": \"" << event.name << "\", \"cat\": \"" << event.category
+                   << "\", \"ph\": \"" << (event.instant ? "i" : "X") << "\", \"ts\": " << number;
+            if (event.instant) {
+                s.file << ", \"s\": \"t\"";
+            } else {
+                std::snprintf(number, sizeof(number), "%.3f", event.duration / 1e3);
+                s.file << ", \"dur\": " << number;
+            }
+            s.file << ", \"pid\": 1, \"tid\": " << buffer->thread << "}";
+        }
+        buffer->tail.store(tail, std::memory_order_release);
+    }
+    s.file.flush();
+}
+
+void flusherLoop() {
+    State& s = state();
+    std::unique_lock<std::mutex> wait(s.flusherMutex);
+    while (!s.stopping) {
+        s.flusherWake.wait_for(wait, kFlushInterval);
+        std::lock_guard<std::mutex> lock(s.mutex);
+        drain(s);
+    }
+}
+    
+} // namespace
+
+std::atomic<bool> Timeline::active{false};
+
+bool Timeline::start(const std::string& path) {
+    State& s = state();
+    {
+        std::lock_guard<std::mutex> lock(s.mutex);
+        s.file.open(path);
+        if (!s.file) return false;
+        s.file << "{\"displayTimeUnit\": \"ns\", \"traceEvents\": [";
+        s.epoch = now();
+    }
+    s.stopping = false;
+    s.flusher = std::thread(flusherLoop);
+    active.store(true, std::memory_order_release);
+    nameThread("main");
+    return true;
+}
+
+void Timeline::stop() {
+    if (!active.exchange(false)) return;
+    
+    State& s = state();
+    {
+        std::lock_guard<std::mutex> lock(s.flusherMutex);
+        s.stopping = true;
+    }
+    s.flusherWake.notify_one();
+    s.flusher.join();
+    
+    std::lock_guard<std::mutex> lock(s.mutex);
+    drain(s);
+    uint64_t dropped = 0;
+    for (auto& buffer : s.buffers) {
+        dropped += buffer->dropped.load(std::memory_order_relaxed);
+    }
+    s.file << "\n], \"otherData\": {\"droppedEvents\": " << dropped << "}}\n";
+    s.file.close();
+}
+
+uint64_t Timeline::now() {
+    auto since = std::chrono::steady_clock::now().time_since_epoch();
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(since).count());
+}
+
+void Timeline::complete(const char* category, const char* name, uint64_t start, uint64_t end) {
+    if (!enabled()) return;
+    currentBuffer().push({category, name, start, end - start, false});
+}
+
+void Timeline::instant(const char* category, const char* name) {
+    if (!enabled()) return;
+    currentBuffer().push({category, name, now(), 0, true});
+}
+
+void Timeline::nameThread(const char* name) {
+    if (!enabled()) return;
+    currentBuffer().name.store(name, std::memory_order_release);
+}
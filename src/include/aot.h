@@ -0,0 +1,40 @@
+#ifndef AOT_H
+#define AOT_H
+
+#include <ostream>
+#include <string>
+#include "bytecode.h"
+
+// Build result codes
+enum class BuildResult {
+    OK,
+    COMPILE_ERROR,  // The script itself does not compile
+    BUILD_ERROR     // Lowering, the C++ compiler or the runtime library failed
+};
+
+// Ahead-of-time compiler behind `fusion build`.
+//
+// The chunk is lowered to straight C++: every operand stack slot becomes a
+// fixed slot of NativeRuntime::stack() (stack depths are static), and every
+// instruction becomes one runtime call with its number fast path inlined.
+// The system C++ compiler then links that against libfusionrt.a, so the
+// executable has neither a dispatch loop nor a compile step at startup.
+//
+// The runtime library and headers are looked up in $FUSION_HOME, or next to
+// the fusion executable; $CXX selects the compiler (default g++).
+class AotCompiler {
+public:
+    static BuildResult build(const std::string& source, const std::string& sourceName,
+                             const std::string& output);
+    
+    // Write the C++ translation of chunk to out; false with error set for
+    // bytecode that cannot be lowered.
+    static bool generate(const Chunk& chunk, const std::string& sourceName,
+                         std::ostream& out, std::string& error);
+
+private:
+    static bool link(const std::string& cppPath, const std::string& output, std::string& error);
+    static std::string runtimeHome();
+};
+
+#endif // AOT_H
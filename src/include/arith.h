@@ -0,0 +1,70 @@
+#ifndef ARITH_H
+#define ARITH_H
+
+#include "bytecode.h"
+
+// Numeric operators on Values, shared by the VM and the native runtime so
+// both follow the same rules:
+// - int op int stays an int; overflow is an error, never a wrap or a
+//   silent switch to double
+// - mixing an int with a double computes in double
+// - '/' always divides in double; 'div' floors, '%' takes the divisor's sign
+// - bitwise operators and shifts take ints only
+//
+// The VM and runtime keep their double-only fast paths inline and call
+// these for everything else. Each returns nullptr and sets result, or the
+// runtime error message.
+const char* numericBinary(OpCode op, const Value& a, const Value& b, Value& result);
+const char* numericUnary(OpCode op, const Value& a, Value& result);
+
+// Condition of a fused compare-and-branch opcode on same-typed operands.
+template <typename T>
+inline bool branchHolds(OpCode op, T a, T b) {
+    switch (op) {
+        case OpCode::EQUAL_JUMP: return a == b;
+        case OpCode::NOT_EQUAL_JUMP: return !(a == b);
+        case OpCode::LESS_JUMP: return a < b;
+        case OpCode::LESS_EQUAL_JUMP: return !(a > b);
+        case OpCode::GREATER_JUMP: return a > b;
+        case OpCode::GREATER_EQUAL_JUMP: return !(a < b);
+        default: return false;
+    }
+}
+
+// Same for any operands: equality follows valuesEqual, ordering the numeric
+// rules above.
+const char* branchCondition(OpCode op, const Value& a, const Value& b, bool& holds);
+
+// Delay of `await <number>`, clamped to EventLoop::kMaxDelayMs; NaN and
+// negative delays are errors.
+const char* awaitDelay(const Value& operand, int64_t& milliseconds);
+
+// Checked int arithmetic used by both the generic and the *_INT opcodes.
+inline const char* addInts(int64_t a, int64_t b, Value& result) {
+    int64_t sum;
+    if (__builtin_add_overflow(a, b, &sum)) return "Integer overflow.";
+    result = sum;
+    return nullptr;
+}
+
+inline const char* subtractInts(int64_t a, int64_t b, Value& result) {
+    int64_t difference;
+    if (__builtin_sub_overflow(a, b, &difference)) return "Integer overflow.";
+    result = difference;
+    return nullptr;
+}
+
+inline const char* multiplyInts(int64_t a, int64_t b, Value& result) {
+    int64_t product;
+    if (__builtin_mul_overflow(a, b, &product)) return "Integer overflow.";
+    result = product;
+    return nullptr;
+}
+
+inline const char* negateInt(int64_t a, Value& result) {
+    if (a == INT64_MIN) return "Integer overflow.";
+    result = -a;
+    return nullptr;
+}
+
+#endif // ARITH_H
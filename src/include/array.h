@@ -0,0 +1,46 @@
+#ifndef ARRAY_H
+#define ARRAY_H
+
+#include <string>
+#include <vector>
+#include "bytecode.h"
+#include "gc.h"
+
+// Array operations shared by the VM and the native runtime.
+//
+// Arrays of ints, numbers or bools are stored packed (see ArrayStorage), and
+// operators on them run the vector kernels in kernels.h:
+// - + - * / and < > <= >= apply element-wise, to two arrays of the same
+//   length or to an array and a scalar; comparisons give a bool array
+// - the other numeric operators, and arrays with boxed storage, go element
+//   by element through numericBinary() with the same rules as scalars
+// - == compares whole arrays (see valuesEqual), it is not element-wise
+//
+// Array operands must be collector roots (stack slots), since the result
+// is allocated while they are still needed. Each returns nullptr and sets
+// its result, or the runtime error message.
+
+// Array of count values; the storage follows from their types. The result
+// may be elements[0].
+const char* buildArray(Heap& heap, Value* elements, size_t count, Value& result);
+// An array of length copies of fill.
+const char* fillArray(Heap& heap, size_t length, const Value& fill, Value& result);
+
+// Indexing a dict looks up a key instead (see dict.h).
+const char* getIndex(const Value& array, const Value& index, Value& result);
+const char* setIndex(Heap& heap, const Value& array, const Value& index, const Value& value);
+
+// a <op> b with at least one array operand; the result replaces a.
+const char* arrayBinary(Heap& heap, OpCode op, Value& a, const Value& b);
+// NEGATE or BIT_NOT of an array; the result replaces a.
+const char* arrayUnary(Heap& heap, OpCode op, Value& a);
+
+// Element i of any array as a Value.
+Value arrayElement(const ObjArray* array, size_t i);
+// Elements of a NUMBERS or INTS array as doubles; ints are widened into
+// scratch. Valid until the next allocation.
+const double* arrayNumbers(const ObjArray* array, std::vector<double>& scratch);
+
+bool arraysEqual(const ObjArray* a, const ObjArray* b);
+
+#endif // ARRAY_H
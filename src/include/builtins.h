@@ -0,0 +1,32 @@
+#ifndef BUILTINS_H
+#define BUILTINS_H
+
+#include <string>
+#include "bytecode.h"
+#include "gc.h"
+
+// Functions built into the language, called by name. The compiler resolves
+// the name and emits CALL_BUILTIN with the id.
+//   len(a)            elements of an array, characters of a string,
+//                     entries of a dict
+//   array(n, fill)    n copies of fill (default 0.0)
+//   sum(a), min(a), max(a), dot(a, b)
+//   all(a), any(a)    whether every / some element is truthy
+//   keys(d), values(d)  arrays in the dict's iteration order
+//   has(d, k)         whether the dict has the key
+//   get(d, k, other)  the key's value, or other (default null)
+//   remove(d, k)      delete the key; whether it was there
+// Reductions over packed arrays run the kernels in kernels.h.
+enum class Builtin : uint8_t { LEN, ARRAY, SUM, MIN, MAX, DOT, ALL, ANY, KEYS, VALUES, HAS, GET, REMOVE };
+
+// False for names that are not builtins.
+bool findBuiltin(const std::string& name, Builtin& builtin, int& minArity, int& maxArity);
+const char* builtinName(Builtin builtin);
+// False for ids that are not builtins.
+bool builtinArity(uint8_t id, int& minArity, int& maxArity);
+
+// args are argc collector roots (stack slots). Returns nullptr and sets
+// result, which may be args[0], or the runtime error message.
+const char* callBuiltin(Heap& heap, Builtin builtin, Value* args, int argc, Value& result);
+
+#endif // BUILTINS_H
@@ -1,11 +1,14 @@
 #ifndef BYTECODE_H
 #define BYTECODE_H
 
+#include <iostream>
+#include <memory>
 #include <vector>
 #include <string>
 #include <unordered_map>
 #include <variant>
 #include <cstdint>
+#include "object.h"
 
 // Bytecode instruction opcodes
 enum class OpCode : uint8_t {
@@ -19,13 +22,167 @@ enum class OpCode : uint8_t {
     EQUALS,   // Compare top two values for equality
     GREATER,  // Compare second value > top value
     LESS,     // Compare second value < top value
+    LESS_EQUAL,    // !(second > top); typed forms use GREATER + NOT
+    GREATER_EQUAL, // !(second < top)
+    FLOOR_DIVIDE, // Divide and round toward negative infinity ('div')
+    MODULO,       // Remainder with the sign of the divisor ('%')
+    BIT_AND,      // Bitwise operators take ints only
+    BIT_OR,
+    BIT_XOR,
+    BIT_NOT,
+    SHIFT_LEFT,
+    SHIFT_RIGHT,  // Arithmetic shift
+    
+    // Forms emitted when the type checker proved the operand types; the VM
+    // does not check the tags again
+    ADD_NUMBER,
+    SUBTRACT_NUMBER,
+    MULTIPLY_NUMBER,
+    DIVIDE_NUMBER,   // Still checks for division by zero
+    NEGATE_NUMBER,
+    EQUALS_NUMBER,
+    GREATER_NUMBER,
+    LESS_NUMBER,
+    ADD_INT,         // Int forms still check for overflow
+    SUBTRACT_INT,
+    MULTIPLY_INT,
+    NEGATE_INT,
+    EQUALS_INT,
+    GREATER_INT,
+    LESS_INT,
+    CONCAT,          // Concatenate two strings
+    
+    GET_LOCAL,       // Push the variable in the slot named by the operand byte
+    SET_LOCAL,       // Pop into the variable slot
+    // String variables a loop appends to (see stringbuilder.h)
+    GET_STRING_LOCAL, // GET_LOCAL that first turns a builder back into a string
+    APPEND_LOCAL,     // Operands: slot, count; pop count strings and append them
+    GET_MEMBER,       // Push an imported module's variable, named by the Chunk::members operand
+    
+    // Arrays and dicts
+    BUILD_ARRAY,     // Replace the operand-byte count of values with an array of them
+    BUILD_DICT,      // Replace the operand-byte count of key/value pairs with a dict
+    GET_INDEX,       // Pop index (or key) and array (or dict), push the element
+    SET_INDEX,       // Pop value, index and array; store the element
+    CALL_BUILTIN,    // Operands: Builtin id, argument count; the result replaces the arguments
+    
+    // Control flow. The 16-bit big-endian offset operand counts from the
+    // end of the instruction.
+    JUMP,            // Jump forward
+    JUMP_IF_FALSE,   // Pop the condition; jump forward when it is falsy
+    JUMP_IF_TRUE,    // Pop the condition; jump forward when it is truthy
+    // 'and'/'or' as values: jump keeping the top when it decides the
+    // result, else pop it and evaluate the right operand
+    JUMP_IF_FALSE_OR_POP,
+    JUMP_IF_TRUE_OR_POP,
+    LOOP,            // Jump backward; a third operand byte indexes Chunk::loopCounts
+    
+    // Fused compare-and-branch: pop two values and jump forward unless
+    // "second <op> top" holds. <= and >= are the negations of > and <, as
+    // in the unfused forms.
+    EQUAL_JUMP,
+    NOT_EQUAL_JUMP,
+    LESS_JUMP,
+    LESS_EQUAL_JUMP,
+    GREATER_JUMP,
+    GREATER_EQUAL_JUMP,
+    
     PRINT,    // Print top value on stack
     POP,      // Remove top value from stack
+    AWAIT,    // Suspend until the operation on top of stack completes
     RETURN    // End execution
 };
 
-// Runtime value types
-using Value = std::variant<double, bool, std::string, std::nullptr_t>;
+// Runtime value types; strings and other heap data live behind Obj*.
+// Ints are stored unboxed next to doubles.
+using Value = std::variant<double, bool, Obj*, std::nullptr_t, int64_t>;
+
+// Helpers shared by the VM and the native runtime, so both agree on
+// truthiness, equality and how values print.
+inline bool isStringValue(const Value& value) {
+    return std::holds_alternative<Obj*>(value) &&
+           isObjType(std::get<Obj*>(value), ObjType::STRING);
+}
+
+inline bool isArrayValue(const Value& value) {
+    return std::holds_alternative<Obj*>(value) &&
+           isObjType(std::get<Obj*>(value), ObjType::ARRAY);
+}
+
+inline bool isDictValue(const Value& value) {
+    return std::holds_alternative<Obj*>(value) &&
+           isObjType(std::get<Obj*>(value), ObjType::DICT);
+}
+
+// Elements of an array with VALUES storage.
+inline Value* arrayValues(ObjArray* array) {
+    return reinterpret_cast<Value*>(array + 1);
+}
+
+inline const Value* arrayValues(const ObjArray* array) {
+    return reinterpret_cast<const Value*>(array + 1);
+}
+
+// Keys and values of a dict table, interleaved: capacity pairs.
+inline Value* dictTableValues(ObjDictTable* table) {
+    return reinterpret_cast<Value*>(table + 1);
+}
+
+inline const Value* dictTableValues(const ObjDictTable* table) {
+    return reinterpret_cast<const Value*>(table + 1);
+}
+
+// Payload of a value the type checker proved to be a number. Skips the
+// variant's tag check, so calling it on anything else is undefined.
+inline double numberOf(const Value& value) {
+    if (!std::holds_alternative<double>(value)) __builtin_unreachable();
+    return *std::get_if<double>(&value);
+}
+
+// Same for a value proven to be an int.
+inline int64_t intOf(const Value& value) {
+    if (!std::holds_alternative<int64_t>(value)) __builtin_unreachable();
+    return *std::get_if<int64_t>(&value);
+}
+
+bool isTruthy(const Value& value);
+bool valuesEqual(const Value& a, const Value& b);
+// Text print shows for a value. Numbers use the shortest digits that read
+// back as the same double.
+std::string valueToString(const Value& value);
+// Same, appended to out; appendScalar() takes anything but arrays and dicts.
+void appendValue(std::string& out, const Value& value);
+void appendScalar(std::string& out, const Value& value);
+
+// Encoded length and net operand stack effect of an opcode; false for bytes
+// that are not opcodes. AWAIT counts as 0, its result replaces the operand.
+// BUILD_ARRAY, BUILD_DICT, CALL_BUILTIN and APPEND_LOCAL also pop the
+// values their operands count.
+bool describeOpCode(uint8_t byte, int& length, int& effect);
+// Mnemonic the disassembler prints for an opcode; "UNKNOWN" for other bytes.
+const char* opCodeName(uint8_t byte);
+
+class Chunk;
+
+// Target of the jump instruction at offset. False for instructions that do
+// not jump; the operands must be in bounds.
+bool jumpTarget(const Chunk& chunk, size_t offset, long& target);
+
+// Operand stack depth (not counting locals) before each instruction,
+// following jumps; -1 for bytes that are unreachable or not an instruction
+// start. False when the code is malformed: unknown opcodes, truncated
+// operands, jumps outside the code or into an instruction, paths that
+// disagree on the depth, underflow, or falling off the end.
+bool stackDepths(const Chunk& chunk, std::vector<int>& depths, int& maxDepth);
+
+// Check everything the VM trusts about a chunk before running it: well
+// formed control flow and stack depths as above, plus operands in bounds
+// (constants, variable slots, loop counters, builtins and their arity,
+// module variables) and a line per byte. Sets chunk.maxDepth; false and
+// why on error.
+bool verifyChunk(Chunk& chunk, std::string& error);
+
+class JitCode;
 
 // Representation of a compiled bytecode chunk
 class Chunk {
@@ -37,17 +194,45 @@ public:
     std::vector<uint8_t> code;
     std::vector<Value> constants;
     std::vector<int> lines;  // Line numbers for debugging
+    
+    // Variable slots at the base of the stack, below the operands
+    int localCount = 0;
+    std::vector<std::string> localNames;  // By slot, for tools
+    // Back edges taken per loop, for profilers and tiering
+    std::vector<uint64_t> loopCounts;
+    
+    // Modules the code imports, by name, and the module variables it reads
+    struct Member {
+        uint8_t module;  // Index into imports
+        std::string name;
+    };
+    std::vector<std::string> imports;
+    std::vector<Member> members;
+    // Deepest the operand stack gets, above the variables; -1 until
+    // verifyChunk() passes
+    int maxDepth = -1;
+    
+    // Tiering: entries into this chunk, and its native code once hot
+    uint32_t executionCount = 0;
+    std::shared_ptr<JitCode> jitCode;
 };
 
 // Disassembler for bytecode chunks
 class Disassembler {
 public:
-    static void disassembleChunk(const Chunk& chunk, const std::string& name);
-    static int disassembleInstruction(const Chunk& chunk, int offset);
+    static void disassembleChunk(const Chunk& chunk, const std::string& name,
+                                 std::ostream& out = std::cout);
+    // Returns the offset of the next instruction.
+    static int disassembleInstruction(const Chunk& chunk, int offset, std::ostream& out = std::cout);
 
 private:
-    static int simpleInstruction(const std::string& name, int offset);
-    static int constantInstruction(const std::string& name, const Chunk& chunk, int offset);
+    static int simpleInstruction(const std::string& name, int offset, std::ostream& out);
+    static int constantInstruction(const std::string& name, const Chunk& chunk, int offset,
+                                   std::ostream& out);
+    static int byteInstruction(const std::string& name, const Chunk& chunk, int offset,
+                               std::ostream& out);
+    static int jumpInstruction(const std::string& name, const Chunk& chunk, int offset,
+                               std::ostream& out);
 };
 
 #endif // BYTECODE_H
\ No newline at end of file
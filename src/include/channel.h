@@ -0,0 +1,276 @@
+#ifndef CHANNEL_H
+#define CHANNEL_H
+
+#include <atomic>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+#include "eventloop.h"
+#include "timeline.h"
+
+// Fiber parked on a channel. Fibers are stackless continuations on an
+// EventLoop (e.g. a suspended VM), so parking means keeping the loop alive
+// with one hold() and posting `retry` back to it when the channel changes.
+// One claim flag can be shared by several registrations (select); only the
+// first waker to flip it resumes the fiber and releases the hold. The
+// fiber then cancels its other registrations; a waker that reaches one
+// first skips it.
+struct ChannelWaiter {
+    EventLoop* loop;
+    std::function<void()> retry;
+    std::shared_ptr<std::atomic<bool>> claim;
+};
+
+// Waiters of one direction (senders or receivers) of a channel. The fast
+// path only reads `count`; the mutex is taken to park or to wake.
+class WaiterList {
+public:
+    // Park unless `ready()` succeeds once this fiber is visible to wakers.
+    // Returns true when ready() succeeded and nothing was parked. The caller
+    // holds the loop while the fiber may be parked.
+    template <typename Ready>
+    bool parkUnless(ChannelWaiter waiter, Ready&& ready) {
+        std::lock_guard<std::mutex> lock(mutex);
+        count.fetch_add(1, std::memory_order_seq_cst);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (ready()) {
+            count.fetch_sub(1, std::memory_order_relaxed);
+            return true;
+        }
+        waiters.push_back(std::move(waiter));
+        Timeline::instant("task", "park");
+        return false;
+    }
+    
+    // Remove the registrations made under claim.
+    void cancel(const std::shared_ptr<std::atomic<bool>>& claim) {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (auto it = waiters.begin(); it != waiters.end();) {
+            if (it->claim == claim) {
+                it = waiters.erase(it);
+                count.fetch_sub(1, std::memory_order_relaxed);
+            } else {
+                ++it;
+            }
+        }
+    }
+    
+    size_t size() const { return count.load(std::memory_order_relaxed); }
+    
+    // Call after making progress in the other direction.
+    void wakeOne() {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (count.load(std::memory_order_seq_cst) == 0) return;
+        
+        std::unique_lock<std::mutex> lock(mutex);
+        while (!waiters.empty()) {
+            ChannelWaiter waiter = std::move(waiters.front());
+            waiters.pop_front();
+            count.fetch_sub(1, std::memory_order_relaxed);
+            
+            // A stale select registration does not consume the wakeup.
+            if (waiter.claim->exchange(true)) continue;
+            
+            EventLoop* loop = waiter.loop;
+            auto retry = std::move(waiter.retry);
+            loop->post([loop, retry]() {
+                loop->release();
+                retry();
+            });
+            Timeline::instant("task", "wake");
+            return;
+        }
+    }
+
+private:
+    std::mutex mutex;
+    std::atomic<size_t> count{0};
+    std::deque<ChannelWaiter> waiters;
+};
+
+// Bounded multi-producer multi-consumer channel.
+//
+// The buffer is a lock-free ring (one sequence number per cell), so
+// trySend/tryRecv never block and never take a lock. The ring is rounded
+// up to a power of two, but no more than `capacity` messages (at least
+// one) are ever buffered: a send that would exceed it fails or parks. send/recv complete
+// immediately when they can; otherwise the calling fiber is parked on its
+// EventLoop and resumed when a slot or a message becomes available, without
+// blocking an OS thread. Between tasks, send only values produced by
+// Heap::exportValue.
+template <typename T>
+class Channel {
+public:
+    explicit Channel(size_t capacity) : bound(capacity > 0 ? capacity : 1) {
+        size_t size = 2;
+        while (size < bound) size <<= 1;
+        mask = size - 1;
+        cells = std::make_unique<Cell[]>(size);
+        for (size_t i = 0; i < size; i++) {
+            cells[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+    
+    Channel(const Channel&) = delete;
+    Channel& operator=(const Channel&) = delete;
+    
+    size_t capacity() const { return bound; }
+    // Fibers parked in send() and in recv() or select().
+    size_t parkedSenders() const { return senders.size(); }
+    size_t parkedReceivers() const { return receivers.size(); }
+    
+    bool trySend(T value) {
+        if (!push(value)) return false;
+        receivers.wakeOne();
+        return true;
+    }
+    
+    bool tryRecv(T& out) {
+        if (!pop(out)) return false;
+        senders.wakeOne();
+        return true;
+    }
+    
+    // Deliver value, parking the fiber on loop while the channel is full.
+    void send(EventLoop& loop, T value, std::function<void()> done) {
+        if (trySend(value)) {
+            done();
+            return;
+        }
+        
+        auto retry = [this, &loop, value, done]() { send(loop, value, done); };
+        auto claim = std::make_shared<std::atomic<bool>>(false);
+        loop.hold();
+        if (senders.parkUnless({&loop, retry, claim}, [&]() { return push(value); })) {
+            loop.release();
+            receivers.wakeOne();
+            done();
+        }
+    }
+    
+    // Take a value, parking the fiber on loop while the channel is empty.
+    void recv(EventLoop& loop, std::function<void(T)> done) {
+        T value;
+        if (tryRecv(value)) {
+            done(std::move(value));
+            return;
+        }
+        
+        auto retry = [this, &loop, done]() { recv(loop, done); };
+        auto claim = std::make_shared<std::atomic<bool>>(false);
+        loop.hold();
+        if (receivers.parkUnless({&loop, retry, claim}, [&]() { return pop(value); })) {
+            loop.release();
+            senders.wakeOne();
+            done(std::move(value));
+        }
+    }
+    
+    // Receive from whichever channel has a value first; done gets its index.
+    static void select(EventLoop& loop, std::vector<Channel*> channels,
+                       std::function<void(size_t, T)> done) {
+        T value;
+        for (size_t i = 0; i < channels.size(); i++) {
+            if (channels[i]->tryRecv(value)) {
+                done(i, std::move(value));
+                return;
+            }
+        }
+        
+        // Register on every channel under one claim. `completed` is only
+        // touched on this loop's thread.
+        auto claim = std::make_shared<std::atomic<bool>>(false);
+        auto completed = std::make_shared<bool>(false);
+        auto retry = [&loop, channels, done, claim, completed]() {
+            if (!*completed) {
+                // The waker took one registration; drop the others.
+                for (Channel* channel : channels) channel->receivers.cancel(claim);
+                select(loop, channels, done);
+                return;
+            }
+            // We finished before this wakeup arrived; pass it on.
+            for (Channel* channel : channels) channel->receivers.wakeOne();
+        };
+        
+        loop.hold();
+        for (size_t i = 0; i < channels.size(); i++) {
+            Channel* channel = channels[i];
+            bool ready = channel->receivers.parkUnless({&loop, retry, claim}, [&]() {
+                return channel->pop(value);
+            });
+            if (ready) {
+                // Withdraw the registrations made so far. If a waker
+                // claimed one first, its post releases the hold.
+                if (!claim->exchange(true)) loop.release();
+                for (size_t j = 0; j < i; j++) channels[j]->receivers.cancel(claim);
+                *completed = true;
+                channel->senders.wakeOne();
+                done(i, std::move(value));
+                return;
+            }
+        }
+    }
+
+private:
+    struct Cell {
+        std::atomic<size_t> sequence;
+        T data;
+    };
+    
+    std::unique_ptr<Cell[]> cells;
+    size_t mask;
+    size_t bound;  // Most messages buffered at once; at most mask + 1
+    alignas(64) std::atomic<size_t> enqueuePos{0};
+    alignas(64) std::atomic<size_t> dequeuePos{0};
+    WaiterList senders;
+    WaiterList receivers;
+    
+    bool push(const T& value) {
+        size_t pos = enqueuePos.load(std::memory_order_relaxed);
+        while (true) {
+            // A stale dequeuePos only overstates what is buffered, and a
+            // receiver advances it before waking a parked sender.
+            if (pos - dequeuePos.load(std::memory_order_acquire) >= bound) return false;  // full
+            Cell& cell = cells[pos & mask];
+            size_t sequence = cell.sequence.load(std::memory_order_acquire);
+            intptr_t diff = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos);
+            if (diff == 0) {
+                if (enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    cell.data = value;
+                    cell.sequence.store(pos + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (diff < 0) {
+                return false;  // full
+            } else {
+                pos = enqueuePos.load(std::memory_order_relaxed);
+            }
+        }
+    }
+    
+    bool pop(T& out) {
+        size_t pos = dequeuePos.load(std::memory_order_relaxed);
+        while (true) {
+            Cell& cell = cells[pos & mask];
+            size_t sequence = cell.sequence.load(std::memory_order_acquire);
+            intptr_t diff = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos + 1);
+            if (diff == 0) {
+                if (dequeuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    out = std::move(cell.data);
+                    cell.sequence.store(pos + mask + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (diff < 0) {
+                return false;  // empty
+            } else {
+                pos = dequeuePos.load(std::memory_order_relaxed);
+            }
+        }
+    }
+};
+
+#endif // CHANNEL_H
@@ -2,15 +2,22 @@
 #define COMPILER_H
 
 #include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
 #include "bytecode.h"
+#include "gc.h"
 #include "expression.h"
 #include "statement.h"
 #include "lexer.h"
 #include "parser.h"
+#include "typechecker.h"
 
 // Compiler class that turns source code into bytecode
 class Compiler : public ExpressionVisitor, public StatementVisitor {
 public:
+    explicit Compiler(Heap& heap) : heap(heap) {}
+    
     bool compile(const std::string& source, Chunk& chunk);
     
     // Expression visitor methods
@@ -18,25 +25,80 @@ public:
     void visitGroupingExpression(GroupingExpression* expr) override;
     void visitUnaryExpression(UnaryExpression* expr) override;
     void visitBinaryExpression(BinaryExpression* expr) override;
+    void visitLogicalExpression(LogicalExpression* expr) override;
     void visitVariableExpression(VariableExpression* expr) override;
+    void visitAwaitExpression(AwaitExpression* expr) override;
+    void visitArrayExpression(ArrayExpression* expr) override;
+    void visitDictExpression(DictExpression* expr) override;
+    void visitIndexExpression(IndexExpression* expr) override;
+    void visitCallExpression(CallExpression* expr) override;
+    void visitMemberExpression(MemberExpression* expr) override;
     
     // Statement visitor methods
     void visitExpressionStatement(ExpressionStatement* stmt) override;
     void visitPrintStatement(PrintStatement* stmt) override;
     void visitClassStatement(ClassStatement* stmt) override;
     void visitTaskStatement(TaskStatement* stmt) override;
-    
+    void visitAssignStatement(AssignStatement* stmt) override;
+    void visitSetIndexStatement(SetIndexStatement* stmt) override;
+    void visitIfStatement(IfStatement* stmt) override;
+    void visitWhileStatement(WhileStatement* stmt) override;
+    void visitForStatement(ForStatement* stmt) override;
+    void visitBreakStatement(BreakStatement* stmt) override;
+    void visitContinueStatement(ContinueStatement* stmt) override;
+    void visitImportStatement(ImportStatement* stmt) override;
+
 private:
+    // A loop being compiled
+    struct Loop {
+        int start;               // Where its back edge jumps to
+        uint8_t index;           // Its Chunk::loopCounts entry
+        bool continueForward;    // 'for' continues at the increment, after the body
+        std::vector<int> breakJumps;
+        std::vector<int> continueJumps;
+    };
+    
+    Heap& heap;  // String constants are allocated here
+    TypeChecker types;
     Chunk* compilingChunk;
     bool hadError;
     int currentLine;
     
+    // Variable slots, numbered in order of first assignment
+    std::unordered_map<std::string, uint8_t> locals;
+    std::vector<Loop> loops;  // Innermost last
+    // String variables some loop appends to, read with GET_STRING_LOCAL
+    std::unordered_set<std::string> builtStrings;
+    
     // Helper methods for emitting bytecode
     void emitByte(OpCode byte);
     void emitBytes(OpCode byte1, uint8_t byte2);
+    void emitOperand(uint8_t byte);
     void emitConstant(const Value& value);
     void emitReturn();
     
+    // Jumps: emitJump returns the operand to patch once the target is known.
+    int emitJump(OpCode op);
+    void patchJump(int operand);
+    void emitLoop(const Loop& loop);
+    // Compile a branch condition without materializing a bool: the jumps
+    // added to jumps are taken when its truth equals jumpWhen, otherwise
+    // control falls through.
+    void emitCondition(Expression* condition, bool jumpWhen, std::vector<int>& jumps);
+    
+    void compileBlock(const std::vector<std::unique_ptr<Statement>>& statements);
+    // `s = s + a + b ...` on a string variable: the pieces a, b, ... when
+    // every one is a proven string, else false.
+    bool appendPieces(AssignStatement* stmt, std::vector<Expression*>& pieces);
+    void findAppends(const std::vector<std::unique_ptr<Statement>>& statements, bool inLoop);
+    int declareLocal(const std::string& name);  // Slot, or -1 after an error
+    int addLoop();                               // Loop index, or -1 after an error
+    
+    // Proven type shared by both operands (NUMBER, INT, ...), else UNKNOWN
+    StaticType operandType(BinaryExpression* expr);
+    // Pick the form of an operator for a proven operand type
+    static OpCode typedOp(StaticType type, OpCode generic, OpCode number, OpCode integer);
+    
     // Error handling
     void error(const std::string& message);
     
@@ -0,0 +1,47 @@
+#ifndef DICT_H
+#define DICT_H
+
+#include "bytecode.h"
+#include "gc.h"
+
+// Dict operations shared by the VM and the native runtime.
+//
+// Keys are strings, numbers, ints, bools or null, matched with
+// valuesEqual() (so 1 and 1.0 are the same key); NaN can never be found
+// and is rejected. Iteration (printing, keys(), values()) follows insertion
+// order, also after removals; removing is linear in the dict's size, since
+// the later entries move down to keep the array dense.
+//
+// The table (ObjDictTable) is SwissTable-style open addressing: a control
+// byte per slot holds 7 bits of the key's hash, and a lookup compares a
+// whole group of 16 control bytes against them with SSE2 before touching
+// any entry. Probing is linear and deletion shifts the rest of the probe
+// run back, so there are no tombstones and lookups stop at the first free
+// slot. String keys hash once, into ObjString::hash. The entries are a
+// dense array next to the index, so iterating and rehashing never chase
+// pointers.
+//
+// Dict, key and value arguments must be collector roots (stack slots),
+// since inserting may allocate a larger table. Each returns nullptr and
+// sets its result, or the runtime error message.
+
+// Dict of count key/value pairs, pairs[2 * i] and pairs[2 * i + 1]; later
+// duplicates win. The result may be pairs[0].
+const char* buildDict(Heap& heap, Value* pairs, size_t count, Value& result);
+
+// The error names the key when it is missing.
+const char* dictGet(const ObjDict* dict, const Value& key, Value& result);
+// Inserts the key or replaces its value.
+const char* dictSet(Heap& heap, const Value& dict, const Value& key, const Value& value);
+// found tells whether the key was there; result is left alone otherwise.
+const char* dictFind(const ObjDict* dict, const Value& key, bool& found, Value& result);
+const char* dictRemove(Heap& heap, ObjDict* dict, const Value& key, bool& removed);
+
+// Entry i in iteration order, i < dict->count.
+Value dictKey(const ObjDict* dict, size_t i);
+Value dictValue(const ObjDict* dict, size_t i);
+
+// Same keys with equal values, in any order.
+bool dictsEqual(const ObjDict* a, const ObjDict* b);
+
+#endif // DICT_H
@@ -0,0 +1,109 @@
+#ifndef EVENTLOOP_H
+#define EVENTLOOP_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <queue>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// Single-threaded event loop built on epoll. Timers share one timerfd armed
+// to the earliest deadline, fd readiness (sockets, pipes) is reported through
+// one-shot watches, and blocking work such as file reads runs on a small
+// thread pool whose completions are posted back through an eventfd. All
+// callbacks run on the thread that calls run()/runOnce().
+class EventLoop {
+public:
+    using Callback = std::function<void()>;
+    using FdCallback = std::function<void(uint32_t events)>;
+    using Work = std::function<Callback()>;
+    
+    explicit EventLoop(int workerThreads = 4);
+    ~EventLoop();
+    
+    EventLoop(const EventLoop&) = delete;
+    EventLoop& operator=(const EventLoop&) = delete;
+    
+    // Longest timer delay, about a century; longer ones are clamped to it
+    // so the deadline cannot overflow.
+    static constexpr int64_t kMaxDelayMs = 100ll * 365 * 24 * 3600 * 1000;
+    
+    // Run callback once after the given delay (negative counts as none).
+    void addTimer(int64_t milliseconds, Callback callback);
+    
+    // Run callback once when fd becomes ready for any of the epoll events.
+    void watch(int fd, uint32_t events, FdCallback callback);
+    void unwatch(int fd);
+    
+    // Run work on the thread pool; the callback it returns runs on the loop.
+    void submit(Work work);
+    
+    // Read a whole file on the thread pool.
+    void readFile(const std::string& path,
+                  std::function<void(bool ok, std::string contents)> callback);
+    
+    // Run callback on the loop thread. Safe to call from any thread.
+    void post(Callback callback);
+    
+    // Keep run() going while something outside the loop (e.g. a channel
+    // with a parked fiber) still owes it a post(). Loop thread only.
+    void hold();
+    void release();
+    
+    // Number of timers, watches, pool jobs and holds still outstanding.
+    size_t pending() const;
+    
+    // Dispatch events until nothing is pending.
+    void run();
+    // Wait up to timeoutMs (-1 blocks) and dispatch whatever became ready.
+    void runOnce(int timeoutMs);
+
+private:
+    struct Timer {
+        int64_t deadline;  // CLOCK_MONOTONIC, nanoseconds
+        uint64_t sequence; // FIFO among equal deadlines
+        Callback callback;
+        
+        bool operator>(const Timer& other) const {
+            return deadline != other.deadline ? deadline > other.deadline
+                                              : sequence > other.sequence;
+        }
+    };
+    
+    int epollFd;
+    int timerFd;
+    int wakeFd;
+    
+    std::priority_queue<Timer, std::vector<Timer>, std::greater<Timer>> timers;
+    uint64_t timerSequence = 0;
+    int64_t armedDeadline = 0;
+    
+    std::unordered_map<int, FdCallback> watches;
+    
+    // Thread pool state
+    int workerCount;
+    std::vector<std::thread> workers;
+    std::mutex workMutex;
+    std::condition_variable workReady;
+    std::deque<Work> workQueue;
+    bool stopping = false;
+    size_t jobsInFlight = 0;
+    size_t holds = 0;
+    
+    std::mutex completionMutex;
+    std::vector<Callback> completions;
+    
+    void workerLoop();
+    void armTimer();
+    void fireTimers();
+    void drainCompletions();
+    
+    static int64_t now();
+};
+
+#endif // EVENTLOOP_H
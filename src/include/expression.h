@@ -3,6 +3,7 @@
 
 #include <memory>
 #include <string>
+#include <vector>
 #include "token.h"
 
 // Forward declarations
@@ -18,11 +19,12 @@ public:
 // Literal expression (numbers, strings, booleans, null)
 class Literal : public Expression {
 public:
-    Literal(const std::string& value) : value(value) {}
+    Literal(const std::string& value, int line) : value(value), line(line) {}
     
     void accept(ExpressionVisitor* visitor) override;
     
     std::string value;
+    int line;
 };
 
 // Grouping expression (parenthesized expressions)
@@ -61,6 +63,20 @@ public:
     std::unique_ptr<Expression> right;
 };
 
+// Logical expression (a and b, a or b); the right operand is evaluated
+// only when the left one does not decide the result
+class LogicalExpression : public Expression {
+public:
+    LogicalExpression(std::unique_ptr<Expression> left, Token op, std::unique_ptr<Expression> right)
+        : left(std::move(left)), op(op), right(std::move(right)) {}
+    
+    void accept(ExpressionVisitor* visitor) override;
+    
+    std::unique_ptr<Expression> left;
+    Token op;
+    std::unique_ptr<Expression> right;
+};
+
 // Variable expression (identifier reference)
 class VariableExpression : public Expression {
 public:
@@ -71,6 +87,80 @@ public:
     Token name;
 };
 
+// Await expression (e.g., await 100, await "data.txt")
+class AwaitExpression : public Expression {
+public:
+    AwaitExpression(Token keyword, std::unique_ptr<Expression> operand)
+        : keyword(keyword), operand(std::move(operand)) {}
+    
+    void accept(ExpressionVisitor* visitor) override;
+    
+    Token keyword;
+    std::unique_ptr<Expression> operand;
+};
+
+// Array literal (e.g., [1, 2, 3])
+class ArrayExpression : public Expression {
+public:
+    ArrayExpression(Token bracket, std::vector<std::unique_ptr<Expression>> elements)
+        : bracket(bracket), elements(std::move(elements)) {}
+    
+    void accept(ExpressionVisitor* visitor) override;
+    
+    Token bracket;
+    std::vector<std::unique_ptr<Expression>> elements;
+};
+
+// Dict literal (e.g., {"a": 1, "b": 2})
+class DictExpression : public Expression {
+public:
+    DictExpression(Token brace, std::vector<std::unique_ptr<Expression>> keys,
+                   std::vector<std::unique_ptr<Expression>> values)
+        : brace(brace), keys(std::move(keys)), values(std::move(values)) {}
+    
+    void accept(ExpressionVisitor* visitor) override;
+    
+    Token brace;
+    std::vector<std::unique_ptr<Expression>> keys;
+    std::vector<std::unique_ptr<Expression>> values;  // values[i] goes with keys[i]
+};
+
+// Index expression (e.g., a[i])
+class IndexExpression : public Expression {
+public:
+    IndexExpression(std::unique_ptr<Expression> array, Token bracket, std::unique_ptr<Expression> index)
+        : array(std::move(array)), bracket(bracket), index(std::move(index)) {}
+    
+    void accept(ExpressionVisitor* visitor) override;
+    
+    std::unique_ptr<Expression> array;
+    Token bracket;
+    std::unique_ptr<Expression> index;
+};
+
+// Call of a builtin function by name (e.g., sum(a)); see builtins.h
+class CallExpression : public Expression {
+public:
+    CallExpression(Token name, std::vector<std::unique_ptr<Expression>> arguments)
+        : name(name), arguments(std::move(arguments)) {}
+    
+    void accept(ExpressionVisitor* visitor) override;
+    
+    Token name;
+    std::vector<std::unique_ptr<Expression>> arguments;
+};
+
+// Variable of an imported module (e.g., config.port)
+class MemberExpression : public Expression {
+public:
+    MemberExpression(Token module, Token name) : module(module), name(name) {}
+    
+    void accept(ExpressionVisitor* visitor) override;
+    
+    Token module;
+    Token name;
+};
+
 // Visitor for expressions
 class ExpressionVisitor {
 public:
@@ -79,7 +169,14 @@ public:
     virtual void visitGroupingExpression(GroupingExpression* expr) = 0;
     virtual void visitUnaryExpression(UnaryExpression* expr) = 0;
     virtual void visitBinaryExpression(BinaryExpression* expr) = 0;
+    virtual void visitLogicalExpression(LogicalExpression* expr) = 0;
     virtual void visitVariableExpression(VariableExpression* expr) = 0;
+    virtual void visitAwaitExpression(AwaitExpression* expr) = 0;
+    virtual void visitArrayExpression(ArrayExpression* expr) = 0;
+    virtual void visitDictExpression(DictExpression* expr) = 0;
+    virtual void visitIndexExpression(IndexExpression* expr) = 0;
+    virtual void visitCallExpression(CallExpression* expr) = 0;
+    virtual void visitMemberExpression(MemberExpression* expr) = 0;
 };
 
 // Implementations of accept methods
@@ -99,8 +196,36 @@ inline void BinaryExpression::accept(ExpressionVisitor* visitor) {
     visitor->visitBinaryExpression(this);
 }
 
+inline void LogicalExpression::accept(ExpressionVisitor* visitor) {
+    visitor->visitLogicalExpression(this);
+}
+
 inline void VariableExpression::accept(ExpressionVisitor* visitor) {
     visitor->visitVariableExpression(this);
 }
 
+inline void AwaitExpression::accept(ExpressionVisitor* visitor) {
+    visitor->visitAwaitExpression(this);
+}
+
+inline void ArrayExpression::accept(ExpressionVisitor* visitor) {
+    visitor->visitArrayExpression(this);
+}
+
+inline void DictExpression::accept(ExpressionVisitor* visitor) {
+    visitor->visitDictExpression(this);
+}
+
+inline void IndexExpression::accept(ExpressionVisitor* visitor) {
+    visitor->visitIndexExpression(this);
+}
+
+inline void CallExpression::accept(ExpressionVisitor* visitor) {
+    visitor->visitCallExpression(this);
+}
+
+inline void MemberExpression::accept(ExpressionVisitor* visitor) {
+    visitor->visitMemberExpression(this);
+}
+
 #endif // EXPRESSION_H
\ No newline at end of file
@@ -0,0 +1,172 @@
+#ifndef FUSIONRT_H
+#define FUSIONRT_H
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+#include "arith.h"
+#include "builtins.h"
+#include "bytecode.h"
+#include "eventloop.h"
+#include "gc.h"
+#include "output.h"
+#include "stringbuilder.h"
+
+// Runtime linked into programs built with `fusion build` (libfusionrt.a).
+//
+// The generated code keeps the chunk's variables at the bottom of stack()
+// and each operand stack slot above them at a fixed index, and calls one
+// method per instruction; jumps become gotos. Double fast paths
+// are inline here; ints, strings, arrays, awaits and errors go out of line. Opcodes
+// the type checker specialized are lowered to plain C++ on numberOf() and
+// intOf() instead. Errors print like the VM's and exit with the same
+// status (70).
+class NativeRuntime {
+public:
+    // slots is the chunk's variable count plus its maximum stack depth,
+    // constants its table size.
+    NativeRuntime(size_t slots, size_t constants);
+    
+    NativeRuntime(const NativeRuntime&) = delete;
+    NativeRuntime& operator=(const NativeRuntime&) = delete;
+    
+    // Slots are collector roots, so strings in them survive (and follow)
+    // collections. Slots above the current depth just keep stale values alive.
+    Value* stack() { return slots.data(); }
+    
+    void defineString(size_t index, const char* chars, size_t length);
+    const Value& constant(size_t index) const { return constants[index]; }
+    
+    void add(Value& a, const Value& b, int line) {
+        if (bothNumbers(a, b)) {
+            a = std::get<double>(a) + std::get<double>(b);
+        } else if (isStringValue(a) && isStringValue(b)) {
+            concatenate(a, b);
+        } else {
+            binary(OpCode::ADD, a, b, line);
+        }
+    }
+    
+    void subtract(Value& a, const Value& b, int line) {
+        if (!bothNumbers(a, b)) return binary(OpCode::SUBTRACT, a, b, line);
+        a = std::get<double>(a) - std::get<double>(b);
+    }
+    
+    void multiply(Value& a, const Value& b, int line) {
+        if (!bothNumbers(a, b)) return binary(OpCode::MULTIPLY, a, b, line);
+        a = std::get<double>(a) * std::get<double>(b);
+    }
+    
+    void divide(Value& a, const Value& b, int line) {
+        if (!bothNumbers(a, b)) return binary(OpCode::DIVIDE, a, b, line);
+        if (std::get<double>(b) == 0) error("Division by zero.", line);
+        a = std::get<double>(a) / std::get<double>(b);
+    }
+    
+    // DIVIDE_NUMBER; the operands are proven numbers, b may still be zero.
+    void divideNumbers(Value& a, const Value& b, int line) {
+        if (numberOf(b) == 0) error("Division by zero.", line);
+        a = numberOf(a) / numberOf(b);
+    }
+    
+    void negate(Value& a, int line) {
+        if (!std::holds_alternative<double>(a)) return unary(OpCode::NEGATE, a, line);
+        a = -std::get<double>(a);
+    }
+    
+    void logicalNot(Value& a) { a = !isTruthy(a); }
+    void equals(Value& a, const Value& b) { a = valuesEqual(a, b); }
+    
+    void greater(Value& a, const Value& b, int line) {
+        if (!bothNumbers(a, b)) return binary(OpCode::GREATER, a, b, line);
+        a = std::get<double>(a) > std::get<double>(b);
+    }
+    
+    void less(Value& a, const Value& b, int line) {
+        if (!bothNumbers(a, b)) return binary(OpCode::LESS, a, b, line);
+        a = std::get<double>(a) < std::get<double>(b);
+    }
+    
+    void lessEqual(Value& a, const Value& b, int line) {
+        if (!bothNumbers(a, b)) return binary(OpCode::LESS_EQUAL, a, b, line);
+        a = !(std::get<double>(a) > std::get<double>(b));
+    }
+    
+    void greaterEqual(Value& a, const Value& b, int line) {
+        if (!bothNumbers(a, b)) return binary(OpCode::GREATER_EQUAL, a, b, line);
+        a = !(std::get<double>(a) < std::get<double>(b));
+    }
+    
+    // Any numeric operator without a fast path: 'div', '%', bitwise
+    // operators, ints, mixed operands and arrays.
+    void binary(OpCode op, Value& a, const Value& b, int line);
+    void unary(OpCode op, Value& a, int line);
+    
+    // *_INT opcodes; the operands are proven ints but may still overflow.
+    void addInts(Value& a, const Value& b, int line) {
+        if (const char* message = ::addInts(intOf(a), intOf(b), a)) error(message, line);
+    }
+    
+    void subtractInts(Value& a, const Value& b, int line) {
+        if (const char* message = ::subtractInts(intOf(a), intOf(b), a)) error(message, line);
+    }
+    
+    void multiplyInts(Value& a, const Value& b, int line) {
+        if (const char* message = ::multiplyInts(intOf(a), intOf(b), a)) error(message, line);
+    }
+    
+    void negateInt(Value& a, int line) {
+        if (const char* message = ::negateInt(intOf(a), a)) error(message, line);
+    }
+    
+    // Condition of a fused compare-and-branch opcode.
+    bool branch(OpCode op, const Value& a, const Value& b, int line) {
+        if (bothNumbers(a, b)) return branchHolds(op, std::get<double>(a), std::get<double>(b));
+        if (std::holds_alternative<int64_t>(a) && std::holds_alternative<int64_t>(b)) {
+            return branchHolds(op, std::get<int64_t>(a), std::get<int64_t>(b));
+        }
+        bool holds = false;
+        if (const char* message = branchCondition(op, a, b, holds)) error(message, line);
+        return holds;
+    }
+    
+    // Both operands must be strings.
+    void concatenate(Value& a, const Value& b);
+    // APPEND_LOCAL and GET_STRING_LOCAL (see stringbuilder.h)
+    void append(Value& variable, const Value* pieces, int count, int line);
+    void flatten(Value& variable) { flattenString(heap, variable); }
+    
+    // Arrays. Operands are consecutive slots starting at the first, which
+    // receives the result.
+    void buildArray(Value* elements, int count, int line);
+    // count key/value pairs
+    void buildDict(Value* pairs, int count, int line);
+    void getIndex(Value& array, const Value& index, int line);
+    void setIndex(const Value& array, const Value& index, const Value& value, int line);
+    void call(Builtin builtin, Value* args, int argc, int line);
+    
+    void print(const Value& value);
+    
+    // Block on the event loop until the operation completes; the result
+    // replaces the operand.
+    void await(Value& operand, int line);
+    
+    // Flush output; the value main() returns.
+    int finish();
+    
+    [[noreturn]] void error(const std::string& message, int line);
+
+private:
+    Heap heap;
+    Output output;
+    std::unique_ptr<EventLoop> loop;  // Created by the first await
+    std::vector<Value> slots;
+    std::vector<Value> constants;
+    
+    static bool bothNumbers(const Value& a, const Value& b) {
+        return std::holds_alternative<double>(a) && std::holds_alternative<double>(b);
+    }
+};
+
+#endif // FUSIONRT_H
@@ -0,0 +1,313 @@
+#ifndef GC_H
+#define GC_H
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <thread>
+#include <vector>
+#include "bytecode.h"
+#include "heapprofile.h"
+#include "object.h"
+#include "shared.h"
+
+// Collector counters, cumulative since the heap was created
+struct HeapStats {
+    size_t bytesAllocated = 0;    // Everything handed out, both generations
+    size_t bytesPromoted = 0;     // Copied from the nursery into the old generation
+    size_t oldBytes = 0;          // Currently allocated in the old generation
+    size_t minorCollections = 0;
+    size_t majorCollections = 0;
+    size_t cardSlotsScanned = 0;  // References minor collections read on dirty old cards
+    size_t markerSlotsTraced = 0;   // Reference slots the concurrent marker thread read
+    size_t mutatorSlotsTraced = 0;  // Ones it left to the mutator, whose card kept changing
+};
+
+// Log2-bucketed histogram of mutator pauses, in microseconds
+class PauseHistogram {
+public:
+    void record(std::chrono::nanoseconds pause);
+    
+    uint64_t count() const { return samples; }
+    std::chrono::nanoseconds max() const { return std::chrono::nanoseconds(longest); }
+    std::chrono::nanoseconds total() const { return std::chrono::nanoseconds(sum); }
+    // Upper bound of the bucket holding the given percentile (0-100).
+    std::chrono::nanoseconds percentile(double p) const;
+    
+    void print(std::ostream& out) const;
+
+private:
+    std::array<uint64_t, 32> buckets{};  // bucket i holds pauses < 2^i us
+    uint64_t samples = 0;
+    int64_t longest = 0;
+    int64_t sum = 0;
+};
+
+// Pauses observed between the end of one major cycle and the end of the next
+struct GcCycle {
+    PauseHistogram pauses;
+    size_t liveBytes = 0;      // Old generation after the cycle's sweep
+    bool concurrent = false;
+};
+
+// Precise generational heap, private to one task's VM.
+//
+// New objects are bump-allocated in a fixed nursery. A minor collection
+// copies everything reachable from the roots (and from dirty cards in the
+// old generation) out of the nursery and resets the bump pointer, so
+// temporaries that die young cost one pointer increment each.
+//
+// The old generation is a list of aligned segments with a card table each.
+// Reference fields of heap objects must be written through storeField()
+// (or storeValue() for Value slots), which dirties the card holding the
+// field on old->young stores; a minor collection reads only the slots on
+// dirty cards, so a large old array costs what was written to it.
+//
+// Major collections either stop the world (mark and sweep in one pause) or,
+// after setConcurrent(), mark on a background thread: a short pause
+// snapshots the roots, the mutator keeps running with a snapshot-at-the-
+// beginning barrier and allocates black, and sweeping is done lazily at
+// allocation time in steps bounded by the pause budget. While marking,
+// storeValue() brackets each store into an old object with a bump of the
+// card's version, so the marker can read a card's Values like a seqlock
+// and retry if it changed; the few cards that keep changing under it are
+// traced by the mutator in steps bounded the same way.
+class Heap {
+public:
+    static constexpr size_t kDefaultNurserySize = 1 << 20;
+    static constexpr size_t kSegmentSize = 1 << 18;
+    static constexpr size_t kCardSize = 512;
+    static constexpr size_t kCardsPerSegment = kSegmentSize / kCardSize;
+    
+    explicit Heap(size_t nurserySize = kDefaultNurserySize);
+    ~Heap();
+    
+    Heap(const Heap&) = delete;
+    Heap& operator=(const Heap&) = delete;
+    
+    // Mark the old generation concurrently and keep each collector pause
+    // on the mutator thread within maxPause where the work can be split.
+    void setConcurrent(std::chrono::nanoseconds maxPause);
+    bool isConcurrent() const { return concurrent; }
+    // Start a major collection at the next allocation, concurrent after
+    // setConcurrent().
+    void requestMajor() { majorRequested = true; }
+    
+    // Allocate a string whose characters the caller fills in. May collect,
+    // so any object the caller still needs must be reachable from a root.
+    ObjString* allocateString(size_t length);
+    ObjString* copyString(const char* chars, size_t length);
+    // Allocate straight into the old generation, for data that lives as
+    // long as a chunk (e.g. string constants).
+    ObjString* copyTenuredString(const char* chars, size_t length);
+    // An empty builder with room for capacity characters. Collects like
+    // allocateString().
+    ObjStringBuilder* allocateStringBuilder(size_t capacity);
+    // Allocate an array of length elements. VALUES elements start as null;
+    // packed elements are uninitialized, the caller fills them in. Collects
+    // like allocateString().
+    ObjArray* allocateArray(ArrayStorage storage, size_t length);
+    // An empty dict, and a table for one with every slot free and every
+    // entry null. Collect like allocateString().
+    ObjDict* allocateDict();
+    ObjDictTable* allocateDictTable(size_t capacity, size_t slots);
+    
+    // Register a vector of values the collector must treat as roots and
+    // update when objects move. The vector must outlive the heap or be
+    // removed first.
+    void addRoots(std::vector<Value>* values);
+    void removeRoots(std::vector<Value>* values);
+    
+    // Sample allocations into profiler and let it take snapshots; null
+    // detaches it. The profiler must outlive the heap or be detached first.
+    void setProfiler(HeapProfiler* newProfiler) { profiler = newProfiler; }
+    
+    // Heap walking for tools: every object a root set refers to, and every
+    // object obj refers to. Nothing may allocate while walking.
+    void forEachRoot(const std::function<void(const std::vector<Value>* roots, size_t index, Obj* obj)>& visit) const;
+    static void forEachChild(Obj* obj, const std::function<void(Obj* child)>& visit);
+    
+    // Prepare a value for another task: primitives and already shared
+    // objects pass through, and anything else is deep-copied into a message
+    // in the shared region, keeping shared structure and cycles. Nothing is
+    // allocated in this heap.
+    Value exportValue(const Value& value, SharedHeap& shared);
+    // Adopt a message from another task: it is deep-copied into this heap,
+    // so the receiver can change it without the sender seeing it, and freed.
+    // Each message is imported once.
+    Value importValue(const Value& message);
+    
+    // Store a reference into a field of owner with both barriers applied.
+    void storeField(Obj* owner, Obj** field, Obj* value) {
+        if (marking && *field != nullptr) shade(*field);
+        // Atomic: the concurrent marker may be reading the field.
+        __atomic_store_n(field, value, __ATOMIC_RELEASE);
+        if (value != nullptr && isYoung(value) && !isYoung(owner)) {
+            dirtyCard(owner, field);
+        }
+    }
+    
+    // Same for an element of a VALUES array or a dict table.
+    void storeValue(Obj* owner, Value* slot, const Value& value) {
+        if (marking) {
+            if (Obj* const* old = std::get_if<Obj*>(slot)) {
+                if (*old != nullptr) shade(*old);
+            }
+        }
+        if (marking && !isYoung(owner)) {
+            storeWhileMarking(owner, slot, value);
+        } else {
+            *slot = value;
+        }
+        if (Obj* const* obj = std::get_if<Obj*>(&value)) {
+            if (*obj != nullptr && isYoung(*obj) && !isYoung(owner)) dirtyCard(owner, slot);
+        }
+    }
+    
+    bool isYoung(const Obj* obj) const {
+        const uint8_t* address = reinterpret_cast<const uint8_t*>(obj);
+        return address >= nurseryStart && address < nurseryEnd;
+    }
+    
+    void collectMinor();
+    // Run a full major collection now, finishing any concurrent cycle.
+    void collectMajor();
+    
+    const HeapStats& stats() const { return counters; }
+    const std::vector<GcCycle>& cycles() const { return completedCycles; }
+    const PauseHistogram& pauses() const { return allPauses; }
+    void printPauseReport(std::ostream& out) const;
+
+private:
+    // Old-generation segment; the header sits at the start of its
+    // kSegmentSize-aligned block so an object address finds its cards by
+    // masking. Objects larger than a segment get a block of their own,
+    // with a card table of its own covering the whole block.
+    struct Segment {
+        uint8_t* top;
+        uint8_t* end;
+        bool dirty;
+        bool swept;  // False between the end of marking and its lazy sweep
+        size_t cardCount;
+        uint8_t* cards;  // smallCards, or allocated for an oversized block
+        uint32_t* cardVersions;  // Odd while a store to the card is under way
+        uint8_t smallCards[kCardsPerSegment];
+        
+        uint8_t* begin();
+    };
+    
+    // Part of an old object on dirty cards, for the minor collection to scan
+    struct DirtyRange {
+        Obj* obj;
+        const uint8_t* begin;
+        const uint8_t* end;
+    };
+    
+    // Slots [begin, end) of a VALUES array or dict table left to the mutator
+    struct DeferredSlots {
+        Obj* obj;
+        size_t begin;
+        size_t end;
+    };
+    
+    enum class Phase { IDLE, MARKING, SWEEPING };
+    
+    uint8_t* nurseryStart;
+    uint8_t* nurseryTop;
+    uint8_t* nurseryEnd;
+    
+    std::vector<Segment*> segments;
+    Segment* currentSegment = nullptr;
+    std::multimap<uint32_t, Obj*> freeList;  // FREE holes by size
+    
+    std::vector<std::vector<Value>*> roots;
+    std::vector<Obj*> grayStack;
+    
+    size_t nextMajorThreshold;
+    bool majorRequested = false;
+    HeapStats counters;
+    HeapProfiler* profiler = nullptr;
+    
+    // Pause accounting
+    PauseHistogram allPauses;
+    GcCycle currentCycle;
+    std::vector<GcCycle> completedCycles;
+    
+    // Concurrent collection state. `marking` gates the SATB barrier and is
+    // only touched by the mutator; the marker thread works on markStack.
+    bool concurrent = false;
+    std::chrono::nanoseconds pauseBudget{0};
+    Phase phase = Phase::IDLE;
+    bool marking = false;
+    size_t sweepCursor = 0;
+    std::vector<Obj*> satbLocal;
+    
+    std::thread marker;
+    std::mutex markMutex;
+    std::condition_variable markerWake;
+    std::vector<Obj*> markInbox;   // Gray objects handed to the marker
+    std::atomic<bool> markerIdle{true};
+    bool markerStop = false;
+    std::vector<Obj*> markStack;   // Marker thread only
+    std::atomic<size_t> markerSlots{0};  // Folded into counters at the end of marking
+    // Slots the marker could not read because the mutator kept storing to
+    // their card, for the mutator to trace. Guarded by markMutex;
+    // deferredPending is set while it has entries.
+    std::vector<DeferredSlots> markDeferred;
+    std::atomic<bool> deferredPending{false};
+    // Mutator side: slots taken from markDeferred, the next to trace at the
+    // back, and when the next tracing step may start.
+    std::vector<DeferredSlots> deferredWork;
+    std::chrono::steady_clock::time_point nextDeferredStep;
+    
+    Obj* allocate(ObjType type, size_t size);
+    Obj* allocateOld(size_t size);
+    uint8_t allocationFlags(const Segment* segment) const;
+    Segment* newSegment(size_t payload);
+    void releaseSegment(Segment* segment);
+    static Segment* segmentOf(const Obj* obj);
+    // owner is the object holding slot; its header finds the segment.
+    void dirtyCard(const Obj* owner, const void* slot);
+    static Obj* makeFree(uint8_t* at, size_t size);
+    
+    // Minor collection helpers
+    void minorCollection();
+    Obj* evacuate(Obj* obj);
+    void scanDirtyCards();
+    
+    // Major collection helpers
+    void markObject(Obj* obj);
+    void beginSweep();
+    void sweepNext();
+    bool sweepSegment(Segment* segment);
+    void finishCycle(bool wasConcurrent);
+    
+    // Concurrent collection helpers
+    void startConcurrentCycle();
+    void concurrentStep();
+    bool tryFinishMarking();
+    // Trace deferred objects until the deadline, collecting the objects
+    // they newly mark into reached; true once none are left.
+    bool traceDeferred(std::chrono::steady_clock::time_point deadline, std::vector<Obj*>& reached);
+    void handToMarker(const std::vector<Obj*>& gray);
+    void shade(Obj* obj);
+    void flushSatb();
+    void storeWhileMarking(Obj* owner, Value* slot, const Value& value);
+    void markerLoop();
+    // Mark what values[0, count) of obj refers to, a card at a time; the
+    // slots of cards that keep changing go to deferred. Returns the slots read.
+    size_t markValues(Obj* obj, const Value* values, size_t count, std::vector<DeferredSlots>& deferred);
+    static bool tryMark(Obj* obj);
+    
+    void recordPause(std::chrono::steady_clock::time_point start, const char* kind);
+};
+
+#endif // GC_H
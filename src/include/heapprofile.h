@@ -0,0 +1,133 @@
+#ifndef HEAPPROFILE_H
+#define HEAPPROFILE_H
+
+#include <csignal>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <ostream>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "bytecode.h"
+#include "object.h"
+
+class Heap;
+
+// Allocation-site sampling and heap snapshots (`fusion --heap-profile`).
+//
+// While a profiler is attached to a heap, allocations are sampled about
+// once per sampleBytes allocated (the gap is drawn from an exponential
+// distribution, so periodic allocation patterns cannot hide), and each
+// sample is charged to the line of the instruction that allocated it,
+// scaled to estimate all allocations there. Sampled objects are followed
+// through the nursery, so a snapshot can also tell which sites the live
+// objects came from.
+//
+// A snapshot walks everything reachable from the heap's roots and builds
+// the dominator tree of that graph (an object's dominator is the closest
+// object every path from the roots to it passes through), so each object's
+// retained size is what would be freed if it became unreachable. It is
+// written as tab-separated rows, "<kind> <key> <objects> <bytes>", sorted by
+// kind and key and keyed without addresses, so two snapshots of the same
+// script compare with diff or `fusion heap-diff`:
+//
+//   total  -                           all reachable objects, their bytes
+//   type   ARRAY                       objects of a type, their own bytes
+//   path   items > ARRAY > DICT        objects at a dominator path (from
+//                                      the root slot down), retained bytes
+//   live   line 12 STRING              estimated live objects from a site
+//   alloc  line 12 STRING              estimated allocations at a site
+//
+// Paths are listed for objects retaining at least 1% of the heap.
+class HeapProfiler {
+public:
+    static constexpr size_t kDefaultSampleBytes = 512 * 1024;
+    
+    // chunk and ip are the VM's running chunk and instruction pointer, read
+    // when a sample is taken.
+    HeapProfiler(Chunk* const& chunk, const int& ip, size_t sampleBytes = kDefaultSampleBytes);
+    
+    HeapProfiler(const HeapProfiler&) = delete;
+    HeapProfiler& operator=(const HeapProfiler&) = delete;
+    
+    // Label a root set registered with the heap; slots with a name in
+    // slotNames use it, the rest "<label>[<index>]".
+    void nameRoots(const std::vector<Value>* roots, std::string label,
+                   const std::vector<std::string>* slotNames = nullptr);
+    
+    // Where requested snapshots go: after requestSnapshot(), e.g. from a
+    // signal handler, the next safepoint writes "<path>.1", "<path>.2", ...
+    void setSnapshotPath(std::string path) { snapshotPath = std::move(path); }
+    static void requestSnapshot() { snapshotRequested = 1; }
+    
+    // A point where every live object is reachable from the roots: before
+    // each allocation, and when the VM wakes up on the event loop.
+    void safepoint(const Heap& heap) {
+        if (snapshotRequested != 0) writeRequestedSnapshot(heap);
+    }
+    // Hooks for the heap.
+    void allocated(Obj* obj, size_t size) {
+        if (size < untilSample) {
+            untilSample -= size;
+            return;
+        }
+        sample(obj, size);
+    }
+    // After a minor collection: follow sampled objects that survived.
+    void afterMinor(const Heap& heap);
+    // Once a major mark is complete: forget sampled objects left unmarked.
+    void afterMark(const Heap& heap);
+    
+    void writeSnapshot(const Heap& heap, std::ostream& out);
+    bool writeSnapshot(const Heap& heap, const std::string& path);
+
+private:
+    struct Site {
+        double objects = 0;  // Estimated from the samples
+        double bytes = 0;
+    };
+    
+    // A sampled object still believed alive, and what it stands for.
+    struct Sampled {
+        int site;
+        double objects;
+        double bytes;
+    };
+    
+    static volatile std::sig_atomic_t snapshotRequested;
+    
+    Chunk* const& chunk;
+    const int& ip;
+    double sampleBytes;
+    size_t untilSample;
+    std::mt19937_64 random;
+    
+    std::vector<std::pair<int, ObjType>> siteKeys;  // Site index -> line, type
+    std::map<std::pair<int, ObjType>, int> siteIndex;
+    std::vector<Site> allocatedAt;
+    std::unordered_map<Obj*, Sampled> sampled;
+    
+    struct RootNames {
+        std::string label;
+        const std::vector<std::string>* slotNames;
+    };
+    std::unordered_map<const std::vector<Value>*, RootNames> rootNames;
+    
+    std::string snapshotPath;
+    int snapshotsWritten = 0;
+    
+    void sample(Obj* obj, size_t size);
+    size_t nextSampleGap();
+    void writeRequestedSnapshot(const Heap& heap);
+    std::string rootName(const std::vector<Value>* roots, size_t index) const;
+};
+
+// Print how much every row changed between two snapshots, biggest byte
+// growth first; false and a message on err if either is not a snapshot.
+bool diffHeapSnapshots(const std::string& before, const std::string& after, std::ostream& out,
+                       std::ostream& err);
+
+#endif // HEAPPROFILE_H
@@ -0,0 +1,76 @@
+#ifndef JIT_H
+#define JIT_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "bytecode.h"
+
+// Entries (runs and loop back-edges) after which a chunk is compiled
+#ifdef DEBUG_STRESS_JIT
+constexpr uint32_t kJitThreshold = 1;
+#else
+constexpr uint32_t kJitThreshold = 1000;
+#endif
+
+// Where native code handed control back to the interpreter
+struct JitExit {
+    Value* top;  // One past the top of the operand stack
+    intptr_t ip; // Next instruction for VM::run to execute
+};
+
+// Baseline x86-64 code for one chunk.
+//
+// Every opcode becomes a fixed machine-code template that works directly on
+// the interpreter's operand stack, so control can move between the two at
+// any instruction boundary. Jumps and loops stay in native code; back edges
+// still bump Chunk::loopCounts and spend the VM's fuel, exiting at the loop
+// head once it drops below 0. Variables are read through the stack base (a
+// string variable still holding a builder exits to be flattened). Numeric
+// fast paths are guarded on the value tags; when a guard fails (string
+// operands, division by zero, ...) the code exits at that instruction with
+// the stack untouched and VM::run executes it. Typed opcodes get the same
+// templates without the guards; the int forms only check for overflow.
+// Indexing reads number and int array elements inline. Opcodes without a
+// template ('div', '%', '~', shifts, CONCAT, anything that allocates or
+// stores into an array, builtin calls, module variables, PRINT, AWAIT,
+// RETURN) always exit the same way.
+class JitCode {
+public:
+    // Returns nullptr when the platform, the Value layout or the chunk is
+    // not supported; the chunk then stays interpreted.
+    static std::shared_ptr<JitCode> compile(const Chunk& chunk);
+    
+    ~JitCode();
+    
+    JitCode(const JitCode&) = delete;
+    JitCode& operator=(const JitCode&) = delete;
+    
+    // True when ip starts an instruction that has native code.
+    bool canEnter(int ip) const {
+        return ip >= 0 && static_cast<size_t>(ip) < entries.size() && entries[ip] >= 0;
+    }
+    
+    // Operand stack slots the code may push beyond the depth at ip. The
+    // caller makes them valid Values before entering.
+    size_t headroom(int ip) const { return maxDepth - depths[ip]; }
+    
+    // Bytecode length this code was compiled from; stale once the chunk grows.
+    size_t codeLength() const { return entries.size(); }
+    
+    // base is the bottom of the stack, where the variable slots are; fuel
+    // is the VM's back-edge budget.
+    JitExit enter(Value* base, Value* top, const Value* constants, int ip, int64_t* fuel) const;
+
+private:
+    uint8_t* memory = nullptr;
+    size_t mappedSize = 0;
+    std::vector<int32_t> entries;  // Native offset per bytecode offset, or -1
+    std::vector<int> depths;       // Static stack depth before each instruction
+    int maxDepth = 0;
+    
+    JitCode() = default;
+};
+
+#endif // JIT_H
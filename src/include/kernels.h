@@ -0,0 +1,55 @@
+#ifndef KERNELS_H
+#define KERNELS_H
+
+#include <cstddef>
+#include <cstdint>
+
+// Loops over packed array storage (see ArrayStorage). On x86-64 most have an
+// AVX2 version, picked at run time when the CPU has it, and an SSE2 one;
+// other targets, the tails of every loop and the int kernels SSE2 cannot
+// express (64-bit multiply and compare) run the scalar version.
+//
+// Reductions add in four interleaved lanes (element i goes to lane i % 4)
+// and combine them as (l0 + l1) + (l2 + l3), whatever the vector width, so
+// a sum comes out bit-identical on every machine.
+//
+// Binary kernels take a step per operand: 1 walks an array, 0 repeats the
+// operand's only element (array op scalar). out may alias an operand.
+
+enum class Kernel : uint8_t { ADD, SUBTRACT, MULTIPLY, DIVIDE };
+
+// LESS_EQUAL is !(a > b) and GREATER_EQUAL !(a < b), as for scalars, so
+// they hold for NaN.
+enum class Compare : uint8_t { LESS, GREATER, LESS_EQUAL, GREATER_EQUAL };
+
+void binaryDoubles(Kernel op, const double* a, size_t aStep, const double* b, size_t bStep,
+                   double* out, size_t n);
+// ADD, SUBTRACT and MULTIPLY; false when any element overflows.
+bool binaryInts(Kernel op, const int64_t* a, size_t aStep, const int64_t* b, size_t bStep,
+                int64_t* out, size_t n);
+
+// out[i] is 1 when "a[i] <op> b[i]" holds, else 0.
+void compareDoubles(Compare op, const double* a, size_t aStep, const double* b, size_t bStep,
+                    uint8_t* out, size_t n);
+void compareInts(Compare op, const int64_t* a, size_t aStep, const int64_t* b, size_t bStep,
+                 uint8_t* out, size_t n);
+
+void negateDoubles(const double* a, double* out, size_t n);
+bool containsZero(const double* a, size_t n);  // 0.0 or -0.0
+bool equalDoubles(const double* a, const double* b, size_t n);
+
+double sumDoubles(const double* a, size_t n);
+double dotDoubles(const double* a, const double* b, size_t n);
+// Smallest (or largest) of n > 0 doubles; NaN when any element is NaN.
+double extremeDoubles(const double* a, size_t n, bool largest);
+
+// Exact: false only when the true result does not fit in an int64_t (dotInts
+// also gives up if a running sum leaves the 128-bit range).
+bool sumInts(const int64_t* a, size_t n, int64_t& result);
+bool dotInts(const int64_t* a, const int64_t* b, size_t n, int64_t& result);
+int64_t extremeInts(const int64_t* a, size_t n, bool largest);
+
+// Number of set elements in a bool array (each byte 0 or 1).
+size_t countBools(const uint8_t* a, size_t n);
+
+#endif // KERNELS_H
@@ -0,0 +1,96 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+// Process-wide runtime counters for monitoring (`fusion --metrics=<file>`).
+//
+// Every thread bumps its own block of counters with plain relaxed stores,
+// so counting costs no more than an add and is never contended. A thread
+// that exits folds its block into a retired total and frees it, so
+// collect() sums the blocks of running threads plus that total, and hosts
+// that start a thread per request do not pile up blocks. Queue depths are not sampled but derived on read, as what was
+// added minus what was taken off.
+enum class Metric : uint8_t {
+    INSTRUCTIONS,       // Run by the interpreter (not by native code)
+    JIT_ENTRIES,        // Times the interpreter entered native code
+    JIT_COMPILES,       // Chunks compiled to native code
+    JIT_CACHE_HITS,     // Runs that reused a chunk's native code
+    PREEMPTIONS,        // Runs stopped for running out of fuel
+    ALLOCATIONS,
+    ALLOCATED_BYTES,
+    MINOR_COLLECTIONS,
+    MAJOR_COLLECTIONS,
+    AWAITS_STARTED,
+    AWAITS_FINISHED,
+    JOBS_SUBMITTED,     // Thread pool
+    JOBS_FINISHED,
+    TIMERS_ADDED,
+    TIMERS_FIRED,
+    COUNT
+};
+
+constexpr size_t kMetricCount = static_cast<size_t>(Metric::COUNT);
+
+// Upper bounds of the GC pause histogram's buckets, in nanoseconds; one
+// more bucket takes everything longer.
+constexpr std::array<int64_t, 8> kPauseBounds = {
+    10'000, 50'000, 100'000, 500'000, 1'000'000, 5'000'000, 10'000'000, 100'000'000,
+};
+
+struct MetricsSnapshot {
+    std::array<uint64_t, kMetricCount> counters{};
+    std::array<uint64_t, kPauseBounds.size() + 1> pauses{};  // Per bucket, not cumulative
+    uint64_t pauseNanos = 0;
+    
+    uint64_t operator[](Metric metric) const { return counters[static_cast<size_t>(metric)]; }
+    
+    // Prometheus text exposition format (version 0.0.4).
+    void writePrometheus(std::ostream& out) const;
+};
+
+// One thread's counters. Only that thread writes them; readers load them.
+struct ThreadMetrics {
+    std::array<std::atomic<uint64_t>, kMetricCount> counters{};
+    std::array<std::atomic<uint64_t>, kPauseBounds.size() + 1> pauses{};
+    std::atomic<uint64_t> pauseNanos{0};
+};
+
+class Metrics {
+public:
+    static void add(Metric metric, uint64_t amount = 1) {
+        bump(local().counters[static_cast<size_t>(metric)], amount);
+    }
+    static void recordPause(std::chrono::nanoseconds pause);
+    
+    // Sum of every thread's counters so far.
+    static MetricsSnapshot collect();
+    // Blocks of counters held, one per running thread that has counted.
+    static size_t threadBlocks();
+    
+    // Write the Prometheus text to path when signal arrives, every interval
+    // (if non-zero) and at stopExport(); false if path cannot be written.
+    // The file is replaced atomically, so a scraper never sees half of it.
+    static bool startExport(const std::string& path, std::chrono::nanoseconds interval, int signal);
+    static void stopExport();
+
+private:
+    static inline thread_local ThreadMetrics* current = nullptr;
+    struct Retirement;  // Calls detach() when its thread exits
+    
+    static ThreadMetrics& local() { return current != nullptr ? *current : attach(); }
+    static ThreadMetrics& attach();
+    static void detach();
+    
+    static void bump(std::atomic<uint64_t>& counter, uint64_t amount) {
+        counter.store(counter.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+    }
+};
+
+#endif // METRICS_H
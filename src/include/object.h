@@ -0,0 +1,199 @@
+#ifndef OBJECT_H
+#define OBJECT_H
+
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <string>
+
+// Heap object kinds
+enum class ObjType : uint8_t {
+    STRING, // Immutable character data
+    ARRAY,  // Fixed-length array, elements stored inline
+    DICT,   // Hash map; its entries live in a DICT_TABLE
+    DICT_TABLE,
+    STRING_BUILDER, // Growable buffer private to one string variable
+    FREE    // Hole in the old generation, reusable by the allocator
+};
+
+// Header flags
+enum ObjFlags : uint8_t {
+    OBJ_MARKED = 1 << 0,    // Reached during the current major mark
+    OBJ_FORWARDED = 1 << 1, // Copied out of the nursery; see forwardee()
+    OBJ_SHARED = 1 << 2,    // Lives in a SharedHeap, immutable
+    OBJ_MESSAGE = 1 << 3    // Shared, part of a message freed once imported
+};
+
+// Common header of every heap object. Objects are laid out back to back in
+// the nursery and in old-generation segments, so `size` (the full aligned
+// allocation including this header) is what lets the collector walk them.
+struct Obj {
+    ObjType type;
+    uint8_t flags;
+    uint16_t reserved;
+    uint32_t size;
+    
+    bool isMarked() const { return flags & OBJ_MARKED; }
+    bool isForwarded() const { return flags & OBJ_FORWARDED; }
+    bool isShared() const { return flags & OBJ_SHARED; }
+    bool isInMessage() const { return flags & OBJ_MESSAGE; }
+    
+    // A forwarded object keeps its new address in the first payload word.
+    Obj* forwardee() const { return *reinterpret_cast<Obj* const*>(this + 1); }
+    void forwardTo(Obj* copy) {
+        flags |= OBJ_FORWARDED;
+        *reinterpret_cast<Obj**>(this + 1) = copy;
+    }
+};
+
+// Immutable string; the characters follow the struct and are NUL terminated.
+struct ObjString : Obj {
+    uint32_t length;
+    uint32_t hash;  // hashChars() of the characters, 0 until a dict needs it
+    
+    char* chars() { return reinterpret_cast<char*>(this + 1); }
+    const char* chars() const { return reinterpret_cast<const char*>(this + 1); }
+};
+
+// Characters of a string variable that a loop keeps appending to (see
+// APPEND_LOCAL), with spare capacity after them so an append usually just
+// copies the new characters in. Only that variable's slot ever refers to
+// it: reading the variable turns it back into an ObjString first, so no
+// other reference can see it change.
+struct ObjStringBuilder : Obj {
+    uint32_t length;
+    uint32_t capacity;
+    
+    char* chars() { return reinterpret_cast<char*>(this + 1); }
+    const char* chars() const { return reinterpret_cast<const char*>(this + 1); }
+};
+
+// How an array stores its elements. Arrays whose elements are all ints, all
+// numbers (ints mixed with numbers are widened) or all bools are packed
+// unboxed, so kernels can run over them; anything else is boxed Values.
+enum class ArrayStorage : uint8_t {
+    NUMBERS, // double
+    INTS,    // int64_t
+    BOOLS,   // uint8_t, 0 or 1
+    VALUES   // Value, the only storage the collector traces
+};
+
+// Fixed-length array; the elements follow the struct. The storage is chosen
+// at creation and never changes, so a store of the wrong kind is an error.
+struct ObjArray : Obj {
+    ArrayStorage storage;
+    uint8_t reserved2[3];
+    uint32_t length;
+    
+    double* numbers() { return reinterpret_cast<double*>(this + 1); }
+    const double* numbers() const { return reinterpret_cast<const double*>(this + 1); }
+    int64_t* ints() { return reinterpret_cast<int64_t*>(this + 1); }
+    const int64_t* ints() const { return reinterpret_cast<const int64_t*>(this + 1); }
+    uint8_t* bools() { return reinterpret_cast<uint8_t*>(this + 1); }
+    const uint8_t* bools() const { return reinterpret_cast<const uint8_t*>(this + 1); }
+};
+
+// Insertion-ordered hash map (see dict.h). The entries are in a separate
+// table, replaced by a larger one when it fills up.
+struct ObjDict : Obj {
+    uint32_t count;  // Entries in use, the first count of the table's
+    uint32_t reserved2;
+    Obj* table;      // ObjDictTable, or nullptr before the first insert
+};
+
+constexpr size_t kDictEntrySize = 32;     // Key and value, two Values
+constexpr size_t kDictGroupWidth = 16;    // Control bytes probed at once
+constexpr uint8_t kDictEmpty = 0x80;      // Control byte of a free slot
+
+// Open-addressing table of a dict. The struct is followed by
+//   entries[capacity]    key/value pairs, in the dict's iteration order
+//   hashes[capacity]     uint32_t hash of each entry's key
+//   slotEntries[slots]   uint32_t entry index of each occupied slot
+//   control[slots + kDictGroupWidth]
+// A control byte is kDictEmpty or the low 7 bits of the hash of the key in
+// its slot; the first group is repeated past the end so a group can be
+// loaded at any slot without wrapping.
+struct ObjDictTable : Obj {
+    uint32_t capacity;
+    uint32_t slots;  // A power of two, at least kDictGroupWidth
+    
+    uint32_t* hashes() {
+        return reinterpret_cast<uint32_t*>(reinterpret_cast<uint8_t*>(this + 1) + capacity * kDictEntrySize);
+    }
+    const uint32_t* hashes() const { return const_cast<ObjDictTable*>(this)->hashes(); }
+    uint32_t* slotEntries() { return hashes() + capacity; }
+    const uint32_t* slotEntries() const { return hashes() + capacity; }
+    uint8_t* control() { return reinterpret_cast<uint8_t*>(slotEntries() + slots); }
+    const uint8_t* control() const { return reinterpret_cast<const uint8_t*>(slotEntries() + slots); }
+};
+
+// Every allocation is a multiple of this and at least kMinObjectSize, which
+// leaves room for a forwarding pointer after the header.
+constexpr size_t kObjAlignment = 8;
+constexpr size_t kMinObjectSize = sizeof(Obj) + sizeof(Obj*);
+
+inline size_t alignObjectSize(size_t size) {
+    size = (size + kObjAlignment - 1) & ~(kObjAlignment - 1);
+    return size < kMinObjectSize ? kMinObjectSize : size;
+}
+
+inline size_t stringAllocationSize(size_t length) {
+    return alignObjectSize(sizeof(ObjString) + length + 1);
+}
+
+// Object sizes are 32-bit, which bounds the length of a string.
+constexpr size_t kMaxStringLength = UINT32_MAX - sizeof(ObjString) - kObjAlignment - 1;
+
+inline size_t arrayElementSize(ArrayStorage storage) {
+    switch (storage) {
+        case ArrayStorage::NUMBERS: return sizeof(double);
+        case ArrayStorage::INTS: return sizeof(int64_t);
+        case ArrayStorage::BOOLS: return sizeof(uint8_t);
+        case ArrayStorage::VALUES: return 16;  // sizeof(Value), checked in gc.cpp
+    }
+    return 16;
+}
+
+// Object sizes are 32-bit, which bounds the length of an array.
+inline size_t maxArrayLength(ArrayStorage storage) {
+    return (UINT32_MAX - sizeof(ObjArray) - kObjAlignment) / arrayElementSize(storage);
+}
+
+inline size_t arrayAllocationSize(ArrayStorage storage, size_t length) {
+    return alignObjectSize(sizeof(ObjArray) + length * arrayElementSize(storage));
+}
+
+inline size_t dictTableAllocationSize(size_t capacity, size_t slots) {
+    return alignObjectSize(sizeof(ObjDictTable) + capacity * (kDictEntrySize + sizeof(uint32_t)) +
+                           slots * (sizeof(uint32_t) + 1) + kDictGroupWidth);
+}
+
+inline bool isObjType(const Obj* obj, ObjType type) {
+    return obj != nullptr && obj->type == type;
+}
+
+inline std::string stringOf(const ObjString* string) {
+    return std::string(string->chars(), string->length);
+}
+
+// Hash of a string's characters for ObjString::hash; never 0. Reads eight
+// bytes at a time, so it differs between byte orders.
+inline uint32_t hashChars(const char* chars, size_t length) {
+    uint64_t hash = 0x9e3779b97f4a7c15ull ^ length;
+    size_t i = 0;
+    for (; i + 8 <= length; i += 8) {
+        uint64_t word;
+        std::memcpy(&word, chars + i, 8);
+        hash = (hash ^ word) * 0xff51afd7ed558ccdull;
+        hash ^= hash >> 32;
+    }
+    uint64_t tail = 0;
+    std::memcpy(&tail, chars + i, length - i);
+    hash = (hash ^ tail) * 0xc4ceb9fe1a85ec53ull;
+    hash ^= hash >> 29;
+    hash *= 0xff51afd7ed558ccdull;
+    hash ^= hash >> 32;
+    return static_cast<uint32_t>(hash) | (static_cast<uint32_t>(hash) == 0);
+}
+
+#endif // OBJECT_H
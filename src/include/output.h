@@ -0,0 +1,59 @@
+#ifndef OUTPUT_H
+#define OUTPUT_H
+
+#include <cstddef>
+#include <string>
+#include "bytecode.h"
+
+// When buffered print output reaches standard output.
+enum class FlushPolicy {
+    LINE,   // After every print; the default when stdout is a terminal
+    BLOCK,  // Once kOutputBlockSize bytes wait, and before an await blocks
+    EXIT    // Only when the script finishes or fails
+};
+
+constexpr size_t kOutputBlockSize = 64 * 1024;
+
+// Output of print, shared by the VM and the native runtime.
+//
+// Values are formatted straight into one buffer that is written to file
+// descriptor 1 with write(2), so printing a line costs no iostream and,
+// unless the policy is LINE, no system call. Each owner flushes before
+// reporting a runtime error and when its script ends; the destructor
+// flushes anything left. stdout (and so std::cout) is flushed first, so
+// text written there earlier, like the REPL prompt, still comes out in order.
+class Output {
+public:
+    // LINE if stdout is a terminal, else BLOCK.
+    Output();
+    ~Output();
+    
+    Output(const Output&) = delete;
+    Output& operator=(const Output&) = delete;
+    
+    void setPolicy(FlushPolicy newPolicy) { policy = newPolicy; }
+    FlushPolicy getPolicy() const { return policy; }
+    
+    // The value's text and a newline.
+    void print(const Value& value) {
+        appendValue(buffer, value);
+        buffer += '\n';
+        if (policy == FlushPolicy::LINE ||
+            (policy == FlushPolicy::BLOCK && buffer.size() >= kOutputBlockSize)) {
+            flush();
+        }
+    }
+    
+    // About to wait on an await: flush unless output is held until exit.
+    void beforeWait() {
+        if (policy != FlushPolicy::EXIT) flush();
+    }
+    
+    void flush();
+
+private:
+    FlushPolicy policy;
+    std::string buffer;
+};
+
+#endif // OUTPUT_H
@@ -26,22 +26,37 @@ private:
     std::unique_ptr<ClassStatement> classDeclaration();
     std::unique_ptr<TaskStatement> taskDeclaration();
     std::unique_ptr<Statement> printStatement();
+    std::unique_ptr<Statement> assignment();
+    std::unique_ptr<Statement> ifStatement();
+    std::unique_ptr<Statement> whileStatement();
+    std::unique_ptr<Statement> forStatement();
+    std::vector<std::unique_ptr<Statement>> block(const std::string& owner);
     std::unique_ptr<Statement> expressionStatement();
     void consumeEndOfStatement();
 
     // Expression parsing methods using recursive descent
     std::unique_ptr<Expression> expression();
+    std::unique_ptr<Expression> logicalOr();
+    std::unique_ptr<Expression> logicalAnd();
+    std::unique_ptr<Expression> logicalNot();
     std::unique_ptr<Expression> equality();
     std::unique_ptr<Expression> comparison();
+    std::unique_ptr<Expression> bitOr();
+    std::unique_ptr<Expression> bitXor();
+    std::unique_ptr<Expression> bitAnd();
+    std::unique_ptr<Expression> shift();
     std::unique_ptr<Expression> term();
     std::unique_ptr<Expression> factor();
     std::unique_ptr<Expression> unary();
+    std::unique_ptr<Expression> call();
     std::unique_ptr<Expression> primary();
+    std::vector<std::unique_ptr<Expression>> arguments(TokenType closing, const std::string& message);
 
     // Helper methods
     void skipNewlines();
     bool match(TokenType type);
     bool check(TokenType type);
+    bool checkNext(TokenType type);
     Token advance();
     Token peek();
     Token previous();
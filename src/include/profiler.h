@@ -0,0 +1,89 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <chrono>
+#include <csignal>
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#include <x86intrin.h>
+#endif
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <vector>
+#include "bytecode.h"
+
+// Execution profile of a VM's chunk (`fusion --profile`).
+//
+// While a profiler is attached the VM stays in the interpreter (no JIT)
+// and calls step() before every instruction. Each instruction is counted,
+// and the time until the next one starts is charged to it (read from the
+// cycle counter on x86-64; time suspended on an await is not counted).
+// Separately, a CPU-time timer (SIGPROF) sets a flag about once a
+// millisecond and the next step() takes it as a sample of ip; samples
+// cost nothing between ticks, so timing every instruction does not
+// distort them.
+//
+// Everything is kept per instruction offset and folded by opcode and by
+// Chunk::lines when reporting. Only one profiler can sample at a time.
+class Profiler {
+public:
+    explicit Profiler(const Chunk& chunk);
+    ~Profiler();
+    
+    Profiler(const Profiler&) = delete;
+    Profiler& operator=(const Profiler&) = delete;
+    
+    void step(size_t ip) {
+        uint64_t now = ticks();
+        if (ip >= counts.size()) grow(ip);
+        if (running != kNotRunning) elapsed[running] += now - started;
+        counts[ip]++;
+        running = ip;
+        started = now;
+        if (sampleDue != 0) takeSample(ip);
+    }
+    
+    // The script finished, failed or suspended; stop charging time until
+    // the next step().
+    void pause();
+    // The chunk was recompiled (VM::load): forget everything counted for
+    // the code it held, so the profile covers the new script alone.
+    void reset();
+    
+    uint64_t instructions() const;
+    
+    // Hot spots by opcode and by line, hottest first.
+    void report(std::ostream& out) const;
+    // One "script;line <n>;<OPCODE> <samples>" line per sampled line and
+    // opcode, the collapsed-stack format flamegraph.pl reads.
+    void writeCollapsed(std::ostream& out) const;
+
+private:
+    static constexpr size_t kNotRunning = SIZE_MAX;
+    static volatile std::sig_atomic_t sampleDue;  // Set by the SIGPROF handler
+    
+    const Chunk& chunk;
+    std::vector<uint64_t> counts;    // Per instruction offset
+    std::vector<uint64_t> elapsed;   // Ticks, per offset
+    std::vector<uint64_t> samples;   // Per offset
+    size_t running = kNotRunning;    // Offset being timed
+    uint64_t started = 0;            // Ticks when it started
+    // When profiling began, to convert ticks to nanoseconds.
+    uint64_t firstTick;
+    std::chrono::steady_clock::time_point firstTime;
+    
+    static uint64_t ticks() {
+        #if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+        return __rdtsc();
+        #else
+        return std::chrono::steady_clock::now().time_since_epoch().count();
+        #endif
+    }
+    double nanosPerTick() const;
+    
+    void grow(size_t ip);
+    void takeSample(size_t ip);
+    static void onTimer(int signal);
+};
+
+#endif // PROFILER_H
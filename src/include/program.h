@@ -0,0 +1,40 @@
+#ifndef PROGRAM_H
+#define PROGRAM_H
+
+#include <memory>
+#include <string>
+#include "bytecode.h"
+#include "shared.h"
+
+// A compiled script, shared read-only by every VM that runs it.
+//
+// Compiling is the part of running a script that does not depend on the
+// run, so embedders that run one script for many requests compile it once
+// into a Program and hand it to as many VMs (isolates: each with its own
+// stack, variables and heap) as they like, on any threads, at the same
+// time. The program's string constants are interned in its own
+// SharedHeap, which private collectors never mark, move or free, and the
+// chunk is compiled to native code up front, so running it writes nothing
+// shared. The one exception is Chunk::loopCounts: back edges bump them
+// without synchronization, so concurrent runs may lose counts there.
+class Program {
+public:
+    // Compile source; null (with the errors reported on stderr) when it
+    // does not compile.
+    static std::shared_ptr<const Program> compile(const std::string& source);
+    
+    Program(const Program&) = delete;
+    Program& operator=(const Program&) = delete;
+    
+    const Chunk& getChunk() const { return chunk; }
+
+private:
+    friend class VM;
+    
+    SharedHeap strings;  // Declared first: the chunk's constants point into it
+    mutable Chunk chunk;  // Mutable for the loop counters only
+    
+    Program() = default;
+};
+
+#endif // PROGRAM_H
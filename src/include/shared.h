@@ -0,0 +1,72 @@
+#ifndef SHARED_H
+#define SHARED_H
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "bytecode.h"
+#include "object.h"
+
+// Region shared by every task of a program.
+//
+// Each task's VM owns a private Heap that it collects on its own. Values
+// cross between tasks as messages: Heap::exportValue deep-copies a value
+// (strings, arrays and dicts, keeping shared structure and cycles) into
+// one block here, and Heap::importValue copies it into the receiver's heap
+// and frees the block. The region therefore holds only the messages in
+// flight, however long a pipeline runs; a message that is never imported
+// is freed with the region. Send the exported values over a
+// Channel<Value> (channel.h), each one to a single receiver.
+//
+// Strings interned with shareString() (a Program's constants) are kept for
+// the region's lifetime instead, and every VM uses them in place. Objects
+// here carry OBJ_SHARED, message objects OBJ_MESSAGE too; private
+// collectors never mark, move or free them.
+class SharedHeap {
+public:
+    static constexpr size_t kArenaSize = 1 << 20;
+    
+    SharedHeap() = default;
+    ~SharedHeap();
+    
+    SharedHeap(const SharedHeap&) = delete;
+    SharedHeap& operator=(const SharedHeap&) = delete;
+    
+    // Thread-safe; returns the existing copy when an equal string was shared.
+    ObjString* shareString(const char* chars, size_t length);
+    // Thread-safe; room for a message of size bytes of objects, which the
+    // caller lays out from the start of the block. The first object is the
+    // message's root.
+    uint8_t* allocateMessage(size_t size);
+    // Thread-safe; free the message whose root is root, in whichever
+    // region holds it.
+    static void releaseMessage(const Obj* root);
+    
+    // Interned strings plus the messages not yet imported.
+    size_t bytesAllocated() const;
+
+private:
+    // Precedes each message's objects; messages in flight form a list, so
+    // the region can free those nobody imported.
+    struct alignas(kObjAlignment) Message {
+        SharedHeap* owner;
+        size_t size;
+        Message* prev;
+        Message* next;
+    };
+    
+    mutable std::mutex mutex;
+    std::vector<uint8_t*> arenas;
+    uint8_t* top = nullptr;
+    uint8_t* end = nullptr;
+    size_t allocated = 0;
+    std::unordered_map<std::string_view, ObjString*> interned;
+    Message* messages = nullptr;
+    
+    void* allocate(size_t size);
+};
+
+#endif // SHARED_H
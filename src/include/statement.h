@@ -1,6 +1,7 @@
 #ifndef STATEMENT_H
 #define STATEMENT_H
 
+#include <cstdint>
 #include <memory>
 #include <string>
 #include <vector>
@@ -68,6 +69,112 @@ public:
     std::vector<std::pair<std::string, std::string>> params;  // (name, type)
     std::string returnType;
     std::vector<std::unique_ptr<Statement>> body;
+    bool isAsync = false;  // declared as 'async task'
+};
+
+// Assignment; the first assignment to a name declares it (e.g., x = 1)
+class AssignStatement : public Statement {
+public:
+    AssignStatement(Token name, std::unique_ptr<Expression> value)
+        : name(name), value(std::move(value)) {}
+    
+    void accept(StatementVisitor* visitor) override;
+    
+    Token name;
+    std::unique_ptr<Expression> value;
+};
+
+// Store into an array element (e.g., a[i] = x)
+class SetIndexStatement : public Statement {
+public:
+    SetIndexStatement(std::unique_ptr<IndexExpression> target, std::unique_ptr<Expression> value)
+        : target(std::move(target)), value(std::move(value)) {}
+    
+    void accept(StatementVisitor* visitor) override;
+    
+    std::unique_ptr<IndexExpression> target;
+    std::unique_ptr<Expression> value;
+};
+
+// If statement; 'else if' nests another IfStatement in elseBranch
+class IfStatement : public Statement {
+public:
+    IfStatement(Token keyword, std::unique_ptr<Expression> condition,
+                std::vector<std::unique_ptr<Statement>> thenBranch,
+                std::vector<std::unique_ptr<Statement>> elseBranch)
+        : keyword(keyword), condition(std::move(condition)),
+          thenBranch(std::move(thenBranch)), elseBranch(std::move(elseBranch)) {}
+    
+    void accept(StatementVisitor* visitor) override;
+    
+    Token keyword;
+    std::unique_ptr<Expression> condition;
+    std::vector<std::unique_ptr<Statement>> thenBranch;
+    std::vector<std::unique_ptr<Statement>> elseBranch;
+};
+
+// While loop
+class WhileStatement : public Statement {
+public:
+    WhileStatement(Token keyword, std::unique_ptr<Expression> condition,
+                   std::vector<std::unique_ptr<Statement>> body)
+        : keyword(keyword), condition(std::move(condition)), body(std::move(body)) {}
+    
+    void accept(StatementVisitor* visitor) override;
+    
+    Token keyword;
+    std::unique_ptr<Expression> condition;
+    std::vector<std::unique_ptr<Statement>> body;
+};
+
+// Counting loop: for i in range(start, stop, step). The step is a non-zero
+// int literal so the loop direction is known at compile time.
+class ForStatement : public Statement {
+public:
+    ForStatement(Token keyword, Token variable, std::unique_ptr<Expression> start,
+                 std::unique_ptr<Expression> stop, int64_t step,
+                 std::vector<std::unique_ptr<Statement>> body)
+        : keyword(keyword), variable(variable), start(std::move(start)),
+          stop(std::move(stop)), step(step), body(std::move(body)) {}
+    
+    void accept(StatementVisitor* visitor) override;
+    
+    Token keyword;
+    Token variable;
+    std::unique_ptr<Expression> start;
+    std::unique_ptr<Expression> stop;
+    int64_t step;
+    std::vector<std::unique_ptr<Statement>> body;
+};
+
+// Break out of the innermost loop
+class BreakStatement : public Statement {
+public:
+    BreakStatement(Token keyword) : keyword(keyword) {}
+    
+    void accept(StatementVisitor* visitor) override;
+    
+    Token keyword;
+};
+
+// Skip to the next iteration of the innermost loop
+class ContinueStatement : public Statement {
+public:
+    ContinueStatement(Token keyword) : keyword(keyword) {}
+    
+    void accept(StatementVisitor* visitor) override;
+    
+    Token keyword;
+};
+
+// Import of a module by name (e.g., import config); see VM::addModulePath
+class ImportStatement : public Statement {
+public:
+    ImportStatement(Token name) : name(name) {}
+    
+    void accept(StatementVisitor* visitor) override;
+    
+    Token name;
 };
 
 // Visitor for statements
@@ -78,6 +185,14 @@ public:
     virtual void visitPrintStatement(PrintStatement* stmt) = 0;
     virtual void visitClassStatement(ClassStatement* stmt) = 0;
     virtual void visitTaskStatement(TaskStatement* stmt) = 0;
+    virtual void visitAssignStatement(AssignStatement* stmt) = 0;
+    virtual void visitSetIndexStatement(SetIndexStatement* stmt) = 0;
+    virtual void visitIfStatement(IfStatement* stmt) = 0;
+    virtual void visitWhileStatement(WhileStatement* stmt) = 0;
+    virtual void visitForStatement(ForStatement* stmt) = 0;
+    virtual void visitBreakStatement(BreakStatement* stmt) = 0;
+    virtual void visitContinueStatement(ContinueStatement* stmt) = 0;
+    virtual void visitImportStatement(ImportStatement* stmt) = 0;
 };
 
 // Implementations of accept methods
@@ -97,4 +212,36 @@ inline void TaskStatement::accept(StatementVisitor* visitor) {
     visitor->visitTaskStatement(this);
 }
 
+inline void AssignStatement::accept(StatementVisitor* visitor) {
+    visitor->visitAssignStatement(this);
+}
+
+inline void SetIndexStatement::accept(StatementVisitor* visitor) {
+    visitor->visitSetIndexStatement(this);
+}
+
+inline void IfStatement::accept(StatementVisitor* visitor) {
+    visitor->visitIfStatement(this);
+}
+
+inline void WhileStatement::accept(StatementVisitor* visitor) {
+    visitor->visitWhileStatement(this);
+}
+
+inline void ForStatement::accept(StatementVisitor* visitor) {
+    visitor->visitForStatement(this);
+}
+
+inline void BreakStatement::accept(StatementVisitor* visitor) {
+    visitor->visitBreakStatement(this);
+}
+
+inline void ContinueStatement::accept(StatementVisitor* visitor) {
+    visitor->visitContinueStatement(this);
+}
+
+inline void ImportStatement::accept(StatementVisitor* visitor) {
+    visitor->visitImportStatement(this);
+}
+
 #endif // STATEMENT_H
\ No newline at end of file
@@ -0,0 +1,25 @@
+#ifndef STRINGBUILDER_H
+#define STRINGBUILDER_H
+
+#include "bytecode.h"
+#include "gc.h"
+
+// Repeated `s = s + x` in a loop, shared by the VM and the native runtime.
+//
+// Concatenating copies both operands, so building a string one piece at a
+// time is quadratic. The compiler turns such an assignment into
+// APPEND_LOCAL instead, which makes the variable's value a StringBuilder
+// (ObjStringBuilder) on the first append and copies only the new pieces
+// after that; capacity doubles when it runs out, so an append is amortized
+// O(length of the piece). The variable is read with GET_STRING_LOCAL,
+// which flattens the builder back into an ObjString the first time, so no
+// other code ever sees a builder.
+//
+// variable is a local slot proven to hold a string or a builder; pieces
+// are strings on the stack. Both are collector roots.
+
+// Returns nullptr, or the runtime error message.
+const char* appendStrings(Heap& heap, Value& variable, const Value* pieces, size_t count);
+void flattenString(Heap& heap, Value& variable);
+
+#endif // STRINGBUILDER_H
@@ -0,0 +1,65 @@
+#ifndef TIMELINE_H
+#define TIMELINE_H
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+// Process-wide timeline of what the runtime spends wall-clock time on
+// (`fusion --timeline=<file>`), written as Chrome trace events that
+// chrome://tracing and Perfetto open.
+//
+// Recording is cheap enough to leave in place: while the timeline is off
+// each call site costs one relaxed load. While it is on, each thread
+// appends fixed-size events (names are string literals, never copied) to
+// its own single-producer ring buffer without locks; a flusher thread
+// drains every buffer a few times a second and writes the JSON, so the
+// recording threads never touch the file. A thread whose buffer is full
+// drops events, and the count is reported at the end.
+//
+// Categories in use: "compile" (lex, parse, typecheck, codegen), "vm"
+// (each run of the chunk, JIT compiles), "task" (awaits parked on the event
+// loop, thread pool work, channel park/wake) and "gc" (every collector pause
+// by kind, and concurrent marking on the marker thread).
+class Timeline {
+public:
+    // Start recording into path; false if it cannot be written.
+    static bool start(const std::string& path);
+    // Drain every buffer, finish the file and stop recording.
+    static void stop();
+    
+    static bool enabled() { return active.load(std::memory_order_relaxed); }
+    
+    // Nanoseconds on the timeline's clock.
+    static uint64_t now();
+    
+    // An event that ran from start to end (from now()).
+    static void complete(const char* category, const char* name, uint64_t start, uint64_t end);
+    static void instant(const char* category, const char* name);
+    // Label the calling thread in the viewer.
+    static void nameThread(const char* name);
+
+private:
+    static std::atomic<bool> active;
+};
+
+// Records a complete event for its own lifetime.
+class TimelineScope {
+public:
+    TimelineScope(const char* category, const char* name)
+        : category(category), name(name), start(Timeline::enabled() ? Timeline::now() : 0) {}
+    
+    ~TimelineScope() {
+        if (start != 0 && Timeline::enabled()) Timeline::complete(category, name, start, Timeline::now());
+    }
+    
+    TimelineScope(const TimelineScope&) = delete;
+    TimelineScope& operator=(const TimelineScope&) = delete;
+
+private:
+    const char* category;
+    const char* name;
+    uint64_t start;
+};
+
+#endif // TIMELINE_H
@@ -5,8 +5,8 @@
 
 enum class TokenType {
     // Keywords
-    CLASS, DEF, TASK, PARALLEL, ASYNC, AWAIT,
-    IF, ELSE, FOR, WHILE, RETURN, AND, OR, NOT, PRINT,
+    CLASS, DEF, TASK, PARALLEL, ASYNC, AWAIT, IMPORT,
+    IF, ELSE, FOR, IN, WHILE, RETURN, AND, OR, NOT, PRINT, DIV,
 
     //Control flow
     PASS, BREAK, CONTINUE,
@@ -15,7 +15,9 @@ enum class TokenType {
     IDENTIFIER, STRING, NUMBER,
 
     // Operators
-    PLUS, MINUS, STAR, SLASH, BANG,
+    PLUS, MINUS, STAR, SLASH, PERCENT, BANG,
+    AMPERSAND, PIPE, CARET, TILDE,
+    LESS_LESS, GREATER_GREATER, // Shifts
     GREATER, GREATER_EQUAL,
     LESS, LESS_EQUAL,
     EQUAL, EQUAL_EQUAL,
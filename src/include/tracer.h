@@ -0,0 +1,87 @@
+#ifndef TRACER_H
+#define TRACER_H
+
+#include <climits>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <ostream>
+#include <string>
+#include <vector>
+#include "bytecode.h"
+
+// Which executed instructions a Tracer records (`--trace-lines=<a>-<b>`,
+// `--trace-ops=<OPCODE>,...`).
+struct TraceFilter {
+    int firstLine = 0;
+    int lastLine = INT_MAX;
+    std::vector<bool> opCodes;  // Indexed by opcode; empty = all
+    
+    bool matches(const Chunk& chunk, size_t ip) const {
+        int line = chunk.lines[ip];
+        return line >= firstLine && line <= lastLine &&
+               (opCodes.empty() || opCodes[chunk.code[ip]]);
+    }
+    
+    // Parse "<first>-<last>" (or one line) and "ADD,LOOP"; false if malformed.
+    bool parseLines(const std::string& text);
+    bool parseOpCodes(const std::string& text);
+};
+
+// Execution trace of a VM's chunk (`fusion --trace[=<file>]`).
+//
+// While a tracer is attached the VM runs an instrumented copy of its
+// dispatch loop, without the JIT, that calls step() before every
+// instruction; the copy the VM normally runs has no tracing code at all.
+// A text tracer writes the stack and the disassembled instruction. A
+// binary tracer writes only the instruction's offset, as a varint, and
+// appends the chunk itself when closed, so `fusion replay <file>` can print
+// the instructions back through the Disassembler without the script:
+//
+//   "FTRC" version:u8  offset:varint ...
+//   chunk: code length, code bytes, one line per byte, constant count,
+//          constants (tag byte, then payload)
+//   position of the chunk section:u64, where the offsets end
+//
+// Counts, lengths and lines are varints (LEB128) too.
+class Tracer {
+public:
+    // Text, to out.
+    Tracer(const Chunk& chunk, TraceFilter filter, std::ostream& out);
+    // Binary, to a file; check ok().
+    Tracer(const Chunk& chunk, TraceFilter filter, const std::string& path);
+    ~Tracer();
+    
+    Tracer(const Tracer&) = delete;
+    Tracer& operator=(const Tracer&) = delete;
+    
+    bool ok() const { return text != nullptr || static_cast<bool>(file); }
+    
+    void step(size_t ip, const std::vector<Value>& stack) {
+        if (filter.matches(chunk, ip)) record(ip, stack);
+    }
+    
+    // Finish a binary trace; later steps are dropped.
+    void close();
+    // The chunk is about to be recompiled (VM::load). A binary trace holds
+    // one chunk, so once it has recorded anything it is finished with the
+    // code its offsets refer to; a text trace carries on with the new
+    // script.
+    void chunkReplaced();
+
+private:
+    const Chunk& chunk;
+    TraceFilter filter;
+    std::ostream* text = nullptr;
+    std::ofstream file;
+    bool closed = false;
+    bool recorded = false;  // Any offsets written yet
+    
+    void record(size_t ip, const std::vector<Value>& stack);
+};
+
+// Print a binary trace's instructions to out; false and a message on err
+// if the file is not a trace.
+bool replayTrace(const std::string& path, std::ostream& out, std::ostream& err);
+
+#endif // TRACER_H
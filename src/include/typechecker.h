@@ -0,0 +1,118 @@
+#ifndef TYPECHECKER_H
+#define TYPECHECKER_H
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include "expression.h"
+#include "statement.h"
+
+// Static types. UNKNOWN means "not proven": the value is checked at run time.
+enum class StaticType : uint8_t {
+    UNKNOWN,
+    NUMBER,  // A double
+    INT,
+    STRING,
+    BOOL,
+    NULL_TYPE,
+    ARRAY,
+    DICT,
+    VOID  // Only as a task return type
+};
+
+// Annotation names: number, int, string, bool, null, array, dict, void, and any
+// (UNKNOWN).
+bool parseTypeName(const std::string& name, StaticType& type);
+const char* typeName(StaticType type);
+
+// Type-checking pass run between parsing and code generation.
+//
+// Types come from literals, task parameter and return annotations, and local
+// inference through operators: an operator whose operands can never be
+// valid is a compile error, and otherwise its result type is whatever it
+// must be for the operation to succeed (e.g. '&' of two ints yields an int).
+// Operators also apply element-wise to arrays, so an operand that is not
+// proven leaves the result unproven too.
+// A variable has the type of its assignments when they all agree, found by
+// re-checking until no variable changes; a variable read where it may not
+// have been assigned yet is an error, so a proven type always holds.
+// The compiler asks typeOf() for operand types to pick opcodes that skip
+// the VM's dynamic checks.
+class TypeChecker : public ExpressionVisitor, public StatementVisitor {
+public:
+    bool check(const std::vector<std::unique_ptr<Statement>>& statements);
+    
+    // Proven type of an expression checked by the last check().
+    StaticType typeOf(const Expression* expr) const;
+    // Proven type of a script-level variable.
+    StaticType variableType(const std::string& name) const;
+    
+    // Expression visitor methods
+    void visitLiteral(Literal* expr) override;
+    void visitGroupingExpression(GroupingExpression* expr) override;
+    void visitUnaryExpression(UnaryExpression* expr) override;
+    void visitBinaryExpression(BinaryExpression* expr) override;
+    void visitLogicalExpression(LogicalExpression* expr) override;
+    void visitVariableExpression(VariableExpression* expr) override;
+    void visitAwaitExpression(AwaitExpression* expr) override;
+    void visitArrayExpression(ArrayExpression* expr) override;
+    void visitDictExpression(DictExpression* expr) override;
+    void visitIndexExpression(IndexExpression* expr) override;
+    void visitCallExpression(CallExpression* expr) override;
+    void visitMemberExpression(MemberExpression* expr) override;
+    
+    // Statement visitor methods
+    void visitExpressionStatement(ExpressionStatement* stmt) override;
+    void visitPrintStatement(PrintStatement* stmt) override;
+    void visitClassStatement(ClassStatement* stmt) override;
+    void visitTaskStatement(TaskStatement* stmt) override;
+    void visitAssignStatement(AssignStatement* stmt) override;
+    void visitSetIndexStatement(SetIndexStatement* stmt) override;
+    void visitIfStatement(IfStatement* stmt) override;
+    void visitWhileStatement(WhileStatement* stmt) override;
+    void visitForStatement(ForStatement* stmt) override;
+    void visitBreakStatement(BreakStatement* stmt) override;
+    void visitContinueStatement(ContinueStatement* stmt) override;
+    void visitImportStatement(ImportStatement* stmt) override;
+
+private:
+    using Variables = std::unordered_map<std::string, StaticType>;
+    
+    std::unordered_map<const Expression*, StaticType> types;
+    Variables globals;
+    std::unordered_map<const TaskStatement*, Variables> taskVariables;
+    Variables* variables = &globals;  // Scope being checked
+    
+    // Definite assignment: names assigned on every path to this point.
+    // When the point is unreachable (after break) anything goes.
+    std::unordered_set<std::string> assigned;
+    bool reachable = true;
+    int loopDepth = 0;
+    
+    bool changed = false;    // A variable's type widened during this pass
+    bool reporting = false;  // Only the final pass reports errors
+    bool hadError = false;
+    
+    void pass(const std::vector<std::unique_ptr<Statement>>& statements);
+    void checkBlock(const std::vector<std::unique_ptr<Statement>>& statements);
+    void assign(const std::string& name, StaticType type);
+    
+    StaticType infer(Expression* expr);
+    void record(const Expression* expr, StaticType type);
+    
+    // Operand must be a number or an int (or unknown); reports an error otherwise.
+    void expectNumber(StaticType type, const Token& op, bool unary);
+    // Operand must be an int (or unknown).
+    void expectInt(StaticType type, const Token& op, bool unary);
+    // Operands of an element-wise operator on arrays: arrays or numbers.
+    void expectElementWise(StaticType left, StaticType right, const Token& op);
+    // Array and index of a[i].
+    void checkIndex(IndexExpression* expr);
+    
+    void error(int line, const std::string& message);
+};
+
+#endif // TYPECHECKER_H
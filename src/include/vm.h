@@ -1,38 +1,182 @@
 #ifndef VM_H
 #define VM_H
 
+#include <memory>
+#include <string>
+#include <unordered_map>
 #include <vector>
 #include "bytecode.h"
+#include "eventloop.h"
+#include "gc.h"
+#include "heapprofile.h"
+#include "jit.h"
+#include "output.h"
+#include "profiler.h"
+#include "program.h"
+#include "tracer.h"
 
 // Interpretation result codes
 enum class InterpretResult {
     OK,
     COMPILE_ERROR,
-    RUNTIME_ERROR
+    RUNTIME_ERROR,
+    SUSPENDED, // Parked on an await; the event loop resumes it
+    PREEMPTED  // Out of fuel (see VM::setFuel); run() carries on
 };
 
-// Virtual machine that executes bytecode
+// Virtual machine that executes bytecode.
+//
+// A VM is one isolate: its stack (the script's variables sit at the base),
+// heap and output are its own, and it runs on one thread at a time. It
+// runs either source, compiled into its own chunk, or a shared Program
+// (program.h) that any number of VMs can run concurrently, e.g. one per
+// request:
+//
+//   auto program = Program::compile(source);
+//   VM vm;  // on each request's thread
+//   vm.interpret(program);
 class VM {
 public:
     VM();
+    // Share an event loop so many VMs can have awaits pending at once.
+    explicit VM(EventLoop& loop);
     
+    // Compile and run to completion, driving the event loop across awaits.
     InterpretResult interpret(const std::string& source);
+    InterpretResult interpret(std::shared_ptr<const Program> program);
+    // Compile and run until the first await; completions resume it from
+    // the event loop. The final outcome is available from status().
+    InterpretResult start(const std::string& source);
+    InterpretResult start(std::shared_ptr<const Program> program);
+    // Compile into the VM's own chunk and reset the stack, ready for run();
+    // false on a compile error.
+    bool load(const std::string& source);
+    // Run program next, with a fresh stack; false, leaving the VM as it
+    // was, when program is null because it did not compile.
+    bool load(std::shared_ptr<const Program> program);
+    // Run from ip until the script finishes, fails, awaits or is preempted;
+    // after PREEMPTED, calling run() again continues it.
     InterpretResult run();
     
+    // Give every run() a budget of loop back edges, 0 (the default) for
+    // none; the one after the last is preempted. Straight-line code cannot
+    // run long, so it is never checked. start() and interpret() yield to
+    // the event loop on preemption and continue once everything else ready
+    // has run, so VMs sharing a loop take turns; a host scheduling VMs on
+    // its own threads calls run() instead.
+    void setFuel(uint64_t backEdges) { fuelPerRun = backEdges; }
+    
+    // Where `import name` looks for "name.fs", in order. A module is read,
+    // compiled into its own chunk and run only when a variable of it is
+    // first read, once per VM; its top level may not await.
+    void addModulePath(std::string directory) { modulePaths.push_back(std::move(directory)); }
+    
+    InterpretResult status() const { return state; }
+    Heap& getHeap() { return heap; }
+    Output& getOutput() { return output; }
+    
+    // Profile everything run from now on, in the interpreter only. The
+    // profilers and tracer work on source compiled by the VM, not on
+    // Programs.
+    void enableProfiling();
+    Profiler* getProfiler() { return profiler.get(); }
+    // Trace everything run from now on, in the interpreter only (see tracer.h).
+    void setTracer(std::unique_ptr<Tracer> newTracer);
+    Tracer* getTracer() { return tracer.get(); }
+    // Sample allocation sites and write heap snapshots (see heapprofile.h);
+    // snapshots requested while running go to "<snapshotPath>.<n>".
+    void enableHeapProfiling(const std::string& snapshotPath);
+    HeapProfiler* getHeapProfiler() { return heapProfiler.get(); }
+    // Disassemble the chunk to stdout after each compile.
+    void setDumpBytecode(bool dump) { dumpBytecode = dump; }
+    
+    const Chunk& getChunk() const { return *chunk; }
+
 private:
-    Chunk chunk;
+    struct Module;
+    // Resolved Chunk::members entry; module is null until first read.
+    struct MemberSlot {
+        Module* module = nullptr;
+        int slot = 0;
+    };
+    // A module once loaded; its variables are the slots at the base of its
+    // stack, as its top level left them.
+    struct Module {
+        std::string name;
+        Chunk chunk;
+        std::vector<Value> stack;
+        std::vector<MemberSlot> members;  // By chunk.members index
+        bool running = false;
+    };
+    
+    Heap heap;
+    Chunk sourceChunk;  // What load(source) compiles into
+    std::shared_ptr<const Program> program;
+    Chunk* chunk = &sourceChunk;  // Running: sourceChunk or the program's
     std::vector<Value> stack;
     int ip; // Instruction pointer
     
+    std::unique_ptr<EventLoop> ownedLoop;
+    EventLoop* loop;
+    InterpretResult state;
+    Output output;  // Flushed when the script finishes or fails
+    std::unique_ptr<Profiler> profiler;
+    std::unique_ptr<Tracer> tracer;
+    std::unique_ptr<HeapProfiler> heapProfiler;
+    bool dumpBytecode = false;
+    uint64_t awaitStart = 0;  // Timeline clock when the pending await parked
+    uint64_t fuelPerRun = 0;
+    int64_t fuel = 0;  // Back edges left in this run; preempted below 0
+    
+    std::vector<std::string> modulePaths;
+    std::unordered_map<std::string, std::unique_ptr<Module>> modules;  // By name
+    Module* unit = nullptr;  // Module running, null for the script
+    std::vector<MemberSlot> scriptMembers;  // By Chunk::members index
+    
     // Stack operations
     void push(Value value);
     Value pop();
     Value peek(int distance = 0);
     
-    // Helper methods for runtime values
-    bool isTruthy(const Value& value);
-    bool valuesEqual(const Value& a, const Value& b);
-    std::string valueToString(const Value& value);
+    // Replace the two strings on top of the stack with their concatenation.
+    void concatenate();
+    
+    // Numeric operators beyond the inline double fast paths (ints, mixed
+    // operands, errors). Report a runtime error and return false on failure.
+    bool binaryNumeric(OpCode op);
+    bool unaryNumeric(OpCode op);
+    // Pop the operands of a fused compare-and-branch and evaluate it.
+    bool compareForBranch(OpCode op, bool& holds);
+    
+    // Await support: start the operation described by the operand and
+    // arrange for resume() to be called with its result.
+    bool beginAwait(const Value& operand);
+    // Empty the stack down to fresh variable slots, sized for the verified
+    // chunk, and start over at its first instruction.
+    void resetStack();
+    // Drive the event loop until the script finishes or fails.
+    InterpretResult finish();
+    // GET_MEMBER's slow path: load the module if need be, find the
+    // variable and remember where it is. False after a runtime error.
+    bool resolveMember(uint8_t index, MemberSlot& member);
+    // Find, compile and run the module; null after a runtime error.
+    Module* loadModule(const std::string& name);
+    // run() into state, yielding to the event loop whenever preempted.
+    void proceed();
+    void resume(Value result);
+    void fail(const std::string& message);
+    // Count the pending await as finished, and record it on the timeline.
+    void finishAwait();
+    
+    // The dispatch loop, run() picks a copy: kInstrumented feeds the
+    // profiler and tracer before every instruction and never enters the JIT.
+    template <bool kInstrumented>
+    InterpretResult dispatch();
+    
+    // Tiering: compile the chunk once hot, and run its native code from ip
+    // until it hands an instruction back to the interpreter.
+    void countExecution();
+    void enterJit();
     
     // Error handling
     void runtimeError(const std::string& message);
@@ -41,7 +185,8 @@ private:
     bool isNumber(const Value& value);
     bool isString(const Value& value);
     double asNumber(const Value& value);
+    ObjString* asObjString(const Value& value);
     std::string asString(const Value& value);
 };
 
-#endif // VM_H
\ No newline at end of file
+#endif // VM_H
@@ -0,0 +1,35 @@
+#include <sstream>
+#include "../src/include/aot.h"
+#include "../src/include/program.h"
+#include "test.h"
+
+// Built executables are checked against the interpreter by the scripts
+// marked "// aot"; these cover what is decided before the C++ compiler runs.
+
+TEST(generateLowersAScriptToAMainFunction) {
+    std::shared_ptr<const Program> program = Program::compile("x = 2\nfor i in range(3) {\n    x = x * 2\n}\nprint x\n");
+    CHECK(program != nullptr);
+    std::ostringstream code;
+    std::string error;
+    CHECK(AotCompiler::generate(program->getChunk(), "loop.fs", code, error));
+    CHECK(error.empty());
+    CHECK(code.str().find("int main() {") != std::string::npos);
+}
+
+TEST(generateRejectsScriptsThatImport) {
+    std::shared_ptr<const Program> program = Program::compile("import config\nprint config.port\n");
+    CHECK(program != nullptr);
+    std::ostringstream code;
+    std::string error;
+    CHECK(!AotCompiler::generate(program->getChunk(), "app.fs", code, error));
+    CHECK_EQ(error, std::string("scripts that import modules cannot be built yet."));
+}
+
+TEST(buildReportsScriptsThatDoNotCompile) {
+    BuildResult result = BuildResult::OK;
+    std::string errors = captureOutput(2, [&]() {
+        result = AotCompiler::build("print y\n", "broken.fs", "/tmp/fusion-aot-test-unused");
+    });
+    CHECK(result == BuildResult::COMPILE_ERROR);
+    CHECK(!errors.empty());
+}
@@ -0,0 +1,61 @@
+#include <string>
+#include <vector>
+#include "../src/include/bytecode.h"
+#include "test.h"
+
+namespace {
+
+const uint8_t CONSTANT = static_cast<uint8_t>(OpCode::CONSTANT);
+const uint8_t ADD = static_cast<uint8_t>(OpCode::ADD);
+const uint8_t GET_LOCAL = static_cast<uint8_t>(OpCode::GET_LOCAL);
+const uint8_t JUMP = static_cast<uint8_t>(OpCode::JUMP);
+const uint8_t PRINT = static_cast<uint8_t>(OpCode::PRINT);
+const uint8_t RETURN = static_cast<uint8_t>(OpCode::RETURN);
+
+// A chunk of the given bytes, all on line 1, with one constant.
+Chunk chunkOf(const std::vector<uint8_t>& code) {
+    Chunk chunk;
+    for (uint8_t byte : code) {
+        chunk.write(static_cast<OpCode>(byte), 1);
+    }
+    chunk.addConstant(1.0);
+    return chunk;
+}
+
+// Why verifyChunk rejects chunk; empty when it passes.
+std::string rejection(Chunk chunk) {
+    std::string error;
+    if (verifyChunk(chunk, error)) return "";
+    if (chunk.maxDepth != -1) return "rejected with a stack depth";
+    return error;
+}
+    
+} // namespace
+
+TEST(verifiedChunksRecordTheirDeepestStack) {
+    Chunk chunk = chunkOf({CONSTANT, 0, CONSTANT, 0, CONSTANT, 0, ADD, ADD, PRINT, RETURN});
+    std::string error;
+    CHECK(verifyChunk(chunk, error));
+    CHECK_EQ(chunk.maxDepth, 3);
+    
+    // Code nothing jumps to is never run, so its operands go unchecked.
+    CHECK_EQ(rejection(chunkOf({RETURN, CONSTANT, 9})), std::string());
+}
+
+TEST(verifierRejectsMalformedChunks) {
+    const std::string malformed = "malformed control flow or stack depths";
+    CHECK_EQ(rejection(chunkOf({255, RETURN})), malformed);
+    CHECK_EQ(rejection(chunkOf({CONSTANT})), malformed);
+    CHECK_EQ(rejection(chunkOf({CONSTANT, 0, ADD, PRINT, RETURN})), malformed);
+    CHECK_EQ(rejection(chunkOf({JUMP, 0, 10, RETURN})), malformed);
+    CHECK_EQ(rejection(chunkOf({JUMP, 0, 1, CONSTANT, 0, PRINT, RETURN})), malformed);
+    CHECK_EQ(rejection(chunkOf({CONSTANT, 0, PRINT})), malformed);
+    
+    CHECK_EQ(rejection(chunkOf({CONSTANT, 1, PRINT, RETURN})), std::string("constant out of range at offset 0"));
+    CHECK_EQ(rejection(chunkOf({CONSTANT, 0, PRINT, GET_LOCAL, 0, PRINT, RETURN})),
+             std::string("variable slot out of range at offset 3"));
+    
+    Chunk lines = chunkOf({CONSTANT, 0, PRINT, RETURN});
+    lines.lines.pop_back();
+    CHECK_EQ(rejection(lines), std::string("line table does not match the code"));
+}
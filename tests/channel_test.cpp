@@ -0,0 +1,161 @@
+#include <functional>
+#include <thread>
+#include <vector>
+#include "../src/include/channel.h"
+#include "../src/include/gc.h"
+#include "../src/include/shared.h"
+#include "test.h"
+
+TEST(channelsBufferInOrderUpToCapacity) {
+    // Capacities that are not powers of two hold exactly that many, also
+    // once the ring has wrapped around.
+    for (size_t capacity : {1, 3, 4, 5}) {
+        Channel<int> channel(capacity);
+        CHECK_EQ(channel.capacity(), capacity);
+        int value = -1;
+        for (int round = 0; round < 3; round++) {
+            for (size_t i = 0; i < capacity; i++) {
+                CHECK(channel.trySend(static_cast<int>(i)));
+            }
+            CHECK(!channel.trySend(-1));
+            CHECK(channel.tryRecv(value));
+            CHECK_EQ(value, 0);
+            CHECK(channel.trySend(static_cast<int>(capacity)));
+            CHECK(!channel.trySend(-1));
+            for (size_t i = 1; i <= capacity; i++) {
+                CHECK(channel.tryRecv(value));
+                CHECK_EQ(value, static_cast<int>(i));
+            }
+            CHECK(!channel.tryRecv(value));
+        }
+    }
+}
+
+TEST(sendParksUntilAReceiverMakesRoom) {
+    EventLoop loop;
+    Channel<int> channel(2);
+    CHECK(channel.trySend(1));
+    CHECK(channel.trySend(2));
+    
+    bool sent = false;
+    channel.send(loop, 3, [&]() { sent = true; });
+    CHECK(!sent);
+    CHECK_EQ(channel.parkedSenders(), size_t(1));
+    
+    std::vector<int> received;
+    channel.recv(loop, [&](int value) { received.push_back(value); });
+    loop.run();
+    CHECK(sent);
+    CHECK_EQ(channel.parkedSenders(), size_t(0));
+    int value;
+    while (channel.tryRecv(value)) received.push_back(value);
+    CHECK(received == std::vector<int>({1, 2, 3}));
+}
+
+TEST(recvParksUntilAnotherThreadSends) {
+    // Producer and consumer fibers on their own loops and threads.
+    Channel<int> channel(8);
+    const int count = 2000;
+    std::thread producer([&]() {
+        EventLoop loop;
+        std::function<void(int)> sendFrom = [&](int i) {
+            if (i == count) return;
+            channel.send(loop, i, [&, i]() { sendFrom(i + 1); });
+        };
+        sendFrom(0);
+        loop.run();
+    });
+    
+    EventLoop loop;
+    long long sum = 0;
+    int received = 0;
+    std::function<void()> receive = [&]() {
+        channel.recv(loop, [&](int value) {
+            sum += value;
+            if (++received < count) receive();
+        });
+    };
+    receive();
+    loop.run();
+    producer.join();
+    CHECK_EQ(received, count);
+    CHECK_EQ(sum, static_cast<long long>(count) * (count - 1) / 2);
+}
+
+TEST(selectTakesWhicheverChannelIsReady) {
+    EventLoop loop;
+    Channel<int> quiet(2);
+    Channel<int> busy(2);
+    CHECK(busy.trySend(7));
+    
+    size_t index = 99;
+    int value = 0;
+    Channel<int>::select(loop, {&quiet, &busy}, [&](size_t i, int v) {
+        index = i;
+        value = v;
+    });
+    CHECK_EQ(index, size_t(1));
+    CHECK_EQ(value, 7);
+    CHECK_EQ(quiet.parkedReceivers(), size_t(0));
+}
+
+TEST(selectWithdrawsLosingRegistrations) {
+    // Each select parks on both channels and is woken by the busy one; its
+    // registration on the quiet one must not be left behind.
+    EventLoop loop;
+    Channel<int> quiet(2);
+    Channel<int> busy(2);
+    int received = 0;
+    for (int round = 0; round < 100; round++) {
+        Channel<int>::select(loop, {&quiet, &busy}, [&](size_t index, int) {
+            if (index == 1) received++;
+        });
+        CHECK_EQ(quiet.parkedReceivers(), size_t(1));
+        CHECK(busy.trySend(round));
+        loop.run();
+        CHECK_EQ(quiet.parkedReceivers(), size_t(0));
+        CHECK_EQ(busy.parkedReceivers(), size_t(0));
+    }
+    CHECK_EQ(received, 100);
+    
+    // Completing at once on a later channel withdraws the earlier ones.
+    Channel<int> later(2);
+    Channel<int>::select(loop, {&quiet, &busy, &later}, [](size_t, int) {});
+    CHECK(later.trySend(1));
+    loop.run();
+    CHECK_EQ(quiet.parkedReceivers() + busy.parkedReceivers(), size_t(0));
+}
+
+TEST(channelsCarryExportedValuesBetweenHeaps) {
+    SharedHeap shared;
+    Channel<Value> channel(16);
+    std::thread sender([&]() {
+        Heap heap;
+        EventLoop loop;
+        std::function<void(int)> sendFrom = [&](int i) {
+            if (i == 100) return;
+            std::string text = "item " + std::to_string(i);
+            Value string = static_cast<Obj*>(heap.copyString(text.data(), text.size()));
+            channel.send(loop, heap.exportValue(string, shared), [&, i]() { sendFrom(i + 1); });
+        };
+        sendFrom(0);
+        loop.run();
+    });
+    
+    Heap heap;
+    EventLoop loop;
+    std::vector<Value> roots;
+    heap.addRoots(&roots);
+    std::function<void()> receive = [&]() {
+        channel.recv(loop, [&](Value message) {
+            roots.push_back(heap.importValue(message));
+            if (roots.size() < 100) receive();
+        });
+    };
+    receive();
+    loop.run();
+    sender.join();
+    CHECK_EQ(roots.size(), size_t(100));
+    CHECK_EQ(stringOf(static_cast<ObjString*>(std::get<Obj*>(roots[42]))), std::string("item 42"));
+    heap.removeRoots(&roots);
+}
@@ -0,0 +1,136 @@
+#include <algorithm>
+#include <string>
+#include <vector>
+#include "../src/include/metrics.h"
+#include "../src/include/program.h"
+#include "../src/include/vm.h"
+#include "test.h"
+
+namespace {
+
+// Mnemonics of the instructions source compiles to; empty when it does not
+// compile.
+std::vector<std::string> opcodes(const std::string& source) {
+    std::vector<std::string> names;
+    std::shared_ptr<const Program> program;
+    captureOutput(2, [&]() { program = Program::compile(source); });
+    if (!program) return names;
+    const Chunk& chunk = program->getChunk();
+    for (size_t offset = 0; offset < chunk.code.size();) {
+        int length, effect;
+        if (!describeOpCode(chunk.code[offset], length, effect)) break;
+        names.push_back(opCodeName(chunk.code[offset]));
+        offset += length;
+    }
+    return names;
+}
+
+bool uses(const std::vector<std::string>& names, const std::string& name) {
+    return std::find(names.begin(), names.end(), name) != names.end();
+}
+
+// What compiling source reports on stderr; empty when it compiles.
+std::string compileErrors(const std::string& source) {
+    return captureOutput(2, [&]() { Program::compile(source); });
+}
+
+std::string run(const std::string& source) {
+    return captureOutput(1, [&]() {
+        VM vm;
+        vm.interpret(source);
+    });
+}
+    
+} // namespace
+
+TEST(provenNumbersUseUncheckedOpcodes) {
+    const char* source = "x = 1.5\ny = x * 2.0 + x\nprint y - x\nprint -y\n";
+    std::vector<std::string> names = opcodes(source);
+    CHECK(uses(names, "MULTIPLY_NUMBER"));
+    CHECK(uses(names, "ADD_NUMBER"));
+    CHECK(uses(names, "SUBTRACT_NUMBER"));
+    CHECK(uses(names, "NEGATE_NUMBER"));
+    CHECK(!uses(names, "ADD") && !uses(names, "MULTIPLY"));
+    CHECK_EQ(run(source), std::string("3\n-4.5\n"));
+}
+
+TEST(provenStringsConcatenateWithoutChecks) {
+    const char* source = "s = \"ab\"\nprint s + \"cd\"\n";
+    std::vector<std::string> names = opcodes(source);
+    CHECK(uses(names, "CONCAT"));
+    CHECK(!uses(names, "ADD"));
+    CHECK_EQ(run(source), std::string("abcd\n"));
+}
+
+TEST(unknownTypesKeepTheCheckedOpcodes) {
+    // x is a number on one path and a string on the other.
+    const char* source = "if 1 < 2 {\n    x = 1.5\n} else {\n    x = \"a\"\n}\nprint x + x\n";
+    std::vector<std::string> names = opcodes(source);
+    CHECK(uses(names, "ADD"));
+    CHECK(!uses(names, "ADD_NUMBER") && !uses(names, "CONCAT"));
+    CHECK_EQ(run(source), std::string("3\n"));
+}
+
+TEST(impossibleOperandsAreCompileErrors) {
+    CHECK_EQ(compileErrors("x = 1.5\nprint x + \"a\"\n"),
+             std::string("Type error at line 2: Operands of '+' must be two numbers or two strings, got number and string.\n"));
+    CHECK(compileErrors("print -\"x\"\n").find("Type error at line 1") == 0);
+    CHECK(compileErrors("await true\n").find("Type error at line 1") == 0);
+    CHECK(opcodes("print 1 + \"a\"\n").empty());
+}
+
+TEST(intLiteralsCompileToUnboxedInts) {
+    std::shared_ptr<const Program> program = Program::compile("x = 9007199254740993\nprint x\n");
+    CHECK(program != nullptr);
+    const std::vector<Value>& constants = program->getChunk().constants;
+    CHECK_EQ(constants.size(), size_t(1));
+    CHECK(std::holds_alternative<int64_t>(constants[0]));
+    CHECK_EQ(std::get<int64_t>(constants[0]), int64_t(9007199254740993));
+    CHECK(uses(opcodes("x = 3\ny = x * 4 + x\nprint y < x\n"), "MULTIPLY_INT"));
+}
+
+TEST(comparisonsInConditionsCompileToFusedBranches) {
+    std::vector<std::string> names = opcodes("i = 0\nwhile i < 10 {\n    i = i + 1\n}\nif i >= 10 {\n    print i\n}\n");
+    CHECK(uses(names, "LESS_JUMP"));
+    CHECK(uses(names, "GREATER_EQUAL_JUMP"));
+    CHECK(uses(names, "LOOP"));
+    CHECK(!uses(names, "LESS") && !uses(names, "JUMP_IF_FALSE"));
+}
+
+TEST(backEdgesCountLoopIterations) {
+    std::shared_ptr<const Program> program =
+        Program::compile("for i in range(10) {\n    for j in range(5) {\n    }\n}\n");
+    CHECK(program != nullptr);
+    VM vm;
+    CHECK(vm.interpret(program) == InterpretResult::OK);
+    const std::vector<uint64_t>& counts = program->getChunk().loopCounts;
+    CHECK_EQ(counts.size(), size_t(2));
+    CHECK_EQ(counts[0] + counts[1], uint64_t(60));
+}
+
+TEST(variablesMustBeAssignedOnEveryPath) {
+    CHECK_EQ(compileErrors("if 1 < 2 {\n    x = 1\n}\nprint x\n"),
+             std::string("Type error at line 4: Variable 'x' is used before it is assigned.\n"));
+    CHECK(compileErrors("if 1 < 2 {\n    x = 1\n} else {\n    x = 2\n}\nprint x\n").empty());
+}
+
+TEST(logicalOperatorsBranchAroundTheRightOperand) {
+    // As values they keep the deciding operand; as conditions they only jump.
+    std::vector<std::string> value = opcodes("x = 1\nprint x > 2 and x < 5\nprint x or 2\n");
+    CHECK(uses(value, "JUMP_IF_FALSE_OR_POP"));
+    CHECK(uses(value, "JUMP_IF_TRUE_OR_POP"));
+    std::vector<std::string> condition = opcodes("x = 1\nif x > 2 and not (x < 5) or x == 1 {\n    print x\n}\n");
+    CHECK(!uses(condition, "JUMP_IF_FALSE_OR_POP") && !uses(condition, "JUMP_IF_TRUE_OR_POP"));
+    CHECK(!uses(condition, "NOT") && !uses(condition, "GREATER") && !uses(condition, "EQUALS"));
+    CHECK_EQ(run("x = 0\nprint x != 0 and 10 div x > 1\nprint x == 0 or 10 div x > 1\n"), std::string("false\ntrue\n"));
+}
+
+TEST(stringBuildingAppendsInPlace) {
+    // Copying the string on every append would allocate gigabytes here.
+    const char* source = "s = \"\"\nfor i in range(200000) {\n    s = s + \"ab\" + \"c\"\n}\nprint len(s)\n";
+    CHECK(uses(opcodes(source), "APPEND_LOCAL"));
+    uint64_t before = Metrics::collect()[Metric::ALLOCATED_BYTES];
+    CHECK_EQ(run(source), std::string("600000\n"));
+    uint64_t allocated = Metrics::collect()[Metric::ALLOCATED_BYTES] - before;
+    CHECK(allocated < 16 * 600000);
+}
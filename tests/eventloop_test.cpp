@@ -0,0 +1,102 @@
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <string>
+#include "../src/include/eventloop.h"
+#include "../src/include/vm.h"
+#include "test.h"
+
+namespace {
+
+// A listening socket on 127.0.0.1 with a kernel-chosen port.
+int listenLoopback(sockaddr_in& address) {
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    address = {};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t length = sizeof(address);
+    if (fd < 0 || bind(fd, reinterpret_cast<sockaddr*>(&address), length) < 0 || listen(fd, 4) < 0 ||
+        getsockname(fd, reinterpret_cast<sockaddr*>(&address), &length) < 0) {
+        return -1;
+    }
+    return fd;
+}
+    
+} // namespace
+
+TEST(loopbackEchoRunsOnWatches) {
+    EventLoop loop;
+    sockaddr_in address;
+    int listener = listenLoopback(address);
+    CHECK(listener >= 0);
+    
+    int client = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    connect(client, reinterpret_cast<sockaddr*>(&address), sizeof(address));
+    
+    // Server: accept, then echo what arrives. Client: send once writable,
+    // then read the echo.
+    int server = -1;
+    std::string echoed;
+    loop.watch(listener, EPOLLIN, [&](uint32_t) {
+        server = accept4(listener, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        loop.watch(server, EPOLLIN, [&](uint32_t) {
+            char buffer[64];
+            ssize_t count = read(server, buffer, sizeof(buffer));
+            if (count > 0) (void)!write(server, buffer, count);
+        });
+    });
+    loop.watch(client, EPOLLOUT, [&](uint32_t) {
+        (void)!write(client, "ping", 4);
+        loop.watch(client, EPOLLIN, [&](uint32_t) {
+            char buffer[64];
+            ssize_t count = read(client, buffer, sizeof(buffer));
+            if (count > 0) echoed.assign(buffer, count);
+        });
+    });
+    loop.run();
+    
+    CHECK_EQ(echoed, std::string("ping"));
+    close(client);
+    close(server);
+    close(listener);
+}
+
+TEST(timersFireInDeadlineOrder) {
+    EventLoop loop;
+    std::string order;
+    loop.addTimer(30, [&]() { order += "c"; });
+    loop.addTimer(0, [&]() { order += "a"; });
+    loop.addTimer(10, [&]() { order += "b"; });
+    loop.addTimer(-10, [&]() { order += "a"; });
+    loop.run();
+    CHECK_EQ(order, std::string("aabc"));
+}
+
+TEST(hugeTimerDelaysDoNotOverflow) {
+    // An overflowed deadline would lie in the past and fire first.
+    EventLoop loop;
+    bool hugeFired = false;
+    bool shortFired = false;
+    loop.addTimer(INT64_MAX, [&]() { hugeFired = true; });
+    loop.addTimer(5, [&]() { shortFired = true; });
+    while (!shortFired) loop.runOnce(-1);
+    CHECK(!hugeFired);
+    CHECK_EQ(loop.pending(), size_t(1));
+}
+
+TEST(awaitsOfVMsSharingALoopInterleave) {
+    // The shorter sleep finishes first although its VM started second.
+    EventLoop loop;
+    VM slow(loop);
+    VM fast(loop);
+    CHECK(slow.start("await 40\nx = 1\n") == InterpretResult::SUSPENDED);
+    CHECK(fast.start("await 5\nx = 2\n") == InterpretResult::SUSPENDED);
+    while (fast.status() == InterpretResult::SUSPENDED) loop.runOnce(-1);
+    CHECK(fast.status() == InterpretResult::OK);
+    CHECK(slow.status() == InterpretResult::SUSPENDED);
+    loop.run();
+    CHECK(slow.status() == InterpretResult::OK);
+}
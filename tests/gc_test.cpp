@@ -0,0 +1,152 @@
+#include <string>
+#include <vector>
+#include "../src/include/gc.h"
+#include "test.h"
+
+namespace {
+
+ObjArray* rootArray(std::vector<Value>& roots, size_t index) {
+    return static_cast<ObjArray*>(std::get<Obj*>(roots[index]));
+}
+
+bool holdsString(const Value& value, const std::string& expected) {
+    const Obj* const* obj = std::get_if<Obj*>(&value);
+    return obj != nullptr && isObjType(*obj, ObjType::STRING) &&
+           stringOf(static_cast<const ObjString*>(*obj)) == expected;
+}
+    
+} // namespace
+
+TEST(garbageDiesInTheNursery) {
+    Heap heap;
+    for (int i = 0; i < 200000; i++) {
+        heap.copyString("temporary", 9);
+    }
+    CHECK(heap.stats().minorCollections > 0);
+    CHECK_EQ(heap.stats().bytesPromoted, size_t(0));
+}
+
+TEST(rootedStringsArePromoted) {
+    Heap heap;
+    std::vector<Value> roots;
+    heap.addRoots(&roots);
+    roots.push_back(static_cast<Obj*>(heap.copyString("kept", 4)));
+    heap.collectMinor();
+    CHECK(!heap.isYoung(std::get<Obj*>(roots[0])));
+    CHECK(holdsString(roots[0], "kept"));
+    heap.collectMajor();
+    CHECK(holdsString(roots[0], "kept"));
+    heap.removeRoots(&roots);
+}
+
+TEST(oldToYoungStoresSurviveMinorCollections) {
+    Heap heap;
+    std::vector<Value> roots;
+    heap.addRoots(&roots);
+    roots.push_back(static_cast<Obj*>(heap.allocateArray(ArrayStorage::VALUES, 4)));
+    heap.collectMinor();
+    ObjString* young = heap.copyString("young", 5);
+    ObjArray* array = rootArray(roots, 0);
+    CHECK(!heap.isYoung(array));
+    heap.storeValue(array, &arrayValues(array)[2], static_cast<Obj*>(young));
+    heap.collectMinor();
+    CHECK(holdsString(arrayValues(rootArray(roots, 0))[2], "young"));
+    heap.removeRoots(&roots);
+}
+
+TEST(minorCollectionsScanOnlyDirtyCards) {
+    // Filling a large old array: each minor collection must read the slots
+    // written since the last one, not the whole array.
+    Heap heap;
+    std::vector<Value> roots;
+    heap.addRoots(&roots);
+    const size_t length = 1000000;
+    roots.push_back(static_cast<Obj*>(heap.allocateArray(ArrayStorage::VALUES, length)));
+    CHECK(!heap.isYoung(std::get<Obj*>(roots[0])));
+    for (size_t i = 0; i < length; i++) {
+        ObjString* string = heap.copyString("ab", 2);
+        ObjArray* array = rootArray(roots, 0);
+        heap.storeValue(array, &arrayValues(array)[i], static_cast<Obj*>(string));
+    }
+    
+    CHECK(heap.stats().minorCollections >= 10);
+    CHECK(heap.stats().cardSlotsScanned <= 2 * length);
+    ObjArray* array = rootArray(roots, 0);
+    CHECK(holdsString(arrayValues(array)[0], "ab"));
+    CHECK(holdsString(arrayValues(array)[length - 1], "ab"));
+    heap.removeRoots(&roots);
+}
+
+TEST(concurrentMarkPausesStayWithinBudget) {
+    // Marking a large array of Values must not show up as one long pause,
+    // whichever thread ends up tracing it.
+    Heap heap;
+    heap.setConcurrent(std::chrono::milliseconds(1));
+    std::vector<Value> roots;
+    heap.addRoots(&roots);
+    const size_t length = 1000000;
+    roots.push_back(static_cast<Obj*>(heap.allocateArray(ArrayStorage::VALUES, length)));
+    for (size_t i = 0; i < length; i++) {
+        ObjString* string = heap.copyString("ab", 2);
+        ObjArray* array = rootArray(roots, 0);
+        heap.storeValue(array, &arrayValues(array)[i], static_cast<Obj*>(string));
+    }
+    // Finishing a cycle the fill left marking keeps the nursery; empty it
+    // so the measured cycle starts clean.
+    heap.collectMajor();
+    heap.collectMinor();
+    
+    size_t cycles = heap.cycles().size();
+    heap.requestMajor();
+    while (heap.cycles().size() == cycles) {
+        heap.copyString("garbage", 7);
+    }
+    const GcCycle& cycle = heap.cycles().back();
+    CHECK(cycle.concurrent);
+    CHECK(cycle.pauses.max() < std::chrono::milliseconds(8));
+    ObjArray* array = rootArray(roots, 0);
+    CHECK(holdsString(arrayValues(array)[length / 2], "ab"));
+    CHECK(holdsString(arrayValues(array)[length - 1], "ab"));
+    heap.removeRoots(&roots);
+}
+
+TEST(concurrentMarkingTracesValuesOnTheMarkerThread) {
+    // The mutator keeps rewriting the start of the array while it is being
+    // marked; the marker still reads nearly all of it, and nothing the
+    // array holds at the end is lost.
+    Heap heap;
+    heap.setConcurrent(std::chrono::milliseconds(1));
+    std::vector<Value> roots;
+    heap.addRoots(&roots);
+    const size_t length = 200000;
+    roots.push_back(static_cast<Obj*>(heap.allocateArray(ArrayStorage::VALUES, length)));
+    for (size_t i = 0; i < length; i++) {
+        ObjString* string = heap.copyString("ab", 2);
+        ObjArray* array = rootArray(roots, 0);
+        heap.storeValue(array, &arrayValues(array)[i], static_cast<Obj*>(string));
+    }
+    heap.collectMajor();
+    heap.collectMinor();
+    
+    HeapStats before = heap.stats();
+    size_t cycles = heap.cycles().size();
+    heap.requestMajor();
+    for (size_t i = 0; heap.cycles().size() == cycles; i++) {
+        ObjString* string = heap.copyString("cd", 2);
+        ObjArray* array = rootArray(roots, 0);
+        heap.storeValue(array, &arrayValues(array)[i % 64], static_cast<Obj*>(string));
+    }
+    CHECK(heap.cycles().back().concurrent);
+    size_t byMarker = heap.stats().markerSlotsTraced - before.markerSlotsTraced;
+    size_t byMutator = heap.stats().mutatorSlotsTraced - before.mutatorSlotsTraced;
+    CHECK(byMarker >= length - 256);
+    CHECK(byMarker >= 9 * byMutator);
+    
+    heap.collectMajor();
+    ObjArray* array = rootArray(roots, 0);
+    for (size_t i = 0; i < length; i++) {
+        const Value& element = arrayValues(array)[i];
+        CHECK(holdsString(element, "ab") || holdsString(element, "cd"));
+    }
+    heap.removeRoots(&roots);
+}
@@ -0,0 +1,72 @@
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <unistd.h>
+#include "../src/include/heapprofile.h"
+#include "../src/include/vm.h"
+#include "test.h"
+
+namespace {
+
+// The snapshot of what source leaves reachable.
+std::string snapshotAfter(const std::string& source) {
+    VM vm;
+    vm.enableHeapProfiling("/tmp/fusion-heap-test-unused");
+    captureOutput(1, [&]() { vm.interpret(source); });
+    std::ostringstream snapshot;
+    vm.getHeapProfiler()->writeSnapshot(vm.getHeap(), snapshot);
+    return snapshot.str();
+}
+
+std::string temporaryFile(const std::string& contents) {
+    char path[] = "/tmp/fusion-heap-XXXXXX";
+    int fd = mkstemp(path);
+    std::ofstream(path) << contents;
+    close(fd);
+    return path;
+}
+    
+} // namespace
+
+TEST(snapshotsCountTypesAndRetainedPaths) {
+    // items holds 2000 small int arrays; the loop's temporaries all die.
+    std::string snapshot = snapshotAfter(
+        "items = array(2000, [0])\nfor i in range(2000) {\n    items[i] = [i, i + 1]\n}\n"
+        "temp = [0]\nfor i in range(500000) {\n    temp = [i]\n}\n");
+    size_t inner = arrayAllocationSize(ArrayStorage::INTS, 2);
+    size_t outer = arrayAllocationSize(ArrayStorage::VALUES, 2000);
+    size_t last = arrayAllocationSize(ArrayStorage::INTS, 1);
+    auto row = [](const std::string& kind, const std::string& key, size_t objects, size_t bytes) {
+        return kind + "\t" + key + "\t" + std::to_string(objects) + "\t" + std::to_string(bytes) + "\n";
+    };
+    CHECK_EQ(snapshot.rfind("# fusion heap snapshot", 0), size_t(0));
+    CHECK(snapshot.find(row("total", "-", 2002, outer + 2000 * inner + last)) != std::string::npos);
+    CHECK(snapshot.find(row("type", "ARRAY", 2002, outer + 2000 * inner + last)) != std::string::npos);
+    CHECK(snapshot.find(row("path", "items > ARRAY", 2001, outer + 2000 * inner)) != std::string::npos);
+    CHECK(snapshot.find(row("path", "items > ARRAY > ARRAY", 2000, 2000 * inner)) != std::string::npos);
+    // Sampled sites: the loop allocated 500000 arrays, none still live.
+    CHECK(snapshot.find("alloc\tline 7 ARRAY\t") != std::string::npos);
+    CHECK(snapshot.find("live\tline 7 ARRAY\t") == std::string::npos);
+}
+
+TEST(heapDiffSortsRowsByGrowth) {
+    std::string header = "# fusion heap snapshot: kind, key, objects, bytes\n";
+    std::string before = temporaryFile(header + "total\t-\t10\t1000\ntype\tARRAY\t4\t400\ntype\tSTRING\t6\t600\n");
+    std::string after = temporaryFile(header + "total\t-\t30\t5400\ntype\tDICT\t2\t4000\ntype\tSTRING\t28\t1400\n");
+    std::ostringstream out, errors;
+    bool diffed = diffHeapSnapshots(before, after, out, errors);
+    std::ostringstream rejected, message;
+    bool notSnapshot = diffHeapSnapshots(before, "/no/such/snapshot", rejected, message);
+    std::remove(before.c_str());
+    std::remove(after.c_str());
+    
+    CHECK(diffed);
+    CHECK_EQ(out.str(), std::string("# bytes, objects, kind, key\n"
+                                    "+4400\t+20\ttotal\t-\n"
+                                    "+4000\t+2\ttype\tDICT\n"
+                                    "+800\t+22\ttype\tSTRING\n"
+                                    "-400\t-4\ttype\tARRAY\n"));
+    CHECK(!notSnapshot);
+    CHECK(!message.str().empty());
+}
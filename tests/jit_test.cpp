@@ -0,0 +1,58 @@
+#include "../src/include/jit.h"
+#include "../src/include/metrics.h"
+#include "../src/include/vm.h"
+#include "test.h"
+
+namespace {
+
+// What source prints, run with the JIT or (profiled, so) interpreted only.
+std::string output(const std::string& source, bool interpreted) {
+    return captureOutput(1, [&]() {
+        VM vm;
+        if (interpreted) vm.enableProfiling();
+        vm.interpret(source);
+    });
+}
+
+uint64_t jitCompiles() {
+    return Metrics::collect()[Metric::JIT_COMPILES];
+}
+
+const char* const kHotLoops[] = {
+    // int and double arithmetic, compare-and-branch
+    "t = 0\nfor i in range(50000) {\n    t = t + i * 3 - 1\n}\nprint t\n",
+    "f = 0.0\ni = 0\nwhile i < 20000 {\n    f = f + 1.0 / (i + 1)\n    i = i + 1\n}\nprint f\n",
+    // a variable changing type after the loop is compiled
+    "x = 1\nfor i in range(5000) {\n    if i == 2500 {\n        x = 0.5\n    }\n    x = x + 1\n}\nprint x\n",
+    // exits for concatenation and printing, inline array reads
+    "s = \"\"\nfor i in range(3000) {\n    if i % 1000 == 0 {\n        s = s + \"k\"\n        print i\n    }\n}\nprint s\n",
+    "a = [1.5, 2, 3, 4]\nh = 0\nfor i in range(4000) {\n    if a[i % 4] >= 3 {\n        h = h + 1\n    }\n}\nprint h\n",
+    // nested loops, break and continue
+    "c = 0\nfor i in range(300) {\n    for j in range(300) {\n        if j > i {\n            break\n        }\n        if j % 2 == 0 {\n            continue\n        }\n        c = c + 1\n    }\n}\nprint c\n",
+};
+    
+} // namespace
+
+TEST(jitRunsHotLoopsLikeTheInterpreter) {
+    for (const char* source : kHotLoops) {
+        std::string interpreted = output(source, true);
+        uint64_t compiles = jitCompiles();
+        std::string native = output(source, false);
+        CHECK(!interpreted.empty());
+        CHECK_EQ(native, interpreted);
+        #if defined(__x86_64__) && defined(__linux__)
+        CHECK(jitCompiles() > compiles);
+        #endif
+    }
+}
+
+TEST(jitChecksIntOverflowInCompiledLoops) {
+    // Overflows on the 3001st iteration, long after compiling.
+    InterpretResult result = InterpretResult::OK;
+    std::string errors = captureOutput(2, [&]() {
+        VM vm;
+        result = vm.interpret("x = 9223372036854772807\nfor i in range(5000) {\n    x = x + 1\n}\nprint x\n");
+    });
+    CHECK(result == InterpretResult::RUNTIME_ERROR);
+    CHECK_EQ(errors, std::string("Integer overflow.\n[line 3] in script\n"));
+}
@@ -0,0 +1,72 @@
+// Runs every registered test, or those whose names contain an argument.
+
+#include <unistd.h>
+#include <cstdio>
+#include <cstring>
+#include "test.h"
+
+namespace {
+
+bool currentFailed = false;
+
+bool selected(const char* name, int argc, char* argv[]) {
+    if (argc < 2) return true;
+    for (int i = 1; i < argc; i++) {
+        if (std::strstr(name, argv[i]) != nullptr) return true;
+    }
+    return false;
+}
+    
+} // namespace
+
+std::vector<TestCase>& testCases() {
+    static std::vector<TestCase> cases;
+    return cases;
+}
+
+void testFailed(const char* file, int line, const std::string& message) {
+    currentFailed = true;
+    std::cerr << "  " << file << ":" << line << ": " << message << std::endl;
+}
+
+std::string captureOutput(int fd, const std::function<void()>& run) {
+    std::fflush(nullptr);
+    std::cout.flush();
+    std::FILE* file = std::tmpfile();
+    int saved = dup(fd);
+    dup2(fileno(file), fd);
+    run();
+    std::fflush(nullptr);
+    std::cout.flush();
+    dup2(saved, fd);
+    close(saved);
+    
+    std::string text;
+    std::rewind(file);
+    char buffer[4096];
+    size_t count;
+    while ((count = std::fread(buffer, 1, sizeof(buffer), file)) > 0) {
+        text.append(buffer, count);
+    }
+    std::fclose(file);
+    return text;
+}
+
+int main(int argc, char* argv[]) {
+    int run = 0;
+    int failed = 0;
+    for (const TestCase& test : testCases()) {
+        if (!selected(test.name, argc, argv)) continue;
+        
+        currentFailed = false;
+        test.run();
+        run++;
+        if (currentFailed) {
+            failed++;
+            std::cerr << "FAIL " << test.name << std::endl;
+        }
+    }
+    
+    std::cout << run - failed << " of " << run << " tests passed" << std::endl;
+    return failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,110 @@
+#include <csignal>
+#include <fstream>
+#include <sstream>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+#include "../src/include/metrics.h"
+#include "../src/include/vm.h"
+#include "test.h"
+
+TEST(countersSumEveryThreadIncludingExitedOnes) {
+    uint64_t before = Metrics::collect()[Metric::JOBS_SUBMITTED];
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; t++) {
+        threads.emplace_back([]() {
+            for (int i = 0; i < 1000; i++) Metrics::add(Metric::JOBS_SUBMITTED);
+        });
+    }
+    for (std::thread& thread : threads) thread.join();
+    CHECK_EQ(Metrics::collect()[Metric::JOBS_SUBMITTED] - before, uint64_t(4000));
+}
+
+TEST(exitedThreadsFoldIntoTheRetiredTotal) {
+    // A thread per request must not leave a block behind per request.
+    size_t blocks = Metrics::threadBlocks();
+    MetricsSnapshot before = Metrics::collect();
+    for (int t = 0; t < 200; t++) {
+        std::thread([]() {
+            Metrics::add(Metric::JOBS_FINISHED, 3);
+            Metrics::recordPause(std::chrono::microseconds(20));
+        }).join();
+    }
+    MetricsSnapshot after = Metrics::collect();
+    CHECK(Metrics::threadBlocks() <= blocks);
+    CHECK_EQ(after[Metric::JOBS_FINISHED] - before[Metric::JOBS_FINISHED], uint64_t(600));
+    CHECK_EQ(after.pauses[1] - before.pauses[1], uint64_t(200));
+}
+
+TEST(interpreterAndAllocatorBumpTheirCounters) {
+    MetricsSnapshot before = Metrics::collect();
+    captureOutput(1, []() {
+        VM vm;
+        vm.enableProfiling();  // Interpreted, so every instruction counts
+        vm.interpret("t = 0\nfor i in range(1000) {\n    a = array(10, i)\n    t = t + a[0]\n}\nprint t\n");
+    });
+    MetricsSnapshot after = Metrics::collect();
+    CHECK(after[Metric::INSTRUCTIONS] - before[Metric::INSTRUCTIONS] >= 1000 * 10);
+    CHECK(after[Metric::ALLOCATIONS] - before[Metric::ALLOCATIONS] >= 1000);
+    CHECK(after[Metric::ALLOCATED_BYTES] - before[Metric::ALLOCATED_BYTES] >= 1000 * arrayAllocationSize(ArrayStorage::INTS, 10));
+}
+
+TEST(prometheusTextHasCumulativeBucketsAndGauges) {
+    MetricsSnapshot snapshot;
+    snapshot.counters[static_cast<size_t>(Metric::INSTRUCTIONS)] = 12345;
+    snapshot.counters[static_cast<size_t>(Metric::AWAITS_STARTED)] = 7;
+    snapshot.counters[static_cast<size_t>(Metric::AWAITS_FINISHED)] = 5;
+    snapshot.pauses[0] = 2;                    // Under 10us
+    snapshot.pauses[5] = 3;                    // 1-5ms
+    snapshot.pauses[kPauseBounds.size()] = 1;  // Over 100ms
+    snapshot.pauseNanos = 1'500'000'000;
+    std::ostringstream out;
+    snapshot.writePrometheus(out);
+    std::string text = out.str();
+    
+    for (const char* line : {
+             "# TYPE fusion_instructions_total counter\nfusion_instructions_total 12345\n",
+             "# TYPE fusion_awaits_pending gauge\nfusion_awaits_pending 2\n",
+             "# TYPE fusion_gc_pause_seconds histogram\n",
+             "fusion_gc_pause_seconds_bucket{le=\"1e-05\"} 2\n",
+             "fusion_gc_pause_seconds_bucket{le=\"0.001\"} 2\n",
+             "fusion_gc_pause_seconds_bucket{le=\"0.005\"} 5\n",
+             "fusion_gc_pause_seconds_bucket{le=\"0.1\"} 5\n",
+             "fusion_gc_pause_seconds_bucket{le=\"+Inf\"} 6\n",
+             "fusion_gc_pause_seconds_sum 1.500000000\n",
+             "fusion_gc_pause_seconds_count 6\n"}) {
+        CHECK(text.find(line) != std::string::npos);
+    }
+}
+
+TEST(pausesLandInTheirBuckets) {
+    MetricsSnapshot before = Metrics::collect();
+    Metrics::recordPause(std::chrono::microseconds(3));
+    Metrics::recordPause(std::chrono::milliseconds(2));
+    Metrics::recordPause(std::chrono::seconds(1));
+    MetricsSnapshot after = Metrics::collect();
+    CHECK_EQ(after.pauses[0] - before.pauses[0], uint64_t(1));
+    CHECK_EQ(after.pauses[5] - before.pauses[5], uint64_t(1));
+    CHECK_EQ(after.pauses.back() - before.pauses.back(), uint64_t(1));
+    CHECK_EQ(after.pauseNanos - before.pauseNanos, uint64_t(1'002'003'000));
+}
+
+TEST(exportRewritesTheFileOnSignal) {
+    char path[] = "/tmp/fusion-metrics-XXXXXX";
+    close(mkstemp(path));
+    CHECK(Metrics::startExport(path, std::chrono::nanoseconds(0), SIGUSR1));
+    unlink(path);
+    std::raise(SIGUSR1);
+    bool written = false;
+    for (int i = 0; i < 200 && !written; i++) {
+        usleep(10000);
+        written = access(path, F_OK) == 0;
+    }
+    Metrics::stopExport();
+    std::ifstream file(path);
+    std::ostringstream text;
+    text << file.rdbuf();
+    unlink(path);
+    CHECK(written);
+    CHECK(text.str().rfind("# HELP fusion_instructions_total ", 0) == 0);
+}
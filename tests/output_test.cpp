@@ -0,0 +1,61 @@
+#include <sys/stat.h>
+#include "../src/include/output.h"
+#include "test.h"
+
+namespace {
+
+// Bytes written to file descriptor 1 so far (a file while captured).
+size_t written() {
+    struct stat status;
+    fstat(1, &status);
+    return static_cast<size_t>(status.st_size);
+}
+    
+} // namespace
+
+TEST(linePolicyWritesEveryPrint) {
+    std::string text = captureOutput(1, [&]() {
+        Output output;
+        output.setPolicy(FlushPolicy::LINE);
+        output.print(1.5);
+        CHECK_EQ(written(), size_t(4));
+        output.print(int64_t(-7));
+        CHECK_EQ(written(), size_t(7));
+    });
+    CHECK_EQ(text, std::string("1.5\n-7\n"));
+}
+
+TEST(blockPolicyWritesFullBlocksAndBeforeWaits) {
+    std::string text = captureOutput(1, [&]() {
+        Output output;
+        output.setPolicy(FlushPolicy::BLOCK);
+        output.print(true);
+        CHECK_EQ(written(), size_t(0));
+        output.beforeWait();
+        CHECK_EQ(written(), size_t(5));
+        
+        size_t lines = 0;
+        while (written() == 5) {
+            output.print(0.25);
+            lines++;
+        }
+        CHECK(written() >= kOutputBlockSize);
+        CHECK_EQ(lines, kOutputBlockSize / 5 + 1);
+    });
+    CHECK_EQ(text.substr(0, 10), std::string("true\n0.25\n"));
+}
+
+TEST(exitPolicyHoldsOutputUntilFlushed) {
+    std::string text = captureOutput(1, [&]() {
+        Output output;
+        output.setPolicy(FlushPolicy::EXIT);
+        for (int i = 0; i < 20000; i++) {
+            output.print(nullptr);
+        }
+        output.beforeWait();
+        CHECK_EQ(written(), size_t(0));
+        output.flush();
+        CHECK_EQ(written(), size_t(20000 * 5));
+    });
+    CHECK_EQ(text.size(), size_t(20000 * 5));
+}
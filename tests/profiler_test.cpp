@@ -0,0 +1,64 @@
+#include <regex>
+#include <sstream>
+#include "../src/include/profiler.h"
+#include "../src/include/vm.h"
+#include "test.h"
+
+namespace {
+
+std::string loop(int iterations) {
+    return "t = 0\nfor i in range(" + std::to_string(iterations) + ") {\n    t = t + i % 7\n}\nprint t\n";
+}
+    
+} // namespace
+
+TEST(profilerCountsEveryInstruction) {
+    // Each iteration runs 14 instructions, plus 10 outside the loop.
+    VM vm;
+    vm.enableProfiling();
+    captureOutput(1, [&]() { vm.interpret(loop(30000)); });
+    Profiler* profiler = vm.getProfiler();
+    CHECK(profiler != nullptr);
+    CHECK_EQ(profiler->instructions(), uint64_t(14 * 30000 + 10));
+    
+    std::ostringstream report;
+    profiler->report(report);
+    CHECK(std::regex_search(report.str(), std::regex("\\nMODULO +30000 ")));
+    CHECK(std::regex_search(report.str(), std::regex("\\nLOOP +30000 ")));
+    CHECK(std::regex_search(report.str(), std::regex("\\nline 3 +180000 ")));
+}
+
+TEST(profilerSamplesIntoCollapsedStacks) {
+    VM vm;
+    vm.enableProfiling();
+    captureOutput(1, [&]() { vm.interpret(loop(300000)); });
+    std::ostringstream stacks;
+    vm.getProfiler()->writeCollapsed(stacks);
+    CHECK(!stacks.str().empty());
+    std::istringstream lines(stacks.str());
+    std::string line;
+    while (std::getline(lines, line)) {
+        CHECK(std::regex_match(line, std::regex("script;line [1-5];[A-Z_]+ [1-9][0-9]*")));
+    }
+}
+
+TEST(profilingAnotherScriptStartsOver) {
+    // The second script is shorter than the first, and must not be charged
+    // for its instructions.
+    VM vm;
+    vm.enableProfiling();
+    captureOutput(1, [&]() {
+        vm.interpret(loop(30000));
+        vm.interpret("x = 7\nprint x\n");
+    });
+    Profiler* profiler = vm.getProfiler();
+    CHECK(profiler->instructions() > 0 && profiler->instructions() < 10);
+    
+    std::ostringstream report;
+    profiler->report(report);
+    CHECK(!std::regex_search(report.str(), std::regex("MODULO|LOOP|line [3-5]")));
+    CHECK(std::regex_search(report.str(), std::regex("\\nPRINT +1 ")));
+    std::ostringstream stacks;
+    profiler->writeCollapsed(stacks);
+    CHECK(!std::regex_search(stacks.str(), std::regex("line [3-5]")));
+}
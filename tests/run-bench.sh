@@ -0,0 +1,48 @@
+#!/bin/bash
+# Check the benchmark harness on one small workload: every stage is
+# measured and written to the JSON results, and a second run compares
+# against the first.
+
+bench=$(realpath "${1:-./fusion-bench}")
+workload="$(cd "$(dirname "$0")/.." && pwd)/bench/workloads/arrays.fs"
+json=$(mktemp)
+trap 'rm -f "$json"' EXIT
+failed=0
+
+fail() {
+    echo "FAIL $1"
+    failed=1
+}
+
+"$bench" --warmup=0 --reps=3 --label=test --json="$json" "$workload" >/dev/null 2>&1 || fail "bench run"
+
+# arrays.fs goes through all four stages, the generated programs through
+# the front end only.
+expected="arrays.fs/lex arrays.fs/parse arrays.fs/compile arrays.fs/run
+generated-1000/lex generated-1000/parse generated-1000/compile
+generated-10000/lex generated-10000/parse generated-10000/compile"
+actual=$(sed -n 's/^{"workload": "\([^"]*\)", "stage": "\([^"]*\)".*/\1\/\2/p' "$json" | tr '\n' ' ')
+[ "$actual" = "$(echo $expected) " ] || fail "stages: $actual"
+grep -q '^{"label": "test", "warmup": 0, "reps": 3' "$json" || fail "JSON header"
+
+# Percentiles are ordered and every stage did some work.
+awk -F'[:,]' '/"stage"/ {
+    for (i = 1; i < NF; i++) {
+        name = $i
+        gsub(/[ "{]/, "", name)
+        value[name] = $(i + 1) + 0
+    }
+    if (!(value["work"] > 0 && value["min_ns"] > 0 && value["min_ns"] <= value["p50_ns"] &&
+          value["p50_ns"] <= value["p90_ns"] && value["p90_ns"] <= value["max_ns"])) bad = 1
+} END { exit bad }' "$json" || fail "percentiles"
+
+report=$("$bench" --warmup=0 --reps=1 --baseline="$json" "$workload" 2>/dev/null)
+[ "$(echo "$report" | grep -c '%$')" -eq 10 ] || fail "baseline comparison"
+
+"$bench" --no-such-option >/dev/null 2>&1
+[ $? -eq 64 ] || fail "usage error"
+"$bench" --baseline=/no/such/file "$workload" >/dev/null 2>&1
+[ $? -eq 74 ] || fail "missing baseline"
+
+[ "$failed" -eq 0 ] && echo "bench harness passed"
+[ "$failed" -eq 0 ]
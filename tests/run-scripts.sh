@@ -0,0 +1,54 @@
+#!/bin/bash
+# Run every tests/scripts/*.fs with the given fusion binary and compare what
+# it prints with the files next to it: <name>.out for stdout, <name>.err
+# for stderr (which must be empty when there is none). A first line
+# "// args: <options>" passes options before the script, and a line
+# "// aot" has it also built with `fusion build` and the executable checked
+# against the same files. Scripts run in their own directory, with
+# tests/scripts/modules on FUSION_PATH.
+
+fusion=$(realpath "${1:-./fusion}")
+dir=$(cd "$(dirname "$0")/scripts" && pwd)
+passed=0
+failed=0
+executable=$(mktemp)
+trap 'rm -f "$executable"' EXIT
+
+# check <label> <name> <command...>: run the command in the scripts
+# directory and compare its output with <name>.out and <name>.err.
+check() {
+    local label=$1 name=$2
+    shift 2
+    local actualOut actualErr expectedErr=/dev/null
+    actualOut=$(mktemp)
+    actualErr=$(mktemp)
+    (cd "$dir" && FUSION_PATH="$dir/modules" "$@" >"$actualOut" 2>"$actualErr")
+    [ -f "$dir/$name.err" ] && expectedErr="$dir/$name.err"
+    if diff -u "$dir/$name.out" "$actualOut" >/dev/null && diff -u "$expectedErr" "$actualErr" >/dev/null; then
+        passed=$((passed + 1))
+    else
+        failed=$((failed + 1))
+        echo "FAIL $label"
+        diff -u "$dir/$name.out" "$actualOut" | sed 's/^/  /'
+        diff -u "$expectedErr" "$actualErr" | sed 's/^/  /'
+    fi
+    rm -f "$actualOut" "$actualErr"
+}
+
+for script in "$dir"/*.fs; do
+    name=$(basename "$script" .fs)
+    args=$(sed -n '1s|^// args: ||p' "$script")
+    check "$name.fs" "$name" "$fusion" $args "$name.fs"
+
+    if grep -qx '// aot' "$script"; then
+        if "$fusion" build "$script" -o "$executable"; then
+            check "$name.fs (built)" "$name" "$executable"
+        else
+            failed=$((failed + 1))
+            echo "FAIL $name.fs (build)"
+        fi
+    fi
+done
+
+echo "$passed of $((passed + failed)) scripts passed"
+[ "$failed" -eq 0 ]
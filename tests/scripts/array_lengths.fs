@@ -0,0 +1,5 @@
+// Element-wise operands must have the same length
+// aot
+a = [1, 2, 3]
+print a + 1
+print a + [1, 2]
@@ -0,0 +1,37 @@
+// Element-wise kernels, reductions and boxed fallback; lengths that leave
+// a remainder after the vector width
+// aot
+a = [1, 2, 3, 4, 5, 6, 7]
+b = [7, 6, 5, 4, 3, 2, 1]
+print a + b
+print a * 2
+print a - 0.5
+print a / 2
+print a < b
+print a == b
+print a == [1, 2, 3, 4, 5, 6, 7]
+print sum(a)
+print min(a)
+print max(b)
+print dot(a, b)
+print all(a > 0)
+print any(a > 6)
+
+f = array(19, 1.5)
+f[18] = -2.0
+print sum(f)
+print min(f)
+print len(f)
+
+mixed = [1, "two", 3.0, [4]]
+print mixed
+mixed[1] = 2
+print mixed[1] + mixed[2]
+print len(mixed)
+
+big = array(1000, 3)
+for i in range(1000) {
+    big[i] = i
+}
+print sum(big * big)
+print max(big - 500)
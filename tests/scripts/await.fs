@@ -0,0 +1,9 @@
+// await sleeps on a timer or reads a file without blocking the VM
+// aot
+print "before"
+await 20
+await 1.5
+print "after"
+text = await "await_data.txt"
+print text
+print len(text)
@@ -0,0 +1,2 @@
+text = await "no_such_file.txt"
+// aot
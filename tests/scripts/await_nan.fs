@@ -0,0 +1,7 @@
+// Overflow to infinity, then inf - inf
+// aot
+x = 10.0
+for i in range(400) {
+    x = x * 10.0
+}
+await (x - x)
@@ -0,0 +1,4 @@
+print "start"
+// aot
+await -5
+print "unreachable"
@@ -0,0 +1,69 @@
+// if/else chains, while and for loops with steps, break and continue
+// aot
+for i in range(5) {
+    if i == 0 {
+        print "zero"
+    } else if i % 2 == 0 {
+        print "even"
+    } else {
+        print "odd"
+    }
+}
+
+n = 27
+steps = 0
+while n != 1:
+    if n % 2 == 0:
+        n = n div 2
+    else:
+        n = 3 * n + 1
+    steps = steps + 1
+print steps
+
+total = 0
+for i in range(10, 0, -3) {
+    total = total + i
+}
+print total
+
+for i in range(2, 20, 5):
+    print i
+
+found = -1
+for i in range(100) {
+    if i * i > 50 {
+        found = i
+        break
+    }
+}
+print found
+
+odd = 0
+i = 0
+while i < 10 {
+    i = i + 1
+    if i % 2 == 0 {
+        continue
+    }
+    odd = odd + i
+}
+print odd
+
+pairs = 0
+for a in range(4) {
+    for b in range(4) {
+        if b > a {
+            break
+        }
+        pairs = pairs + 1
+    }
+}
+print pairs
+
+for i in range(0) {
+    print "never"
+}
+if 1 > 2 {
+    print "never"
+}
+print "done"
@@ -0,0 +1,5 @@
+// Reading a missing key is an error; get() takes a default instead
+// aot
+d = {"a": 1}
+print get(d, "b", 0)
+print d["b"]
@@ -0,0 +1,45 @@
+// Dict literals, updates, removal and insertion order
+// aot
+d = {"a": 1, 2: "b", 1.5: [1, 2]}
+print d
+print d["a"]
+print d[2]
+d["c"] = 3
+d["a"] = 10
+print d
+print len(d)
+print keys(d)
+print values(d)
+print has(d, "c")
+print has(d, "z")
+print get(d, "z", "default")
+remove(d, "a")
+print d
+print d[1.5]
+
+// Removing a middle key keeps the others in order; adding it back puts
+// it last
+m = {"w": 1, "x": 2, "y": 3, "z": 4}
+remove(m, "x")
+print keys(m)
+print m["y"]
+m["x"] = 5
+print m
+
+// 1 and 1.0 are the same key
+n = {1: "int"}
+n[1.0] = "number"
+print n
+
+// Growing past several table sizes, then removing most keys
+counts = {}
+for i in range(1000) {
+    counts[i % 300] = get(counts, i % 300, 0) + 1
+}
+print len(counts)
+print counts[0]
+print counts[299]
+for i in range(290) {
+    remove(counts, i)
+}
+print counts
@@ -0,0 +1,6 @@
+// args: --dump-bytecode --trace --trace-ops=PRINT
+// The listing goes to stdout before the run; traced PRINTs go to stderr
+x = 2
+if x > 1 {
+    print x * 3
+}
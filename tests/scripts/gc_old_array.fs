@@ -0,0 +1,14 @@
+// A large old array filled with fresh strings across many minor collections
+// aot
+n = 300000
+a = array(n, "")
+s = "ab"
+for i in range(n) {
+    a[i] = s + s
+}
+total = 0
+for i in range(n) {
+    total = total + len(a[i])
+}
+print total
+print a[0] == "abab" and a[n - 1] == "abab"
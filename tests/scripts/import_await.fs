@@ -0,0 +1,2 @@
+import sleepy
+print sleepy.ready
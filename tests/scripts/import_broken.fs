@@ -0,0 +1,2 @@
+import broken
+print broken.x
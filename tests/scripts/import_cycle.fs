@@ -0,0 +1,2 @@
+import cycle_a
+print cycle_a.value
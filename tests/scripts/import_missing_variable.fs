@@ -0,0 +1,2 @@
+import config
+print config.nope
@@ -0,0 +1,2 @@
+import nowhere
+print nowhere.x
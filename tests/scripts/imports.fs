@@ -0,0 +1,10 @@
+// Modules load when one of their variables is first read, once each,
+// and an import nothing reads is never looked for.
+import config
+import server
+import unused
+print "before"
+print config.port
+print config.port + 1
+print server.url
+print config.host
@@ -0,0 +1,5 @@
+// div and % by an int zero are errors
+// aot
+x = 0
+print 5 % 3
+print 5 div x
@@ -0,0 +1,6 @@
+// Int arithmetic raises an error instead of wrapping
+// aot
+x = 9223372036854775807
+print x - 1
+print x * 2
+print "unreachable"
@@ -0,0 +1,23 @@
+// Ints stay exact past 2^53; / divides in double, div floors, % follows the divisor
+// aot
+big = 9007199254740993
+print big
+print big + 2
+print 7 / 2
+print 7 div 2
+print -7 div 2
+print 7 % 3
+print -7 % 3
+print 7 % -3
+print 6 & 3
+print 6 | 3
+print 6 ^ 3
+print ~5
+print 1 << 62
+print -16 >> 2
+print 3 + 0.5
+print 2 * 1.5
+print 9223372036854775807
+print -9223372036854775807 - 1
+print 5 == 5.0
+print 2 < 2.5
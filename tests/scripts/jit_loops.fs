@@ -0,0 +1,30 @@
+// Hot loops run in native code; failed guards hand instructions back
+// aot
+total = 0
+for i in range(100000) {
+    total = total + i * 2 - 1
+}
+print total
+x = 1
+for i in range(5000) {
+    if i == 2500 {
+        x = 0.5
+    }
+    x = x + 1
+}
+print x
+s = ""
+for i in range(3000) {
+    if i % 1000 == 0 {
+        s = s + "k"
+    }
+}
+print s
+a = [1, 2, 3, 4]
+hits = 0
+for i in range(4000) {
+    if a[i % 4] >= 3 {
+        hits = hits + 1
+    }
+}
+print hits
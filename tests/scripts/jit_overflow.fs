@@ -0,0 +1,7 @@
+// Overflow checks stay in compiled loops
+// aot
+x = 9223372036854772807
+for i in range(5000) {
+    x = x + 1
+}
+print x
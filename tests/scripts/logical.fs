@@ -0,0 +1,29 @@
+// and/or yield the deciding operand and skip the right one
+// aot
+print 1 and 2
+print 1 > 2 and 2
+print 1 > 2 or "fallback"
+print "first" or "second"
+print not 1 > 2
+print not "x"
+
+// The right operand would fail if it ran.
+zero = 0
+print zero != 0 and 10 div zero > 1
+print zero == 0 or 10 div zero > 1
+a = [1, 2, 3]
+i = 5
+if i < len(a) and a[i] > 0 {
+    print "in range"
+} else {
+    print "out of range"
+}
+
+// Conditions combine without building bools.
+count = 0
+for n in range(30) {
+    if n % 3 == 0 and not (n % 5 == 0) or n == 25 {
+        count = count + 1
+    }
+}
+print count
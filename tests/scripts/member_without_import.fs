@@ -0,0 +1 @@
+print config.port
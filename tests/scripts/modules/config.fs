@@ -0,0 +1,3 @@
+print "loading config"
+port = 8080
+host = "localhost"
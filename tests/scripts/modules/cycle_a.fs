@@ -0,0 +1,2 @@
+import cycle_b
+value = cycle_b.value
@@ -0,0 +1,2 @@
+import cycle_a
+value = cycle_a.value
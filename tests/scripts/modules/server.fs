@@ -0,0 +1,3 @@
+import config
+print "loading server"
+url = "http://" + config.host
@@ -0,0 +1,2 @@
+await 1
+ready = 1
@@ -0,0 +1,20 @@
+// Numbers print as the shortest text that reads back to the same double
+// aot
+print 0.1
+print 0.1 + 0.2
+print 1.0 / 3.0
+print 100.0
+print 0.000000025
+print 1000000000000000000000.0
+print 123456789012345680000.0
+print -0.0
+print 2.0 / 3.0 * 1000000.0
+x = 10.0
+for i in range(400) {
+    x = x * 10.0
+}
+print x
+print -x
+print 42
+print -9223372036854775807 - 1
+print [0.5, 100000000000000000000000.0, 3]
@@ -0,0 +1,26 @@
+// s = s + ... in a loop appends in place; reading s flattens it
+// aot
+s = ""
+for i in range(5) {
+    s = s + "<" + "x" + ">"
+}
+print s
+
+log = "start"
+for i in range(3) {
+    log = log + ", step"
+    if i == 1 {
+        print log
+    }
+    copy = log
+    log = log + "!"
+    print copy
+}
+print log
+
+big = ""
+for i in range(100000) {
+    big = big + "ab"
+}
+print len(big)
+print big == big + ""
@@ -0,0 +1,233 @@
+#include <algorithm>
+#include <functional>
+#include <string>
+#include <thread>
+#include <vector>
+#include "../src/include/channel.h"
+#include "../src/include/dict.h"
+#include "../src/include/gc.h"
+#include "../src/include/shared.h"
+#include "test.h"
+
+namespace {
+
+ObjArray* asArray(const Value& value) {
+    return static_cast<ObjArray*>(std::get<Obj*>(value));
+}
+
+Value string(Heap& heap, const std::string& text) {
+    return static_cast<Obj*>(heap.copyString(text.data(), text.size()));
+}
+
+// The dict's value for a string key; keys are looked up as shared strings.
+Value valueAt(SharedHeap& shared, const ObjDict* dict, const std::string& key) {
+    Value result;
+    Value lookup = static_cast<Obj*>(shared.shareString(key.data(), key.size()));
+    if (dictGet(dict, lookup, result) != nullptr) return nullptr;
+    return result;
+}
+    
+} // namespace
+
+TEST(exportedStringsTravelAsMessages) {
+    Heap heap;
+    SharedHeap shared;
+    std::vector<Value> roots;
+    heap.addRoots(&roots);
+    roots.push_back(static_cast<Obj*>(heap.copyString("hello", 5)));
+    
+    Value message = heap.exportValue(roots[0], shared);
+    Obj* string = std::get<Obj*>(message);
+    CHECK(string->isShared() && string->isInMessage());
+    CHECK_EQ(stringOf(static_cast<ObjString*>(string)), std::string("hello"));
+    CHECK_EQ(shared.bytesAllocated(), stringAllocationSize(5));
+    // Exporting a shared object again is free.
+    CHECK(std::get<Obj*>(heap.exportValue(message, shared)) == string);
+    
+    roots.push_back(heap.importValue(message));
+    CHECK(!std::get<Obj*>(roots[1])->isShared());
+    CHECK_EQ(stringOf(static_cast<ObjString*>(std::get<Obj*>(roots[1]))), std::string("hello"));
+    CHECK_EQ(shared.bytesAllocated(), size_t(0));
+    heap.removeRoots(&roots);
+}
+
+TEST(internedStringsAreUsedInPlace) {
+    // A program's constants: one copy per distinct string, never freed and
+    // never copied by an import.
+    Heap heap;
+    SharedHeap shared;
+    ObjString* first = shared.shareString("hello", 5);
+    CHECK(first == shared.shareString("hello", 5));
+    CHECK(first->isShared() && !first->isInMessage());
+    Value constant = static_cast<Obj*>(first);
+    CHECK(std::get<Obj*>(heap.exportValue(constant, shared)) == first);
+    CHECK(std::get<Obj*>(heap.importValue(constant)) == first);
+}
+
+TEST(primitivesPassThroughExport) {
+    Heap heap;
+    SharedHeap shared;
+    CHECK(std::get<double>(heap.exportValue(1.5, shared)) == 1.5);
+    CHECK(std::get<int64_t>(heap.exportValue(int64_t(7), shared)) == 7);
+    CHECK(std::get<bool>(heap.exportValue(true, shared)));
+    CHECK(std::holds_alternative<std::nullptr_t>(heap.exportValue(nullptr, shared)));
+}
+
+TEST(messagesOutliveTheSendersHeap) {
+    // A task exports strings and exits; another adopts them and collects
+    // its own heap around them.
+    SharedHeap shared;
+    std::vector<Value> messages;
+    std::thread sender([&]() {
+        Heap heap;
+        for (int i = 0; i < 1000; i++) {
+            std::string text = "message " + std::to_string(i);
+            ObjString* string = heap.copyString(text.data(), text.size());
+            messages.push_back(heap.exportValue(static_cast<Obj*>(string), shared));
+        }
+    });
+    sender.join();
+    
+    Heap receiver;
+    std::vector<Value> roots;
+    receiver.addRoots(&roots);
+    for (const Value& message : messages) {
+        roots.push_back(receiver.importValue(message));
+    }
+    CHECK_EQ(shared.bytesAllocated(), size_t(0));
+    for (int i = 0; i < 100000; i++) {
+        receiver.copyString("garbage", 7);
+    }
+    receiver.collectMajor();
+    CHECK_EQ(stringOf(static_cast<ObjString*>(std::get<Obj*>(roots[999]))), std::string("message 999"));
+    receiver.removeRoots(&roots);
+}
+
+TEST(arraysAndDictsCrossTasksAsCopies) {
+    // The sender builds [inner, {"name": "fusion", "inner": inner}, "text",
+    // itself], sends it and then changes its own objects; the receiver
+    // gets an equal private copy with the aliasing and the cycle intact.
+    SharedHeap shared;
+    Channel<Value> channel(1);
+    Value message;
+    std::thread sender([&]() {
+        Heap heap;
+        EventLoop loop;
+        std::vector<Value> roots;
+        heap.addRoots(&roots);
+        ObjArray* inner = heap.allocateArray(ArrayStorage::INTS, 3);
+        for (int i = 0; i < 3; i++) inner->ints()[i] = i + 1;
+        roots.push_back(static_cast<Obj*>(inner));
+        roots.push_back(string(heap, "name"));
+        roots.push_back(string(heap, "fusion"));
+        roots.push_back(string(heap, "inner"));
+        roots.push_back(roots[0]);
+        Value dict;
+        buildDict(heap, &roots[1], 2, dict);
+        roots.push_back(dict);
+        roots.push_back(static_cast<Obj*>(heap.allocateArray(ArrayStorage::VALUES, 4)));
+        roots.push_back(string(heap, "text"));
+        ObjArray* outer = asArray(roots[6]);
+        heap.storeValue(outer, &arrayValues(outer)[0], roots[0]);
+        heap.storeValue(outer, &arrayValues(outer)[1], roots[5]);
+        heap.storeValue(outer, &arrayValues(outer)[2], roots[7]);
+        heap.storeValue(outer, &arrayValues(outer)[3], roots[6]);
+        
+        message = heap.exportValue(roots[6], shared);
+        channel.send(loop, message, []() {});
+        loop.run();
+        asArray(roots[0])->ints()[0] = 99;
+        roots.push_back(string(heap, "changed"));
+        dictSet(heap, roots[5], roots[1], roots[8]);
+        heap.removeRoots(&roots);
+    });
+    
+    Heap heap;
+    EventLoop loop;
+    std::vector<Value> roots;
+    heap.addRoots(&roots);
+    channel.recv(loop, [&](Value received) { roots.push_back(heap.importValue(received)); });
+    loop.run();
+    sender.join();
+    for (int i = 0; i < 100000; i++) {
+        heap.copyString("garbage", 7);
+    }
+    heap.collectMajor();
+    CHECK_EQ(shared.bytesAllocated(), size_t(0));
+    
+    CHECK_EQ(roots.size(), size_t(1));
+    ObjArray* outer = asArray(roots[0]);
+    CHECK(!outer->isShared());
+    CHECK(std::get<Obj*>(arrayValues(outer)[3]) == outer);
+    ObjArray* inner = asArray(arrayValues(outer)[0]);
+    CHECK(!inner->isShared());
+    CHECK_EQ(inner->ints()[0], int64_t(1));
+    CHECK_EQ(inner->ints()[2], int64_t(3));
+    auto* dict = static_cast<ObjDict*>(std::get<Obj*>(arrayValues(outer)[1]));
+    CHECK(isObjType(dict, ObjType::DICT) && !dict->isShared());
+    CHECK_EQ(valueToString(valueAt(shared, dict, "name")), std::string("fusion"));
+    CHECK(std::get<Obj*>(valueAt(shared, dict, "inner")) == inner);
+    CHECK_EQ(stringOf(static_cast<ObjString*>(std::get<Obj*>(arrayValues(outer)[2]))), std::string("text"));
+    heap.removeRoots(&roots);
+}
+
+TEST(pipelinesKeepTheSharedRegionBounded) {
+    // 20000 messages, each with strings never sent before, through a
+    // channel of 8: the region holds at most what is in flight, and
+    // nothing once all are received.
+    SharedHeap shared;
+    Channel<Value> channel(8);
+    const int count = 20000;
+    size_t messageBytes = 0;
+    std::thread sender([&]() {
+        Heap heap;
+        EventLoop loop;
+        std::vector<Value> roots;
+        heap.addRoots(&roots);
+        std::function<void(int)> sendFrom = [&](int i) {
+            if (i == count) return;
+            roots.assign({string(heap, "key " + std::to_string(i)), string(heap, "value " + std::to_string(i))});
+            Value dict;
+            buildDict(heap, &roots[0], 1, dict);
+            roots.push_back(dict);
+            roots.push_back(static_cast<Obj*>(heap.allocateArray(ArrayStorage::VALUES, 2)));
+            ObjArray* array = asArray(roots[3]);
+            heap.storeValue(array, &arrayValues(array)[0], roots[2]);
+            heap.storeValue(array, &arrayValues(array)[1], roots[1]);
+            size_t before = shared.bytesAllocated();
+            Value message = heap.exportValue(roots[3], shared);
+            if (i == 0) messageBytes = shared.bytesAllocated() - before;
+            channel.send(loop, message, [&, i]() { sendFrom(i + 1); });
+        };
+        sendFrom(0);
+        loop.run();
+        heap.removeRoots(&roots);
+    });
+    
+    Heap heap;
+    EventLoop loop;
+    std::vector<Value> roots(1);
+    heap.addRoots(&roots);
+    int received = 0;
+    size_t most = 0;
+    std::function<void()> receive = [&]() {
+        channel.recv(loop, [&](Value message) {
+            most = std::max(most, shared.bytesAllocated());
+            roots[0] = heap.importValue(message);
+            if (++received < count) receive();
+        });
+    };
+    receive();
+    loop.run();
+    sender.join();
+    
+    CHECK_EQ(received, count);
+    CHECK(messageBytes > 0);
+    // The channel's 8, one being exported and one being received, with
+    // room for later messages' longer strings.
+    CHECK(most <= 10 * (messageBytes + 64));
+    CHECK_EQ(shared.bytesAllocated(), size_t(0));
+    ObjArray* last = asArray(roots[0]);
+    CHECK_EQ(valueToString(arrayValues(last)[1]), "value " + std::to_string(count - 1));
+    heap.removeRoots(&roots);
+}
@@ -0,0 +1,58 @@
+#ifndef TEST_H
+#define TEST_H
+
+#include <functional>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Tests of the runtime's C++ interfaces (`make test`), for what scripts in
+// tests/scripts cannot reach: the collector, channels, the event loop and
+// the embedding API. A test is a function declared with TEST(name); the
+// CHECK macros report a failed condition and return from it.
+struct TestCase {
+    const char* name;
+    std::function<void()> run;
+};
+
+std::vector<TestCase>& testCases();
+// Record a failure of the test running now.
+void testFailed(const char* file, int line, const std::string& message);
+// What run writes to file descriptor fd: 1 where scripts print, 2 for
+// errors.
+std::string captureOutput(int fd, const std::function<void()>& run);
+
+struct TestRegistration {
+    TestRegistration(const char* name, std::function<void()> run) {
+        testCases().push_back({name, std::move(run)});
+    }
+};
+
+#define TEST(name)                                                   \
+    static void name();                                              \
+    static TestRegistration name##Registration(#name, name);         \
+    static void name()
+
+#define CHECK(condition)                                             \
+    do {                                                             \
+        if (!(condition)) {                                          \
+            testFailed(__FILE__, __LINE__, #condition);              \
+            return;                                                  \
+        }                                                            \
+    } while (0)
+
+#define CHECK_EQ(actual, expected)                                   \
+    do {                                                             \
+        const auto& actualValue = (actual);                          \
+        const auto& expectedValue = (expected);                      \
+        if (!(actualValue == expectedValue)) {                       \
+            std::ostringstream message;                              \
+            message << #actual << " is " << actualValue              \
+                    << ", expected " << expectedValue;               \
+            testFailed(__FILE__, __LINE__, message.str());           \
+            return;                                                  \
+        }                                                            \
+    } while (0)
+
+#endif // TEST_H
@@ -0,0 +1,106 @@
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <regex>
+#include <sstream>
+#include <thread>
+#include <unistd.h>
+#include "../src/include/timeline.h"
+#include "../src/include/vm.h"
+#include "test.h"
+
+namespace {
+
+struct Event {
+    std::string name;
+    std::string category;
+    double start;
+    double duration;
+    std::string thread;
+};
+
+// Record run() into a temporary file and return its complete events, and
+// the file's text.
+std::vector<Event> record(const std::function<void()>& run, std::string& text) {
+    char path[] = "/tmp/fusion-timeline-XXXXXX";
+    close(mkstemp(path));
+    if (!Timeline::start(path)) return {};
+    run();
+    Timeline::stop();
+    std::ifstream file(path);
+    std::ostringstream contents;
+    contents << file.rdbuf();
+    text = contents.str();
+    std::remove(path);
+    
+    std::vector<Event> events;
+    std::regex complete("\\{\"name\": \"([^\"]+)\", \"cat\": \"([a-z]+)\", \"ph\": \"X\", "
+                        "\"ts\": ([0-9.]+), \"dur\": ([0-9.]+), \"pid\": 1, \"tid\": ([0-9]+)\\}");
+    for (std::sregex_iterator it(text.begin(), text.end(), complete), end; it != end; ++it) {
+        events.push_back({(*it)[1], (*it)[2], std::stod((*it)[3]), std::stod((*it)[4]), (*it)[5]});
+    }
+    return events;
+}
+
+const Event* find(const std::vector<Event>& events, const std::string& name) {
+    for (const Event& event : events) {
+        if (event.name == name) return &event;
+    }
+    return nullptr;
+}
+    
+} // namespace
+
+TEST(timelineRecordsCompileRunAwaitAndGc) {
+    std::string text;
+    std::vector<Event> events = record([]() {
+        captureOutput(1, []() {
+            VM vm;
+            vm.interpret("t = 0\nfor i in range(20000) {\n    a = array(100, i)\n    t = t + a[99]\n}\n"
+                         "await 5\nprint t\n");
+        });
+    }, text);
+    CHECK_EQ(text.rfind("{\"displayTimeUnit\": \"ns\", \"traceEvents\": [\n", 0), size_t(0));
+    CHECK(text.find("\"otherData\": {\"droppedEvents\": 0}}") != std::string::npos);
+    
+    for (const char* name : {"lex", "parse", "typecheck", "codegen"}) {
+        const Event* event = find(events, name);
+        CHECK(event != nullptr && event->category == "compile");
+    }
+    const Event* await = find(events, "await");
+    CHECK(await != nullptr && await->category == "task");
+    CHECK(await->duration >= 4000);
+    
+    // Collections happen inside a run, on the same clock.
+    const Event* minor = find(events, "minor");
+    CHECK(minor != nullptr);
+    CHECK_EQ(minor->category, std::string("gc"));
+    bool inRun = false;
+    for (const Event& event : events) {
+        inRun = inRun || (event.name == "run" && minor->start >= event.start &&
+                          minor->start + minor->duration <= event.start + event.duration);
+    }
+    CHECK(inRun);
+}
+
+TEST(timelineKeepsEachThreadApart) {
+    std::string text;
+    std::vector<Event> events = record([]() {
+        TimelineScope outer("vm", "run");
+        std::thread worker([]() {
+            Timeline::nameThread("test worker");
+            TimelineScope scope("task", "work");
+        });
+        worker.join();
+    }, text);
+    const Event* run = find(events, "run");
+    const Event* work = find(events, "work");
+    CHECK(run != nullptr && work != nullptr);
+    CHECK(run->thread != work->thread);
+    CHECK(text.find("\"tid\": " + work->thread + ", \"args\": {\"name\": \"test worker\"}") != std::string::npos);
+    
+    // Stopped, the scopes record nothing.
+    CHECK(!Timeline::enabled());
+    TimelineScope ignored("vm", "run");
+}
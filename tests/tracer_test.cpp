@@ -0,0 +1,122 @@
+#include <cstdio>
+#include <cstdlib>
+#include <sstream>
+#include <unistd.h>
+#include "../src/include/tracer.h"
+#include "../src/include/vm.h"
+#include "test.h"
+
+namespace {
+
+const char* const kLoop = "x = 1\nfor i in range(3) {\n    x = x + i\n}\nprint x\n";
+
+// The instructions of a text trace, without the stack lines.
+std::string withoutStacks(const std::string& trace) {
+    std::istringstream lines(trace);
+    std::string kept;
+    for (std::string line; std::getline(lines, line);) {
+        if (line.rfind("Stack:", 0) != 0) kept += line + "\n";
+    }
+    return kept;
+}
+
+size_t occurrences(const std::string& text, const std::string& part) {
+    size_t count = 0;
+    for (size_t at = text.find(part); at != std::string::npos; at = text.find(part, at + 1)) count++;
+    return count;
+}
+    
+} // namespace
+
+TEST(traceFiltersParseLinesAndOpCodes) {
+    TraceFilter filter;
+    CHECK(filter.parseLines("10-20"));
+    CHECK_EQ(filter.firstLine, 10);
+    CHECK_EQ(filter.lastLine, 20);
+    CHECK(filter.parseLines("7"));
+    CHECK_EQ(filter.lastLine, 7);
+    CHECK(!filter.parseLines("20-10"));
+    CHECK(!filter.parseLines("x"));
+    CHECK(!filter.parseLines("3-"));
+    CHECK(filter.parseOpCodes("ADD_INT,LOOP"));
+    CHECK(filter.opCodes[static_cast<uint8_t>(OpCode::LOOP)]);
+    CHECK(!filter.opCodes[static_cast<uint8_t>(OpCode::ADD)]);
+    CHECK(!filter.parseOpCodes("ADD_INT,NOPE"));
+}
+
+TEST(textTraceKeepsOnlyFilteredInstructions) {
+    TraceFilter filter;
+    filter.parseLines("3");
+    filter.parseOpCodes("ADD_INT");
+    std::ostringstream trace;
+    VM vm;
+    vm.setTracer(std::make_unique<Tracer>(vm.getChunk(), filter, trace));
+    captureOutput(1, [&]() { vm.interpret(kLoop); });
+    CHECK_EQ(trace.str(), std::string("Stack: [ 1 ][ 0 ][ 1 ][ 0 ]\n0019    | ADD_INT\n"
+                                      "Stack: [ 1 ][ 1 ][ 1 ][ 1 ]\n0019    | ADD_INT\n"
+                                      "Stack: [ 2 ][ 2 ][ 2 ][ 2 ]\n0019    | ADD_INT\n"));
+}
+
+TEST(binaryTraceReplaysLikeTheTextTrace) {
+    std::ostringstream text;
+    {
+        VM vm;
+        vm.setTracer(std::make_unique<Tracer>(vm.getChunk(), TraceFilter(), text));
+        captureOutput(1, [&]() { vm.interpret(kLoop); });
+    }
+    
+    char path[] = "/tmp/fusion-trace-XXXXXX";
+    close(mkstemp(path));
+    {
+        VM vm;
+        auto tracer = std::make_unique<Tracer>(vm.getChunk(), TraceFilter(), path);
+        CHECK(tracer->ok());
+        vm.setTracer(std::move(tracer));
+        captureOutput(1, [&]() { vm.interpret(kLoop); });
+        vm.getTracer()->close();
+    }
+    std::ostringstream replay, errors;
+    bool replayed = replayTrace(path, replay, errors);
+    std::remove(path);
+    CHECK(replayed);
+    CHECK_EQ(replay.str(), "== trace ==\n" + withoutStacks(text.str()));
+    CHECK_EQ(occurrences(replay.str(), "LOOP -> 0008 (loop 0)"), size_t(3));
+}
+
+TEST(binaryTraceEndsWhenAnotherScriptLoads) {
+    // The trace holds one chunk, so it stops with the script it recorded.
+    std::ostringstream text;
+    {
+        VM vm;
+        vm.setTracer(std::make_unique<Tracer>(vm.getChunk(), TraceFilter(), text));
+        captureOutput(1, [&]() { vm.interpret(kLoop); });
+    }
+    
+    char path[] = "/tmp/fusion-trace-XXXXXX";
+    close(mkstemp(path));
+    {
+        VM vm;
+        vm.setTracer(std::make_unique<Tracer>(vm.getChunk(), TraceFilter(), path));
+        captureOutput(1, [&]() {
+            vm.interpret(kLoop);
+            vm.interpret("print 5\n");
+        });
+    }
+    std::ostringstream replay, errors;
+    bool replayed = replayTrace(path, replay, errors);
+    std::remove(path);
+    CHECK(replayed);
+    CHECK_EQ(replay.str(), "== trace ==\n" + withoutStacks(text.str()));
+}
+
+TEST(replayRejectsFilesThatAreNotTraces) {
+    char path[] = "/tmp/fusion-trace-XXXXXX";
+    int fd = mkstemp(path);
+    CHECK(write(fd, "print 1\n", 8) == 8);
+    close(fd);
+    std::ostringstream replay, errors;
+    bool replayed = replayTrace(path, replay, errors);
+    std::remove(path);
+    CHECK(!replayed);
+    CHECK(!errors.str().empty());
+}
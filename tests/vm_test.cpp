@@ -0,0 +1,104 @@
+#include <sstream>
+#include <thread>
+#include <vector>
+#include "../src/include/metrics.h"
+#include "../src/include/program.h"
+#include "../src/include/vm.h"
+#include "test.h"
+
+TEST(programsThatDoNotCompileAreCompileErrors) {
+    std::shared_ptr<const Program> program;
+    std::string errors = captureOutput(2, [&]() { program = Program::compile("print y\n"); });
+    CHECK(program == nullptr);
+    CHECK(!errors.empty());
+    
+    VM vm;
+    CHECK(vm.interpret(program) == InterpretResult::COMPILE_ERROR);
+    CHECK(vm.status() == InterpretResult::COMPILE_ERROR);
+    
+    // A failed load leaves the program loaded before it in place.
+    CHECK(vm.load(Program::compile("print 1 + 2\n")));
+    CHECK(!vm.load(program));
+    InterpretResult result = InterpretResult::COMPILE_ERROR;
+    CHECK_EQ(captureOutput(1, [&]() { result = vm.run(); }), std::string("3\n"));
+    CHECK(result == InterpretResult::OK);
+}
+
+TEST(oneProgramRunsOnManyVMsAtOnce) {
+    std::shared_ptr<const Program> program = Program::compile(
+        "s = \"\"\nt = 0\nfor i in range(20000) {\n    t = t + i % 7\n    s = s + \"x\"\n}\nprint t\n");
+    CHECK(program != nullptr);
+    const int vms = 8;
+    std::vector<InterpretResult> results(vms, InterpretResult::COMPILE_ERROR);
+    std::string output = captureOutput(1, [&]() {
+        std::vector<std::thread> threads;
+        for (int i = 0; i < vms; i++) {
+            threads.emplace_back([&, i]() {
+                VM vm;
+                results[i] = vm.interpret(program);
+            });
+        }
+        for (auto& thread : threads) thread.join();
+    });
+    
+    std::istringstream lines(output);
+    std::string line;
+    int printed = 0;
+    while (std::getline(lines, line)) {
+        CHECK_EQ(line, std::string("59997"));
+        printed++;
+    }
+    CHECK_EQ(printed, vms);
+    for (InterpretResult result : results) {
+        CHECK(result == InterpretResult::OK);
+    }
+}
+
+TEST(loadingSourceAgainReplacesTheLastScript) {
+    VM vm;
+    std::string output = captureOutput(1, [&]() {
+        CHECK(vm.interpret("t = 0\nfor i in range(5000) {\n    t = t + 1\n}\nprint t\n") == InterpretResult::OK);
+        CHECK(vm.interpret("x = \"a\"\nprint x + \"b\"\n") == InterpretResult::OK);
+    });
+    CHECK_EQ(output, std::string("5000\nab\n"));
+}
+
+TEST(runsOutOfFuelAtBackEdgesAndContinues) {
+    // 100000 back edges at 1000 a run: about a hundred preemptions, each
+    // picking up where the last one stopped.
+    VM vm;
+    vm.setFuel(1000);
+    CHECK(vm.load("t = 0\nfor i in range(100000) {\n    t = t + i % 7\n}\nprint t\n"));
+    uint64_t before = Metrics::collect()[Metric::PREEMPTIONS];
+    int preemptions = 0;
+    InterpretResult result = InterpretResult::PREEMPTED;
+    std::string output = captureOutput(1, [&]() {
+        while ((result = vm.run()) == InterpretResult::PREEMPTED) preemptions++;
+    });
+    CHECK(result == InterpretResult::OK);
+    CHECK_EQ(output, std::string("299995\n"));
+    CHECK(preemptions >= 90 && preemptions <= 100);
+    CHECK(Metrics::collect()[Metric::PREEMPTIONS] - before >= uint64_t(preemptions));
+    
+    // Straight-line code is never checked, however little fuel there is.
+    vm.setFuel(1);
+    CHECK(vm.load("x = 1\ny = x + 2\nz = y * 3\n"));
+    CHECK(vm.run() == InterpretResult::OK);
+}
+
+TEST(fuelTimeSlicesVMsSharingALoop) {
+    // A runaway script started first must not hold up a short one: they
+    // take turns, so the short one finishes long before it.
+    EventLoop loop;
+    VM runaway(loop);
+    VM quick(loop);
+    runaway.setFuel(1000);
+    quick.setFuel(1000);
+    CHECK(runaway.start("t = 0\nfor i in range(3000000) {\n    t = t + 1\n}\n") == InterpretResult::SUSPENDED);
+    CHECK(quick.start("t = 0\nfor i in range(10000) {\n    t = t + 1\n}\n") == InterpretResult::SUSPENDED);
+    while (quick.status() == InterpretResult::SUSPENDED) loop.runOnce(-1);
+    CHECK(quick.status() == InterpretResult::OK);
+    CHECK(runaway.status() == InterpretResult::SUSPENDED);
+    loop.run();
+    CHECK(runaway.status() == InterpretResult::OK);
+}